@@ -50,6 +50,7 @@ void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*
 {
 	try {
 		std::vector<AssetTrackingTuple*>& vec = m_mgtClient->getAssetTrackingTuples(m_service);
+		lock_guard<mutex> guard(m_mutex);
 		for (AssetTrackingTuple* & rec : vec)
 		{
 			assetTrackerTuplesCache.insert(rec);
@@ -74,6 +75,7 @@ void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*
 bool AssetTracker::checkAssetTrackingCache(AssetTrackingTuple& tuple)	
 {
 	AssetTrackingTuple *ptr = &tuple;
+	lock_guard<mutex> guard(m_mutex);
 	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(ptr);
 	if (it == assetTrackerTuplesCache.end())
 	{
@@ -86,6 +88,7 @@ bool AssetTracker::checkAssetTrackingCache(AssetTrackingTuple& tuple)
 AssetTrackingTuple* AssetTracker::findAssetTrackingCache(AssetTrackingTuple& tuple)	
 {
 	AssetTrackingTuple *ptr = &tuple;
+	lock_guard<mutex> guard(m_mutex);
 	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(ptr);
 	if (it == assetTrackerTuplesCache.end())
 	{
@@ -100,23 +103,40 @@ AssetTrackingTuple* AssetTracker::findAssetTrackingCache(AssetTrackingTuple& tup
 /**
  * Add asset tracking tuple via microservice management API and in cache
  *
+ * The cache lock is not held during the call to the management API, so
+ * that other threads checking the cache are not held up by it. The tuple
+ * is recorded as pending whilst the call is made, so that only one thread
+ * adds a tuple that is seen by several threads at the same time.
+ *
  * @param tuple		New tuple to add in DB and in cache
  */
 void AssetTracker::addAssetTrackingTuple(AssetTrackingTuple& tuple)
 {
-	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(&tuple);
-	if (it == assetTrackerTuplesCache.end())
+	AssetTrackingTuple *ptr;
 	{
-		bool rv = m_mgtClient->addAssetTrackingTuple(tuple.m_serviceName, tuple.m_pluginName, tuple.m_assetName, tuple.m_eventName);
-		if (rv) // insert into cache only if DB operation succeeded
+		lock_guard<mutex> guard(m_mutex);
+		if (assetTrackerTuplesCache.find(&tuple) != assetTrackerTuplesCache.end()
+				|| m_pendingTuples.find(&tuple) != m_pendingTuples.end())
 		{
-			AssetTrackingTuple *ptr = new AssetTrackingTuple(tuple);
-			assetTrackerTuplesCache.insert(ptr);
-			Logger::getLogger()->info("addAssetTrackingTuple(): Added tuple to cache: '%s'", tuple.assetToString().c_str());
+			return;
 		}
-		else
-			Logger::getLogger()->error("addAssetTrackingTuple(): Failed to insert asset tracking tuple into DB: '%s'", tuple.assetToString().c_str());
+		ptr = new AssetTrackingTuple(tuple);
+		m_pendingTuples.insert(ptr);
 	}
+	bool rv = m_mgtClient->addAssetTrackingTuple(tuple.m_serviceName, tuple.m_pluginName, tuple.m_assetName, tuple.m_eventName);
+	bool cached = false;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_pendingTuples.erase(ptr);
+		// insert into cache only if DB operation succeeded
+		cached = rv && assetTrackerTuplesCache.insert(ptr).second;
+	}
+	if (!cached)
+		delete ptr;
+	if (rv)
+		Logger::getLogger()->info("addAssetTrackingTuple(): Added tuple to cache: '%s'", tuple.assetToString().c_str());
+	else
+		Logger::getLogger()->error("addAssetTrackingTuple(): Failed to insert asset tracking tuple into DB: '%s'", tuple.assetToString().c_str());
 }
 
 /**
@@ -18,168 +18,231 @@
 #include <exception>
 #include <base64databuffer.h>
 #include <base64dpimage.h>
+#include <reading_json_writer.h>
 
- /**
+/**
  * Return the value as a string
  *
  * @return	String representing the DatapointValue object
  */
 std::string DatapointValue::toString() const
 {
-	std::ostringstream ss;
-
-	switch (m_type)
-	{
-	case T_INTEGER:
-		ss << m_value.i;
-		return ss.str();
-	case T_FLOAT:
-		{
-			char tmpBuffer[100];
-			std::string s;
-
-			snprintf(tmpBuffer, sizeof(tmpBuffer), "%.10f", m_value.f);
-			s= tmpBuffer;
+	std::string rval;
 
-			// remove trailing 0's
-			if (s[s.size()-1]== '0') {
-				s.erase(s.find_last_not_of('0') + 1, std::string::npos);
+	ReadingJSONWriter(rval).value(*this);
+	return rval;
+}
 
-				// add '0' i
-				if (s[s.size()-1]== '.')
-					s.append("0");
+/**
+ * Return asset reading data point as a JSON
+ * property that can be included within a JSON
+ * document.
+ */
+std::string Datapoint::toJSONProperty()
+{
+	std::string rval;
 
-			}
+	ReadingJSONWriter(rval).datapoint(*this);
+	return rval;
+}
 
-			return s;
-		}
-	case T_FLOAT_ARRAY:
-		ss << "[";
-		for (auto it = m_value.a->begin();
-		     it != m_value.a->end();
-		     ++it)
-		{
-			if (it != m_value.a->begin())
-			{
-				ss << ", ";
-			}
-			ss << *it;
-		}
-		ss << "]";
-		return ss.str();
-	case T_DP_DICT:
-	case T_DP_LIST:
-		ss << ((m_type==T_DP_DICT)?'{':'[');
-		for (auto it = m_value.dpa->begin(); // std::vector<Datapoint *>*	dpa;
-		     it != m_value.dpa->end();
-		     ++it)
-		{
-			if (it != m_value.dpa->begin())
-			{
-				ss << ", ";
-			}
-			ss << ((m_type==T_DP_DICT)?(*it)->toJSONProperty():(*it)->getData().toString());
-		}
-		ss << ((m_type==T_DP_DICT)?'}':']');
-		return ss.str();
-	case T_STRING:
-		ss << "\"";
-		ss << escape(*m_value.str);
-		ss << "\"";
-		return ss.str();
-	case T_DATABUFFER:
-		ss << "\"__DATABUFFER:" 
-			<< ((Base64DataBuffer *)m_value.dataBuffer)->encode()
-			<< "\"";
-		return ss.str();
-	case T_IMAGE:
-		ss << "\"__DPIMAGE:" 
-			<< ((Base64DPImage *)m_value.image)->encode()
-			<< "\"";
-		return ss.str();
-	case T_2D_FLOAT_ARRAY:
-		{
-		ss << "[ ";
-		bool first = true;
-		for (auto row : *(m_value.a2d))
-		{
-			if (first)
-				first = false;
-			else
-				ss << ", ";
-			ss << "[";
-			for (auto it = row->begin();
-			     it != row->end();
-			     ++it)
-			{
-				if (it != row->begin())
-				{
-					ss << ", ";
-				}
-				ss << *it;
-			}
-			ss << "]";
-		}
-		ss << " ]";
-		return ss.str();
-		}
-	default:
-		throw std::runtime_error("No string representation for datapoint type");
-	}
+/**
+ * Construct a 2D array from a set of rows
+ *
+ * @param rows	The rows of the array
+ */
+Float2DArray::Float2DArray(const std::vector< std::vector<double> *>& rows) : m_view(NULL), m_hasView(false)
+{
+	size_t total = 0;
+	for (auto row : rows)
+		total += row->size();
+	m_values.reserve(total);
+	m_offsets.reserve(rows.size() + 1);
+	m_offsets.push_back(0);
+	for (auto row : rows)
+		addRow(row->data(), row->size());
 }
 
 /**
- * Delete the DatapointValue along with possibly nested Datapoint objects
+ * Copy constructor, the copy always holds its values contiguously
+ *
+ * @param rhs	The array to copy
  */
-void DatapointValue::deleteNestedDPV()
+Float2DArray::Float2DArray(const Float2DArray& rhs) : m_view(NULL), m_hasView(false)
 {
-	if (m_type == T_STRING)
+	if (rhs.m_hasView.load(std::memory_order_acquire))
 	{
-		delete m_value.str;
-		m_value.str = NULL;
+		m_offsets.reserve(rhs.rows() + 1);
+		m_offsets.push_back(0);
+		for (size_t i = 0; i < rhs.rows(); i++)
+			addRow(rhs.row(i), rhs.rowLength(i));
 	}
-	else if (m_type == T_FLOAT_ARRAY)
+	else
 	{
-		delete m_value.a;
-		m_value.a = NULL;
+		m_values = rhs.m_values;
+		m_offsets = rhs.m_offsets;
 	}
-	else if (m_type == T_IMAGE)
-	{
-		delete m_value.image;
-		m_value.a = NULL;
-	}
-	else if (m_type == T_DATABUFFER)
+}
+
+/**
+ * Move constructor, the array moved from is left empty
+ *
+ * @param rhs	The array to move
+ */
+Float2DArray::Float2DArray(Float2DArray&& rhs) : m_values(std::move(rhs.m_values)),
+	m_offsets(std::move(rhs.m_offsets)), m_view(rhs.m_view),
+	m_hasView(rhs.m_hasView.load())
+{
+	rhs.m_values.clear();
+	rhs.m_offsets.assign(1, 0);
+	rhs.m_view = NULL;
+	rhs.m_hasView = false;
+}
+
+/**
+ * Destructor for a 2D array, deleting the rows if they were created
+ */
+Float2DArray::~Float2DArray()
+{
+	if (m_view)
 	{
-		delete m_value.dataBuffer;
-		m_value.dataBuffer = NULL;
+		for (auto row : *m_view)
+			delete row;
+		delete m_view;
 	}
-	else if (m_type == T_IMAGE)
+}
+
+/**
+ * Return the array as a vector of rows, as used by earlier versions
+ * of DatapointValue. The rows are created on the first call, several
+ * threads may read the same const value so the creation is serialised.
+ * From then on the rows hold the values of the array, the contiguous
+ * values are left in place for the readers that may still be using
+ * them.
+ *
+ * @return	The rows of the array
+ */
+const std::vector< std::vector<double>* >* Float2DArray::view()
+{
+	if (m_hasView.load(std::memory_order_acquire))
+		return m_view;
+
+	std::lock_guard<std::mutex> guard(m_viewMutex);
+	if (!m_hasView.load(std::memory_order_relaxed))
 	{
-		delete m_value.image;
-		m_value.image = NULL;
+		std::vector< std::vector<double>* > *rowVectors = new std::vector< std::vector<double>* >;
+		rowVectors->reserve(m_offsets.size() - 1);
+		for (size_t i = 0; i + 1 < m_offsets.size(); i++)
+			rowVectors->push_back(new std::vector<double>(m_values.data() + m_offsets[i],
+						m_values.data() + m_offsets[i + 1]));
+		m_view = rowVectors;
+		m_hasView.store(true, std::memory_order_release);
 	}
-	else if (m_type == T_DP_DICT ||
-		 m_type == T_DP_LIST)
+	return m_view;
+}
+
+/**
+ * Return the rows of the array for the caller to change, as returned
+ * by earlier versions of DatapointValue. Rows and values may be added,
+ * changed or removed through the returned vector.
+ *
+ * @return	The rows of the array
+ */
+std::vector< std::vector<double>* >*& Float2DArray::rowVectors()
+{
+	view();
+	// Nothing reads the contiguous values once the rows exist
+	std::vector<double>().swap(m_values);
+	m_offsets.assign(1, 0);
+	return m_view;
+}
+
+/**
+ * Delete the DatapointValue along with possibly nested Datapoint objects.
+ * The value is left as the integer 0.
+ */
+void DatapointValue::deleteNestedDPV()
+{
+	switch (m_type)
 	{
-		if (m_value.dpa) {
-			for (auto it = m_value.dpa->begin();
-				 it != m_value.dpa->end();
-				 ++it)
-			{
-				// Call DatapointValue destructor
-				delete(*it);
-			}
+		case T_STRING:
+			m_value.str.~basic_string();
+			break;
+		case T_FLOAT_ARRAY:
+			ReadingArena::destroy(m_value.a);
+			break;
+		case T_IMAGE:
+			delete m_value.image;
+			break;
+		case T_DATABUFFER:
+			delete m_value.dataBuffer;
+			break;
+		case T_DP_DICT:
+		case T_DP_LIST:
+			if (m_value.dpa) {
+				for (auto it = m_value.dpa->begin();
+					 it != m_value.dpa->end();
+					 ++it)
+				{
+					// Call DatapointValue destructor
+					delete(*it);
+				}
 
-			// Remove vector pointer
-			delete m_value.dpa;
-			m_value.dpa = NULL;
-		}
+				// Remove vector pointer
+				ReadingArena::destroy(m_value.dpa);
+			}
+			break;
+		case T_2D_FLOAT_ARRAY:
+			ReadingArena::destroy(m_value.a2d);
+			break;
+		default:
+			break;
 	}
-	else if (m_type == T_2D_FLOAT_ARRAY)
+	m_type = T_INTEGER;
+	m_value.i = 0;
+}
+
+/**
+ * Take over the value held by another DatapointValue, leaving
+ * that value as the integer 0. This value must not hold a value
+ * that needs to be deleted.
+ *
+ * @param obj	The value to move from
+ */
+void DatapointValue::moveFrom(DatapointValue& obj) noexcept
+{
+	m_type = obj.m_type;
+	switch (m_type)
 	{
-		delete m_value.a2d;
-		m_value.a2d = NULL;
+		case T_STRING:
+			new (&m_value.str) std::string(std::move(obj.m_value.str));
+			obj.m_value.str.~basic_string();
+			break;
+		case T_INTEGER:
+			m_value.i = obj.m_value.i;
+			break;
+		case T_FLOAT:
+			m_value.f = obj.m_value.f;
+			break;
+		case T_FLOAT_ARRAY:
+			m_value.a = obj.m_value.a;
+			break;
+		case T_DP_DICT:
+		case T_DP_LIST:
+			m_value.dpa = obj.m_value.dpa;
+			break;
+		case T_IMAGE:
+			m_value.image = obj.m_value.image;
+			break;
+		case T_DATABUFFER:
+			m_value.dataBuffer = obj.m_value.dataBuffer;
+			break;
+		case T_2D_FLOAT_ARRAY:
+			m_value.a2d = obj.m_value.a2d;
+			break;
 	}
+	obj.m_type = T_INTEGER;
+	obj.m_value.i = 0;
 }
 
 /**
@@ -201,14 +264,21 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
 	switch (m_type)
 	{
 		case T_STRING:
-			m_value.str = new std::string(*(obj.m_value.str));
+			new (&m_value.str) std::string(obj.m_value.str);
+			break;
+		case T_INTEGER:
+			m_value.i = obj.m_value.i;
+			break;
+		case T_FLOAT:
+			m_value.f = obj.m_value.f;
 			break;
 		case T_FLOAT_ARRAY:
-			m_value.a = new std::vector<double>(*(obj.m_value.a));
+			m_value.a = ReadingArena::create<std::vector<double>>(*(obj.m_value.a));
 			break;
 		case T_DP_DICT:
 		case T_DP_LIST:
-			m_value.dpa = new std::vector<Datapoint*>();
+			m_value.dpa = ReadingArena::create<std::vector<Datapoint*>>();
+			m_value.dpa->reserve(obj.m_value.dpa->size());
 			for (auto it = obj.m_value.dpa->begin();
 				it != obj.m_value.dpa->end();
 				++it)
@@ -227,20 +297,7 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
 			m_value.dataBuffer = new DataBuffer(*(obj.m_value.dataBuffer));
 			break;
 		case T_2D_FLOAT_ARRAY:
-			m_value.a2d = new std::vector< std::vector<double>* >;
-			for (auto row : *obj.m_value.a2d)
-			{
-				std::vector<double> *nrow = new std::vector<double>;
-				for (auto& d : *row)
-				{
-					nrow->push_back(d);
-				}
-				m_value.a2d->push_back(nrow);
-			}
-			m_type = T_2D_FLOAT_ARRAY;
-			break;
-		default:
-			m_value = obj.m_value;
+			m_value.a2d = ReadingArena::create<Float2DArray>(*(obj.m_value.a2d));
 			break;
 	}
 }
@@ -250,110 +307,16 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
  */
 DatapointValue& DatapointValue::operator=(const DatapointValue& rhs)
 {
-	if (m_type == T_STRING)
-	{
-		// Remove previous value
-		delete m_value.str;
-	}
-	if (m_type == T_FLOAT_ARRAY)
-	{
-		// Remove previous value
-		delete m_value.a;
-	}
-	if (m_type == T_DP_DICT || m_type == T_DP_LIST)
-	{
-		// Remove previous value
-		delete m_value.dpa;
-	}
-	if (m_type == T_IMAGE)
-	{
-		delete m_value.image;
-	}
-	if (m_type == T_DATABUFFER)
-	{
-		delete m_value.dataBuffer;
-	}
-	if (m_type == T_2D_FLOAT_ARRAY)
-	{
-		delete m_value.a2d;
-	}
-
-	m_type = rhs.m_type;
-
-	switch (m_type)
+	if (this != &rhs)
 	{
-	case T_STRING:
-		m_value.str = new std::string(*(rhs.m_value.str));
-		break;
-	case T_FLOAT_ARRAY:
-		m_value.a = new std::vector<double>(*(rhs.m_value.a));
-		break;
-	case T_DP_DICT:
-	case T_DP_LIST:
-		m_value.dpa = new std::vector<Datapoint*>(*(rhs.m_value.dpa));
-		break;
-	case T_IMAGE:
-		m_value.image = new DPImage(*(rhs.m_value.image));
-		break;
-	case T_DATABUFFER:
-		m_value.dataBuffer = new DataBuffer(*(rhs.m_value.dataBuffer));
-		break;
-	case T_2D_FLOAT_ARRAY:
-		m_value.a2d = new std::vector< std::vector<double>* >;
-		for (auto row : *(rhs.m_value.a2d))
-		{
-			std::vector<double> *nrow = new std::vector<double>;
-			for (auto& d : *row)
-			{
-				nrow->push_back(d);
-			}
-			m_value.a2d->push_back(nrow);
-		}
-		m_type = T_2D_FLOAT_ARRAY;
-		break;
-	default:
-		m_value = rhs.m_value;
-		break;
+		// Copy first, rhs may be nested within this value
+		DatapointValue copy(rhs);
+		deleteNestedDPV();
+		moveFrom(copy);
 	}
-
 	return *this;
 }
 
-/**
- * Escape quotes etc to allow the string to be a property value within
- * a JSON document
- *
- * @param str	The string to escape
- * @return The escaped string
- */
-const std::string DatapointValue::escape(const std::string& str) const
-{
-std::string rval;
-int bscount = 0;
-
-	for (size_t i = 0; i < str.length(); i++)
-	{
-		if (str[i] == '\\')
-		{
-			bscount++;
-		}
-		else if (str[i] == '\"')
-		{
-			if ((bscount & 1) == 0)	// not already escaped
-			{
-				rval += "\\";	// Add escape of "
-			}
-			bscount = 0;
-		}
-		else
-		{
-			bscount = 0;
-		}
-		rval += str[i];
-	}
-	return rval;
-}
-
 /**
  * Parsing a Json string
  * 
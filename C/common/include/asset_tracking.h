@@ -13,6 +13,7 @@
 #include <vector>
 #include <sstream>
 #include <unordered_set>
+#include <mutex>
 #include <management_client.h>
 
 /**
@@ -136,7 +137,10 @@ private:
 	static AssetTracker	*instance;
 	ManagementClient	*m_mgtClient;
 	std::string		m_service;
+	std::mutex		m_mutex;	// The cache is used by the filter and ingest threads
 	std::unordered_set<AssetTrackingTuple*, std::hash<AssetTrackingTuple*>, AssetTrackingTuplePtrEqual>	assetTrackerTuplesCache;
+	// Tuples being added via the management API by another thread
+	std::unordered_set<AssetTrackingTuple*, std::hash<AssetTrackingTuple*>, AssetTrackingTuplePtrEqual>	m_pendingTuples;
 };
 
 #endif
@@ -14,17 +14,109 @@
 #include <iomanip>
 #include <cfloat>
 #include <vector>
+#include <new>
+#include <mutex>
+#include <atomic>
 #include <logger.h>
 #include <dpimage.h>
 #include <databuffer.h>
+#include <interned_string.h>
+#include <reading_arena.h>
 #include <rapidjson/document.h>
 
 class Datapoint;
+
+/**
+ * A two dimensional array of floating point values. The values of all
+ * the rows are held in a single contiguous block, row by row, rows may
+ * be of different lengths.
+ *
+ * Once the rows have been requested as a vector of row vectors, the
+ * representation used by earlier versions, those vectors hold the
+ * values of the array and the contiguous block is no longer used.
+ */
+class Float2DArray {
+	public:
+		Float2DArray() : m_offsets(1, 0), m_view(NULL), m_hasView(false) {};
+		Float2DArray(const std::vector< std::vector<double> *>& rows);
+		Float2DArray(const Float2DArray& rhs);
+		Float2DArray(Float2DArray&& rhs);
+		~Float2DArray();
+
+		/**
+		 * Append a row to the array
+		 */
+		void		addRow(const double *values, size_t count)
+				{
+					if (m_hasView.load(std::memory_order_acquire))
+					{
+						m_view->push_back(new std::vector<double>(values, values + count));
+						return;
+					}
+					m_values.insert(m_values.end(), values, values + count);
+					m_offsets.push_back(m_values.size());
+				};
+		/**
+		 * Append a row of the given length to the array, returning
+		 * a pointer to the values of the row for the caller to fill
+		 */
+		double		*appendRow(size_t count)
+				{
+					if (m_hasView.load(std::memory_order_acquire))
+					{
+						m_view->push_back(new std::vector<double>(count));
+						return m_view->back()->data();
+					}
+					m_values.resize(m_values.size() + count);
+					m_offsets.push_back(m_values.size());
+					return m_values.data() + m_offsets[m_offsets.size() - 2];
+				};
+		size_t		rows() const
+				{
+					if (m_hasView.load(std::memory_order_acquire))
+						return m_view->size();
+					return m_offsets.size() - 1;
+				};
+		size_t		rowLength(size_t row) const
+				{
+					if (m_hasView.load(std::memory_order_acquire))
+						return (*m_view)[row]->size();
+					return m_offsets[row + 1] - m_offsets[row];
+				};
+		const double	*row(size_t row) const
+				{
+					if (m_hasView.load(std::memory_order_acquire))
+						return (*m_view)[row]->data();
+					return m_values.data() + m_offsets[row];
+				};
+		const std::vector< std::vector<double>* >*
+				view();
+		std::vector< std::vector<double>* >*&
+				rowVectors();
+
+	private:
+		Float2DArray&	operator=(const Float2DArray&);
+		std::vector<double>	m_values;
+		std::vector<size_t>	m_offsets;	// Start of each row, plus the end of the last
+		std::vector< std::vector<double>* >
+					*m_view;
+		std::atomic<bool>	m_hasView;	// The values are held in m_view
+		std::mutex		m_viewMutex;	// Serialises the creation of m_view
+};
+
 /**
  * Class to hold an actual reading value.
  * The class is simply a tagged union that also contains
  * methods to return the value as a string for encoding
  * in a JSON document.
+ *
+ * Strings are held within the union itself, so short strings need no
+ * heap allocation at all. Values may be moved rather than copied, a
+ * moved from value is left holding the integer 0.
+ *
+ * The arrays and nested datapoint vectors are created in the current
+ * ReadingArena of the thread if there is one, they are deleted by the
+ * value and must not be deleted by its users.
  */
 class DatapointValue {
 	public:
@@ -33,7 +125,15 @@ class DatapointValue {
 		 */
 		DatapointValue(const std::string& value)
 		{
-			m_value.str = new std::string(value);
+			new (&m_value.str) std::string(value);
+			m_type = T_STRING;
+		};
+		/**
+		 * Construct with a string, taking over its contents
+		 */
+		DatapointValue(std::string&& value)
+		{
+			new (&m_value.str) std::string(std::move(value));
 			m_type = T_STRING;
 		};
 		/**
@@ -57,7 +157,16 @@ class DatapointValue {
 		 */
 		DatapointValue(const std::vector<double>& values)
 		{
-			m_value.a = new std::vector<double>(values);
+			m_value.a = ReadingArena::create<std::vector<double>>(values);
+			m_type = T_FLOAT_ARRAY;
+		};
+		/**
+		 * Construct with an array of floating point values,
+		 * taking over the contents of the vector
+		 */
+		DatapointValue(std::vector<double>&& values)
+		{
+			m_value.a = ReadingArena::create<std::vector<double>>(std::move(values));
 			m_type = T_FLOAT_ARRAY;
 		};
 
@@ -112,16 +221,17 @@ class DatapointValue {
 		 */
 		DatapointValue(const std::vector< std::vector<double> *>& values)
 		{
-			m_value.a2d = new std::vector< std::vector<double>* >;
-			for (auto row : values)
-			{
-				std::vector<double> *nrow = new std::vector<double>;
-				for (auto& d : *row)
-				{
-					nrow->push_back(d);
-				}
-				m_value.a2d->push_back(nrow);
-			}
+			m_value.a2d = ReadingArena::create<Float2DArray>(values);
+			m_type = T_2D_FLOAT_ARRAY;
+		};
+
+		/**
+		 * Construct with a 2 dimentional array of floating point values,
+		 * taking over the contents of the array
+		 */
+		DatapointValue(Float2DArray&& values)
+		{
+			m_value.a2d = ReadingArena::create<Float2DArray>(std::move(values));
 			m_type = T_2D_FLOAT_ARRAY;
 		};
 
@@ -130,11 +240,34 @@ class DatapointValue {
 		 */
 		DatapointValue(const DatapointValue& obj);
 
+		/**
+		 * Move constructor
+		 */
+		DatapointValue(DatapointValue&& obj) noexcept
+		{
+			moveFrom(obj);
+		};
+
 		/**
 		 * Assignment Operator
 		 */
 		DatapointValue& operator=(const DatapointValue& rhs);
 
+		/**
+		 * Move assignment Operator
+		 */
+		DatapointValue& operator=(DatapointValue&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				// Move first, rhs may be nested within this value
+				DatapointValue moved(std::move(rhs));
+				deleteNestedDPV();
+				moveFrom(moved);
+			}
+			return *this;
+		};
+
 		/**
 		 * Destructor
 		 */
@@ -148,6 +281,7 @@ class DatapointValue {
 		 */
 		void setValue(long value)
 		{
+			deleteNestedDPV();
 			m_value.i = value;
 			m_type = T_INTEGER;
 		}
@@ -159,6 +293,7 @@ class DatapointValue {
 		 */
 		void setValue(double value)
 		{
+			deleteNestedDPV();
 			m_value.f = value;
 			m_type = T_FLOAT;
 		}
@@ -168,7 +303,9 @@ class DatapointValue {
 		 */
 		void setValue(const DPImage& value)
 		{
-			m_value.image = new DPImage(value);
+			DPImage *image = new DPImage(value);
+			deleteNestedDPV();
+			m_value.image = image;
 			m_type = T_IMAGE;
 		}
 
@@ -180,7 +317,13 @@ class DatapointValue {
 		/**
 		 * Return string value without trailing/leading quotes
 		 */
-		std::string	toStringValue() const { return *m_value.str; };
+		std::string	toStringValue() const { return m_value.str; };
+
+		/**
+		 * Return a reference to the string value, the value
+		 * must be of type T_STRING
+		 */
+		const std::string&	getStringRef() const { return m_value.str; };
 
 		/**
 		 * Return long value
@@ -237,6 +380,10 @@ class DatapointValue {
 		{
 			return m_value.dpa;
 		}
+		std::vector<Datapoint*>* const& getDpVec() const
+		{
+			return m_value.dpa;
+		}
 
 		/**
 		 * Return array of float
@@ -245,11 +392,32 @@ class DatapointValue {
 		{
 			return m_value.a;
 		}
+		std::vector<double>* const& getDpArr() const
+		{
+			return m_value.a;
+		}
 
 		/**
-		 * Return 2D array of float
+		 * Return 2D array of float as a vector of rows.
+		 * The rows are created from the contiguous values
+		 * the first time they are requested and hold the values
+		 * of the array from then on, changes made to them are
+		 * part of the datapoint value. Use get2DArray to read
+		 * the values without creating the rows.
 		 */
 		std::vector<std::vector<double>* >*& getDp2DArr()
+		{
+			return m_value.a2d->rowVectors();
+		}
+		const std::vector<std::vector<double>* >* getDp2DArr() const
+		{
+			return m_value.a2d->view();
+		}
+
+		/**
+		 * Return the 2D array of float
+		 */
+		const Float2DArray *get2DArray() const
 		{
 			return m_value.a2d;
 		}
@@ -257,7 +425,7 @@ class DatapointValue {
 		/**
 		 * Return the Image
 		 */
-		DPImage *getImage()
+		DPImage *getImage() const
 		{
 			return m_value.image;
 		}
@@ -265,16 +433,19 @@ class DatapointValue {
 		/**
 		 * Return the DataBuffer
 		 */
-		DataBuffer *getDataBuffer()
+		DataBuffer *getDataBuffer() const
 		{
 			return m_value.dataBuffer;
 		}
 
 	private:
+		friend class ReadingJSONWriter;
 		void deleteNestedDPV();
-		const std::string	escape(const std::string& str) const;
+		void moveFrom(DatapointValue& obj) noexcept;
 		union data_t {
-			std::string*		str;
+			data_t() {};
+			~data_t() {};
+			std::string		str;
 			long			i;
 			double			f;
 			std::vector<double>*	a;
@@ -282,8 +453,7 @@ class DatapointValue {
 						*dpa;
 			DPImage			*image;
 			DataBuffer		*dataBuffer;
-			std::vector< std::vector<double>* >
-						*a2d;
+			Float2DArray		*a2d;
 			} m_value;
 		DatapointTag	m_type;
 };
@@ -291,6 +461,9 @@ class DatapointValue {
 /**
  * Name and value pair used to represent a data value
  * within an asset reading.
+ *
+ * The name is interned, the datapoint itself is allocated from the
+ * current ReadingArena of the thread if there is one.
  */
 class Datapoint {
 	public:
@@ -301,7 +474,31 @@ class Datapoint {
 		{
 		}
 
-		~Datapoint()
+		/**
+		 * Construct with a data point value
+		 */
+		Datapoint(const char *name, DatapointValue& value) : m_name(name), m_value(value)
+		{
+		}
+
+		/**
+		 * Construct with an already interned name
+		 */
+		Datapoint(const InternedString& name, DatapointValue& value) : m_name(name), m_value(value)
+		{
+		}
+
+		/**
+		 * Construct with a data point value that is moved
+		 * into the datapoint rather than copied
+		 */
+		Datapoint(const std::string& name, DatapointValue&& value) : m_name(name), m_value(std::move(value))
+		{
+		}
+		Datapoint(const char *name, DatapointValue&& value) : m_name(name), m_value(std::move(value))
+		{
+		}
+		Datapoint(const InternedString& name, DatapointValue&& value) : m_name(name), m_value(std::move(value))
 		{
 		}
 		/**
@@ -309,18 +506,25 @@ class Datapoint {
 		 * property that can be included within a JSON
 		 * document.
 		 */
-		std::string	toJSONProperty()
-		{
-			std::string rval = "\"" + m_name + "\":";
-			rval += m_value.toString();
+		std::string	toJSONProperty();
 
-			return rval;
-		}
+		static void *operator new(size_t size) { return ReadingArena::allocateObject(size); };
+		static void *operator new(size_t, void *ptr) { return ptr; };
+		static void operator delete(void *ptr) { ReadingArena::freeObject(ptr); };
+		static void operator delete(void *, void *) { };
 
 		/**
 		 * Return the Datapoint name
 		 */
-		const std::string getName() const
+		const std::string& getName() const
+		{
+			return m_name;
+		}
+
+		/**
+		 * Return the interned Datapoint name
+		 */
+		const InternedString& getInternedName() const
 		{
 			return m_name;
 		}
@@ -336,7 +540,7 @@ class Datapoint {
 		/**
 		 * Return Datapoint value
 		 */
-		const DatapointValue getData() const
+		const DatapointValue& getData() const
 		{
 			return m_value;
 		}
@@ -357,7 +561,8 @@ class Datapoint {
 		std::vector<Datapoint*>* recursiveJson(const rapidjson::Value& document);
 
 	private:
-		std::string		m_name;
+		friend class ReadingJSONWriter;
+		InternedString		m_name;
 		DatapointValue		m_value;
 };
 #endif
@@ -0,0 +1,107 @@
+#ifndef _INTERNED_STRING_H
+#define _INTERNED_STRING_H
+/*
+ * Fledge interned asset and datapoint names.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <ostream>
+#include <string.h>
+
+#define INTERN_MAX_NAMES	100000	// Maximum number of names held in the table
+
+/**
+ * A string held in a process wide symbol table.
+ *
+ * Asset and datapoint names are repeated in every reading, interning
+ * them means each distinct name is stored once and a name is held as a
+ * single pointer. Copying a name, or comparing two interned names, does
+ * not touch the characters of the name.
+ *
+ * Interned strings are never released, the table is intended for names
+ * and not for arbitrary data values. The table is bounded, once it holds
+ * INTERN_MAX_NAMES names further new names are not added to it. Each such
+ * name is held in a string of its own, as a std::string would be, and is
+ * copied and compared by its characters. A warning is logged when the
+ * table fills, as that suggests names are being generated from data, for
+ * example with a timestamp or a counter in the name.
+ */
+class InternedString {
+	public:
+		InternedString() { assign("", 0); };
+		InternedString(const std::string& str) { assign(str.c_str(), str.length()); };
+		InternedString(const char *str) { assign(str, strlen(str)); };
+		InternedString(const char *str, size_t len) { assign(str, len); };
+		InternedString(const InternedString& rhs) : m_str(rhs.m_owned ? new std::string(*rhs.m_str) : rhs.m_str),
+				m_owned(rhs.m_owned) {};
+		~InternedString() { release(); };
+
+		InternedString&		operator=(const InternedString& rhs)
+					{
+						if (this != &rhs)
+						{
+							release();
+							m_owned = rhs.m_owned;
+							m_str = m_owned ? new std::string(*rhs.m_str) : rhs.m_str;
+						}
+						return *this;
+					};
+		InternedString&		operator=(const std::string& str)
+					{
+						release();
+						assign(str.c_str(), str.length());
+						return *this;
+					};
+		InternedString&		operator=(const char *str)
+					{
+						release();
+						assign(str, strlen(str));
+						return *this;
+					};
+		operator const std::string&() const { return *m_str; };
+		const std::string&	str() const { return *m_str; };
+		const char		*c_str() const { return m_str->c_str(); };
+		size_t			length() const { return m_str->length(); };
+		size_t			size() const { return m_str->size(); };
+		bool			empty() const { return m_str->empty(); };
+		bool			isInterned() const { return !m_owned; };
+		bool			operator==(const InternedString& rhs) const
+					{
+						return m_str == rhs.m_str || ((m_owned || rhs.m_owned) && *m_str == *rhs.m_str);
+					};
+		bool			operator!=(const InternedString& rhs) const { return !(*this == rhs); };
+
+		static const std::string
+					*intern(const char *str, size_t len);
+		static size_t		count();
+
+	private:
+		void			assign(const char *str, size_t len)
+					{
+						m_str = intern(str, len);
+						m_owned = (m_str == NULL);
+						if (m_owned)
+							m_str = new std::string(str, len);
+					};
+		void			release()
+					{
+						if (m_owned)
+							delete m_str;
+					};
+		const std::string	*m_str;
+		bool			m_owned;	// m_str is not in the table
+};
+
+inline bool operator==(const InternedString& lhs, const std::string& rhs) { return lhs.str() == rhs; }
+inline bool operator==(const std::string& lhs, const InternedString& rhs) { return lhs == rhs.str(); }
+inline bool operator==(const InternedString& lhs, const char *rhs) { return lhs.str() == rhs; }
+inline bool operator!=(const InternedString& lhs, const std::string& rhs) { return lhs.str() != rhs; }
+inline bool operator!=(const std::string& lhs, const InternedString& rhs) { return lhs != rhs.str(); }
+inline bool operator!=(const InternedString& lhs, const char *rhs) { return lhs.str() != rhs; }
+inline std::ostream& operator<<(std::ostream& os, const InternedString& str) { return os << str.str(); }
+#endif
@@ -11,9 +11,35 @@
  */
 
 #include <string>
+#include <atomic>
+#include <stdarg.h>
 
 #define PRINT_FUNC	Logger::getLogger()->info("%s:%d", __FUNCTION__, __LINE__);
 
+/**
+ * Limit the rate at which a repetitive message is logged.
+ *
+ * A LogThrottle is declared static at the point the message is logged
+ * and passed to the logging call. At most one message per interval is
+ * logged from that point, the next message logged after an interval
+ * reports how many messages were suppressed.
+ *
+ * @code
+ *	static LogThrottle throttle(60);
+ *	Logger::getLogger()->info(throttle, "Written block of %d readings", count);
+ * @endcode
+ */
+class LogThrottle {
+	public:
+		LogThrottle(unsigned int interval) : m_interval(interval),
+				m_next(0), m_suppressed(0) {};
+		bool		allow(unsigned int& suppressed);
+	private:
+		const unsigned int		m_interval;	// Seconds
+		std::atomic<long>		m_next;
+		std::atomic<unsigned int>	m_suppressed;
+};
+
 /**
  * Fledge Logger class used to log to syslog
  *
@@ -22,9 +48,22 @@
  * call debug, info, warn etc. using the instance
  * of the class. TO get that instance call the static
  * method getLogger.
+ *
+ * Messages below the minimum level are discarded before they are
+ * formatted. A format passed as a string literal is not copied, so a
+ * message discarded by its level costs no allocation. Other messages are formatted by the caller and passed
+ * to a background thread that writes them to syslog, fatal messages
+ * are written immediately. Where the arguments of a debug message are
+ * expensive to build, check isDebugEnabled before building them.
  */
 class Logger {
 	public:
+		/**
+		 * A function that is passed the messages in place of syslog,
+		 * along with the syslog priority of each message
+		 */
+		typedef void	(*LogSink)(int priority, const char *message);
+
 		Logger(const std::string& application);
 		~Logger();
 		static Logger *getLogger();
@@ -34,11 +73,31 @@ class Logger {
 		void warn(const std::string& msg, ...);
 		void error(const std::string& msg, ...);
 		void fatal(const std::string& msg, ...);
+		void debug(LogThrottle& throttle, const std::string& msg, ...);
+		void info(LogThrottle& throttle, const std::string& msg, ...);
+		void warn(LogThrottle& throttle, const std::string& msg, ...);
+		void error(LogThrottle& throttle, const std::string& msg, ...);
+		void debug(const char *msg, ...);
+		void info(const char *msg, ...);
+		void warn(const char *msg, ...);
+		void error(const char *msg, ...);
+		void fatal(const char *msg, ...);
+		void debug(LogThrottle& throttle, const char *msg, ...);
+		void info(LogThrottle& throttle, const char *msg, ...);
+		void warn(LogThrottle& throttle, const char *msg, ...);
+		void error(LogThrottle& throttle, const char *msg, ...);
 		void setMinLevel(const std::string& level);
 		std::string& getMinLevel() { return levelString; }
+		bool isDebugEnabled() const;
+		bool isInfoEnabled() const;
+		void flush();
+		static void setSink(LogSink sink);
 	private:
-		std::string 	*format(const std::string& msg, va_list ap);
+		void		log(int priority, LogThrottle *throttle,
+					const char *msg, va_list ap);
 		static Logger   *instance;
+		static std::atomic<int>
+				m_level;
 		std::string     levelString;
 };
 
@@ -24,11 +24,11 @@ class PythonReading : public Reading {
 		static std::string	errorMessage();
 		static bool		isArray(PyObject *);
 		static bool		doneNumPyImport;
+		static int		InitNumPy();
 
 	private:
 		PyObject		*convertDatapoint(Datapoint *dp, bool bytesString = false);
 		DatapointValue		*getDatapointValue(PyObject *object);
 		void 			fixQuoting(std::string& str);
-		int			InitNumPy();
 };
 #endif
@@ -21,6 +21,8 @@ class PythonReadingSet : public ReadingSet {
 	public:
 		PythonReadingSet(PyObject *pySet);
 		PyObject	*toPython(bool changeKeys = false);
+		PyObject	*toColumns();
+		bool		fromColumns(PyObject *columns);
 	private:
 		void setReadingAttr(Reading* newReading, PyObject *readingList, bool fillIfMissing);
 };
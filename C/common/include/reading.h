@@ -29,6 +29,9 @@
  *
  * NB The timestamp data held for both the system timestamp and the
  * user timestamp are always held internally as UTC times
+ *
+ * The asset name is interned, the reading itself is allocated from the
+ * current ReadingArena of the thread if there is one.
  */
 class Reading {
 	public:
@@ -37,8 +40,13 @@ class Reading {
 		Reading(const std::string& asset, std::vector<Datapoint *> values, const std::string& ts);
 		Reading(const std::string& asset, const std::string& datapoints);
 		Reading(const Reading& orig);
+		Reading(Reading&& orig);
 
 		~Reading();
+		static void			*operator new(size_t size) { return ReadingArena::allocateObject(size); };
+		static void			*operator new(size_t, void *ptr) { return ptr; };
+		static void			operator delete(void *ptr) { ReadingArena::freeObject(ptr); };
+		static void			operator delete(void *, void *) { };
 		void				addDatapoint(Datapoint *value);
 		Datapoint			*removeDatapoint(const std::string& name);
 		Datapoint			*getDatapoint(const std::string& name) const;
@@ -76,14 +84,14 @@ class Reading {
 		const std::string getAssetDateUserTime(readingTimeFormat datetimeFmt = FMT_DEFAULT, bool addMs = true) const;
 
 	protected:
+		friend class ReadingJSONWriter;
 		Reading() {};
 		Reading&			operator=(Reading const&);
 		void				stringToTimestamp(const std::string& timestamp, struct timeval *ts);
-		const std::string		escape(const std::string& str) const;
 		std::vector<Datapoint *>	*JSONtoDatapoints(const rapidjson::Value& json);
 		unsigned long			m_id;
 		bool				m_has_id;
-		std::string			m_asset;
+		InternedString			m_asset;
 		struct timeval			m_timestamp;
 		struct timeval			m_userTimestamp;
 		std::vector<Datapoint *>	m_values;
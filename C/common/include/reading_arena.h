@@ -0,0 +1,107 @@
+#ifndef _READING_ARENA_H
+#define _READING_ARENA_H
+/*
+ * Fledge arena allocation of readings and datapoints.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <vector>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <stddef.h>
+
+#define READING_ARENA_CHUNK	(64 * 1024)	// Size and alignment of the chunks, a power of 2
+#define READING_ARENA_REGION	(sizeof(void *) == 8 ? ((size_t)16 << 30) : ((size_t)256 << 20))
+
+/**
+ * An arena from which the readings and datapoints of a reading set
+ * can be allocated in a few large chunks rather than one heap
+ * allocation per object.
+ *
+ * Objects are allocated from the arena by the thread that created
+ * it while a ReadingArena::Scope for the arena is active, any
+ * Reading or Datapoint created by the thread in that scope is placed
+ * in the arena, as are the arrays and nested datapoint vectors their
+ * values create. Nothing changes for the code that uses the objects,
+ * they are deleted as usual. Deleting an arena object runs its
+ * destructor but leaves its memory in place, the chunks are freed
+ * together once every object allocated from the arena has been deleted
+ * and the creator has released its own reference to the arena.
+ *
+ * The chunks are taken from a single range of address space reserved
+ * when the first arena is created. An object is known to belong to an
+ * arena from its address alone, with no lock and no lookup: an address
+ * within the range is in an arena chunk, and the arena is held at the
+ * start of the chunk, found by masking the address. Objects allocated
+ * from the heap carry no extra data. Should the range be exhausted, or
+ * could it not be reserved, objects are simply allocated from the heap.
+ */
+class ReadingArena {
+	public:
+		ReadingArena(size_t chunkSize = READING_ARENA_CHUNK);
+		void		release();
+
+		/**
+		 * Direct the allocation of readings and datapoints created
+		 * by this thread to an arena for the lifetime of the scope.
+		 */
+		class Scope {
+			public:
+				Scope(ReadingArena *arena);
+				~Scope();
+			private:
+				ReadingArena	*m_previous;
+		};
+
+		static void	*allocateObject(size_t size);
+		static void	freeObject(void *ptr);
+
+		/**
+		 * Create an object in the current arena of the thread if
+		 * there is one, otherwise on the heap. The object must be
+		 * deleted with destroy.
+		 */
+		template<typename T, typename... Args>
+		static T	*create(Args&&... args)
+		{
+			void *ptr = allocateObject(sizeof(T));
+			try {
+				return new (ptr) T(std::forward<Args>(args)...);
+			} catch (...) {
+				freeObject(ptr);
+				throw;
+			}
+		};
+
+		/**
+		 * Delete an object created by create, or by new
+		 */
+		template<typename T>
+		static void	destroy(T *ptr)
+		{
+			if (ptr)
+			{
+				ptr->~T();
+				freeObject(ptr);
+			}
+		};
+
+	private:
+		~ReadingArena();
+		void		*allocate(size_t size);
+		char		*allocateChunk();
+		static ReadingArena
+				*owner(const void *ptr);
+
+		const size_t		m_chunkSize;
+		std::vector<char *>	m_chunks;
+		char			*m_next;
+		char			*m_end;
+		std::atomic<long>	m_refs;
+};
+#endif
@@ -0,0 +1,53 @@
+#ifndef _READING_JSON_WRITER_H
+#define _READING_JSON_WRITER_H
+/*
+ * Fledge reading JSON serialisation.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+
+class Reading;
+class Datapoint;
+class DatapointValue;
+
+/**
+ * Serialise readings, datapoints and datapoint values as JSON by
+ * appending directly to a caller supplied string.
+ *
+ * The string is only ever appended to, so a caller that serialises many
+ * readings can clear and reuse the same string, keeping its capacity,
+ * rather than building and copying a temporary string per reading and
+ * per value.
+ *
+ * Floating point values are written in the shortest form that reads
+ * back as the same double. Strings have any unescaped double quotes
+ * and control characters escaped, a backslash is assumed to be an
+ * existing escape sequence and is passed through unchanged.
+ */
+class ReadingJSONWriter {
+	public:
+		ReadingJSONWriter(std::string& buffer) : m_buffer(buffer) {};
+		void		reading(const Reading& reading, bool minimal = false);
+		void		datapoints(const std::vector<Datapoint *>& datapoints);
+		void		datapoint(const Datapoint& datapoint);
+		void		value(const DatapointValue& value);
+
+		static void	appendDouble(std::string& json, double value);
+		static void	appendString(std::string& json, const char *str, size_t len);
+		static void	appendString(std::string& json, const std::string& str)
+				{
+					appendString(json, str.c_str(), str.length());
+				};
+
+	private:
+		void		timestamp(const Reading& reading, const struct timeval& tv);
+
+		std::string&	m_buffer;
+};
+#endif
@@ -26,7 +26,7 @@
 class ReadingSet {
 	public:
 		ReadingSet();
-		ReadingSet(const std::string& json);
+		ReadingSet(const std::string& json, bool useArena = false);
 		ReadingSet(const std::vector<Reading *>* readings);
 		~ReadingSet();
 
@@ -43,6 +43,8 @@ class ReadingSet {
 		// Return the reading id of the last  data element
 		unsigned long			getLastId() const { return m_last_id; };
 		unsigned long			getReadingId(uint32_t pos);
+		// Return the reading id of the last reading covered by a send
+		unsigned long			getLastSentId(uint32_t sent, bool partial);
 		void				append(ReadingSet *);
 		void				append(ReadingSet&);
 		void				append(const std::vector<Reading *> &);
@@ -71,7 +73,7 @@ class JSONReading : public Reading {
 		unsigned long	getId() const { return m_id; };
 
 	private:
-		Datapoint 	*datapoint(const std::string& name, const rapidjson::Value& json);
+		Datapoint 	*datapoint(const InternedString& name, const rapidjson::Value& json);
                 void 		escapeCharacter(std::string& stringToEvaluate, std::string pattern);
 };
 
@@ -11,11 +11,80 @@
  */
 
 #define RDS_CONNECTION_MAGIC	0x344f4e4e
+#define RDS_CONNECTION_MAGIC_V2	0x32564e43	// Client will send binary encoded payloads
 #define	RDS_BLOCK_MAGIC		0x5244424b
 #define	RDS_READING_MAGIC	0x52444947
+#define	RDS_BINARY_READING_MAGIC 0x52444942	// Reading payload uses the binary encoding
 #define RDS_ACK_MAGIC		0x4241434b
 #define RDS_NACK_MAGIC		0x4e41434b
 
+/*
+ * Protocol versions. Version 1 sends the datapoints of each reading as
+ * JSON text, version 2 allows the typed binary encoding defined below.
+ * The storage service advertises the highest version it supports in
+ * the response to the stream creation request.
+ */
+#define RDS_PROTOCOL_JSON	1
+#define RDS_PROTOCOL_BINARY	2
+#define RDS_PROTOCOL_VERSION	RDS_PROTOCOL_BINARY
+
+/*
+ * Binary payload encoding, version 1.
+ *
+ * The payload starts with the byte RDS_PAYLOAD_BINARY_V1, which can never
+ * be the first byte of a JSON payload, followed by a uint32_t count of the
+ * datapoints. Each datapoint is a uint32_t name length, the name without
+ * a null terminator, a uint8_t type tag and the value encoded as below.
+ * All values are in the native byte order of the host, as are the rest
+ * of the stream headers.
+ *
+ *	RDS_DP_INTEGER		int64_t
+ *	RDS_DP_FLOAT		double
+ *	RDS_DP_STRING		uint32_t length, characters
+ *	RDS_DP_FLOAT_ARRAY	uint32_t count, double values
+ *	RDS_DP_DICT		uint32_t count, nested datapoints
+ *	RDS_DP_LIST		uint32_t count, nested datapoints
+ *	RDS_DP_IMAGE		uint32_t width, height, depth, length, pixel data
+ *	RDS_DP_DATABUFFER	uint32_t item size, item count, data
+ *	RDS_DP_2D_FLOAT_ARRAY	uint32_t rows, each row as a RDS_DP_FLOAT_ARRAY
+ */
+#define RDS_PAYLOAD_BINARY_V1	0x01
+#define RDS_PAYLOAD_IS_BINARY(payload)	(*(const unsigned char *)(payload) == RDS_PAYLOAD_BINARY_V1)
+
+#define RDS_DP_INTEGER		1
+#define RDS_DP_FLOAT		2
+#define RDS_DP_STRING		3
+#define RDS_DP_FLOAT_ARRAY	4
+#define RDS_DP_DICT		5
+#define RDS_DP_LIST		6
+#define RDS_DP_IMAGE		7
+#define RDS_DP_DATABUFFER	8
+#define RDS_DP_2D_FLOAT_ARRAY	9
+
+/*
+ * Binary reading fetch block, returned by the storage service in response
+ * to a GET of /storage/reading/binary. The block is a RDSFetchHeader
+ * followed by count readings. Each reading is a RDSFetchReadingHeader,
+ * the asset name without a null terminator and the binary encoded payload
+ * of the datapoints described above.
+ */
+#define RDS_FETCH_MAGIC		0x48544346	// "FCTH"
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	count;
+} RDSFetchHeader;
+
+typedef struct {
+	uint64_t	id;
+	int64_t		userTsSec;
+	int64_t		userTsUsec;
+	int64_t		tsSec;
+	int64_t		tsUsec;
+	uint32_t	assetLength;
+	uint32_t	payloadLength;
+} RDSFetchReadingHeader;
+
 typedef struct {
 	uint32_t	magic;
 	uint32_t	token;
@@ -0,0 +1,60 @@
+#ifndef _READING_STREAM_CODEC_H
+#define _READING_STREAM_CODEC_H
+/*
+ * Fledge storage reading stream binary payload encoding.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/time.h>
+#include <reading_stream.h>
+
+class Reading;
+class Datapoint;
+class DatapointValue;
+
+/**
+ * Encode and decode the datapoints of a reading using the typed,
+ * length prefixed binary encoding of the reading stream protocol.
+ *
+ * The encoding avoids the creation of JSON on the sending side of
+ * the stream, the receiver converts the payload to whatever
+ * representation it stores once.
+ */
+class ReadingStreamCodec {
+	public:
+		static void	encode(const Reading& reading, std::string& payload);
+		static bool	toJSON(const char *payload, size_t length, std::string& json);
+		static std::vector<Datapoint *>
+				*decode(const char *payload, size_t length);
+		static void	encodeBlock(const std::vector<Reading *>& readings,
+						std::string& block);
+		static void	startBlock(std::string& block, uint32_t count);
+		static void	appendBlockReading(std::string& block, uint64_t id,
+						const struct timeval& userTs,
+						const struct timeval& ts,
+						const std::string& asset,
+						const char *payload, size_t payloadLength);
+		static std::vector<Reading *>
+				*decodeBlock(const char *block, size_t length);
+	private:
+		static void	encodeDatapoints(const std::vector<Datapoint *>& datapoints,
+						std::string& payload);
+		static void	encodeValue(DatapointValue& value, std::string& payload);
+		static bool	valueToJSON(const char *& p, const char *end,
+						std::string& json);
+		static bool	datapointsToJSON(const char *& p, const char *end,
+						uint32_t count, bool names, std::string& json);
+		static DatapointValue
+				*decodeValue(const char *& p, const char *end);
+		static std::vector<Datapoint *>
+				*decodeDatapoints(const char *& p, const char *end, uint32_t count);
+};
+
+#endif
@@ -49,6 +49,7 @@ class StorageClient {
 		ResultSet	*queryTable(const std::string& tablename, const Query& query);
 		ReadingSet	*queryTableToReadings(const std::string& tableName, const Query& query);
 		int 		insertTable(const std::string& schema, const std::string& tableName, const InsertValues& values);
+		int 		insertTable(const std::string& schema, const std::string& tableName, const std::vector<InsertValues>& values);
 		int		updateTable(const std::string& schema, const std::string& tableName, const InsertValues& values,
 					const Where& where, const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& schema, const std::string& tableName, const JSONProperties& json,
@@ -59,10 +60,13 @@ class StorageClient {
 					const Where& where, const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& schema, const std::string& tableName,
 					std::vector<std::pair<ExpressionValues *, Where *>>& updates, const UpdateModifier *modifier = NULL);
+		int		updateTable(const std::string& schema, const std::string& tableName,
+					std::vector<std::pair<InsertValues *, Where *>>& updates, const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& schema, const std::string& tableName, const InsertValues& values,
 					const ExpressionValues& expressoins, const Where& where, const UpdateModifier *modifier = NULL);
 		int		deleteTable(const std::string& schema, const std::string& tableName, const Query& query);
 		int 		insertTable(const std::string& tableName, const InsertValues& values);
+		int 		insertTable(const std::string& tableName, const std::vector<InsertValues>& values);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const Where& where, const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& tableName, const JSONProperties& json, const Where& where, const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const JSONProperties& json,
@@ -71,6 +75,8 @@ class StorageClient {
 					const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& tableName, std::vector<std::pair<ExpressionValues *, Where *>>& updates,
 					const UpdateModifier *modifier = NULL);
+		int		updateTable(const std::string& tableName, std::vector<std::pair<InsertValues *, Where *>>& updates,
+					const UpdateModifier *modifier = NULL);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const ExpressionValues& expressions,
 					const Where& where, const UpdateModifier *modifier = NULL);
 		int		deleteTable(const std::string& tableName, const Query& query);
@@ -79,6 +85,7 @@ class StorageClient {
 		ResultSet	*readingQuery(const Query& query);
 		ReadingSet 	*readingQueryToReadings(const Query& query);
 		ReadingSet	*readingFetch(const unsigned long readingId, const unsigned long count);
+		ReadingSet	*readingFetchBinary(const unsigned long readingId, const unsigned long count);
 		PurgeResult	readingPurgeByAge(unsigned long age, unsigned long sent, bool purgeUnsent);
 		PurgeResult	readingPurgeBySize(unsigned long size, unsigned long sent, bool purgeUnsent);
 		PurgeResult	readingPurgeByAsset(const std::string& asset);
@@ -114,6 +121,8 @@ class StorageClient {
 		pid_t					m_pid;
 		bool					m_streaming;
 		int					m_stream;
+		int					m_streamProtocol;
+		bool					m_binaryFetch;
 		uint32_t				m_readingBlock;
 		std::string				m_lastException;
 		int					m_exRepeat;
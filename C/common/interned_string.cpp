@@ -0,0 +1,147 @@
+/*
+ * Fledge interned asset and datapoint names.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <interned_string.h>
+#include <logger.h>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+#define INTERN_SHARDS		16	// Must be a power of 2
+#define INTERN_CACHE_SIZE	64	// Per thread cache entries, power of 2
+
+using namespace std;
+
+/**
+ * The characters of a name, used to look names up in the table
+ * without first constructing a std::string
+ */
+struct NameKey {
+	const char	*str;
+	size_t		len;
+};
+
+struct NameKeyHash {
+	size_t operator()(const NameKey& key) const
+	{
+		return hashName(key.str, key.len);
+	}
+	static size_t hashName(const char *str, size_t len)
+	{
+		size_t hash = 14695981039346656037UL;	// FNV-1a
+		for (size_t i = 0; i < len; i++)
+		{
+			hash ^= (unsigned char)str[i];
+			hash *= 1099511628211UL;
+		}
+		return hash;
+	}
+};
+
+struct NameKeyEqual {
+	bool operator()(const NameKey& lhs, const NameKey& rhs) const
+	{
+		return lhs.len == rhs.len && memcmp(lhs.str, rhs.str, lhs.len) == 0;
+	}
+};
+
+/**
+ * A shard of the symbol table, the table is split by hash to reduce
+ * contention between threads creating readings
+ */
+struct InternShard {
+	mutex		mtx;
+	unordered_map<NameKey, const string *, NameKeyHash, NameKeyEqual>
+			names;
+};
+
+/**
+ * Return the shards of the symbol table. The table is deliberately
+ * never destroyed so that names remain valid in static destructors.
+ */
+static InternShard *shards()
+{
+	static InternShard *table = new InternShard[INTERN_SHARDS];
+	return table;
+}
+
+/**
+ * Return the interned copy of a string, adding it to the table if this
+ * is the first time it has been seen and the table is not full.
+ *
+ * A small per thread cache of recently used names is checked first so
+ * that the common case, the same few names used over and over by a
+ * thread, does not take the shard lock.
+ *
+ * @param str	The characters of the string
+ * @param len	The length of the string
+ * @return	The interned string, valid for the lifetime of the process,
+ *		or NULL if the string is not in the table and the table is full
+ */
+const string *InternedString::intern(const char *str, size_t len)
+{
+	static thread_local const string *cache[INTERN_CACHE_SIZE];
+	static atomic<size_t> total(0);
+
+	size_t hash = NameKeyHash::hashName(str, len);
+	const string *cached = cache[hash & (INTERN_CACHE_SIZE - 1)];
+	if (cached && cached->length() == len && memcmp(cached->data(), str, len) == 0)
+	{
+		return cached;
+	}
+
+	InternShard& shard = shards()[(hash >> 32) & (INTERN_SHARDS - 1)];
+	NameKey key = { str, len };
+	const string *interned = NULL;
+	bool full = false;
+	{
+		lock_guard<mutex> guard(shard.mtx);
+		auto it = shard.names.find(key);
+		if (it != shard.names.end())
+		{
+			interned = it->second;
+		}
+		else if (total.fetch_add(1) < INTERN_MAX_NAMES)
+		{
+			interned = new string(str, len);
+			NameKey stored = { interned->data(), interned->length() };
+			shard.names.emplace(stored, interned);
+		}
+		else
+		{
+			total--;
+			full = true;
+		}
+	}
+	if (full)
+	{
+		static atomic<bool> warned(false);
+		if (!warned.exchange(true))
+		{
+			Logger::getLogger()->warn("More than %d distinct asset and datapoint names have been seen, further names are not shared between readings. Names should not be built from changing data values.", INTERN_MAX_NAMES);
+		}
+		return NULL;
+	}
+	cache[hash & (INTERN_CACHE_SIZE - 1)] = interned;
+	return interned;
+}
+
+/**
+ * Return the number of distinct strings that have been interned
+ */
+size_t InternedString::count()
+{
+	size_t total = 0;
+	for (int i = 0; i < INTERN_SHARDS; i++)
+	{
+		lock_guard<mutex> guard(shards()[i].mtx);
+		total += shards()[i].names.size();
+	}
+	return total;
+}
@@ -9,18 +9,33 @@
  */
 #include <logger.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <syslog.h>
 #include <stdarg.h>
 #include <memory>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 using namespace std;
 
 // uncomment line below to get uSec level timestamps
 // #define ADD_USEC_TS
 
+#define LOG_QUEUE_SIZE		256	// Queued messages, must be a power of 2
+#define LOG_MESSAGE_SIZE	1000	// Longest message, including the terminator
+#define LOG_WRITER_IDLE		100	// Milliseconds between checks of an idle queue
+#define LOG_EXIT_WAIT		1000	// Milliseconds to wait for the queue at exit
+#define LOG_FULL_RETRIES	10000	// Attempts to queue a message when the queue is full
+
+static atomic<Logger::LogSink> logSink(NULL);
+
 inline long getCurrTimeUsec()
 {
 	struct timeval m_timestamp;
@@ -28,7 +43,441 @@ inline long getCurrTimeUsec()
 	return m_timestamp.tv_usec;
 }
 
+/**
+ * Return the prefix of the messages logged at a syslog priority
+ *
+ * @param priority	The syslog priority
+ */
+static const char *levelPrefix(int priority)
+{
+	switch (priority)
+	{
+		case LOG_DEBUG:
+			return "DEBUG";
+		case LOG_INFO:
+			return "INFO";
+		case LOG_WARNING:
+			return "WARNING";
+		case LOG_ERR:
+			return "ERROR";
+		default:
+			return "FATAL";
+	}
+}
+
+/**
+ * Write a message to syslog, or to the sink that replaces syslog
+ *
+ * @param priority	The syslog priority of the message
+ * @param message	The formatted message
+ */
+static void output(int priority, const char *message)
+{
+	Logger::LogSink sink = logSink.load(memory_order_acquire);
+	if (sink)
+	{
+		sink(priority, message);
+	}
+	else
+	{
+		syslog(priority, "%s: %s", levelPrefix(priority), message);
+	}
+}
+
+/**
+ * Format a message into a buffer of LOG_MESSAGE_SIZE bytes, adding the
+ * number of earlier messages suppressed by a throttle if there were any
+ *
+ * @param buf		The buffer to format into
+ * @param fmt		The printf format of the message
+ * @param args		The arguments of the message
+ * @param suppressed	The number of messages suppressed
+ */
+static void formatMessage(char *buf, const char *fmt, va_list args, unsigned int suppressed)
+{
+	int len = 0;
+
+#ifdef ADD_USEC_TS
+	len = snprintf(buf, LOG_MESSAGE_SIZE, "[.%06ld] ", getCurrTimeUsec());
+#endif
+	int n = vsnprintf(buf + len, LOG_MESSAGE_SIZE - len, fmt, args);
+	if (n < 0)
+	{
+		buf[len] = 0;
+		return;
+	}
+	len += n;
+	if (suppressed && len < LOG_MESSAGE_SIZE - 1)
+	{
+		snprintf(buf + len, LOG_MESSAGE_SIZE - len,
+				" (%u similar messages suppressed)", suppressed);
+	}
+}
+
+/**
+ * The messages waiting to be written to syslog by the writer thread.
+ *
+ * Logging threads add messages without taking a lock, each claims the
+ * next slot of a ring buffer, formats its message directly into the
+ * slot and then publishes the slot by advancing its sequence number.
+ * Slots are written to syslog in order by whichever thread holds
+ * m_mutex, normally the writer thread.
+ *
+ * There is a single queue per process, as there is a single syslog
+ * connection. The queue is never destroyed, the writer thread is
+ * stopped and the queue flushed when the process exits.
+ */
+class LogQueue {
+	public:
+		static LogQueue	*getQueue();
+		void		write(int priority, const char *fmt, va_list args,
+					unsigned int suppressed);
+		void		writeNow(int priority, const char *fmt, va_list args,
+					unsigned int suppressed);
+		void		flush(bool wait = true);
+	private:
+		struct Slot {
+			atomic<size_t>	sequence;
+			int		priority;
+			char		message[LOG_MESSAGE_SIZE];
+		};
+
+		LogQueue();
+		Slot		*claim(size_t& position);
+		bool		pending();
+		void		drain();
+		void		start();
+		void		stop();
+		void		writer();
+		static void	stopAtExit();
+		static void	prepareFork();
+		static void	parentFork();
+		static void	childFork();
+
+		Slot			*m_slots;
+		atomic<size_t>		m_head;		// The next slot to claim
+		size_t			m_tail;		// The next slot to write
+		mutex			m_mutex;	// Held while writing slots
+		condition_variable	*m_wake;
+		thread			*m_writer;
+		bool			m_running;
+		atomic<bool>		m_started;
+		atomic<bool>		m_stopped;
+		atomic<bool>		m_waiting;
+};
+
+/**
+ * Return the log queue of the process, creating it on first use
+ */
+LogQueue *LogQueue::getQueue()
+{
+	static LogQueue *queue = new LogQueue();
+	return queue;
+}
+
+/**
+ * Create the log queue. The writer thread is not started until the
+ * first message is queued, so that a process may daemonise by forking
+ * after creating its logger but before logging.
+ */
+LogQueue::LogQueue() : m_head(0), m_tail(0), m_writer(NULL), m_running(false),
+	m_started(false), m_stopped(false), m_waiting(false)
+{
+	m_slots = new Slot[LOG_QUEUE_SIZE];
+	for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+	{
+		m_slots[i].sequence.store(i, memory_order_relaxed);
+	}
+	m_wake = new condition_variable();
+	pthread_atfork(prepareFork, parentFork, childFork);
+	atexit(stopAtExit);
+}
+
+/**
+ * Queue a message to be written to syslog by the writer thread. If the
+ * queue is full the caller writes the queued messages before queuing its
+ * own, so that the messages of a thread are written in order. A message
+ * that can still not be queued, as the slot at the head of the queue is
+ * never published, is written directly.
+ *
+ * @param priority	The syslog priority of the message
+ * @param fmt		The printf format of the message
+ * @param args		The arguments of the message
+ * @param suppressed	The number of similar messages suppressed
+ */
+void LogQueue::write(int priority, const char *fmt, va_list args, unsigned int suppressed)
+{
+	if (!m_stopped.load(memory_order_acquire))
+	{
+		if (!m_started.load(memory_order_acquire))
+		{
+			start();
+		}
+		size_t position;
+		Slot *slot = claim(position);
+		for (int retry = 0; !slot && retry < LOG_FULL_RETRIES; retry++)
+		{
+			flush();
+			this_thread::yield();
+			slot = claim(position);
+		}
+		if (slot)
+		{
+			slot->priority = priority;
+			formatMessage(slot->message, fmt, args, suppressed);
+			slot->sequence.store(position + 1, memory_order_release);
+			atomic_thread_fence(memory_order_seq_cst);
+			if (m_waiting.load(memory_order_relaxed))
+			{
+				m_wake->notify_one();
+			}
+			return;
+		}
+	}
+	writeNow(priority, fmt, args, suppressed);
+}
+
+/**
+ * Write a message to syslog immediately, after any queued messages
+ *
+ * @param priority	The syslog priority of the message
+ * @param fmt		The printf format of the message
+ * @param args		The arguments of the message
+ * @param suppressed	The number of similar messages suppressed
+ */
+void LogQueue::writeNow(int priority, const char *fmt, va_list args, unsigned int suppressed)
+{
+	char buf[LOG_MESSAGE_SIZE];
+
+	// Fatal messages may be logged from a signal handler, do not wait
+	// for a thread that may never release the queue
+	flush(priority > LOG_CRIT);
+	formatMessage(buf, fmt, args, suppressed);
+	output(priority, buf);
+}
+
+/**
+ * Write the queued messages to syslog
+ *
+ * @param wait	Wait for another thread that is writing messages
+ */
+void LogQueue::flush(bool wait)
+{
+	if (wait)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		drain();
+	}
+	else if (m_mutex.try_lock())
+	{
+		drain();
+		m_mutex.unlock();
+	}
+}
+
+/**
+ * Claim the next free slot in the ring buffer
+ *
+ * @param position	Set to the position of the claimed slot
+ * @return		The slot or NULL if the queue is full
+ */
+LogQueue::Slot *LogQueue::claim(size_t& position)
+{
+	position = m_head.load(memory_order_relaxed);
+	for (;;)
+	{
+		Slot *slot = &m_slots[position & (LOG_QUEUE_SIZE - 1)];
+		size_t sequence = slot->sequence.load(memory_order_acquire);
+		long diff = (long)sequence - (long)position;
+		if (diff == 0)
+		{
+			if (m_head.compare_exchange_weak(position, position + 1,
+						memory_order_relaxed))
+			{
+				return slot;
+			}
+		}
+		else if (diff < 0)
+		{
+			return NULL;
+		}
+		else
+		{
+			position = m_head.load(memory_order_relaxed);
+		}
+	}
+}
+
+/**
+ * Return true if the next slot to write has been published.
+ * The caller must hold m_mutex.
+ */
+bool LogQueue::pending()
+{
+	Slot *slot = &m_slots[m_tail & (LOG_QUEUE_SIZE - 1)];
+	return slot->sequence.load(memory_order_acquire) == m_tail + 1;
+}
+
+/**
+ * Write the published slots to syslog in order and free them for
+ * reuse. The caller must hold m_mutex.
+ */
+void LogQueue::drain()
+{
+	while (pending())
+	{
+		Slot *slot = &m_slots[m_tail & (LOG_QUEUE_SIZE - 1)];
+		output(slot->priority, slot->message);
+		slot->sequence.store(m_tail + LOG_QUEUE_SIZE, memory_order_release);
+		m_tail++;
+	}
+}
+
+/**
+ * Start the writer thread
+ */
+void LogQueue::start()
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (!m_started.load(memory_order_relaxed))
+	{
+		m_running = true;
+		m_writer = new thread(&LogQueue::writer, this);
+		m_started.store(true, memory_order_release);
+	}
+}
+
+/**
+ * Stop the writer thread and write any messages left in the queue.
+ * Messages logged after this are written to syslog by the caller.
+ */
+void LogQueue::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_stopped.store(true, memory_order_release);
+		m_running = false;
+	}
+	m_wake->notify_one();
+	if (m_writer)
+	{
+		m_writer->join();
+		delete m_writer;
+		m_writer = NULL;
+	}
+	flush();
+}
+
+/**
+ * The writer thread, writes messages to syslog as they are queued
+ */
+void LogQueue::writer()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (m_running)
+	{
+		drain();
+		m_waiting.store(true, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (!pending() && m_running)
+		{
+			m_wake->wait_for(lck, chrono::milliseconds(LOG_WRITER_IDLE));
+		}
+		m_waiting.store(false, memory_order_relaxed);
+	}
+	drain();
+}
+
+/**
+ * Write any queued messages when the process exits.
+ *
+ * The process may exit from the writer thread, which can not wait for
+ * itself, or from a signal handler that interrupted a thread holding
+ * the queue. In those cases the queue is left as it is rather than
+ * waiting for a thread that will never continue.
+ */
+void LogQueue::stopAtExit()
+{
+	LogQueue *queue = getQueue();
+
+	if (queue->m_writer && queue->m_writer->get_id() == this_thread::get_id())
+	{
+		return;
+	}
+	for (int i = 0; i < LOG_EXIT_WAIT; i++)
+	{
+		if (queue->m_mutex.try_lock())
+		{
+			queue->m_mutex.unlock();
+			queue->stop();
+			return;
+		}
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+/**
+ * Write any queued messages before the process forks and stop the
+ * writer thread writing more, so that the messages are not written
+ * by both processes.
+ */
+void LogQueue::prepareFork()
+{
+	LogQueue *queue = getQueue();
+	queue->m_mutex.lock();
+	queue->drain();
+}
+
+/**
+ * Let the writer thread of the parent continue after a fork
+ */
+void LogQueue::parentFork()
+{
+	getQueue()->m_mutex.unlock();
+}
+
+/**
+ * The writer thread does not exist in the child of a fork, arrange for
+ * the child to start its own. The condition variable the writer was
+ * waiting on is replaced as it still records the missing thread.
+ */
+void LogQueue::childFork()
+{
+	LogQueue *queue = getQueue();
+	queue->m_writer = NULL;
+	queue->m_wake = new condition_variable();
+	queue->m_running = false;
+	queue->m_waiting.store(false, memory_order_relaxed);
+	queue->m_started.store(false, memory_order_release);
+	queue->m_mutex.unlock();
+}
+
+/**
+ * Decide if a message should be logged or suppressed
+ *
+ * @param suppressed	Set to the number of messages suppressed
+ *			since the last message that was logged
+ * @return		True if the message should be logged
+ */
+bool LogThrottle::allow(unsigned int& suppressed)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+	long next = m_next.load(memory_order_relaxed);
+	if (now.tv_sec >= next &&
+		m_next.compare_exchange_strong(next, now.tv_sec + m_interval,
+					memory_order_relaxed))
+	{
+		suppressed = m_suppressed.exchange(0, memory_order_relaxed);
+		return true;
+	}
+	m_suppressed.fetch_add(1, memory_order_relaxed);
+	return false;
+}
+
 Logger *Logger::instance = 0;
+atomic<int> Logger::m_level(LOG_DEBUG);
 
 Logger::Logger(const string& application)
 {
@@ -50,6 +499,7 @@ static char ident[80];
 
 Logger::~Logger()
 {
+	flush();
 	closelog();
 }
 
@@ -68,40 +518,97 @@ Logger *Logger::getLogger()
  */
 void Logger::setMinLevel(const string& level)
 {
+	int priority;
+
 	if (level.compare("info") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_INFO));
-		levelString = level;
+		priority = LOG_INFO;
 	} else if (level.compare("warning") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_WARNING));
-		levelString = level;
+		priority = LOG_WARNING;
 	} else if (level.compare("debug") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_DEBUG));
-		levelString = level;
+		priority = LOG_DEBUG;
 	} else if (level.compare("error") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_ERR));
-		levelString = level;
+		priority = LOG_ERR;
 	} else
 	{
 		error("Request to set unsupported log level %s", level.c_str());
+		return;
 	}
+	setlogmask(LOG_UPTO(priority));
+	m_level.store(priority, memory_order_relaxed);
+	levelString = level;
+}
+
+/**
+ * Return true if debug messages are being logged
+ */
+bool Logger::isDebugEnabled() const
+{
+	return m_level.load(memory_order_relaxed) >= LOG_DEBUG;
+}
+
+/**
+ * Return true if information messages are being logged
+ */
+bool Logger::isInfoEnabled() const
+{
+	return m_level.load(memory_order_relaxed) >= LOG_INFO;
+}
+
+/**
+ * Wait for all the messages logged so far to be written to syslog
+ */
+void Logger::flush()
+{
+	LogQueue::getQueue()->flush();
+}
+
+/**
+ * Pass the messages to a sink in place of syslog, for example to
+ * capture the messages of a test
+ *
+ * @param sink	The sink or NULL to write the messages to syslog
+ */
+void Logger::setSink(LogSink sink)
+{
+	logSink.store(sink, memory_order_release);
+}
+
+/**
+ * Log a message if its priority is within the minimum level and
+ * any throttle allows it
+ *
+ * @param priority	The syslog priority of the message
+ * @param throttle	The throttle for the message or NULL
+ * @param msg		The printf format of the message
+ * @param args		The arguments of the message
+ */
+void Logger::log(int priority, LogThrottle *throttle, const char *msg, va_list args)
+{
+	unsigned int suppressed = 0;
+
+	if (priority > m_level.load(memory_order_relaxed))
+		return;
+	if (throttle && !throttle->allow(suppressed))
+		return;
+	LogQueue::getQueue()->write(priority, msg, args, suppressed);
 }
 
 void Logger::debug(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_DEBUG, "DEBUG: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_DEBUG, NULL, msg.c_str(), args);
 	va_end(args);
 }
 
 void Logger::printLongString(const string& s)
 {
+	if (!isDebugEnabled())
+		return;
 	const int charsPerLine = 950;
 	int len = s.size();
 	const char *cstr = s.c_str();
@@ -113,13 +620,7 @@ void Logger::info(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-#ifdef ADD_USEC_TS
-	syslog(LOG_INFO, "[.%06ld] INFO: %s", getCurrTimeUsec(), fmt->c_str());
-#else
-	syslog(LOG_INFO, "INFO: %s", fmt->c_str());
-#endif
-	delete fmt;
+	log(LOG_INFO, NULL, msg.c_str(), args);
 	va_end(args);
 }
 
@@ -127,9 +628,7 @@ void Logger::warn(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_WARNING, "WARNING: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_WARNING, NULL, msg.c_str(), args);
 	va_end(args);
 }
 
@@ -137,30 +636,126 @@ void Logger::error(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-#ifdef ADD_USEC_TS
-		syslog(LOG_ERR, "[.%06ld] ERROR: %s", getCurrTimeUsec(), fmt->c_str());
-#else
-		syslog(LOG_ERR, "ERROR: %s", fmt->c_str());
-#endif
-	delete fmt;
+	log(LOG_ERR, NULL, msg.c_str(), args);
 	va_end(args);
 }
 
+/**
+ * Log a fatal message. Fatal messages are written to syslog before
+ * returning, as the process may be about to terminate.
+ */
 void Logger::fatal(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_CRIT, "FATAL: %s", fmt->c_str());
-	delete fmt;
+	LogQueue::getQueue()->writeNow(LOG_CRIT, msg.c_str(), args, 0);
+	va_end(args);
+}
+
+void Logger::debug(LogThrottle& throttle, const string& msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_DEBUG, &throttle, msg.c_str(), args);
 	va_end(args);
 }
 
-string *Logger::format( const std::string& format, va_list args)
+void Logger::info(LogThrottle& throttle, const string& msg, ...)
 {
-char	buf[1000];
+	va_list args;
+	va_start(args, msg);
+	log(LOG_INFO, &throttle, msg.c_str(), args);
+	va_end(args);
+}
 
-	  vsnprintf(buf, sizeof(buf), format.c_str(), args);
-	  return new string(buf);
+void Logger::warn(LogThrottle& throttle, const string& msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_WARNING, &throttle, msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::error(LogThrottle& throttle, const string& msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_ERR, &throttle, msg.c_str(), args);
+	va_end(args);
+}
+
+/*
+ * The overloads taking the format as a C string are used for string
+ * literals, the level is checked without first building a std::string
+ */
+void Logger::debug(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_DEBUG, NULL, msg, args);
+	va_end(args);
+}
+
+void Logger::info(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_INFO, NULL, msg, args);
+	va_end(args);
+}
+
+void Logger::warn(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_WARNING, NULL, msg, args);
+	va_end(args);
+}
+
+void Logger::error(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_ERR, NULL, msg, args);
+	va_end(args);
+}
+
+void Logger::fatal(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	LogQueue::getQueue()->writeNow(LOG_CRIT, msg, args, 0);
+	va_end(args);
+}
+
+void Logger::debug(LogThrottle& throttle, const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_DEBUG, &throttle, msg, args);
+	va_end(args);
+}
+
+void Logger::info(LogThrottle& throttle, const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_INFO, &throttle, msg, args);
+	va_end(args);
+}
+
+void Logger::warn(LogThrottle& throttle, const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_WARNING, &throttle, msg, args);
+	va_end(args);
+}
+
+void Logger::error(LogThrottle& throttle, const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_ERR, &throttle, msg, args);
+	va_end(args);
 }
@@ -255,23 +255,22 @@ DatapointValue *PythonReading::getDatapointValue(PyObject *value)
 				double d = PyFloat_AS_DOUBLE(PyList_GetItem(value, i));
 				values.push_back(d);
 			}
-			dataPoint = new DatapointValue(values);
+			dataPoint = new DatapointValue(std::move(values));
 		}
 		else if (PyList_Check(item0))	// 2D array 		T_2D_FLOAT_ARRAY
 		{
-			vector<vector<double>* > values;
+			Float2DArray values;
 			for (Py_ssize_t i = 0; i < listSize; i++)
 			{
-				vector<double> *row = new vector<double>;
 				PyObject *pyRow = PyList_GetItem(value, i);
-				for (Py_ssize_t j = 0; j < PyList_Size(pyRow); j++)
+				Py_ssize_t rowSize = PyList_Size(pyRow);
+				double *row = values.appendRow(rowSize);
+				for (Py_ssize_t j = 0; j < rowSize; j++)
 				{
-					double d = PyFloat_AS_DOUBLE(PyList_GetItem(pyRow, j));
-					row->push_back(d);
+					row[j] = PyFloat_AS_DOUBLE(PyList_GetItem(pyRow, j));
 				}
-				values.push_back(row);
 			}
-			dataPoint = new DatapointValue(values);
+			dataPoint = new DatapointValue(std::move(values));
 		}
 		else if (PyDict_Check(item0))	// List of datapoints	T_DP_LIST
 		{
@@ -479,18 +478,17 @@ PyObject *PythonReading::convertDatapoint(Datapoint *dp, bool bytesString)
 	}
 	else if (dataType == DatapointValue::dataTagType::T_2D_FLOAT_ARRAY)
 	{
-		vector<vector<double>* > *vec = dp->getData().getDp2DArr();
-		value = PyList_New(vec->size());
-		int rowNo = 0;
-		for (auto row : *vec)
+		const Float2DArray *array = dp->getData().get2DArray();
+		value = PyList_New(array->rows());
+		for (size_t rowNo = 0; rowNo < array->rows(); rowNo++)
 		{
-			int i = 0;
-			PyObject *pyRow = PyList_New(row->size());
-			for (auto& d : *row)
+			const double *row = array->row(rowNo);
+			PyObject *pyRow = PyList_New(array->rowLength(rowNo));
+			for (size_t i = 0; i < array->rowLength(rowNo); i++)
 			{
-				PyList_SetItem(pyRow, i++, PyFloat_FromDouble(d));
+				PyList_SetItem(pyRow, i, PyFloat_FromDouble(row[i]));
 			}
-			PyList_SetItem(value, rowNo++, pyRow);
+			PyList_SetItem(value, rowNo, pyRow);
 		}
 	}
 	else if (dataType == DatapointValue::dataTagType::T_DATABUFFER)
@@ -10,9 +10,39 @@
 #include <pythonreadingset.h>
 #include <pythonreading.h>
 #include <stdexcept>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+// The numpy API table is owned by pythonreading.cpp
+#define PY_ARRAY_UNIQUE_SYMBOL  PyArray_API_FLEDGE
+#define NO_IMPORT_ARRAY
+#include <numpy/npy_common.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/ndarraytypes.h>
+#include <numpy/ndarrayobject.h>
+
+// Name of the user timestamp column in the columnar representation
+#define USER_TS_COLUMN	"user_ts"
 
 using namespace std;
 
+/**
+ * The readings of a single asset, in the order they appear in the set
+ */
+typedef pair<string, vector<Reading *>> AssetReadings;
+
+/**
+ * A numeric datapoint that is present in every reading of an asset
+ */
+class NumericColumn {
+	public:
+		NumericColumn() : m_float(false) {};
+		vector<Datapoint *>	m_points;
+		bool			m_float;
+};
+
 
 /**
  * Set id, uuid, ts and user_ts in the reading object
@@ -154,3 +184,319 @@ PyObject *PythonReadingSet::toPython(bool changeKeys)
 	return set;
 }
 
+
+/**
+ * Split a set of readings into per asset groups, preserving the order
+ * of the readings within each asset
+ *
+ * @param readings	The readings to group
+ * @param assets	The per asset groups
+ */
+static void groupByAsset(const vector<Reading *>& readings, vector<AssetReadings>& assets)
+{
+	unordered_map<string, size_t> index;
+	for (Reading *reading : readings)
+	{
+		const string& asset = reading->getAssetName();
+		auto it = index.find(asset);
+		if (it == index.end())
+		{
+			it = index.insert(make_pair(asset, assets.size())).first;
+			assets.push_back(AssetReadings(asset, vector<Reading *>()));
+		}
+		assets[it->second].second.push_back(reading);
+	}
+}
+
+/**
+ * Find the integer and floating point datapoints that are present in
+ * every reading of an asset. Datapoints missing from some readings can
+ * not be represented as a column and are left out.
+ *
+ * @param readings	The readings of a single asset
+ * @param columns	The numeric columns, keyed by datapoint name
+ */
+static void numericColumns(const vector<Reading *>& readings, map<string, NumericColumn>& columns)
+{
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		for (Datapoint *dp : readings[i]->getReadingData())
+		{
+			DatapointValue::dataTagType type = dp->getData().getType();
+			if (type != DatapointValue::T_INTEGER && type != DatapointValue::T_FLOAT)
+			{
+				continue;
+			}
+			NumericColumn& column = columns[dp->getName()];
+			if (column.m_points.size() != i)
+			{
+				// Missing from an earlier reading or a duplicate name
+				continue;
+			}
+			column.m_points.push_back(dp);
+			if (type == DatapointValue::T_FLOAT)
+			{
+				column.m_float = true;
+			}
+		}
+	}
+	for (auto it = columns.begin(); it != columns.end(); )
+	{
+		if (it->second.m_points.size() != readings.size())
+			it = columns.erase(it);
+		else
+			++it;
+	}
+	columns.erase(USER_TS_COLUMN);
+}
+
+/**
+ * Convert the ReadingSet to a columnar Python representation.
+ *
+ * The result is a Python dict keyed by asset name. Each value is a dict
+ * of one dimensional numpy arrays with one element per reading of that
+ * asset: "user_ts" holds the user timestamps as microseconds since the
+ * epoch and every integer or floating point datapoint present in all of
+ * the asset's readings has an array of its own. The arrays are filled
+ * directly from the readings without creating a Python object per value.
+ *
+ * @return A Python dict of per asset dicts of numpy arrays
+ */
+PyObject *PythonReadingSet::toColumns()
+{
+	PythonReading::InitNumPy();
+
+	vector<AssetReadings> assets;
+	groupByAsset(m_readings, assets);
+
+	PyObject *set = PyDict_New();
+	for (auto& asset : assets)
+	{
+		const vector<Reading *>& readings = asset.second;
+		npy_intp count = readings.size();
+		PyObject *columns = PyDict_New();
+
+		PyObject *ts = PyArray_SimpleNew(1, &count, NPY_INT64);
+		npy_int64 *tsData = (npy_int64 *)PyArray_DATA((PyArrayObject *)ts);
+		for (npy_intp i = 0; i < count; i++)
+		{
+			struct timeval tVal;
+			readings[i]->getUserTimestamp(&tVal);
+			tsData[i] = (npy_int64)tVal.tv_sec * 1000000 + tVal.tv_usec;
+		}
+		PyDict_SetItemString(columns, USER_TS_COLUMN, ts);
+		Py_DECREF(ts);
+
+		map<string, NumericColumn> numeric;
+		numericColumns(readings, numeric);
+		for (auto& column : numeric)
+		{
+			const vector<Datapoint *>& points = column.second.m_points;
+			PyObject *array;
+			if (column.second.m_float)
+			{
+				array = PyArray_SimpleNew(1, &count, NPY_FLOAT64);
+				double *data = (double *)PyArray_DATA((PyArrayObject *)array);
+				for (npy_intp i = 0; i < count; i++)
+				{
+					const DatapointValue& value = points[i]->getData();
+					data[i] = value.getType() == DatapointValue::T_FLOAT ?
+						value.toDouble() : (double)value.toInt();
+				}
+			}
+			else
+			{
+				array = PyArray_SimpleNew(1, &count, NPY_INT64);
+				npy_int64 *data = (npy_int64 *)PyArray_DATA((PyArrayObject *)array);
+				for (npy_intp i = 0; i < count; i++)
+				{
+					data[i] = points[i]->getData().toInt();
+				}
+			}
+			PyDict_SetItemString(columns, column.first.c_str(), array);
+			Py_DECREF(array);
+		}
+
+		PyDict_SetItemString(set, asset.first.c_str(), columns);
+		Py_DECREF(columns);
+	}
+	return set;
+}
+
+/**
+ * Update the readings in place from a columnar Python representation
+ * as created by toColumns().
+ *
+ * Arrays for existing numeric datapoints overwrite the datapoint values,
+ * taking the type of the array, and the "user_ts" array replaces the
+ * user timestamps. An array whose name is not a datapoint of the asset
+ * is added to the readings as a new datapoint. Arrays that do not have
+ * one element per reading are ignored. The readings of any asset that
+ * is not in the dict are removed from the set and the last id of the
+ * set becomes that of the readings that remain.
+ *
+ * @param set	A Python dict of per asset dicts of numpy arrays
+ * @return	False if the set is not a Python dict
+ */
+bool PythonReadingSet::fromColumns(PyObject *set)
+{
+	if (!PyDict_Check(set))
+	{
+		Logger::getLogger()->error("Expected a Python dict of asset columns, got '%s'",
+					   Py_TYPE(set)->tp_name);
+		return false;
+	}
+	PythonReading::InitNumPy();
+
+	vector<AssetReadings> assets;
+	groupByAsset(m_readings, assets);
+
+	unordered_set<Reading *> removed;
+	for (auto& asset : assets)
+	{
+		const vector<Reading *>& readings = asset.second;
+		// Borrowed reference
+		PyObject *columns = PyDict_GetItemString(set, asset.first.c_str());
+		if (!columns)
+		{
+			removed.insert(readings.begin(), readings.end());
+			continue;
+		}
+		if (!PyDict_Check(columns))
+		{
+			Logger::getLogger()->warn("Columns of asset '%s' are not a dict, readings left unchanged",
+						  asset.first.c_str());
+			continue;
+		}
+
+		npy_intp count = readings.size();
+		map<string, NumericColumn> numeric;
+		numericColumns(readings, numeric);
+
+		PyObject *key, *value;
+		Py_ssize_t pos = 0;
+		while (PyDict_Next(columns, &pos, &key, &value))
+		{
+			const char *name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+			if (!name)
+			{
+				PyErr_Clear();
+				continue;
+			}
+			bool timestamps = strcmp(name, USER_TS_COLUMN) == 0;
+			auto column = numeric.find(name);
+			bool existing = false;
+			if (!timestamps && column == numeric.end())
+			{
+				for (Reading *reading : readings)
+				{
+					if ((existing = (reading->getDatapoint(name) != NULL)))
+						break;
+				}
+			}
+			if (existing)
+			{
+				Logger::getLogger()->warn("Datapoint '%s' of asset '%s' is not a numeric column, ignored",
+							  name, asset.first.c_str());
+				continue;
+			}
+
+			bool isFloat = false;
+			if (!timestamps)
+			{
+				if (PyArray_Check(value))
+					isFloat = !PyArray_ISINTEGER((PyArrayObject *)value);
+				else
+					isFloat = column == numeric.end() || column->second.m_float;
+			}
+			PyArrayObject *array = (PyArrayObject *)PyArray_FROM_OTF(value,
+						isFloat ? NPY_FLOAT64 : NPY_INT64,
+						NPY_ARRAY_IN_ARRAY | (timestamps ? NPY_ARRAY_FORCECAST : 0));
+			if (!array)
+			{
+				PyErr_Clear();
+				Logger::getLogger()->warn("Column '%s' of asset '%s' is not a numeric array, ignored",
+							  name, asset.first.c_str());
+				continue;
+			}
+			if (PyArray_NDIM(array) != 1 || PyArray_DIM(array, 0) != count)
+			{
+				Logger::getLogger()->warn("Column '%s' of asset '%s' does not have %ld elements, ignored",
+							  name, asset.first.c_str(), (long)count);
+				Py_DECREF(array);
+				continue;
+			}
+
+			if (timestamps)
+			{
+				npy_int64 *data = (npy_int64 *)PyArray_DATA(array);
+				for (npy_intp i = 0; i < count; i++)
+				{
+					// Floor division so that times before the epoch
+					// keep tv_usec in the range 0 to 999999
+					npy_int64 sec = data[i] / 1000000;
+					npy_int64 usec = data[i] % 1000000;
+					if (usec < 0)
+					{
+						sec--;
+						usec += 1000000;
+					}
+					struct timeval tVal;
+					tVal.tv_sec = (time_t)sec;
+					tVal.tv_usec = (suseconds_t)usec;
+					readings[i]->setUserTimestamp(tVal);
+				}
+			}
+			else if (column != numeric.end())
+			{
+				const vector<Datapoint *>& points = column->second.m_points;
+				if (isFloat)
+				{
+					double *data = (double *)PyArray_DATA(array);
+					for (npy_intp i = 0; i < count; i++)
+						points[i]->getData().setValue(data[i]);
+				}
+				else
+				{
+					npy_int64 *data = (npy_int64 *)PyArray_DATA(array);
+					for (npy_intp i = 0; i < count; i++)
+						points[i]->getData().setValue((long)data[i]);
+				}
+			}
+			else
+			{
+				for (npy_intp i = 0; i < count; i++)
+				{
+					DatapointValue dpv = isFloat ?
+						DatapointValue(((double *)PyArray_DATA(array))[i]) :
+						DatapointValue((long)((npy_int64 *)PyArray_DATA(array))[i]);
+					readings[i]->addDatapoint(new Datapoint(name, dpv));
+				}
+			}
+			Py_DECREF(array);
+		}
+	}
+
+	if (!removed.empty())
+	{
+		vector<Reading *> kept;
+		kept.reserve(m_readings.size() - removed.size());
+		m_last_id = 0;
+		for (Reading *reading : m_readings)
+		{
+			if (removed.count(reading))
+			{
+				delete reading;
+			}
+			else
+			{
+				kept.push_back(reading);
+				if (reading->getId() > m_last_id)
+					m_last_id = reading->getId();
+			}
+		}
+		m_readings.swap(kept);
+		m_count = m_readings.size();
+	}
+	return true;
+}
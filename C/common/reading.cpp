@@ -8,11 +8,11 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <reading.h>
+#include <reading_json_writer.h>
 #include <ctime>
 #include <string>
 #include <sstream>
 #include <iostream>
-#include <mutex>
 #include <time.h>
 #include <string.h>
 #include <logger.h>
@@ -140,6 +140,20 @@ Reading::Reading(const Reading& orig) : m_asset(orig.m_asset),
 	}
 }
 
+/**
+ * Reading move constructor. The datapoints are taken from the
+ * original reading rather than copied.
+ */
+Reading::Reading(Reading&& orig) : m_id(orig.m_id),
+	m_has_id(orig.m_has_id),
+	m_asset(std::move(orig.m_asset)),
+	m_timestamp(orig.m_timestamp),
+	m_userTimestamp(orig.m_userTimestamp),
+	m_values(std::move(orig.m_values))
+{
+	orig.m_values.clear();
+}
+
 /**
  * Destructor for Reading class
  */
@@ -220,36 +234,11 @@ Datapoint *rval;
  */
 string Reading::toJSON(bool minimal) const
 {
-ostringstream convert;
+string json;
 
-	convert << "{\"asset_code\":\"";
-	convert << escape(m_asset);
-	convert << "\",\"user_ts\":\"";
-
-	// Add date_time with microseconds + timezone UTC:
-	// YYYY-MM-DD HH24:MM:SS.MS+00:00
-	convert << getAssetDateUserTime(FMT_DEFAULT) << "+00:00";
-	if (!minimal)
-	{
-		convert << "\",\"ts\":\"";
-
-		// Add date_time with microseconds + timezone UTC:
-		// YYYY-MM-DD HH24:MM:SS.MS+00:00
-		convert << getAssetDateTime(FMT_DEFAULT) << "+00:00";
-	}
-
-	// Add values
-	convert << "\",\"reading\":{";
-	for (auto it = m_values.cbegin(); it != m_values.cend(); it++)
-	{
-		if (it != m_values.cbegin())
-		{
-			convert << ",";
-		}
-		convert << (*it)->toJSONProperty();
-	}
-	convert << "}}";
-	return convert.str();
+	json.reserve(128 + m_values.size() * 32);
+	ReadingJSONWriter(json).reading(*this, minimal);
+	return json;
 }
 
 /**
@@ -258,36 +247,25 @@ ostringstream convert;
  */
 string Reading::getDatapointsJSON() const
 {
-ostringstream convert;
+string json;
 
-	convert << "{";
-	for (auto it = m_values.cbegin(); it != m_values.cend(); it++)
-	{
-		if (it != m_values.cbegin())
-		{
-			convert << ",";
-		}
-		convert << (*it)->toJSONProperty();
-	}
-	convert << "}";
-	return convert.str();
+	ReadingJSONWriter(json).datapoints(m_values);
+	return json;
 }
 
 /**
  * Convert time since epoch to a formatted m_timestamp DataTime in UTC 
- * and use a cache to speed it up
+ * and use a cache to speed it up. The cache is per thread so that
+ * threads formatting readings in parallel do not contend for it.
  * @param tv_sec	Seconds since epoch
  * @param date_time	Buffer in which to return the formatted timestamp
  * @param dateFormat	Format: FMT_DEFAULT or FMT_STANDARD
  */
 void Reading::getFormattedDateTimeStr(const time_t *tv_sec, char *date_time, readingTimeFormat dateFormat) const
 {
-	static unsigned long cached_sec_since_epoch = 0;
-	static char cached_date_time_str[DATE_TIME_BUFFER_LEN] = "";
-	static readingTimeFormat cachedDateFormat = (readingTimeFormat) 0xff;
-	static std::mutex mtx;
-
-	std::unique_lock<std::mutex> lck(mtx);
+	static thread_local unsigned long cached_sec_since_epoch = 0;
+	static thread_local char cached_date_time_str[DATE_TIME_BUFFER_LEN] = "";
+	static thread_local readingTimeFormat cachedDateFormat = (readingTimeFormat) 0xff;
 
 	if(*cached_date_time_str && cached_sec_since_epoch && *tv_sec == cached_sec_since_epoch && cachedDateFormat == dateFormat)
 	{
@@ -430,58 +408,193 @@ void Reading::setUserTimestamp(const string& timestamp)
 }
 
 /**
- * Convert a string timestamp, with milliseconds to a 
- * struct timeval.
+ * Parse a fixed number of decimal digits
  *
- * Timezone handling
- *    The timezone in the string is extracted to get UTC values.
- *    Times within a reading are always stored as UTC
+ * @param p	Pointer to the first digit
+ * @param n	Number of digits to parse
+ * @param value	Populated with the value of the digits
+ * @return	True if all n characters are digits
+ */
+static inline bool parseDigits(const char *p, int n, int& value)
+{
+	value = 0;
+	for (int i = 0; i < n; i++)
+	{
+		unsigned int d = (unsigned char)p[i] - '0';
+		if (d > 9)
+			return false;
+		value = value * 10 + d;
+	}
+	return true;
+}
+
+/**
+ * Return the number of days since 1970-01-01 of a date in the
+ * proleptic Gregorian calendar
  *
- * @param timestamp	String timestamp
- * @param ts		Struct timeval to populate
+ * @param y	The year
+ * @param m	The month, 1 to 12
+ * @param d	The day of the month, 1 to 31
+ * @return	Days since the epoch, negative for dates before 1970
  */
-void Reading::stringToTimestamp(const string& timestamp, struct timeval *ts)
+static inline long daysFromCivil(int y, int m, int d)
 {
-	static std::mutex mtx;
-	static char cached_timestamp_upto_min[32] = "";
-	static unsigned long cached_sec_since_epoch = 0;
+	y -= m <= 2;
+	const long era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned yoe = (unsigned)(y - era * 400);
+	const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (long)doe - 719468;
+}
 
-	const int timestamp_str_len_till_min = 16;
-	const int timestamp_str_len_till_sec = 19;
-	
-	char date_time [DATE_TIME_BUFFER_LEN];
+/**
+ * Parse a timestamp in the formats used by Fledge and ISO 8601,
+ *
+ *	YYYY-MM-DD[ T]HH:MM:SS[.ffffff][ ][Z|+HH[:MM]|-HH[:MM]|+HHMM|-HHMM]
+ *
+ * The fractional seconds may have any number of digits, only the first
+ * six are used. The hours of the timezone may be given as one or two digits.
+ *
+ * The function uses no locks and does not allocate memory, the conversion
+ * of the date to days since the epoch is cached per thread as consecutive
+ * timestamps almost always fall on the same day.
+ *
+ * @param timestamp	The timestamp to parse
+ * @param len		The length of the timestamp
+ * @param ts		The struct timeval to populate with the UTC time
+ * @return		False if the timestamp is not in a recognised format
+ */
+static bool parseTimestamp(const char *timestamp, size_t len, struct timeval *ts)
+{
+	static thread_local char cachedDate[10] = { 0 };
+	static thread_local long cachedDays = 0;
+
+	const char *ptr = timestamp;
+	const char *end = timestamp + len;
+	int year, month, day, hour, min, sec;
+
+	if (len < 19 || ptr[4] != '-' || ptr[7] != '-' || (ptr[10] != ' ' && ptr[10] != 'T')
+			|| ptr[13] != ':' || ptr[16] != ':')
+		return false;
+	if (!parseDigits(ptr + 11, 2, hour) || !parseDigits(ptr + 14, 2, min)
+			|| !parseDigits(ptr + 17, 2, sec)
+			|| hour > 23 || min > 59 || sec > 60)
+		return false;
+
+	long days;
+	if (memcmp(ptr, cachedDate, sizeof(cachedDate)) == 0)
+	{
+		days = cachedDays;
+	}
+	else
+	{
+		if (!parseDigits(ptr, 4, year) || !parseDigits(ptr + 5, 2, month)
+				|| !parseDigits(ptr + 8, 2, day)
+				|| month < 1 || month > 12 || day < 1 || day > 31)
+			return false;
+		days = daysFromCivil(year, month, day);
+		memcpy(cachedDate, ptr, sizeof(cachedDate));
+		cachedDays = days;
+	}
+	ptr += 19;
+
+	long usec = 0;
+	if (ptr < end && (*ptr == '.' || *ptr == ','))
+	{
+		ptr++;
+		int digits = 0;
+		while (ptr < end && (unsigned)(*ptr - '0') <= 9)
+		{
+			if (digits < 6)
+			{
+				usec = usec * 10 + (*ptr - '0');
+				digits++;
+			}
+			ptr++;
+		}
+		if (digits == 0)
+			return false;
+		while (digits < 6)
+		{
+			usec *= 10;
+			digits++;
+		}
+	}
 
-	strcpy (date_time, timestamp.c_str());
+	while (ptr < end && *ptr == ' ')
+		ptr++;
 
+	long offset = 0;
+	if (ptr < end)
 	{
-		lock_guard<mutex> guard(mtx);
-		
-		char timestamp_sec[32];
-		strncpy(timestamp_sec, date_time, timestamp_str_len_till_sec);
-		timestamp_sec[timestamp_str_len_till_sec] = '\0';
-		if(*cached_timestamp_upto_min && cached_sec_since_epoch && (strncmp(timestamp_sec, cached_timestamp_upto_min, timestamp_str_len_till_min) == 0))
+		if (*ptr == 'Z' || *ptr == 'z')
 		{
-			// cache hit
-			int sec_part = strtoul(timestamp_sec+timestamp_str_len_till_min+1, NULL, 10);
-			ts->tv_sec = cached_sec_since_epoch + sec_part;
+			ptr++;
+		}
+		else if (*ptr == '+' || *ptr == '-')
+		{
+			int sign = (*ptr == '+' ? -1 : 1);
+			int tzHour = 0, tzMin = 0;
+			ptr++;
+			int digits = 0;
+			while (ptr < end && digits < 2 && (unsigned)(*ptr - '0') <= 9)
+			{
+				tzHour = tzHour * 10 + (*ptr++ - '0');
+				digits++;
+			}
+			if (digits == 0)
+				return false;
+			if (ptr < end && *ptr == ':')
+				ptr++;
+			if (ptr < end)
+			{
+				if (end - ptr < 2 || !parseDigits(ptr, 2, tzMin))
+					return false;
+				ptr += 2;
+			}
+			if (tzHour > 23 || tzMin > 59)
+				return false;
+			offset = sign * (3600L * tzHour + 60L * tzMin);
 		}
 		else
 		{
-			// cache miss
-			struct tm tm;
-			memset(&tm, 0, sizeof(struct tm));
-			strptime(date_time, "%Y-%m-%d %H:%M:%S", &tm);
-			// Convert time to epoch - mktime assumes localtime so most adjust for that
-			ts->tv_sec = mktime(&tm);
-
-			extern long timezone;
-			ts->tv_sec -= timezone;
-
-			strncpy(cached_timestamp_upto_min, timestamp_sec, timestamp_str_len_till_min);
-			cached_timestamp_upto_min[timestamp_str_len_till_min] = '\0';
-			cached_sec_since_epoch = ts->tv_sec - tm.tm_sec;  // store only for upto-minute part
+			return false;
 		}
 	}
+	if (ptr != end)
+		return false;
+
+	ts->tv_sec = days * 86400L + hour * 3600L + min * 60L + sec + offset;
+	ts->tv_usec = usec;
+	return true;
+}
+
+/**
+ * Convert a string timestamp, with milliseconds to a 
+ * struct timeval.
+ *
+ * Timezone handling
+ *    The timezone in the string is extracted to get UTC values.
+ *    Times within a reading are always stored as UTC
+ *
+ * Timestamps in the usual Fledge and ISO 8601 formats are converted by
+ * parseTimestamp without taking any locks. Anything else falls back to
+ * strptime, which handles the date and time loosely as before.
+ *
+ * @param timestamp	String timestamp
+ * @param ts		Struct timeval to populate
+ */
+void Reading::stringToTimestamp(const string& timestamp, struct timeval *ts)
+{
+	if (parseTimestamp(timestamp.c_str(), timestamp.length(), ts))
+		return;
+
+	const char *date_time = timestamp.c_str();
+
+	struct tm tm;
+	memset(&tm, 0, sizeof(struct tm));
+	strptime(date_time, "%Y-%m-%d %H:%M:%S", &tm);
+	ts->tv_sec = timegm(&tm);
 	
 	// Now process the fractional seconds
 	const char *ptr = date_time;
@@ -504,55 +617,22 @@ void Reading::stringToTimestamp(const string& timestamp, struct timeval *ts)
 	}
 
 	// Get the timezone from the string and convert to UTC
-	ptr = date_time + 10; // Skip date as it contains '-' characters
+	ptr = timestamp.length() > 10 ? date_time + 10 : ""; // Skip date as it contains '-' characters
 	while (*ptr && *ptr != '-' && *ptr != '+')
 		ptr++;
 	if (*ptr)
 	{
-		int h, m;
+		int h, m = 0;
 		int sign = (*ptr == '+' ? -1 : +1);
-		h = strtoul(ptr+1, NULL, 10);
-		m = strtoul(ptr+4, NULL, 10);
+		char *eptr;
+		h = strtoul(ptr+1, &eptr, 10);
+		if (*eptr == ':')
+			m = strtoul(eptr+1, NULL, 10);
 		ts->tv_sec += sign * ((3600 * h) + (60 * m));
 	}
 }
 
 
-/**
- * Escape quotes etc to allow the string to be a property value within
- * a JSON document
- *
- * @param str	The string to escape
- * @return The escaped string
- */
-const string Reading::escape(const string& str) const
-{
-string rval;
-int bscount = 0;
-
-	for (size_t i = 0; i < str.length(); i++)
-	{
-		if (str[i] == '\\')
-		{
-			bscount++;
-		}
-		else if (str[i] == '\"')
-		{
-			if ((bscount & 1) == 0)	// not already escaped
-			{
-				rval += "\\";	// Add escape of "
-			}
-			bscount = 0;
-		}
-		else
-		{
-			bscount = 0;
-		}
-		rval += str[i];
-	}
-	return rval;
-}
-
 /**
  * Convert a JSON Value object to a set of data points
  *
@@ -0,0 +1,252 @@
+/*
+ * Fledge arena allocation of readings and datapoints.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_arena.h>
+#include <logger.h>
+#include <mutex>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+/**
+ * The header at the start of every chunk, the arena is found from the
+ * address of an object by masking the address to the start of its chunk
+ */
+struct ChunkHeader {
+	ReadingArena	*arena;
+};
+
+#define CHUNK_HEADER	((sizeof(ChunkHeader) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+/**
+ * The range of address space from which the chunks are taken. Chunks
+ * are handed out in address order, chunks freed by an arena are kept
+ * for reuse. The range is never unmapped.
+ */
+static atomic<char *> regionBase(NULL);
+static char *regionNext = NULL;
+static char *regionEnd = NULL;
+static vector<char *> freeChunks;
+static mutex regionMutex;
+static thread_local ReadingArena *currentArena = NULL;
+
+/**
+ * Reserve the range of address space used for the arena chunks. No
+ * memory is committed until a chunk is first used.
+ *
+ * @return	True if the range is available
+ */
+static bool reserveRegion()
+{
+	static bool reserved = false;
+	static bool tried = false;
+
+	if (tried)
+		return reserved;
+	tried = true;
+	size_t size = READING_ARENA_REGION + READING_ARENA_CHUNK;
+	void *region = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (region == MAP_FAILED)
+	{
+		Logger::getLogger()->warn("Unable to reserve address space for reading arenas, readings will be allocated individually");
+		return false;
+	}
+	// Align the chunks on their size so that the header can be found by masking
+	uintptr_t aligned = ((uintptr_t)region + READING_ARENA_CHUNK - 1) & ~((uintptr_t)READING_ARENA_CHUNK - 1);
+	regionNext = (char *)aligned;
+	regionEnd = regionNext + READING_ARENA_REGION;
+	regionBase.store(regionNext, memory_order_release);
+	reserved = true;
+	return true;
+}
+
+/**
+ * Create an arena. The creator holds a reference to the arena which
+ * it must drop with release once it has finished allocating from it.
+ *
+ * @param chunkSize	The number of bytes of each chunk to use, at most
+ *			READING_ARENA_CHUNK less the chunk header
+ */
+ReadingArena::ReadingArena(size_t chunkSize) :
+	m_chunkSize(chunkSize < READING_ARENA_CHUNK - CHUNK_HEADER ? chunkSize : READING_ARENA_CHUNK - CHUNK_HEADER),
+	m_next(NULL), m_end(NULL), m_refs(1)
+{
+}
+
+/**
+ * Return the chunks of the arena for reuse by other arenas. The memory
+ * of the chunks is released to the operating system, the address space
+ * is kept.
+ */
+ReadingArena::~ReadingArena()
+{
+	size_t used = (CHUNK_HEADER + m_chunkSize + getpagesize() - 1) & ~((size_t)getpagesize() - 1);
+	for (char *chunk : m_chunks)
+	{
+		madvise(chunk, used, MADV_DONTNEED);
+	}
+	lock_guard<mutex> guard(regionMutex);
+	freeChunks.insert(freeChunks.end(), m_chunks.begin(), m_chunks.end());
+}
+
+/**
+ * Release a reference to the arena, the arena is destroyed when the
+ * last reference is released
+ */
+void ReadingArena::release()
+{
+	if (m_refs.fetch_sub(1) == 1)
+	{
+		delete this;
+	}
+}
+
+/**
+ * Take a chunk from the reserved range and mark it as belonging to
+ * this arena
+ *
+ * @return	The chunk or NULL if the range is exhausted
+ */
+char *ReadingArena::allocateChunk()
+{
+	char *chunk = NULL;
+	{
+		lock_guard<mutex> guard(regionMutex);
+		if (!freeChunks.empty())
+		{
+			chunk = freeChunks.back();
+			freeChunks.pop_back();
+		}
+		else if (reserveRegion() && regionNext < regionEnd)
+		{
+			if (mprotect(regionNext, READING_ARENA_CHUNK, PROT_READ | PROT_WRITE) == 0)
+			{
+				chunk = regionNext;
+				regionNext += READING_ARENA_CHUNK;
+			}
+		}
+	}
+	if (chunk)
+	{
+		((ChunkHeader *)chunk)->arena = this;
+		m_chunks.push_back(chunk);
+	}
+	return chunk;
+}
+
+/**
+ * Allocate memory from the arena. Allocations larger than a quarter of
+ * the chunk size are not made from the arena so as not to waste the
+ * remainder of the current chunk.
+ *
+ * @param size	The number of bytes to allocate
+ * @return	The allocated memory or NULL if it must come from the heap
+ */
+void *ReadingArena::allocate(size_t size)
+{
+	size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+	if (size > m_chunkSize / 4)
+	{
+		return NULL;
+	}
+	if (m_next == NULL || m_next + size > m_end)
+	{
+		char *chunk = allocateChunk();
+		if (!chunk)
+		{
+			return NULL;
+		}
+		m_next = chunk + CHUNK_HEADER;
+		m_end = m_next + m_chunkSize;
+	}
+	void *ptr = m_next;
+	m_next += size;
+	return ptr;
+}
+
+/**
+ * Return the arena that holds an object
+ *
+ * @param ptr	The object
+ * @return	The arena or NULL if the object was allocated from the heap
+ */
+ReadingArena *ReadingArena::owner(const void *ptr)
+{
+	char *base = regionBase.load(memory_order_acquire);
+	if (base == NULL || (uintptr_t)ptr - (uintptr_t)base >= READING_ARENA_REGION)
+		return NULL;
+	uintptr_t chunk = (uintptr_t)ptr & ~((uintptr_t)READING_ARENA_CHUNK - 1);
+	return ((ChunkHeader *)chunk)->arena;
+}
+
+/**
+ * Allocate the memory for an object, from the current arena of the
+ * thread if there is one, otherwise from the heap.
+ *
+ * @param size	The size of the object
+ * @return	The memory for the object
+ */
+void *ReadingArena::allocateObject(size_t size)
+{
+	ReadingArena *arena = currentArena;
+
+	if (arena)
+	{
+		void *ptr = arena->allocate(size);
+		if (ptr)
+		{
+			arena->m_refs.fetch_add(1, memory_order_relaxed);
+			return ptr;
+		}
+	}
+	return ::operator new(size);
+}
+
+/**
+ * Free the memory of an object allocated by allocateObject. Memory in
+ * an arena is only returned once the whole arena is freed.
+ *
+ * @param ptr	The object to free
+ */
+void ReadingArena::freeObject(void *ptr)
+{
+	if (!ptr)
+		return;
+	ReadingArena *arena = owner(ptr);
+	if (arena)
+	{
+		arena->release();
+	}
+	else
+	{
+		::operator delete(ptr);
+	}
+}
+
+/**
+ * Make an arena the current arena of the thread
+ *
+ * @param arena	The arena to allocate from
+ */
+ReadingArena::Scope::Scope(ReadingArena *arena) : m_previous(currentArena)
+{
+	currentArena = arena;
+}
+
+/**
+ * Restore the previous arena of the thread
+ */
+ReadingArena::Scope::~Scope()
+{
+	currentArena = m_previous;
+}
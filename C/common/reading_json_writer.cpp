@@ -0,0 +1,263 @@
+/*
+ * Fledge reading JSON serialisation.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_json_writer.h>
+#include <reading.h>
+#include <datapoint.h>
+#include <base64databuffer.h>
+#include <base64dpimage.h>
+#include <rapidjson/internal/dtoa.h>
+#include <stdexcept>
+#include <string.h>
+#include <math.h>
+
+using namespace std;
+
+/**
+ * Append a floating point value in the shortest form that reads back as
+ * the same double. Integral values keep a trailing ".0" so they are read
+ * back as floating point values. JSON has no representation for NaN or
+ * infinity, these are written as null.
+ *
+ * @param json	The JSON document being built
+ * @param value	The value to append
+ */
+void ReadingJSONWriter::appendDouble(string& json, double value)
+{
+	char buf[32];
+
+	if (!isfinite(value))
+	{
+		json.append("null");
+		return;
+	}
+	char *end = rapidjson::internal::dtoa(value, buf);
+	json.append(buf, end - buf);
+}
+
+/**
+ * Append a string as a quoted JSON string. Double quotes that are not
+ * already escaped and control characters are escaped, backslashes are
+ * assumed to introduce an existing escape sequence.
+ *
+ * @param json	The JSON document being built
+ * @param str	The string to append
+ * @param len	The length of the string
+ */
+void ReadingJSONWriter::appendString(string& json, const char *str, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	int bscount = 0;
+	size_t start = 0;
+
+	json.push_back('"');
+	for (size_t i = 0; i < len; i++)
+	{
+		unsigned char c = (unsigned char)str[i];
+		if (c == '\\')
+		{
+			bscount++;
+			continue;
+		}
+		if (c == '"')
+		{
+			if ((bscount & 1) == 0)	// not already escaped
+			{
+				json.append(str + start, i - start);
+				json.push_back('\\');
+				start = i;
+			}
+		}
+		else if (c < 0x20)
+		{
+			json.append(str + start, i - start);
+			switch (c)
+			{
+				case '\n': json.append("\\n"); break;
+				case '\r': json.append("\\r"); break;
+				case '\t': json.append("\\t"); break;
+				case '\b': json.append("\\b"); break;
+				case '\f': json.append("\\f"); break;
+				default:
+					json.append("\\u00");
+					json.push_back(hex[c >> 4]);
+					json.push_back(hex[c & 0xf]);
+					break;
+			}
+			start = i + 1;
+		}
+		bscount = 0;
+	}
+	json.append(str + start, len - start);
+	json.push_back('"');
+}
+
+/**
+ * Append a reading timestamp in the format
+ * YYYY-MM-DD HH24:MM:SS.MS+00:00
+ *
+ * @param reading	The reading, used for its formatting cache
+ * @param tv		The timestamp to append
+ */
+void ReadingJSONWriter::timestamp(const Reading& reading, const struct timeval& tv)
+{
+	char date_time[DATE_TIME_BUFFER_LEN];
+	char micro_s[8];
+
+	reading.getFormattedDateTimeStr(&tv.tv_sec, date_time, Reading::FMT_DEFAULT);
+	m_buffer.append(date_time);
+
+	unsigned long usec = tv.tv_usec;
+	micro_s[0] = '.';
+	for (int i = 6; i > 0; i--)
+	{
+		micro_s[i] = '0' + (usec % 10);
+		usec /= 10;
+	}
+	m_buffer.append(micro_s, 7);
+	m_buffer.append("+00:00");
+}
+
+/**
+ * Append a reading as the JSON object used by the storage service
+ * readings API
+ *
+ * @param reading	The reading to append
+ * @param minimal	Do not include the system timestamp
+ */
+void ReadingJSONWriter::reading(const Reading& reading, bool minimal)
+{
+	m_buffer.append("{\"asset_code\":");
+	appendString(m_buffer, reading.m_asset);
+	m_buffer.append(",\"user_ts\":\"");
+	timestamp(reading, reading.m_userTimestamp);
+	if (!minimal)
+	{
+		m_buffer.append("\",\"ts\":\"");
+		timestamp(reading, reading.m_timestamp);
+	}
+	m_buffer.append("\",\"reading\":");
+	datapoints(reading.m_values);
+	m_buffer.push_back('}');
+}
+
+/**
+ * Append a set of datapoints as a JSON object
+ *
+ * @param datapoints	The datapoints to append
+ */
+void ReadingJSONWriter::datapoints(const vector<Datapoint *>& datapoints)
+{
+	m_buffer.push_back('{');
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		if (it != datapoints.cbegin())
+			m_buffer.push_back(',');
+		datapoint(**it);
+	}
+	m_buffer.push_back('}');
+}
+
+/**
+ * Append a datapoint as a JSON property, i.e. the name followed
+ * by the value
+ *
+ * @param datapoint	The datapoint to append
+ */
+void ReadingJSONWriter::datapoint(const Datapoint& datapoint)
+{
+	appendString(m_buffer, datapoint.m_name);
+	m_buffer.push_back(':');
+	value(datapoint.m_value);
+}
+
+/**
+ * Append a datapoint value
+ *
+ * @param value	The value to append
+ */
+void ReadingJSONWriter::value(const DatapointValue& value)
+{
+	switch (value.m_type)
+	{
+	case DatapointValue::T_INTEGER:
+		{
+			char buf[24];
+			int len = snprintf(buf, sizeof(buf), "%ld", value.m_value.i);
+			m_buffer.append(buf, len);
+			break;
+		}
+	case DatapointValue::T_FLOAT:
+		appendDouble(m_buffer, value.m_value.f);
+		break;
+	case DatapointValue::T_STRING:
+		appendString(m_buffer, value.m_value.str);
+		break;
+	case DatapointValue::T_FLOAT_ARRAY:
+		m_buffer.push_back('[');
+		for (auto it = value.m_value.a->cbegin(); it != value.m_value.a->cend(); ++it)
+		{
+			if (it != value.m_value.a->cbegin())
+				m_buffer.append(", ");
+			appendDouble(m_buffer, *it);
+		}
+		m_buffer.push_back(']');
+		break;
+	case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			const Float2DArray *array = value.m_value.a2d;
+			m_buffer.append("[ ");
+			for (size_t row = 0; row < array->rows(); row++)
+			{
+				if (row)
+					m_buffer.append(", ");
+				m_buffer.push_back('[');
+				const double *values = array->row(row);
+				for (size_t i = 0; i < array->rowLength(row); i++)
+				{
+					if (i)
+						m_buffer.append(", ");
+					appendDouble(m_buffer, values[i]);
+				}
+				m_buffer.push_back(']');
+			}
+			m_buffer.append(" ]");
+			break;
+		}
+	case DatapointValue::T_DP_DICT:
+	case DatapointValue::T_DP_LIST:
+		{
+			bool dict = value.m_type == DatapointValue::T_DP_DICT;
+			m_buffer.push_back(dict ? '{' : '[');
+			for (auto it = value.m_value.dpa->cbegin(); it != value.m_value.dpa->cend(); ++it)
+			{
+				if (it != value.m_value.dpa->cbegin())
+					m_buffer.append(", ");
+				if (dict)
+					datapoint(**it);
+				else
+					this->value((*it)->m_value);
+			}
+			m_buffer.push_back(dict ? '}' : ']');
+			break;
+		}
+	case DatapointValue::T_DATABUFFER:
+		m_buffer.append("\"__DATABUFFER:");
+		m_buffer.append(((Base64DataBuffer *)value.m_value.dataBuffer)->encode());
+		m_buffer.push_back('"');
+		break;
+	case DatapointValue::T_IMAGE:
+		m_buffer.append("\"__DPIMAGE:");
+		m_buffer.append(((Base64DPImage *)value.m_value.image)->encode());
+		m_buffer.push_back('"');
+		break;
+	default:
+		throw runtime_error("No string representation for datapoint type");
+	}
+}
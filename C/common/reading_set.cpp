@@ -64,9 +64,14 @@ ReadingSet::ReadingSet(const vector<Reading *>* readings) : m_last_id(0)
  * Construct a reading set from a JSON document returned from
  * the Fledge storage service query or notification.
  *
- * @param json	The JSON document (as string) with readings data
+ * The readings and their datapoints may optionally be allocated from
+ * a ReadingArena, the arena memory is freed when the last of the
+ * readings is deleted.
+ *
+ * @param json		The JSON document (as string) with readings data
+ * @param useArena	Allocate the readings from an arena
  */
-ReadingSet::ReadingSet(const std::string& json) : m_last_id(0)
+ReadingSet::ReadingSet(const std::string& json, bool useArena) : m_last_id(0)
 {
 	unsigned long rows = 0;
 	Document doc;
@@ -108,26 +113,38 @@ ReadingSet::ReadingSet(const std::string& json) : m_last_id(0)
 	if (readings.IsArray())
 	{
 		unsigned long id = 0;
-		// Process every rows and create the result set
-		for (auto& reading : readings.GetArray())
-		{
-			if (!reading.IsObject())
+		ReadingArena *arena = useArena ? new ReadingArena() : NULL;
+		try {
+			ReadingArena::Scope scope(arena);
+			m_readings.reserve(readings.Size());
+			// Process every rows and create the result set
+			for (auto& reading : readings.GetArray())
 			{
-				throw new ReadingSetException("Expected reading to be an object");
-			}
-			JSONReading *value = new JSONReading(reading);
-			m_readings.push_back(value);
+				if (!reading.IsObject())
+				{
+					throw new ReadingSetException("Expected reading to be an object");
+				}
+				JSONReading *value = new JSONReading(reading);
+				m_readings.push_back(value);
 
-			// Get the Reading Id
-			id = value->getId();
+				// Get the Reading Id
+				id = value->getId();
 
-			// We don't have count informations with "readings"
-			if (docHasReadings)
-			{
-				rows++;
-			}
+				// We don't have count informations with "readings"
+				if (docHasReadings)
+				{
+					rows++;
+				}
 
+			}
+		} catch (...) {
+			if (arena)
+				arena->release();
+			throw;
 		}
+		// The readings now hold the only references to the arena
+		if (arena)
+			arena->release();
 		// Set the last id
 		m_last_id = id;
 
@@ -230,6 +247,27 @@ unsigned long ReadingSet::getReadingId(uint32_t pos)
 	return m_last_id;
 }
 
+/**
+ * Return the ID of the last reading covered by a send of the reading set
+ *
+ * @param sent		The number of readings reported as sent
+ * @param partial	True if the sent count covers only the leading readings
+ *			of the set, otherwise any non-zero count covers them all
+ * @return		The ID of the last reading sent, 0 if none were sent
+ */
+unsigned long ReadingSet::getLastSentId(uint32_t sent, bool partial)
+{
+	if (sent == 0)
+	{
+		return 0;
+	}
+	if (partial && sent < m_readings.size())
+	{
+		return m_readings[sent - 1]->getId();
+	}
+	return m_last_id;
+}
+
 /**
  * Construct a reading from a JSON document
  *
@@ -251,7 +289,7 @@ JSONReading::JSONReading(const Value& json)
 	}
 	if (json.HasMember("asset_code"))
 	{
-		m_asset = json["asset_code"].GetString();
+		m_asset = InternedString(json["asset_code"].GetString(), json["asset_code"].GetStringLength());
 	}
 	else
 	{
@@ -327,7 +365,7 @@ JSONReading::JSONReading(const Value& json)
 			// Add 'reading' values
 			for (auto &m : json["reading"].GetObject())
 			{
-				addDatapoint(datapoint(m.name.GetString(), m.value));
+				addDatapoint(datapoint(InternedString(m.name.GetString(), m.name.GetStringLength()), m.value));
 			}
 		}
 		else
@@ -393,7 +431,7 @@ JSONReading::JSONReading(const Value& json)
  * @param item	The JSON object forthe data point
  * @return Datapoint* The new data point
  */
-Datapoint *JSONReading::datapoint(const string& name, const Value& item)
+Datapoint *JSONReading::datapoint(const InternedString& name, const Value& item)
 {
 Datapoint *rval = NULL;
 
@@ -490,8 +528,8 @@ Datapoint *rval = NULL;
 					arrayValues.push_back(i);
 				}
 			}
-			DatapointValue value(arrayValues);
-			rval = new Datapoint(name, value);
+			DatapointValue value(std::move(arrayValues));
+			rval = new Datapoint(name, std::move(value));
 			break;
 			    
 		}
@@ -499,13 +537,13 @@ Datapoint *rval = NULL;
 		// Nested object
 		case kObjectType:
 		{
-			vector<Datapoint *> *obj = new vector<Datapoint *>;
+			vector<Datapoint *> *obj = ReadingArena::create<vector<Datapoint *>>();
 			for (auto &mo : item.GetObject())
 			{
-				obj->push_back(datapoint(mo.name.GetString(), mo.value));
+				obj->push_back(datapoint(InternedString(mo.name.GetString(), mo.name.GetStringLength()), mo.value));
 			}
 			DatapointValue value(obj, true);
-			rval = new Datapoint(name, value);
+			rval = new Datapoint(name, std::move(value));
 			break;
 		}
 
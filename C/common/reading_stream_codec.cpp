@@ -0,0 +1,594 @@
+/*
+ * Fledge storage reading stream binary payload encoding.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_stream_codec.h>
+#include <reading.h>
+#include <datapoint.h>
+#include <reading_json_writer.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Append a fixed size value to the payload
+ */
+template<typename T> static inline void put(string& payload, T value)
+{
+	payload.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * Extract a fixed size value from the payload, checking we do not
+ * read beyond the end of the payload.
+ */
+template<typename T> static inline bool get(const char *& p, const char *end, T& value)
+{
+	if (sizeof(T) > (size_t)(end - p))
+		return false;
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return true;
+}
+
+/**
+ * Encode the datapoints of a reading into the binary payload format
+ * used by version 2 of the reading stream protocol. The encoded data
+ * is appended to the payload string.
+ *
+ * @param reading	The reading to encode
+ * @param payload	The string to append the encoded payload to
+ */
+void ReadingStreamCodec::encode(const Reading& reading, string& payload)
+{
+	payload.push_back((char)RDS_PAYLOAD_BINARY_V1);
+	encodeDatapoints(reading.getReadingData(), payload);
+}
+
+/**
+ * Encode a set of datapoints, preceded by the count of datapoints
+ *
+ * @param datapoints	The datapoints to encode
+ * @param payload	The string to append the encoded datapoints to
+ */
+void ReadingStreamCodec::encodeDatapoints(const vector<Datapoint *>& datapoints, string& payload)
+{
+	put<uint32_t>(payload, datapoints.size());
+	for (auto& dp : datapoints)
+	{
+		const string& name = dp->getName();
+		put<uint32_t>(payload, name.length());
+		payload.append(name);
+		encodeValue(dp->getData(), payload);
+	}
+}
+
+/**
+ * Encode a single datapoint value, the type tag followed by the value
+ *
+ * @param value		The value to encode
+ * @param payload	The string to append the encoded value to
+ */
+void ReadingStreamCodec::encodeValue(DatapointValue& value, string& payload)
+{
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			payload.push_back(RDS_DP_INTEGER);
+			put<int64_t>(payload, value.toInt());
+			break;
+		case DatapointValue::T_FLOAT:
+			payload.push_back(RDS_DP_FLOAT);
+			put<double>(payload, value.toDouble());
+			break;
+		case DatapointValue::T_STRING:
+		{
+			payload.push_back(RDS_DP_STRING);
+			const string str = value.toStringValue();
+			put<uint32_t>(payload, str.length());
+			payload.append(str);
+			break;
+		}
+		case DatapointValue::T_FLOAT_ARRAY:
+		{
+			payload.push_back(RDS_DP_FLOAT_ARRAY);
+			vector<double> *arr = value.getDpArr();
+			put<uint32_t>(payload, arr->size());
+			payload.append((const char *)arr->data(), arr->size() * sizeof(double));
+			break;
+		}
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+			payload.push_back(value.getType() == DatapointValue::T_DP_DICT ?
+					RDS_DP_DICT : RDS_DP_LIST);
+			encodeDatapoints(*(value.getDpVec()), payload);
+			break;
+		case DatapointValue::T_IMAGE:
+		{
+			payload.push_back(RDS_DP_IMAGE);
+			DPImage *image = value.getImage();
+			uint32_t length = image->getWidth() * image->getHeight() * (image->getDepth() / 8);
+			put<uint32_t>(payload, image->getWidth());
+			put<uint32_t>(payload, image->getHeight());
+			put<uint32_t>(payload, image->getDepth());
+			put<uint32_t>(payload, length);
+			payload.append((const char *)image->getData(), length);
+			break;
+		}
+		case DatapointValue::T_DATABUFFER:
+		{
+			payload.push_back(RDS_DP_DATABUFFER);
+			DataBuffer *buffer = value.getDataBuffer();
+			put<uint32_t>(payload, buffer->getItemSize());
+			put<uint32_t>(payload, buffer->getItemCount());
+			payload.append((const char *)buffer->getData(),
+					buffer->getItemSize() * buffer->getItemCount());
+			break;
+		}
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			payload.push_back(RDS_DP_2D_FLOAT_ARRAY);
+			const Float2DArray *arr = value.get2DArray();
+			put<uint32_t>(payload, arr->rows());
+			for (size_t row = 0; row < arr->rows(); row++)
+			{
+				put<uint32_t>(payload, arr->rowLength(row));
+				payload.append((const char *)arr->row(row), arr->rowLength(row) * sizeof(double));
+			}
+			break;
+		}
+		default:
+			throw runtime_error("Unsupported datapoint type for stream encoding");
+	}
+}
+
+/**
+ * Convert a binary encoded payload to the JSON representation that
+ * Reading::getDatapointsJSON would have created for the same reading.
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload
+ * @param json		The string to populate with the JSON document
+ * @return bool		False if the payload is malformed
+ */
+bool ReadingStreamCodec::toJSON(const char *payload, size_t length, string& json)
+{
+	const char *p = payload, *end = payload + length;
+	uint8_t version;
+	uint32_t count;
+
+	json.clear();
+	if (!get(p, end, version) || version != RDS_PAYLOAD_BINARY_V1)
+		return false;
+	if (!get(p, end, count))
+		return false;
+	json.reserve(length * 2);
+	json.push_back('{');
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t nameLen;
+		if (i)
+			json.push_back(',');
+		if (!get(p, end, nameLen) || nameLen > (size_t)(end - p))
+			return false;
+		ReadingJSONWriter::appendString(json, p, nameLen);
+		json.push_back(':');
+		p += nameLen;
+		if (!valueToJSON(p, end, json))
+			return false;
+	}
+	json.push_back('}');
+	return true;
+}
+
+/**
+ * Convert a set of nested datapoints to JSON. Dictionaries include the
+ * datapoint names, lists only include the values.
+ *
+ * @param p		The current position in the payload
+ * @param end		The end of the payload
+ * @param count		The number of datapoints
+ * @param names		Output the names of the datapoints
+ * @param json		The JSON document being built
+ * @return bool		False if the payload is malformed
+ */
+bool ReadingStreamCodec::datapointsToJSON(const char *& p, const char *end,
+		uint32_t count, bool names, string& json)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t nameLen;
+		if (i)
+			json.append(", ");
+		if (!get(p, end, nameLen) || nameLen > (size_t)(end - p))
+			return false;
+		if (names)
+		{
+			ReadingJSONWriter::appendString(json, p, nameLen);
+			json.push_back(':');
+		}
+		p += nameLen;
+		if (!valueToJSON(p, end, json))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Convert a single encoded value to JSON
+ *
+ * @param p		The current position in the payload
+ * @param end		The end of the payload
+ * @param json		The JSON document being built
+ * @return bool		False if the payload is malformed
+ */
+bool ReadingStreamCodec::valueToJSON(const char *& p, const char *end, string& json)
+{
+	uint8_t tag;
+
+	if (!get(p, end, tag))
+		return false;
+	switch (tag)
+	{
+		case RDS_DP_INTEGER:
+		{
+			int64_t i;
+			if (!get(p, end, i))
+				return false;
+			json.append(to_string((long)i));
+			return true;
+		}
+		case RDS_DP_FLOAT:
+		{
+			double d;
+			if (!get(p, end, d))
+				return false;
+			ReadingJSONWriter::appendDouble(json, d);
+			return true;
+		}
+		case RDS_DP_STRING:
+		{
+			uint32_t len;
+			if (!get(p, end, len) || len > (size_t)(end - p))
+				return false;
+			ReadingJSONWriter::appendString(json, p, len);
+			p += len;
+			return true;
+		}
+		case RDS_DP_FLOAT_ARRAY:
+		{
+			uint32_t n;
+			if (!get(p, end, n) || n > (size_t)(end - p) / sizeof(double))
+				return false;
+			json.push_back('[');
+			for (uint32_t i = 0; i < n; i++)
+			{
+				double d;
+				get(p, end, d);
+				if (i)
+					json.append(", ");
+				ReadingJSONWriter::appendDouble(json, d);
+			}
+			json.push_back(']');
+			return true;
+		}
+		case RDS_DP_DICT:
+		case RDS_DP_LIST:
+		{
+			uint32_t n;
+			if (!get(p, end, n))
+				return false;
+			json.push_back(tag == RDS_DP_DICT ? '{' : '[');
+			if (!datapointsToJSON(p, end, n, tag == RDS_DP_DICT, json))
+				return false;
+			json.push_back(tag == RDS_DP_DICT ? '}' : ']');
+			return true;
+		}
+		case RDS_DP_IMAGE:
+		case RDS_DP_DATABUFFER:
+		case RDS_DP_2D_FLOAT_ARRAY:
+		{
+			// Rare types, reuse the encoding of the DatapointValue
+			p--;
+			DatapointValue *value = decodeValue(p, end);
+			if (!value)
+				return false;
+			json.append(value->toString());
+			delete value;
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+/**
+ * Decode a binary encoded payload into a set of datapoints
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload
+ * @return		The datapoints or NULL if the payload is malformed.
+ *			The caller takes ownership of the datapoints.
+ */
+vector<Datapoint *> *ReadingStreamCodec::decode(const char *payload, size_t length)
+{
+	const char *p = payload, *end = payload + length;
+	uint8_t version;
+	uint32_t count;
+
+	if (!get(p, end, version) || version != RDS_PAYLOAD_BINARY_V1)
+		return NULL;
+	if (!get(p, end, count))
+		return NULL;
+	return decodeDatapoints(p, end, count);
+}
+
+/**
+ * Encode a set of readings as a binary fetch block. Each reading carries
+ * its id, timestamps and asset name along with the binary encoding of
+ * its datapoints.
+ *
+ * @param readings	The readings to encode
+ * @param block		The string to populate with the encoded block
+ */
+void ReadingStreamCodec::encodeBlock(const vector<Reading *>& readings, string& block)
+{
+	startBlock(block, readings.size());
+	string payload;
+	for (auto reading : readings)
+	{
+		struct timeval userTs, ts;
+		reading->getUserTimestamp(&userTs);
+		reading->getTimestamp(&ts);
+		payload.clear();
+		encode(*reading, payload);
+		appendBlockReading(block, reading->getId(), userTs, ts,
+				reading->getAssetName(), payload.data(), payload.length());
+	}
+}
+
+/**
+ * Start a binary fetch block, replacing any content of the block
+ * with the block header
+ *
+ * @param block		The block to start
+ * @param count		The number of readings that will be appended
+ */
+void ReadingStreamCodec::startBlock(string& block, uint32_t count)
+{
+	RDSFetchHeader hdr;
+	hdr.magic = RDS_FETCH_MAGIC;
+	hdr.count = count;
+	block.clear();
+	block.append((const char *)&hdr, sizeof(hdr));
+}
+
+/**
+ * Append a reading whose datapoints are already in the binary
+ * encoding to a binary fetch block
+ *
+ * @param block		The block to append to
+ * @param id		The id of the reading
+ * @param userTs	The user timestamp of the reading
+ * @param ts		The timestamp of the reading
+ * @param asset		The asset name of the reading
+ * @param payload	The binary encoded datapoints
+ * @param payloadLength	The length of the encoded datapoints
+ */
+void ReadingStreamCodec::appendBlockReading(string& block, uint64_t id,
+				const struct timeval& userTs, const struct timeval& ts,
+				const string& asset, const char *payload, size_t payloadLength)
+{
+	RDSFetchReadingHeader rhdr;
+	rhdr.id = id;
+	rhdr.userTsSec = userTs.tv_sec;
+	rhdr.userTsUsec = userTs.tv_usec;
+	rhdr.tsSec = ts.tv_sec;
+	rhdr.tsUsec = ts.tv_usec;
+	rhdr.assetLength = asset.length();
+	rhdr.payloadLength = payloadLength;
+	block.append((const char *)&rhdr, sizeof(rhdr));
+	block.append(asset);
+	block.append(payload, payloadLength);
+}
+
+/**
+ * Decode a binary fetch block into a set of readings
+ *
+ * @param block		The encoded block
+ * @param length	The length of the block
+ * @return		The readings or NULL if the block is malformed.
+ *			The caller takes ownership of the readings.
+ */
+vector<Reading *> *ReadingStreamCodec::decodeBlock(const char *block, size_t length)
+{
+	const char *p = block, *end = block + length;
+	RDSFetchHeader hdr;
+
+	if (!get(p, end, hdr) || hdr.magic != RDS_FETCH_MAGIC)
+		return NULL;
+	// The count is not trusted, reserve no more than the block could hold
+	vector<Reading *> *readings = new vector<Reading *>;
+	readings->reserve(min((size_t)hdr.count, (size_t)(end - p) / sizeof(RDSFetchReadingHeader)));
+	for (uint32_t i = 0; i < hdr.count; i++)
+	{
+		RDSFetchReadingHeader rhdr;
+		vector<Datapoint *> *datapoints = NULL;
+		if (get(p, end, rhdr) && (uint64_t)rhdr.assetLength + rhdr.payloadLength <= (size_t)(end - p))
+		{
+			datapoints = decode(p + rhdr.assetLength, rhdr.payloadLength);
+		}
+		if (!datapoints)
+		{
+			for (auto reading : *readings)
+				delete reading;
+			delete readings;
+			return NULL;
+		}
+		Reading *reading = new Reading(string(p, rhdr.assetLength), *datapoints);
+		delete datapoints;
+		p += rhdr.assetLength + rhdr.payloadLength;
+
+		struct timeval tv;
+		reading->setId(rhdr.id);
+		tv.tv_sec = rhdr.userTsSec;
+		tv.tv_usec = rhdr.userTsUsec;
+		reading->setUserTimestamp(tv);
+		tv.tv_sec = rhdr.tsSec;
+		tv.tv_usec = rhdr.tsUsec;
+		reading->setTimestamp(tv);
+		readings->push_back(reading);
+	}
+	return readings;
+}
+
+/**
+ * Decode a number of datapoints from the payload
+ *
+ * @param p		The current position in the payload
+ * @param end		The end of the payload
+ * @param count		The number of datapoints to decode
+ * @return		The datapoints or NULL if the payload is malformed
+ */
+vector<Datapoint *> *ReadingStreamCodec::decodeDatapoints(const char *& p, const char *end, uint32_t count)
+{
+	// Each datapoint is at least a name length and a type tag
+	vector<Datapoint *> *datapoints = new vector<Datapoint *>;
+	datapoints->reserve(min((size_t)count, (size_t)(end - p) / (sizeof(uint32_t) + 1)));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t nameLen;
+		DatapointValue *value = NULL;
+		if (get(p, end, nameLen) && nameLen <= (size_t)(end - p))
+		{
+			string name(p, nameLen);
+			p += nameLen;
+			value = decodeValue(p, end);
+			if (value)
+			{
+				datapoints->push_back(new Datapoint(name, *value));
+				delete value;
+			}
+		}
+		if (!value)
+		{
+			for (auto dp : *datapoints)
+				delete dp;
+			delete datapoints;
+			return NULL;
+		}
+	}
+	return datapoints;
+}
+
+/**
+ * Decode a single value from the payload
+ *
+ * @param p		The current position in the payload
+ * @param end		The end of the payload
+ * @return		The value or NULL if the payload is malformed
+ */
+DatapointValue *ReadingStreamCodec::decodeValue(const char *& p, const char *end)
+{
+	uint8_t tag;
+
+	if (!get(p, end, tag))
+		return NULL;
+	switch (tag)
+	{
+		case RDS_DP_INTEGER:
+		{
+			int64_t i;
+			if (!get(p, end, i))
+				return NULL;
+			return new DatapointValue((long)i);
+		}
+		case RDS_DP_FLOAT:
+		{
+			double d;
+			if (!get(p, end, d))
+				return NULL;
+			return new DatapointValue(d);
+		}
+		case RDS_DP_STRING:
+		{
+			uint32_t len;
+			if (!get(p, end, len) || len > (size_t)(end - p))
+				return NULL;
+			string str(p, len);
+			p += len;
+			return new DatapointValue(str);
+		}
+		case RDS_DP_FLOAT_ARRAY:
+		{
+			uint32_t n;
+			if (!get(p, end, n) || n > (size_t)(end - p) / sizeof(double))
+				return NULL;
+			vector<double> arr(n);
+			memcpy(arr.data(), p, n * sizeof(double));
+			p += n * sizeof(double);
+			return new DatapointValue(arr);
+		}
+		case RDS_DP_DICT:
+		case RDS_DP_LIST:
+		{
+			uint32_t n;
+			if (!get(p, end, n))
+				return NULL;
+			vector<Datapoint *> *dps = decodeDatapoints(p, end, n);
+			if (!dps)
+				return NULL;
+			return new DatapointValue(dps, tag == RDS_DP_DICT);
+		}
+		case RDS_DP_IMAGE:
+		{
+			uint32_t width, height, depth, len;
+			if (!get(p, end, width) || !get(p, end, height)
+					|| !get(p, end, depth) || !get(p, end, len)
+					|| width == 0 || height == 0
+					|| (depth != 8 && depth != 16 && depth != 24 && depth != 32)
+					|| (uint64_t)width * height * (depth / 8) != len
+					|| len > (size_t)(end - p))
+				return NULL;
+			DPImage *image = new DPImage(width, height, depth, (void *)p);
+			p += len;
+			return new DatapointValue(image);
+		}
+		case RDS_DP_DATABUFFER:
+		{
+			uint32_t itemSize, count;
+			if (!get(p, end, itemSize) || !get(p, end, count)
+					|| (uint64_t)itemSize * count > (size_t)(end - p))
+				return NULL;
+			DataBuffer *buffer = new DataBuffer(itemSize, count);
+			buffer->populate((void *)p, itemSize * count);
+			p += (size_t)itemSize * count;
+			return new DatapointValue(buffer);
+		}
+		case RDS_DP_2D_FLOAT_ARRAY:
+		{
+			uint32_t rows;
+			if (!get(p, end, rows))
+				return NULL;
+			Float2DArray arr;
+			for (uint32_t r = 0; r < rows; r++)
+			{
+				uint32_t n;
+				if (!get(p, end, n) || n > (size_t)(end - p) / sizeof(double))
+					return NULL;
+				memcpy(arr.appendRow(n), p, n * sizeof(double));
+				p += n * sizeof(double);
+			}
+			return new DatapointValue(std::move(arr));
+		}
+		default:
+			return NULL;
+	}
+}
@@ -11,6 +11,8 @@
 #include <reading.h>
 #include <reading_set.h>
 #include <reading_stream.h>
+#include <reading_stream_codec.h>
+#include <reading_json_writer.h>
 #include <rapidjson/document.h>
 #include <rapidjson/error/en.h>
 #include <management_client.h>
@@ -46,7 +48,8 @@ std::mutex sto_mtx_client_map;
 /**
  * Storage Client constructor
  */
-StorageClient::StorageClient(const string& hostname, const unsigned short port) : m_streaming(false), m_management(NULL)
+StorageClient::StorageClient(const string& hostname, const unsigned short port) : m_streaming(false),
+	m_streamProtocol(RDS_PROTOCOL_JSON), m_binaryFetch(true), m_management(NULL)
 {
 	m_host = hostname;
 	m_pid = getpid();
@@ -58,7 +61,8 @@ StorageClient::StorageClient(const string& hostname, const unsigned short port)
  * Storage Client constructor
  * stores the provided HttpClient into the map
  */
-StorageClient::StorageClient(HttpClient *client) : m_streaming(false), m_management(NULL)
+StorageClient::StorageClient(HttpClient *client) : m_streaming(false),
+	m_streamProtocol(RDS_PROTOCOL_JSON), m_binaryFetch(true), m_management(NULL)
 {
 
 	std::thread::id thread_id = std::this_thread::get_id();
@@ -121,12 +125,10 @@ HttpClient *StorageClient::getHttpClient(void) {
 bool StorageClient::readingAppend(Reading& reading)
 {
 	try {
-		ostringstream convert;
-
-		convert << "{ \"readings\" : [ ";
-		convert << reading.toJSON();
-		convert << " ] }";
-		auto res = this->getHttpClient()->request("POST", "/storage/reading", convert.str());
+		string payload("{ \"readings\" : [ ");
+		ReadingJSONWriter(payload).reading(reading);
+		payload.append(" ] }");
+		auto res = this->getHttpClient()->request("POST", "/storage/reading", payload);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			return true;
@@ -189,22 +191,26 @@ bool StorageClient::readingAppend(const vector<Reading *>& readings)
 #if INSTRUMENT
 		gettimeofday(&start, NULL);
 #endif
-		ostringstream convert;
-		convert << "{ \"readings\" : [ ";
+		// Serialise all the readings into one buffer, reused by
+		// the thread for subsequent appends
+		static thread_local string payload;
+		ReadingJSONWriter writer(payload);
+		payload.clear();
+		payload.append("{ \"readings\" : [ ");
 		for (vector<Reading *>::const_iterator it = readings.cbegin();
 						 it != readings.cend(); ++it)
 		{
 			if (it != readings.cbegin())
 			{
-				convert << ", ";
+				payload.append(", ");
 			}
-			convert << (*it)->toJSON();
+			writer.reading(**it);
 		}
-		convert << " ] }";
+		payload.append(" ] }");
 #if INSTRUMENT
 		gettimeofday(&t1, NULL);
 #endif
-		auto res = this->getHttpClient()->request("POST", "/storage/reading", convert.str(), headers);
+		auto res = this->getHttpClient()->request("POST", "/storage/reading", payload, headers);
 #if INSTRUMENT
 		gettimeofday(&t2, NULL);
 #endif
@@ -220,7 +226,7 @@ bool StorageClient::readingAppend(const vector<Reading *>& readings)
 			m_logger->info("Appended %d readings in %.3f seconds. Took %.3f seconds to build request", readings.size(), requestTime, buildTime);
 			m_logger->info("%.1f Readings per second, request building %.2f%% of time", readings.size() / (buildTime + requestTime),
 					(buildTime * 100) / (requestTime + buildTime));
-			m_logger->info("Request block size %dK", strlen(convert.str().c_str())/1024);
+			m_logger->info("Request block size %dK", payload.length()/1024);
 #endif
 			return true;
 		}
@@ -307,12 +313,23 @@ ReadingSet *StorageClient::readingQueryToReadings(const Query& query)
  * Retrieve a set of readings for sending on the northbound
  * interface of Fledge
  *
+ * The binary fetch is used if the storage service supports it,
+ * otherwise the readings are fetched as a JSON document.
+ *
  * @param readingId	The ID of the reading which should be the first one to send
  * @param count		Maximum number if readings to return
  * @return ReadingSet	The set of readings
  */
 ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const unsigned long count)
 {
+	if (m_binaryFetch)
+	{
+		ReadingSet *result = readingFetchBinary(readingId, count);
+		if (result || m_binaryFetch)
+		{
+			return result;
+		}
+	}
 	try {
 
 		char url[256];
@@ -324,7 +341,7 @@ ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const uns
 		{
 			ostringstream resultPayload;
 			resultPayload << res->content.rdbuf();
-			ReadingSet *result = new ReadingSet(resultPayload.str().c_str());
+			ReadingSet *result = new ReadingSet(resultPayload.str(), true);
 			return result;
 		}
 		ostringstream resultPayload;
@@ -341,6 +358,65 @@ ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const uns
 	return 0;
 }
 
+/**
+ * Retrieve a block of readings from the storage service as a binary
+ * fetch block. The readings are created directly from the block rather
+ * than from a JSON document.
+ *
+ * If the storage service does not support the binary fetch the
+ * m_binaryFetch flag is cleared and NULL is returned, the caller will
+ * then use the JSON fetch for this and all future requests.
+ *
+ * @param readingId	The ID of the reading which should be the first one to send
+ * @param count		Maximum number if readings to return
+ * @return ReadingSet	The set of readings or NULL if binary fetch is not supported
+ */
+ReadingSet *StorageClient::readingFetchBinary(const unsigned long readingId, const unsigned long count)
+{
+	try {
+
+		char url[256];
+		snprintf(url, sizeof(url), "/storage/reading/binary?id=%ld&count=%ld",
+				readingId, count);
+
+		auto res = this->getHttpClient()->request("GET", url);
+		if (res->status_code.compare("200 OK") == 0)
+		{
+			string block = res->content.string();
+			vector<Reading *> *readings;
+			ReadingArena *arena = new ReadingArena();
+			{
+				ReadingArena::Scope scope(arena);
+				readings = ReadingStreamCodec::decodeBlock(block.data(), block.length());
+			}
+			arena->release();
+			if (!readings)
+			{
+				throw runtime_error("Malformed binary reading block");
+			}
+			ReadingSet *result = new ReadingSet(readings);
+			delete readings;
+			return result;
+		}
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		// Older storage services reject the URL as unsupported
+		if (res->status_code.compare(0, 3, "404") == 0 ||
+			(res->status_code.compare(0, 3, "400") == 0 &&
+			 resultPayload.str().find("Unsupported URL") != string::npos))
+		{
+			m_logger->info("Storage service does not support binary reading fetch, using JSON");
+			m_binaryFetch = false;
+			return NULL;
+		}
+		handleUnexpectedResponse("Fetch readings", res->status_code, resultPayload.str());
+	} catch (exception& ex) {
+		handleException(ex, "fetch readings");
+		throw;
+	}
+	return 0;
+}
+
 /**
  * Purge the readings by age
  *
@@ -581,6 +657,80 @@ int StorageClient::insertTable(const string& schema, const string& tableName, co
 	return 0;
 }
 
+/**
+ * Insert multiple rows into an arbitrary table
+ *
+ * @param tableName	The name of the table into which data will be added
+ * @param values	The rows to insert into the table
+ * @return int		The number of rows inserted
+ */
+int StorageClient::insertTable(const string& tableName, const vector<InsertValues>& values)
+{
+	return insertTable(DEFAULT_SCHEMA, tableName, values);
+}
+
+/**
+ * Insert multiple rows into an arbitrary table with a single
+ * request to the storage service
+ *
+ * @param schema	The name of the schema to insert into
+ * @param tableName	The name of the table into which data will be added
+ * @param values	The rows to insert into the table
+ * @return int		The number of rows inserted
+ */
+int StorageClient::insertTable(const string& schema, const string& tableName, const vector<InsertValues>& values)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	try {
+		ostringstream convert;
+
+		convert << "{ \"inserts\" : [ ";
+		for (auto it = values.cbegin(); it != values.cend(); ++it)
+		{
+			if (it != values.cbegin())
+			{
+				convert << ", ";
+			}
+			convert << it->toJSON();
+		}
+		convert << " ] }";
+
+		char url[128];
+		snprintf(url, sizeof(url), "/storage/schema/%s/table/%s", schema.c_str(), tableName.c_str());
+		auto res = this->getHttpClient()->request("POST", url, convert.str());
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		if (res->status_code.compare("200 OK") == 0 || res->status_code.compare("201 Created") == 0)
+		{
+			Document doc;
+			doc.Parse(resultPayload.str().c_str());
+			if (doc.HasParseError())
+			{
+				m_logger->info("POST result %s.", res->status_code.c_str());
+				m_logger->error("Failed to parse result of insertTable. %s. Document is %s",
+						GetParseError_En(doc.GetParseError()),
+						resultPayload.str().c_str());
+				return -1;
+			}
+			else if (doc.HasMember("message"))
+			{
+				m_logger->error("Failed to append table data: %s",
+					doc["message"].GetString());
+				return -1;
+			}
+			return doc["rows_affected"].GetInt();
+		}
+		handleUnexpectedResponse("Insert table", res->status_code, resultPayload.str());
+	} catch (exception& ex) {
+		handleException(ex, "insert into table %s", tableName.c_str());
+		throw;
+	}
+	return 0;
+}
+
 /**
  * Update data into an arbitrary table
  *
@@ -843,6 +993,102 @@ int StorageClient::updateTable(const string& schema, const string& tableName, ve
 }
 
 
+/**
+ * Update multiple sets of rows of an arbitrary table
+ *
+ * @param tableName	The name of the table to update
+ * @param updates	The values and condition pairs to update in the table
+ * @param modifier	Optional update modifier
+ * @return int		The number of rows updated
+ */
+int StorageClient::updateTable(const string& tableName, vector<pair<InsertValues *, Where *>>& updates, const UpdateModifier *modifier)
+{
+	return updateTable(DEFAULT_SCHEMA, tableName, updates, modifier);
+}
+
+/**
+ * Update multiple sets of rows of an arbitrary table with a single
+ * request to the storage service
+ *
+ * @param schema	The name of the schema of the table
+ * @param tableName	The name of the table to update
+ * @param updates	The values and condition pairs to update in the table
+ * @param modifier	Optional update modifier
+ * @return int		The number of rows updated
+ */
+int StorageClient::updateTable(const string& schema, const string& tableName, vector<pair<InsertValues *, Where *>>& updates, const UpdateModifier *modifier)
+{
+	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
+	if (updates.empty())
+	{
+		return 0;
+	}
+	try {
+		std::thread::id thread_id = std::this_thread::get_id();
+		ostringstream ss;
+		sto_mtx_client_map.lock();
+		m_seqnum_map[thread_id].fetch_add(1);
+		ss << m_pid << "#" << thread_id << "_" << m_seqnum_map[thread_id].load();
+		sto_mtx_client_map.unlock();
+
+		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", ss.str()}};
+
+		ostringstream convert;
+		convert << "{ \"updates\" : [ ";
+		for (vector<pair<InsertValues *, Where *>>::const_iterator it = updates.cbegin();
+						 it != updates.cend(); ++it)
+		{
+			if (it != updates.cbegin())
+			{
+				convert << ", ";
+			}
+			convert << "{ ";
+			if (modifier)
+			{
+				convert << "\"modifiers\" : [ \"" << modifier->toJSON() << "\" ], ";
+			}
+			convert << "\"where\" : ";
+			convert << it->second->toJSON();
+			convert << ", \"values\" : ";
+			convert << it->first->toJSON();
+			convert << " }";
+		}
+		convert << " ] }";
+
+		char url[128];
+		snprintf(url, sizeof(url), "/storage/schema/%s/table/%s", schema.c_str(), tableName.c_str());
+		auto res = this->getHttpClient()->request("PUT", url, convert.str(), headers);
+		if (res->status_code.compare("200 OK") == 0)
+		{
+			ostringstream resultPayload;
+			resultPayload << res->content.rdbuf();
+			Document doc;
+			doc.Parse(resultPayload.str().c_str());
+			if (doc.HasParseError())
+			{
+				m_logger->info("PUT result %s.", res->status_code.c_str());
+				m_logger->error("Failed to parse result of updateTable. %s",
+						GetParseError_En(doc.GetParseError()));
+				return -1;
+			}
+			else if (doc.HasMember("message"))
+			{
+				m_logger->error("Failed to update table data: %s",
+					doc["message"].GetString());
+				return -1;
+			}
+			return doc["rows_affected"].GetInt();
+		}
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		handleUnexpectedResponse("Update table", tableName, res->status_code, resultPayload.str());
+	} catch (exception& ex) {
+		handleException(ex, "update table %s", tableName.c_str());
+		throw;
+	}
+	return -1;
+}
+
 /**
  * Update data into an arbitrary table
  *
@@ -1415,6 +1661,14 @@ bool StorageClient::openStream()
 			}
 		       	port = doc["port"].GetInt();
 			token = doc["token"].GetInt();
+			// Storage services that pre-date the binary encoding do not
+			// report a protocol version and only accept JSON payloads
+			m_streamProtocol = RDS_PROTOCOL_JSON;
+			if (doc.HasMember("protocol") && doc["protocol"].IsInt()
+					&& doc["protocol"].GetInt() >= RDS_PROTOCOL_BINARY)
+			{
+				m_streamProtocol = RDS_PROTOCOL_BINARY;
+			}
 			if ((m_stream = socket(AF_INET, SOCK_STREAM, 0)) == -1)
         		{
 				m_logger->error("Unable to create socket");
@@ -1437,7 +1691,8 @@ bool StorageClient::openStream()
 				return false;
 			}
 			RDSConnectHeader conhdr;
-			conhdr.magic = RDS_CONNECTION_MAGIC;
+			conhdr.magic = m_streamProtocol == RDS_PROTOCOL_BINARY ?
+					RDS_CONNECTION_MAGIC_V2 : RDS_CONNECTION_MAGIC;
 			conhdr.token = token;
 			if (write(m_stream, &conhdr, sizeof(conhdr)) != sizeof(conhdr))
 			{
@@ -1445,7 +1700,8 @@ bool StorageClient::openStream()
 				return false;
 			}
 			m_streaming = true;
-			m_logger->info("Storage stream succesfully created");
+			m_logger->info("Storage stream succesfully created using %s payloads",
+					m_streamProtocol == RDS_PROTOCOL_BINARY ? "binary" : "JSON");
 			return true;
 		}
 		ostringstream resultPayload;
@@ -1480,6 +1736,11 @@ bool StorageClient::openStream()
  * is 0 then no asset name is sent and the name of the asset is the same
  * as the previous asset in the block. Following this the paylod is included.
  *
+ * If the storage service supports version 2 of the protocol the payload
+ * is the binary encoding of the datapoints created by ReadingStreamCodec
+ * and the reading header carries the RDS_BINARY_READING_MAGIC, otherwise
+ * the payload is the JSON representation of the datapoints.
+ *
  * Each block is sent to the storage layer in a number of chunks rather
  * that a single write per block. The implementation make use of the
  * Linux scatter/gather IO calls to reduce the number of copies of data
@@ -1542,9 +1803,10 @@ string				lastAsset;
 	iovp = iovs;
 	phdr = rdhdrs;
 	int offset = 0;
+	bool binary = m_streamProtocol == RDS_PROTOCOL_BINARY;
 	for (int i = 0; i < readings.size(); i++)
 	{
-		phdr->magic = RDS_READING_MAGIC;
+		phdr->magic = binary ? RDS_BINARY_READING_MAGIC : RDS_READING_MAGIC;
 		phdr->readingNo = i;
 		string assetCode = readings[i]->getAssetName();
 		if (i > 0 && assetCode.compare(lastAsset) == 0)
@@ -1559,9 +1821,17 @@ string				lastAsset;
 			phdr->assetLength = assetCode.length() + 1;
 		}
 
-		// Always generate the JSON variant of the data points and send
-		payloads[offset] = readings[i]->getDatapointsJSON();
-		phdr->payloadLength = payloads[offset].length() + 1;
+		if (binary)
+		{
+			payloads[offset].clear();
+			ReadingStreamCodec::encode(*readings[i], payloads[offset]);
+			phdr->payloadLength = payloads[offset].length();
+		}
+		else
+		{
+			payloads[offset] = readings[i]->getDatapointsJSON();
+			phdr->payloadLength = payloads[offset].length() + 1;
+		}
 
 		// Add the reading header
 		iovp->iov_base = phdr;
@@ -1586,7 +1856,7 @@ string				lastAsset;
 		}
 
 		// Add the data points themselves
-		iovp->iov_base = (void *)(payloads[offset].c_str()); // Cast away const due to iovec definition
+		iovp->iov_base = (void *)(payloads[offset].data()); // Cast away const due to iovec definition
 		iovp->iov_len = phdr->payloadLength;
 		length += iovp->iov_len;
 		iovp++;
@@ -1655,7 +1925,8 @@ string				lastAsset;
 			Logger::getLogger()->fatal("Long write %d < %d", length, n);
 		}
 	}
-	Logger::getLogger()->info("Written block of %d readings via streaming connection", readings.size());
+	static LogThrottle throttle(60);
+	Logger::getLogger()->info(throttle, "Written block of %d readings via streaming connection", readings.size());
 	return true;
 }
 
@@ -9,6 +9,7 @@
  */
 
 #include <http_sender.h>
+#include <stdexcept>
 
 using namespace std;
 
@@ -25,3 +26,62 @@ HttpSender::HttpSender()
 HttpSender::~HttpSender()
 {
 }
+
+/**
+ * Send a set of requests, one per payload.
+ *
+ * This default implementation has no support for concurrent requests
+ * and sends the payloads in order, one at a time. Once a request fails
+ * the remaining payloads are not sent as the caller can only
+ * acknowledge the data sent before the failure.
+ *
+ * @param method	The HTTP method (GET, POST, ...)
+ * @param path		The URL path
+ * @param headers	The headers to send with every request
+ * @param payloads	The payloads, one per request
+ * @param maxInFlight	Ignored, requests are sent one at a time
+ * @return		The outcome of each request, in payload order
+ */
+vector<HttpResult> HttpSender::sendRequests(const string& method,
+					    const string& path,
+					    const vector<pair<string, string>>& headers,
+					    const vector<string>& payloads,
+					    unsigned int maxInFlight)
+{
+	vector<HttpResult> results(payloads.size());
+
+	for (size_t i = 0; i < payloads.size(); i++)
+	{
+		HttpResult& result = results[i];
+		result.sent = true;
+		try
+		{
+			result.httpCode = sendRequest(method, path, headers, payloads[i]);
+			result.response = getHTTPResponse();
+			continue;
+		}
+		catch (const BadRequest& e)
+		{
+			result.httpCode = 400;
+			result.error = e.what();
+		}
+		catch (const Unauthorized& e)
+		{
+			result.httpCode = 401;
+			result.error = e.what();
+		}
+		catch (const Conflict& e)
+		{
+			result.httpCode = 409;
+			result.error = e.what();
+		}
+		catch (const exception& e)
+		{
+			result.httpCode = 0;
+			result.error = e.what();
+		}
+		result.response = getHTTPResponse();
+		break;
+	}
+	return results;
+}
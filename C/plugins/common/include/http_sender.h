@@ -17,6 +17,20 @@
 #define HTTP_SENDER_DEFAULT_METHOD "GET"
 #define HTTP_SENDER_DEFAULT_PATH   "/"
 
+/**
+ * The outcome of one of the requests sent by HttpSender::sendRequests
+ */
+class HttpResult
+{
+	public:
+		HttpResult() : httpCode(0), sent(false) {};
+
+		int		httpCode;	// HTTP code, 0 if no HTTP response was received
+		bool		sent;		// false if the request was never attempted
+		std::string	response;	// The HTTP response text
+		std::string	error;		// The error message for failed requests
+};
+
 class HttpSender
 {
 	public:
@@ -43,6 +57,18 @@ class HttpSender
 				const std::string& payload = std::string()
 		) = 0;
 
+		/**
+		 * Send a set of requests that share method, path and headers,
+		 * one per payload, keeping up to maxInFlight of them active at once.
+		 * Returns one result per payload, in payload order.
+		 */
+		virtual std::vector<HttpResult> sendRequests(
+				const std::string& method,
+				const std::string& path,
+				const std::vector<std::pair<std::string, std::string>>& headers,
+				const std::vector<std::string>& payloads,
+				unsigned int maxInFlight);
+
 		virtual std::string getHostPort() = 0;
 		virtual std::string getHTTPResponse() = 0;
 
@@ -49,6 +49,17 @@ public:
 		    const std::string& payload = std::string()
 	);
 
+    /**
+     * Send one POST per payload using a libcurl multi handle,
+     * keeping up to maxInFlight requests active at once.
+     */
+    std::vector<HttpResult> sendRequests(
+		    const std::string& method,
+		    const std::string& path,
+		    const std::vector<std::pair<std::string, std::string>>& headers,
+		    const std::vector<std::string>& payloads,
+		    unsigned int maxInFlight);
+
     void setAuthMethod          (std::string& authMethod)           {m_authMethod = authMethod; }
     void setAuthBasicCredentials(std::string& authBasicCredentials) {m_authBasicCredentials = authBasicCredentials; }
 
@@ -67,7 +78,8 @@ private:
 	LibcurlHttps(const LibcurlHttps&);
 	LibcurlHttps&     operator=(LibcurlHttps const &);
 
-    	void setLibCurlOptions(CURL *sender, const std::string& path, const vector<pair<std::string, std::string>>& headers);
+	struct curl_slist *createHeaders(const vector<pair<std::string, std::string>>& headers);
+    	void setLibCurlOptions(CURL *sender, const std::string& path, struct curl_slist *chunk);
 
 private:
 	CURL               *m_sender;
@@ -20,6 +20,9 @@
 #include <stdlib.h>
 #include <curl/curl.h>
 #include <unistd.h>
+#include <chrono>
+#include <deque>
+#include <algorithm>
 
 #include "libcurl_https.h"
 #include "string_utils.h"
@@ -28,6 +31,19 @@
 
 #define HTTP_HEADER_LINE 255
 
+#define MULTI_WAIT_MS    1000	// Longest wait for activity on the multi handle
+
+/**
+ * The state of one of the requests sent by LibcurlHttps::sendRequests
+ */
+typedef struct {
+	CURL				*handle;
+	size_t				index;		// Index of the payload
+	unsigned int			attempt;	// Number of the current attempt, starting at 1
+	chrono::steady_clock::time_point retryAt;	// When a failed request may be retried
+	char				header[HTTP_HEADER_LINE];
+} CurlTransfer;
+
 using namespace std;
 
 /**
@@ -154,73 +170,90 @@ static size_t cb_header(char *buffer, size_t size, size_t nitems, void *userdata
 }
 
 /**
- * Setups the libcurl general options used in all the HTTP methods
+ * Create the list of HTTP headers sent with a request
  *
- * @param sender    libcurl handle on which the options should be configured
- * @param path      The URL path
  * @param headers   The optional headers to send
- *
+ * @return          The libcurl header list, freed by the caller
  */
-void LibcurlHttps::setLibCurlOptions(CURL *sender, const string& path, const vector<pair<string, string>>& headers)
+struct curl_slist *LibcurlHttps::createHeaders(const vector<pair<string, string>>& headers)
 {
+	struct curl_slist *chunk = NULL;
 	string httpHeader;
 
-#if VERBOSE_LOG
-	curl_easy_setopt(m_sender, CURLOPT_VERBOSE, 1L);
-#else
-	curl_easy_setopt(m_sender, CURLOPT_VERBOSE, 0L);
-	// this workaround is needed to avoid all libcurl debug messages
-	curl_easy_setopt(m_sender, CURLOPT_WRITEFUNCTION, cb_write_data);
-#endif
-	curl_easy_setopt(m_sender, CURLOPT_NOPROGRESS, 1L);
-	curl_easy_setopt(m_sender, CURLOPT_TCP_KEEPALIVE, 1L);
-
-	curl_easy_setopt(m_sender, CURLOPT_TIMEOUT,        m_request_timeout);
-	curl_easy_setopt(m_sender, CURLOPT_CONNECTTIMEOUT, m_connect_timeout);
-
 	// HTTP headers handling
-	m_chunk = curl_slist_append(m_chunk, "User-Agent: " HTTP_SENDER_USER_AGENT);
+	chunk = curl_slist_append(chunk, "User-Agent: " HTTP_SENDER_USER_AGENT);
 
 	// To let PI Web API having Cross-Site Request Forgery (CSRF) enabled as by default configuration
-	m_chunk = curl_slist_append(m_chunk, "X-Requested-With: XMLHttpRequest");
+	chunk = curl_slist_append(chunk, "X-Requested-With: XMLHttpRequest");
 
 	for (auto it = headers.begin(); it != headers.end(); ++it)
 	{
 		httpHeader = (*it).first + ": " + (*it).second;
-		m_chunk = curl_slist_append(m_chunk, httpHeader.c_str());
+		chunk = curl_slist_append(chunk, httpHeader.c_str());
 	}
 
 	// Handle basic authentication
 	if (m_authMethod == "b")
 	{
 		httpHeader = "Authorization: Basic " + m_authBasicCredentials;
-		m_chunk = curl_slist_append(m_chunk, httpHeader.c_str());
+		chunk = curl_slist_append(chunk, httpHeader.c_str());
 
 		/* set user name and password for the authentication */
 		//curl_easy_setopt(m_sender, CURLOPT_USERPWD, "user:pwd");
 	}
-	curl_easy_setopt(m_sender, CURLOPT_HTTPHEADER, m_chunk);
+	else if (m_OCSToken.compare("") != 0)
+	{
+		httpHeader = "Authorization: Bearer " + m_OCSToken;
+		chunk = curl_slist_append(chunk, httpHeader.c_str());
+	}
+	return chunk;
+}
+
+/**
+ * Setups the libcurl general options used in all the HTTP methods
+ *
+ * @param sender    libcurl handle on which the options should be configured
+ * @param path      The URL path
+ * @param chunk     The HTTP headers, as returned by createHeaders
+ *
+ */
+void LibcurlHttps::setLibCurlOptions(CURL *sender, const string& path, struct curl_slist *chunk)
+{
+#if VERBOSE_LOG
+	curl_easy_setopt(sender, CURLOPT_VERBOSE, 1L);
+#else
+	curl_easy_setopt(sender, CURLOPT_VERBOSE, 0L);
+	// this workaround is needed to avoid all libcurl debug messages
+	curl_easy_setopt(sender, CURLOPT_WRITEFUNCTION, cb_write_data);
+#endif
+	curl_easy_setopt(sender, CURLOPT_NOPROGRESS, 1L);
+	curl_easy_setopt(sender, CURLOPT_TCP_KEEPALIVE, 1L);
+
+	curl_easy_setopt(sender, CURLOPT_TIMEOUT,        m_request_timeout);
+	curl_easy_setopt(sender, CURLOPT_CONNECTTIMEOUT, m_connect_timeout);
+
+	curl_easy_setopt(sender, CURLOPT_HTTPHEADER, chunk);
 
 	// Handle Kerberos authentication
 	if (m_authMethod == "k")
 	{
 		Logger::getLogger()->debug("Kerberos authentication - keytab file :%s: ", getenv("KRB5_CLIENT_KTNAME"));
 
-		curl_easy_setopt(m_sender, CURLOPT_HTTPAUTH, CURLAUTH_GSSNEGOTIATE);
+		curl_easy_setopt(sender, CURLOPT_HTTPAUTH, CURLAUTH_GSSNEGOTIATE);
 		// The empty user should be defined for Kerberos authentication
-		curl_easy_setopt(m_sender, CURLOPT_USERPWD, ":");
+		curl_easy_setopt(sender, CURLOPT_USERPWD, ":");
 	}
 
 	// Configure libcurl
 	string url = "https://" + m_host_port + path;
 
-	curl_easy_setopt(m_sender, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(sender, CURLOPT_URL, url.c_str());
 
 	// Setup SSL
-	curl_easy_setopt(m_sender, CURLOPT_USE_SSL, CURLUSESSL_ALL);
-	curl_easy_setopt(m_sender, CURLOPT_SSL_VERIFYPEER, 0L);
-	curl_easy_setopt(m_sender, CURLOPT_SSL_VERIFYHOST, 0L);
-	curl_easy_setopt(m_sender, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+	curl_easy_setopt(sender, CURLOPT_USE_SSL, CURLUSESSL_ALL);
+	curl_easy_setopt(sender, CURLOPT_SSL_VERIFYPEER, 0L);
+	curl_easy_setopt(sender, CURLOPT_SSL_VERIFYHOST, 0L);
+	curl_easy_setopt(sender, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
 }
 
 /**
@@ -269,7 +302,8 @@ int LibcurlHttps::sendRequest(
 	m_sender = curl_easy_init();
 	if(m_sender)
 	{
-		setLibCurlOptions(m_sender, path, headers);
+		m_chunk = createHeaders(headers);
+		setLibCurlOptions(m_sender, path, m_chunk);
 	}
 	else
 	{
@@ -466,3 +500,229 @@ int LibcurlHttps::sendRequest(
 
 	return httpCode;
 }
+
+/**
+ * Send one POST request per payload using a libcurl multi handle so that
+ * up to maxInFlight requests are outstanding at any time. This hides the
+ * round trip time to the server when it is large compared to the time
+ * needed to transfer the payloads.
+ *
+ * Requests are started in payload order and may complete in any order.
+ * A failed request is retried m_max_retry times, waiting m_retry_sleep_time*2
+ * at each attempt, without blocking the other requests. Once a request has
+ * failed definitively no further requests after it are started, as the
+ * caller can only acknowledge the payloads that precede the failure.
+ *
+ * Methods other than POST are sent one at a time by HttpSender::sendRequests.
+ *
+ * @param method	The HTTP method (GET, POST, ...)
+ * @param path		The URL path
+ * @param headers	The headers to send with every request
+ * @param payloads	The payloads, one per request
+ * @param maxInFlight	The maximum number of concurrent requests
+ * @return		The outcome of each request, in payload order
+ */
+vector<HttpResult> LibcurlHttps::sendRequests(const string& method,
+					      const string& path,
+					      const vector<pair<string, string>>& headers,
+					      const vector<string>& payloads,
+					      unsigned int maxInFlight)
+{
+	if (method.compare("POST") != 0 || maxInFlight < 2 || payloads.size() < 2)
+	{
+		return HttpSender::sendRequests(method, path, headers, payloads, maxInFlight);
+	}
+
+	CURLM *multi = curl_multi_init();
+	if (!multi)
+	{
+		Logger::getLogger()->error("libcurl_https - curl_multi_init failed, sending requests one at a time");
+		return HttpSender::sendRequests(method, path, headers, payloads, maxInFlight);
+	}
+	curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)maxInFlight);
+#ifdef CURLPIPE_MULTIPLEX
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+	vector<HttpResult> results(payloads.size());
+	vector<CurlTransfer> transfers(payloads.size());
+	deque<size_t> retries;
+	struct curl_slist *chunk = createHeaders(headers);
+	size_t next = 0;			// The next payload not yet started
+	size_t firstFailure = payloads.size();	// The first payload that failed definitively
+	unsigned int active = 0;
+
+	while (true)
+	{
+		auto now = chrono::steady_clock::now();
+
+		// Start new requests, retries first as they precede any unsent payload
+		while (active < maxInFlight)
+		{
+			size_t index;
+			auto ready = find_if(retries.begin(), retries.end(), [&](size_t i) {
+						return i < firstFailure && transfers[i].retryAt <= now;
+					});
+			if (ready != retries.end())
+			{
+				index = *ready;
+				retries.erase(ready);
+			}
+			else if (next < firstFailure && next < payloads.size())
+			{
+				index = next++;
+			}
+			else
+			{
+				break;
+			}
+
+			CurlTransfer& transfer = transfers[index];
+			if (transfer.attempt == 0)
+			{
+				transfer.handle = curl_easy_init();
+				if (!transfer.handle)
+				{
+					results[index].sent = true;
+					results[index].error = "libcurl_https - curl_easy_init failed";
+					firstFailure = min(firstFailure, index);
+					break;
+				}
+				transfer.index = index;
+				setLibCurlOptions(transfer.handle, path, chunk);
+				curl_easy_setopt(transfer.handle, CURLOPT_POST, 1L);
+				curl_easy_setopt(transfer.handle, CURLOPT_POSTFIELDS,           payloads[index].c_str());
+				curl_easy_setopt(transfer.handle, CURLOPT_POSTFIELDSIZE, (long) payloads[index].length());
+				curl_easy_setopt(transfer.handle, CURLOPT_HEADERDATA,     transfer.header);
+				curl_easy_setopt(transfer.handle, CURLOPT_HEADERFUNCTION, cb_header);
+				curl_easy_setopt(transfer.handle, CURLOPT_PRIVATE,        &transfer);
+			}
+			transfer.attempt++;
+			transfer.header[0] = '\0';
+			if (m_log)
+			{
+				m_ofs << endl << method << " " << path << " (request " << index << ")" << endl;
+				m_ofs << "Headers" << endl;
+				for (auto it = headers.begin(); it != headers.end(); it++)
+				{
+					m_ofs << "    " << it->first << ": " << it->second << endl;
+				}
+				m_ofs << "Payload:" << endl;
+				m_ofs << payloads[index] << endl;
+			}
+			curl_multi_add_handle(multi, transfer.handle);
+			active++;
+		}
+
+		// Abandon the retries that can no longer be acknowledged
+		while (!retries.empty() && retries.back() > firstFailure)
+		{
+			size_t index = retries.back();
+			retries.pop_back();
+			results[index].error = "Not retried following the failure of an earlier request";
+		}
+
+		if (active == 0 && retries.empty())
+		{
+			break;
+		}
+
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		CURLMsg *msg;
+		int queued;
+		while ((msg = curl_multi_info_read(multi, &queued)) != NULL)
+		{
+			if (msg->msg != CURLMSG_DONE)
+			{
+				continue;
+			}
+			CURL *handle = msg->easy_handle;
+			CURLcode res = msg->data.result;
+			char *priv = NULL;
+			long httpCode = 0;
+
+			curl_easy_getinfo(handle, CURLINFO_PRIVATE, &priv);
+			curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &httpCode);
+			curl_multi_remove_handle(multi, handle);
+			active--;
+
+			CurlTransfer *transfer = (CurlTransfer *)priv;
+			HttpResult& result = results[transfer->index];
+			string httpResponseText = transfer->header;
+			if (m_log)
+			{
+				m_ofs << "Response (request " << transfer->index << "):" << endl;
+				m_ofs << "   Code: " << httpCode << endl;
+				m_ofs << "   Content: " << httpResponseText << endl << endl;
+			}
+			StringStripCRLF(httpResponseText);
+
+			result.sent = true;
+			result.httpCode = httpCode;
+			result.response = httpResponseText;
+			if (res == CURLE_OK && httpCode >= 200 && httpCode <= 399)
+			{
+				result.error.clear();
+				continue;
+			}
+
+			if (res != CURLE_OK)
+			{
+				result.error = string(curl_easy_strerror(res));
+				if (httpResponseText.compare("") != 0)
+					result.error += " - " + httpResponseText;
+			}
+			else
+			{
+				result.error = httpResponseText;
+			}
+
+			if (transfer->attempt < m_max_retry && transfer->index < firstFailure)
+			{
+				unsigned int sleepTime = m_retry_sleep_time << (transfer->attempt - 1);
+				transfer->retryAt = chrono::steady_clock::now() + chrono::seconds(sleepTime);
+				retries.insert(upper_bound(retries.begin(), retries.end(), transfer->index),
+						transfer->index);
+			}
+			else
+			{
+				Logger::getLogger()->debug("HTTPS sendRequests : request %u failed after %u attempts, HTTP code |%ld| error |%s|",
+							   (unsigned int)transfer->index,
+							   transfer->attempt,
+							   httpCode,
+							   result.error.c_str());
+				firstFailure = min(firstFailure, transfer->index);
+			}
+		}
+
+		if (active > 0)
+		{
+			curl_multi_wait(multi, NULL, 0, MULTI_WAIT_MS, NULL);
+		}
+		else if (!retries.empty())
+		{
+			// Nothing in flight, wait for the earliest retry
+			auto retryAt = transfers[retries.front()].retryAt;
+			for (auto index : retries)
+			{
+				retryAt = min(retryAt, transfers[index].retryAt);
+			}
+			this_thread::sleep_until(retryAt);
+		}
+	}
+
+	// Cleanup
+	for (auto& transfer : transfers)
+	{
+		if (transfer.handle)
+		{
+			curl_easy_cleanup(transfer.handle);
+		}
+	}
+	curl_multi_cleanup(multi);
+	curl_slist_free_all(chunk);
+
+	return results;
+}
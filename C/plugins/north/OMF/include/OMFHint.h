@@ -2,6 +2,12 @@
 #define _OMF_HINT_H
 
 #include <rapidjson/document.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#define OMF_HINTS_CACHE_SIZE	64	// Number of distinct hint documents kept parsed
 
 /**
  * Virtual base class for an OMF Hint
@@ -157,12 +163,38 @@ class OMFHints
 					getHints() const { return m_hints; };
 		const std::vector<OMFHint *>&
 					getHints(const std::string&) const;
-		const unsigned short	getChecksum() { return m_chksum; };
+		const unsigned short	getChecksum() const { return m_chksum; };
 		static string          	getHintForChecksum(const string &hint);
 	private:
 		rapidjson::Document	m_doc;
 		unsigned short		m_chksum;
 		std::vector<OMFHint *>	m_hints;
-		std::map<std::string, std::vector<OMFHint *> > m_datapointHints;
+		std::unordered_map<std::string, std::vector<OMFHint *> > m_datapointHints;
+};
+
+/**
+ * A bounded cache of parsed hints, keyed by the text of the hint.
+ *
+ * The same few hint documents are typically attached to a large number
+ * of readings, the cache avoids parsing the JSON of each of them. The
+ * cached hints are never modified once parsed so may be shared between
+ * readings and threads, the least recently used entry is discarded
+ * when the cache is full.
+ */
+class OMFHintsCache
+{
+	public:
+		OMFHintsCache(size_t size = OMF_HINTS_CACHE_SIZE) : m_size(size) {};
+		std::shared_ptr<const OMFHints>
+					get(const std::string& hint);
+		size_t			size() const { return m_entries.size(); };
+	private:
+		typedef std::list<std::pair<std::string, std::shared_ptr<const OMFHints> > >
+					HintsList;
+		size_t			m_size;
+		HintsList		m_entries;	// Most recently used first
+		std::unordered_map<std::string, HintsList::iterator>
+					m_index;
+		std::mutex		m_mutex;
 };
 #endif
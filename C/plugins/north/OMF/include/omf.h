@@ -19,6 +19,8 @@
 
 #define	OMF_HINT	"OMFHint"
 
+class OMFWorkers;
+
 // The following will force the OMF version for EDs endpoints
 // Remove or comment out the line below to prevent the forcing
 // of the version
@@ -83,6 +85,7 @@ class OMFDataTypes
 };
 
 class OMFHints;
+class OMFHintsCache;
 
 /**
  * The OMF class.
@@ -229,6 +232,18 @@ class OMF
 
 		void setLegacyMode(bool legacy) { m_legacy = legacy; };
 
+		// Set the number of data posts that may be in flight at once
+		void setMaxConcurrentPosts(unsigned int posts) { m_maxConcurrentPosts = posts; };
+
+		// Set the zlib level used to compress data messages
+		void setCompressionLevel(int level) { m_compressionLevel = level; };
+
+		// Send the linked values of a block with one data message per container
+		void setBatchValues(bool batchValues) { m_batchValues = batchValues; };
+
+		// Set the worker threads used to process a block in parallel
+		void setWorkers(OMFWorkers *workers) { m_workers = workers; };
+
 		static std::string ApplyPIServerNamingRulesObj(const std::string &objName, bool *changed);
 		static std::string ApplyPIServerNamingRulesPath(const std::string &objName, bool *changed);
 		static std::string ApplyPIServerNamingRulesInvalidChars(const std::string &objName, bool *changed);
@@ -247,16 +262,16 @@ private:
 			createMessageHeader(const std::string& type, const std::string& action="create") const;
 
 		// Create data for Type message for current row
-		const std::string createTypeData(const Reading& reading, OMFHints *hints);
+		const std::string createTypeData(const Reading& reading, const OMFHints *hints);
 
 		// Create data for Container message for current row
-		const std::string createContainerData(const Reading& reading, OMFHints *hints);
+		const std::string createContainerData(const Reading& reading, const OMFHints *hints);
 
 		// Create data for additional type message, with 'Data' for current row
 		const std::string createStaticData(const Reading& reading);
 
 		// Create data Link message, with 'Data', for current row
-		std::string createLinkData(const Reading& reading, std::string& AFHierarchyLevel, std::string&  prefix, std::string&  objectPrefix, OMFHints *hints, bool legacy);
+		std::string createLinkData(const Reading& reading, std::string& AFHierarchyLevel, std::string&  prefix, std::string&  objectPrefix, const OMFHints *hints, bool legacy);
 
 		/**
 		 * Creata data for readings data content, with 'Data', for one row
@@ -277,13 +292,13 @@ private:
 		// Create the OMF data types if needed
 		bool handleDataTypes(const string keyComplete,
 			                 const Reading& row,
-				             bool skipSendingTypes, OMFHints *hints);
+				             bool skipSendingTypes, const OMFHints *hints);
 
 		// Send OMF data types
-		bool sendDataTypes(const Reading& row, OMFHints *hints);
+		bool sendDataTypes(const Reading& row, const OMFHints *hints);
 
 		// Get saved dataType
-		bool getCreatedTypes(const std::string& keyComplete, const Reading& row, OMFHints *hints);
+		bool getCreatedTypes(const std::string& keyComplete, const Reading& row, const OMFHints *hints);
 
 		// Set saved dataType
 		unsigned long calcTypeShort(const Reading& row);
@@ -295,10 +310,16 @@ private:
 		void incrementTypeId();
 
 		// Handle data type errors
-		bool handleTypeErrors(const string& keyComplete, const Reading& reading, OMFHints*hints);
+		bool handleTypeErrors(const string& keyComplete, const Reading& reading, const OMFHints *hints);
 
 		string errorMessageHandler(const string &msg);
 
+		// Send data payloads concurrently and return the number of readings acknowledged
+		uint32_t sendConcurrentData(const std::vector<std::string>& payloads,
+					    const std::vector<size_t>& firstReadings,
+					    size_t readingCount,
+					    const std::vector<std::pair<std::string, std::string>>& header);
+
 		// Extract assetName from error message
 		std::string getAssetNameFromError(const char* message);
 
@@ -313,7 +334,7 @@ private:
 		void setTypeId();
 
 		// Set saved dataType
-		bool setCreatedTypes(const Reading& row, OMFHints *hints);
+		bool setCreatedTypes(const Reading& row, const OMFHints *hints);
 
 		// Remove cached data types enttry for given asset name
 		void clearCreatedTypes(const std::string& keyComplete);
@@ -351,7 +372,7 @@ private:
 		bool sendBaseTypes();
 		// End of support for using linked containers
 		//
-		string createAFLinks(Reading &reading, OMFHints *hints);
+		string createAFLinks(Reading &reading, const OMFHints *hints);
 
 
 	private:
@@ -504,12 +525,38 @@ private:
 		 */
 		bool			m_legacy;
 
+		/**
+		 * The maximum number of data posts in flight at once
+		 */
+		unsigned int		m_maxConcurrentPosts;
+
+		/**
+		 * The zlib level used to compress data messages
+		 */
+		int			m_compressionLevel;
+
+		/**
+		 * Batch the linked values of a block by container
+		 */
+		bool			m_batchValues;
+
+		/**
+		 * The worker threads used to process a block in parallel,
+		 * owned by the plugin. A block is processed serially if not set.
+		 */
+		OMFWorkers		*m_workers;
+
 		/**
 		 * Assets that have been logged as having errors. This prevents us
 		 * from flooding the logs with reports for the same asset.
 		 */
 		static std::vector<std::string>
 					m_reportedAssets;
+
+		/**
+		 * Parsed OMF hints, shared by all the blocks of data sent
+		 */
+		static OMFHintsCache	m_hintsCache;
 		/**
 		 * Service name
 		 */
@@ -528,7 +575,7 @@ class OMFData
 			string measurementId,
 			const OMF_ENDPOINT PIServerEndpoint = ENDPOINT_CR,
 			const std::string& DefaultAFLocation = std::string(),
-			OMFHints *hints = NULL);
+			const OMFHints *hints = NULL);
 
 		const std::string& OMFdataVal() const;
 	private:
@@ -14,6 +14,21 @@
 #include <reading.h>
 #include <OMFHint.h>
 
+/**
+ * A datapoint of a reading to send to the container linked to
+ * the asset, using the base type of that container.
+ */
+class OMFLinkedValue
+{
+	public:
+		OMFLinkedValue(const std::string& link, const std::string& baseType, Datapoint *datapoint) :
+			m_link(link), m_baseType(baseType), m_datapoint(datapoint) {};
+		std::string	m_link;
+		std::string	m_baseType;
+		Datapoint	*m_datapoint;
+		std::string	m_value;	// The serialised value when values are batched by container
+};
+
 /**
  * The OMFLinkedData class.
  * A reading is formatted with OMF specifications using the linked
@@ -47,7 +62,16 @@ class OMFLinkedData
 					{};
 		std::string 	processReading(const Reading& reading,
 				const std::string& DefaultAFLocation = std::string(),
-				OMFHints *hints = NULL);
+				const OMFHints *hints = NULL);
+		std::string	prepareReading(const Reading& reading,
+				const std::string& DefaultAFLocation,
+				const OMFHints *hints,
+				std::vector<OMFLinkedValue>& values);
+		static std::string
+				processValues(const Reading& reading,
+				const std::vector<OMFLinkedValue>& values);
+		static void	serialiseValues(const Reading& reading,
+				std::vector<OMFLinkedValue>& values);
 		bool		flushContainers(HttpSender& sender, const std::string& path, std::vector<std::pair<std::string, std::string> >& header);
 		void		setFormats(const std::string& doubleFormat, const std::string& integerFormat)
 				{
@@ -56,7 +80,7 @@ class OMFLinkedData
 				};
 	private:
 		std::string	getBaseType(Datapoint *dp, const std::string& format);
-		void		sendContainer(std::string& link, Datapoint *dp, OMFHints * hints, const std::string& baseType);
+		void		sendContainer(std::string& link, Datapoint *dp, const OMFHints *hints, const std::string& baseType);
 		bool		isTypeSupported(DatapointValue& dataPoint)
 				{
 					switch (dataPoint.getType())
@@ -0,0 +1,50 @@
+#ifndef _OMFPAYLOAD_H
+#define _OMFPAYLOAD_H
+/*
+ * Fledge OSIsoft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+#include <string>
+#include <zlib.h>
+
+#define OMF_NO_COMPRESSION	-2	// Level passed to OMFPayload for an uncompressed payload
+#define OMF_PAYLOAD_CHUNK	65536	// Amount of JSON buffered before it is compressed
+
+/**
+ * A payload that is built a part at a time, the parts are either appended
+ * as they are or gzip compressed as they are appended. Compressing while
+ * the JSON is generated means the complete uncompressed JSON is never held
+ * in memory alongside the compressed payload.
+ *
+ * The zlib stream is kept per thread and reset, rather than created,
+ * for each payload. Payloads are created by the calling thread and the
+ * long lived OMFWorkers threads, so the streams persist between blocks.
+ */
+class OMFPayload {
+	public:
+		OMFPayload(std::string& payload, int level, size_t sizeHint = 0);
+		void		append(const std::string& part)
+				{
+					append(part.data(), part.length());
+				};
+		void		append(const char *part, size_t length);
+		void		finish();
+		size_t		length() const { return m_length; };
+	private:
+		void		deflateChunk(int flush);
+	private:
+		std::string&	m_payload;
+		bool		m_compress;
+		bool		m_finished;
+		z_stream	*m_stream;
+		size_t		m_length;	// Length of the uncompressed JSON
+		std::string	m_pending;	// JSON waiting to be compressed
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _OMFWORKERS_H
+#define _OMFWORKERS_H
+/*
+ * Fledge OSIsoft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/**
+ * A set of long lived worker threads used to process the parts of a
+ * block of readings in parallel.
+ *
+ * The workers are owned by the plugin instance, they are created as
+ * they are first needed and persist from one block to the next. This
+ * avoids the cost of creating a thread for each part of every block
+ * and allows per thread state, such as the zlib streams used to
+ * compress payloads, to be reused.
+ */
+class OMFWorkers {
+	public:
+		OMFWorkers();
+		~OMFWorkers();
+		void		run(std::vector<std::function<void()>>& tasks);
+	private:
+		/**
+		 * A task queued for the workers by a call to run
+		 */
+		class Job {
+			public:
+				Job(std::function<void()> *task, std::exception_ptr *error,
+						size_t *pending) :
+					m_task(task), m_error(error), m_pending(pending) {};
+				std::function<void()>	*m_task;
+				std::exception_ptr	*m_error;
+				size_t			*m_pending;	// Jobs outstanding for the call
+		};
+		void		worker();
+	private:
+		std::mutex		m_mutex;
+		std::condition_variable	m_workCv;
+		std::condition_variable	m_doneCv;
+		std::deque<Job>		m_jobs;
+		std::vector<std::thread>
+					m_threads;
+		bool			m_shutdown;
+};
+
+#endif
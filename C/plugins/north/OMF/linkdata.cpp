@@ -52,24 +52,52 @@ static std::string DataPointNamesAsString(const Reading& reading)
 }
 
 /**
- * OMFLinkedData constructor, generates the OMF message containing the data
+ * Generate the OMF message containing the data for a reading
  *
  * @param reading           Reading for which the OMF message must be generated
  * @param AFHierarchyPrefix Unused at the current stage
  * @param hints             OMF hints for the specific reading for changing the behaviour of the operation
  *
  */
-string OMFLinkedData::processReading(const Reading& reading, const string&  AFHierarchyPrefix, OMFHints *hints)
+string OMFLinkedData::processReading(const Reading& reading, const string&  AFHierarchyPrefix, const OMFHints *hints)
 {
-	string outData;
-	bool changed;
+	vector<OMFLinkedValue> values;
+	string outData = prepareReading(reading, AFHierarchyPrefix, hints, values);
+	string valueData = processValues(reading, values);
+	if (!outData.empty() && !valueData.empty())
+	{
+		outData.append(",");
+	}
+	outData.append(valueData);
+	Logger::getLogger()->debug("Created data messages %s", outData.c_str());
+	return outData;
+}
 
+/**
+ * Prepare a reading for sending using linked types. The asset, the
+ * containers and the links for the datapoints of the reading are created
+ * if they have not already been sent. The datapoints whose values must be
+ * sent are added to the values vector to be passed to processValues.
+ *
+ * This uses the state of what has already been sent so must be called
+ * for each reading in turn.
+ *
+ * @param reading           Reading for which the OMF message must be generated
+ * @param AFHierarchyPrefix Unused at the current stage
+ * @param hints             OMF hints for the specific reading for changing the behaviour of the operation
+ * @param values            The datapoints values to send
+ * @return                  The OMF messages to create the asset and links
+ */
+string OMFLinkedData::prepareReading(const Reading& reading, const string&  AFHierarchyPrefix,
+		const OMFHints *hints, vector<OMFLinkedValue>& values)
+{
+	string outData;
 
 	string assetName = reading.getAssetName();
 	// Apply any TagName hints to modify the containerid
 	if (hints)
 	{
-		const std::vector<OMFHint *> omfHints = hints->getHints();
+		const std::vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 		{
 			if (typeid(**it) == typeid(OMFTagNameHint))
@@ -91,7 +119,7 @@ string OMFLinkedData::processReading(const Reading& reading, const string&  AFHi
 
 
 	// Get reading data
-	const vector<Datapoint*> data = reading.getReadingData();
+	const vector<Datapoint*>& data = reading.getReadingData();
 	vector<string> skippedDatapoints;
 
 	Logger::getLogger()->debug("Processing %s (%s) using Linked Types", assetName.c_str(), DataPointNamesAsString(reading).c_str());
@@ -109,8 +137,8 @@ string OMFLinkedData::processReading(const Reading& reading, const string&  AFHi
 	}
 
 	/**
-	 * This loop creates the data values for each of the datapoints in the
-	 * reading.
+	 * This loop creates the containers and links for each of the
+	 * datapoints in the reading.
 	 */
 	for (vector<Datapoint*>::const_iterator it = data.begin(); it != data.end(); ++it)
 	{
@@ -127,18 +155,10 @@ string OMFLinkedData::processReading(const Reading& reading, const string&  AFHi
 		}
 		else
 		{
-			if (needDelim)
-			{
-				outData.append(",");
-			}
-			else
-			{
-				needDelim = true;
-			}
 			string format;
 			if (hints)
 			{
-				const vector<OMFHint *> omfHints = hints->getHints(dpName);
+				const vector<OMFHint *>& omfHints = hints->getHints(dpName);
 				for (auto hit = omfHints.cbegin(); hit != omfHints.cend(); hit++)
 				{
 					if (typeid(**hit) == typeid(OMFNumberHint))
@@ -189,6 +209,11 @@ string OMFLinkedData::processReading(const Reading& reading, const string&  AFHi
 			}
 			if (m_linkSent->find(link) == m_linkSent->end())
 			{
+				if (needDelim)
+				{
+					outData.append(",");
+				}
+				needDelim = true;
 				outData.append("{ \"typeid\":\"__Link\",");
 				outData.append("\"values\":[ { \"source\" : {");
 				outData.append("\"typeid\": \"FledgeAsset\",");
@@ -196,23 +221,11 @@ string OMFLinkedData::processReading(const Reading& reading, const string&  AFHi
 				outData.append("\" }, \"target\" : {");
 				outData.append("\"containerid\" : \"");
 				outData.append(link);
-				outData.append("\" } } ] },");
+				outData.append("\" } } ] }");
 
 				m_linkSent->insert(pair<string, bool>(link, true));
 			}
-
-			// Convert reading data into the OMF JSON string
-			outData.append("{\"containerid\": \"" + link);
-			outData.append("\", \"values\": [{");
-
-			// Base type we are using for this data point
-			outData.append("\"" + baseType + "\": ");
-			// Add datapoint Value
-		       	outData.append((*it)->getData().toString());
-			outData.append(", ");
-			// Append Z to getAssetDateTime(FMT_STANDARD)
-			outData.append("\"Time\": \"" + reading.getAssetDateUserTime(Reading::FMT_STANDARD) + "Z" + "\"");
-			outData.append("} ] }");
+			values.push_back(OMFLinkedValue(link, baseType, *it));
 		}
 	}
 	if (skippedDatapoints.size() > 0)
@@ -233,10 +246,97 @@ string OMFLinkedData::processReading(const Reading& reading, const string&  AFHi
 		string msg = "The asset " + assetName + " had a number of datapoints, " + points + " that are not supported by OMF and have been omitted";
 		OMF::reportAsset(assetName, "warn", msg);
 	}
-	Logger::getLogger()->debug("Created data messages %s", outData.c_str());
 	return outData;
 }
 
+/**
+ * Return the Time property of the values of a reading
+ *
+ * @param reading	The reading
+ * @return		The Time property
+ */
+static string timeProperty(const Reading& reading)
+{
+	// Append Z to getAssetDateTime(FMT_STANDARD)
+	return "\"Time\": \"" + reading.getAssetDateUserTime(Reading::FMT_STANDARD) + "Z" + "\"";
+}
+
+/**
+ * Append the OMF value object for a linked value. The same value object
+ * is used whether or not the values are batched by container.
+ *
+ * @param value		The value to append
+ * @param time		The Time property of the reading the value belongs to
+ * @param outData	The string to append the value object to
+ */
+static void appendValue(const OMFLinkedValue& value, const string& time, string& outData)
+{
+	// Base type we are using for this data point
+	outData.append("{\"" + value.m_baseType + "\": ");
+	// Add datapoint Value
+	outData.append(value.m_datapoint->getData().toString());
+	outData.append(", ");
+	outData.append(time);
+	outData.append("}");
+}
+
+/**
+ * Create the OMF data messages for the values of a reading that has
+ * been prepared by prepareReading. No state is used, so this may be
+ * called for many readings in parallel.
+ *
+ * @param reading	The reading the values belong to
+ * @param values	The values to send
+ * @return		The OMF data messages
+ */
+string OMFLinkedData::processValues(const Reading& reading, const vector<OMFLinkedValue>& values)
+{
+	string outData;
+	if (values.empty())
+	{
+		return outData;
+	}
+
+	string time = timeProperty(reading);
+	for (auto& value : values)
+	{
+		if (!outData.empty())
+		{
+			outData.append(",");
+		}
+		// Convert reading data into the OMF JSON string
+		outData.append("{\"containerid\": \"" + value.m_link);
+		outData.append("\", \"values\": [");
+		appendValue(value, time, outData);
+		outData.append(" ] }");
+	}
+	return outData;
+}
+
+/**
+ * Serialise each of the values of a reading that has been prepared by
+ * prepareReading, without the enclosing container message. This is used
+ * when the values for a container are batched across a block of readings
+ * into a single message. No state is used, so this may be called for many
+ * readings in parallel.
+ *
+ * @param reading	The reading the values belong to
+ * @param values	The values to serialise
+ */
+void OMFLinkedData::serialiseValues(const Reading& reading, vector<OMFLinkedValue>& values)
+{
+	if (values.empty())
+	{
+		return;
+	}
+
+	string time = timeProperty(reading);
+	for (auto& value : values)
+	{
+		appendValue(value, time, value.m_value);
+	}
+}
+
 /**
  * Calculate the base type we need to link the container
  *
@@ -303,7 +403,7 @@ string OMFLinkedData::getBaseType(Datapoint *dp, const string& format)
  * @param hints		Hints related to this asset
  * @param baseType	The baseType we will use
  */
-void OMFLinkedData::sendContainer(string& linkName, Datapoint *dp, OMFHints * hints, const string& baseType)
+void OMFLinkedData::sendContainer(string& linkName, Datapoint *dp, const OMFHints *hints, const string& baseType)
 {
 	string dataSource = "Fledge";
 	string uom, minimum, maximum, interpolation;
@@ -312,7 +412,7 @@ void OMFLinkedData::sendContainer(string& linkName, Datapoint *dp, OMFHints * hi
 
 	if (hints)
 	{
-		const vector<OMFHint *> omfHints = hints->getHints();
+		const vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.end(); it++)
 		{
 			if (typeid(**it) == typeid(OMFSourceHint))
@@ -321,7 +421,7 @@ void OMFLinkedData::sendContainer(string& linkName, Datapoint *dp, OMFHints * hi
 			}
 		}
 
-		const vector<OMFHint *> dpHints = hints->getHints(dp->getName());
+		const vector<OMFHint *>& dpHints = hints->getHints(dp->getName());
 		for (auto it = dpHints.cbegin(); it != dpHints.end(); it++)
 		{
 			if (typeid(**it) == typeid(OMFSourceHint))
@@ -23,6 +23,7 @@
 #include <string_utils.h>
 #include <datapoint.h>
 #include <thread>
+#include <exception>
 
 #include <piwebapi.h>
 
@@ -34,16 +35,23 @@
 #include <omflinkeddata.h>
 #include <audit_logger.h>
 #include <omferror.h>
+#include <omfpayload.h>
+#include <omfworkers.h>
+#include <functional>
 
 using namespace std;
 using namespace rapidjson;
 
 static bool isTypeSupported(DatapointValue& dataPoint);
 vector<string> OMF::m_reportedAssets;
+OMFHintsCache OMF::m_hintsCache;
 
 // 1 enable performance tracking
 #define INSTRUMENT	0
 
+#define OMF_MIN_SHARD_SIZE		500	// Minimum number of readings serialised by each thread
+#define OMF_MAX_SERIALISE_THREADS	8	// Maximum number of threads used to serialise a block
+
 #define  AFHierarchySeparator '/'
 #define  AF_TYPES_SUFFIX       "-type"      // The asset name is composed by: asset name + AF_TYPES_SUFFIX + incremental id of the type
 
@@ -142,7 +150,7 @@ const char *AF_HIERARCHY_1LEVEL_LINK = QUOTE(
  * @param hints             OMF hints for the specific reading for changing the behaviour of the operation
  *
  */
-OMFData::OMFData(const Reading& reading, string measurementId, const OMF_ENDPOINT PIServerEndpoint,const string&  AFHierarchyPrefix, OMFHints *hints)
+OMFData::OMFData(const Reading& reading, string measurementId, const OMF_ENDPOINT PIServerEndpoint,const string&  AFHierarchyPrefix, const OMFHints *hints)
 {
 	string outData;
 	bool changed;
@@ -152,7 +160,7 @@ OMFData::OMFData(const Reading& reading, string measurementId, const OMF_ENDPOIN
 	// Apply any TagName hints to modify the containerid
 	if (hints)
 	{
-		const std::vector<OMFHint *> omfHints = hints->getHints();
+		const std::vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 		{
 			if (typeid(**it) == typeid(OMFTagNameHint))
@@ -236,6 +244,10 @@ OMF::OMF(const string& name,
 	 m_producerToken(token),
 	 m_sender(sender),
 	 m_legacy(false),
+	 m_maxConcurrentPosts(1),
+	 m_compressionLevel(Z_DEFAULT_COMPRESSION),
+	 m_batchValues(false),
+	 m_workers(NULL),
 	 m_name(name)
 {
 	m_lastError = false;
@@ -257,6 +269,10 @@ OMF::OMF(const string& name,
 	 m_OMFDataTypes(&types),
 	 m_producerToken(token),
 	 m_sender(sender),
+	 m_maxConcurrentPosts(1),
+	 m_compressionLevel(Z_DEFAULT_COMPRESSION),
+	 m_batchValues(false),
+	 m_workers(NULL),
 	 m_name(name)
 {
 	// Get starting type-id sequence or set the default value
@@ -284,47 +300,11 @@ OMF::~OMF()
 std::string OMF::compress_string(const std::string& str,
                             int compressionlevel)
 {
-    const int windowBits = 15;
-    const int GZIP_ENCODING = 16;
-
-    z_stream zs;                        // z_stream is zlib's control structure
-    memset(&zs, 0, sizeof(zs));
-
-    if (deflateInit2(&zs, compressionlevel, Z_DEFLATED,
-		 windowBits | GZIP_ENCODING, 8,
-		 Z_DEFAULT_STRATEGY) != Z_OK)
-        throw(std::runtime_error("deflateInit failed while compressing."));
-
-    zs.next_in = (Bytef*)str.data();
-    zs.avail_in = str.size();           // set the z_stream's input
-
-    int ret;
-    char outbuffer[32768];
-    std::string outstring;
-
-    // retrieve the compressed bytes blockwise
-    do {
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
-
-        ret = deflate(&zs, Z_FINISH);
-
-        if (outstring.size() < zs.total_out) {
-            // append the block to the output string
-            outstring.append(outbuffer,
-                             zs.total_out - outstring.size());
-        }
-    } while (ret == Z_OK);
-
-    deflateEnd(&zs);
-
-    if (ret != Z_STREAM_END) {          // an error occurred that was not EOF
-        std::ostringstream oss;
-        oss << "Exception during zlib compression: (" << ret << ") " << zs.msg;
-        throw(std::runtime_error(oss.str()));
-    }
-
-    return outstring;
+	std::string outstring;
+	OMFPayload payload(outstring, compressionlevel, str.size());
+	payload.append(str);
+	payload.finish();
+	return outstring;
 }
 
 /**
@@ -334,7 +314,7 @@ std::string OMF::compress_string(const std::string& str,
  * @return       True if all data types have been sent (HTTP 2xx OK)
  *               False when first error occurs.
  */
-bool OMF::sendDataTypes(const Reading& row, OMFHints *hints)
+bool OMF::sendDataTypes(const Reading& row, const OMFHints *hints)
 {
 	int res;
 	m_changeTypeId = false;
@@ -1074,6 +1054,230 @@ void OMF::setAFHierarchy()
 	}
 }
 
+/**
+ * The OMF data for a single reading in a block of readings.
+ *
+ * The parts of the data that depend upon the types, containers and links
+ * that have already been sent are created for each reading in turn. The
+ * data values themselves depend only on the reading, these are created
+ * afterwards for all the readings in the block in parallel.
+ */
+class OMFReadingData
+{
+	public:
+		OMFReadingData(Reading *reading, shared_ptr<const OMFHints> hints, size_t index) :
+				m_reading(reading), m_hints(hints), m_index(index), m_legacy(false) {};
+		OMFReadingData(OMFReadingData&& rhs) noexcept :
+				m_reading(rhs.m_reading), m_hints(std::move(rhs.m_hints)), m_index(rhs.m_index),
+				m_legacy(rhs.m_legacy),
+				m_measurementId(std::move(rhs.m_measurementId)),
+				m_AFHierarchyPrefix(std::move(rhs.m_AFHierarchyPrefix)),
+				m_values(std::move(rhs.m_values)),
+				m_prefix(std::move(rhs.m_prefix)),
+				m_body(std::move(rhs.m_body)),
+				m_suffix(std::move(rhs.m_suffix))
+				{
+				};
+		OMFReadingData(const OMFReadingData&) = delete;
+		/**
+		 * Create the data values for the reading. If the linked values
+		 * are batched by container each value is serialised on its own
+		 * and the container messages are created with the payload.
+		 */
+		void	serialise(OMF_ENDPOINT endpoint, bool batchValues)
+		{
+			if (m_legacy)
+			{
+				m_body = OMFData(*m_reading, m_measurementId, endpoint,
+						m_AFHierarchyPrefix, m_hints.get()).OMFdataVal();
+			}
+			else if (batchValues)
+			{
+				OMFLinkedData::serialiseValues(*m_reading, m_values);
+			}
+			else
+			{
+				m_body = OMFLinkedData::processValues(*m_reading, m_values);
+			}
+		};
+		Reading			*m_reading;
+		shared_ptr<const OMFHints>
+					m_hints;
+		size_t			m_index;	// Position of the reading in the block
+		bool			m_legacy;
+		string			m_measurementId;
+		string			m_AFHierarchyPrefix;
+		vector<OMFLinkedValue>	m_values;
+		string			m_prefix;	// Asset and link creation
+		string			m_body;		// The data values
+		string			m_suffix;	// AF hierarchy links
+};
+
+/**
+ * Create the data values for a block of readings. The block is split
+ * into shards of consecutive readings that are processed by the worker
+ * threads, the results are kept with each reading so the original order
+ * is retained.
+ *
+ * @param readingData	The prepared readings
+ * @param endpoint	The endpoint type the data is being sent to
+ * @param batchValues	Linked values are batched by container
+ * @param workers	The worker threads, or NULL to serialise in the calling thread
+ */
+static void serialiseReadings(vector<OMFReadingData>& readingData, OMF_ENDPOINT endpoint,
+		bool batchValues, OMFWorkers *workers)
+{
+	size_t count = readingData.size();
+	size_t shards = count / OMF_MIN_SHARD_SIZE;
+	size_t cores = thread::hardware_concurrency();
+	if (shards > cores)
+		shards = cores;
+	if (shards > OMF_MAX_SERIALISE_THREADS)
+		shards = OMF_MAX_SERIALISE_THREADS;
+	if (shards <= 1 || !workers)
+	{
+		for (auto& data : readingData)
+		{
+			data.serialise(endpoint, batchValues);
+		}
+		return;
+	}
+
+	vector<function<void()>> tasks;
+	size_t shardSize = (count + shards - 1) / shards;
+	for (size_t from = 0; from < count; from += shardSize)
+	{
+		size_t to = min(from + shardSize, count);
+		tasks.push_back([&readingData, endpoint, batchValues, from, to]() {
+				for (size_t i = from; i < to; i++)
+				{
+					readingData[i].serialise(endpoint, batchValues);
+				}
+			});
+	}
+	workers->run(tasks);
+}
+
+/**
+ * The values for a single container gathered from a range of readings
+ */
+class OMFContainerValues
+{
+	public:
+		OMFContainerValues(const OMFLinkedValue *first) : m_first(first), m_length(0) {};
+		const OMFLinkedValue		*m_first;	// Gives the container and base type
+		vector<string *>		m_values;
+		size_t				m_length;
+};
+
+/**
+ * Create the JSON array of OMF messages for a range of the prepared readings,
+ * compressing it as it is created if required.
+ *
+ * If the linked values are batched then a single data message is created
+ * for each container, holding the values from all the readings in the
+ * range in reading order, rather than a message per value.
+ *
+ * The serialised strings of each reading are released as they are added
+ * to the payload, so that the uncompressed JSON of the range is not held
+ * in memory alongside the compressed payload.
+ *
+ * @param readingData	The prepared and serialised readings
+ * @param from		The first reading to include
+ * @param to		One past the last reading to include
+ * @param batchValues	Linked values are batched by container
+ * @param level		The compression level or OMF_NO_COMPRESSION
+ * @param json		The string to write the payload to
+ * @return		The length of the uncompressed JSON
+ */
+static size_t createPayload(vector<OMFReadingData>& readingData, size_t from, size_t to,
+			bool batchValues, int level, string& json)
+{
+	// Group the linked values by container, keeping the order in which
+	// the containers are first seen. A container may have its base type
+	// changed within a block, the values for each base type are kept apart.
+	vector<OMFContainerValues> containers;
+	unordered_map<string, vector<size_t> > containerIndex;
+
+	size_t length = 2;
+	for (size_t i = from; i < to; i++)
+	{
+		OMFReadingData& data = readingData[i];
+		length += data.m_prefix.length() + data.m_body.length() + data.m_suffix.length() + 6;
+		if (!batchValues || data.m_legacy)
+		{
+			continue;
+		}
+		for (OMFLinkedValue& value : data.m_values)
+		{
+			vector<size_t>& indexes = containerIndex[value.m_link];
+			OMFContainerValues *container = NULL;
+			for (size_t index : indexes)
+			{
+				if (containers[index].m_first->m_baseType.compare(value.m_baseType) == 0)
+				{
+					container = &containers[index];
+					break;
+				}
+			}
+			if (!container)
+			{
+				indexes.push_back(containers.size());
+				containers.push_back(OMFContainerValues(&value));
+				container = &containers.back();
+				length += value.m_link.length() + 40;
+			}
+			container->m_values.push_back(&value.m_value);
+			length += value.m_value.length() + 2;
+		}
+	}
+
+	OMFPayload payload(json, level, length);
+	payload.append("[", 1);
+	bool pendingSeparator = false;
+	for (size_t i = from; i < to; i++)
+	{
+		OMFReadingData& data = readingData[i];
+		for (string *part : { &data.m_prefix, &data.m_body, &data.m_suffix })
+		{
+			if (!part->empty())
+			{
+				if (pendingSeparator)
+				{
+					payload.append(", ", 2);
+				}
+				payload.append(*part);
+				string().swap(*part);
+				pendingSeparator = true;
+			}
+		}
+	}
+	for (const OMFContainerValues& container : containers)
+	{
+		if (pendingSeparator)
+		{
+			payload.append(", ", 2);
+		}
+		payload.append("{\"containerid\": \"", 17);
+		payload.append(container.m_first->m_link);
+		payload.append("\", \"values\": [", 14);
+		for (size_t i = 0; i < container.m_values.size(); i++)
+		{
+			if (i)
+			{
+				payload.append(", ", 2);
+			}
+			payload.append(*container.m_values[i]);
+			string().swap(*container.m_values[i]);
+		}
+		payload.append("] }", 3);
+		pendingSeparator = true;
+	}
+	payload.append("]", 1);
+	payload.finish();
+	return payload.length();
+}
+
 /**
  * Send all the readings to the PI Server
  *
@@ -1145,7 +1349,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	 */
 
 	// Used for logging
-	string json_not_compressed;
+	size_t uncompressedLength = 0;
 
 	string OMFHintAFHierarchyTmp;
 	string OMFHintAFHierarchy;
@@ -1156,9 +1360,10 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	OMFLinkedData linkedData(&m_containerSent, &m_assetSent, &m_linkSent, m_PIServerEndpoint);
 	linkedData.setFormats(getFormatType(OMF_TYPE_FLOAT), getFormatType(OMF_TYPE_INTEGER));
 
-	bool pendingSeparator = false;
-	ostringstream jsonData;
-	jsonData << "[";
+	// The OMF data for each reading, the values are created once all the readings have been prepared
+	vector<OMFReadingData> omfData;
+	omfData.reserve(readings.size());
+
 	// Fetch Reading* data
 	for (vector<Reading *>::const_iterator elem = readings.begin();
 						    elem != readings.end();
@@ -1169,13 +1374,15 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 		// Fetch and parse any OMFHint for this reading
 		Datapoint *hintsdp = reading->getDatapoint("OMFHint");
-		OMFHints *hints = NULL;
+		shared_ptr<const OMFHints> hintsPtr;
+		const OMFHints *hints = NULL;
 		bool usingTagHint = false;
 		long typeId = 0;
 		if (hintsdp)
 		{
-			hints = new OMFHints(hintsdp->getData().toString());
-			const vector<OMFHint *> omfHints = hints->getHints();
+			hintsPtr = m_hintsCache.get(hintsdp->getData().toString());
+			hints = hintsPtr.get();
+			const vector<OMFHint *>& omfHints = hints->getHints();
 			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 			{
 				if (typeid(**it) == typeid(OMFTagHint))
@@ -1212,6 +1419,9 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			}
 		}
 
+		// The reading data keeps a reference to the hints
+		OMFReadingData data(reading, hintsPtr, elem - readings.begin());
+
 		// Applies the PI-Server naming rules to the AssetName
 		{
 
@@ -1269,7 +1479,6 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			setAFHierarchy();
 		}
 
-		string outData;
 		// Use old style complex types if the user has forced it via configuration,
 		// we are running against an EDS endpoint or Connector Relay or we have types defined for this
 		// asset already
@@ -1289,7 +1498,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 				bool usingTypeNameHint = false;
 				if (hints)
 				{
-					const vector<OMFHint *> omfHints = hints->getHints();
+					const vector<OMFHint *>& omfHints = hints->getHints();
 					for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 					{
 						if (typeid(**it) == typeid(OMFTypeNameHint))
@@ -1385,7 +1594,9 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 			measurementId = generateMeasurementId(m_assetName);
 
-			outData = OMFData(*reading, measurementId, m_PIServerEndpoint, AFHierarchyPrefix, hints ).OMFdataVal();
+			data.m_legacy = true;
+			data.m_measurementId = measurementId;
+			data.m_AFHierarchyPrefix = AFHierarchyPrefix;
 		}
 		else
 		{
@@ -1393,7 +1604,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			// in the processReading call
 			auto asset_sent = m_assetSent.find(m_assetName);
 			// Send data for this reading using the new mechanism
-			outData = linkedData.processReading(*reading, AFHierarchyPrefix, hints);
+			data.m_prefix = linkedData.prepareReading(*reading, AFHierarchyPrefix, hints, data.m_values);
 			if (asset_sent == m_assetSent.end())
 			{
 				// If the hierarchy has not already been sent then send it
@@ -1407,26 +1618,15 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 					AFHierarchySent = true;
 				}
 
-				string af = createAFLinks(*reading, hints);
-				if (! af.empty())
-				{
-					outData.append(",");
-					outData.append(af);
-				}
+				data.m_suffix = createAFLinks(*reading, hints);
 			}
 		}
-		if (!outData.empty())
-		{
-			jsonData << (pendingSeparator ? ", " : "") << outData;
-			pendingSeparator = true;
-		}
-
-		if (hints)
-		{
-			delete hints;
-		}
+		omfData.push_back(std::move(data));
 	}
 
+	// Create the data values for all the readings in parallel
+	serialiseReadings(omfData, m_PIServerEndpoint, m_batchValues, m_workers);
+
 #if INSTRUMENT
 	gettimeofday(&t2, NULL);
 #endif
@@ -1434,15 +1634,52 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	// Remove all assets supersetDataPoints
 	OMF::unsetMapObjectTypes(m_SuperSetDataPoints);
 
-	jsonData << "]";
-
-	string json = jsonData.str();
-	json_not_compressed = json;
+	// Split the block into one payload per concurrent post, each post covers
+	// a contiguous range of the readings starting at firstReadings[i].
+	// The payloads are compressed as they are created.
+	int level = compression ? m_compressionLevel : OMF_NO_COMPRESSION;
+	bool batchValues = m_batchValues;
+	string json;
+	vector<string> payloads;
+	vector<size_t> firstReadings;
+	size_t posts = min((size_t)m_maxConcurrentPosts, omfData.size());
+	if (posts > 1)
+	{
+		size_t perPost = (omfData.size() + posts - 1) / posts;
+		for (size_t from = 0; from < omfData.size(); from += perPost)
+		{
+			firstReadings.push_back(from == 0 ? 0 : omfData[from].m_index);
+		}
+		payloads.resize(firstReadings.size());
 
-	if (compression)
+		// Each payload is created and compressed by a worker thread, the
+		// workers persist so their compression streams are reused
+		vector<function<void()>> tasks;
+		for (size_t i = 0; i < payloads.size(); i++)
+		{
+			size_t from = i * perPost;
+			tasks.push_back([&omfData, &payloads, i, from, perPost, batchValues, level]() {
+					createPayload(omfData, from, min(from + perPost, omfData.size()),
+							batchValues, level, payloads[i]);
+				});
+		}
+		if (m_workers)
+		{
+			m_workers->run(tasks);
+		}
+		else
+		{
+			for (auto& task : tasks)
+			{
+				task();
+			}
+		}
+	}
+	else
 	{
-		json = compress_string(json);
+		uncompressedLength = createPayload(omfData, 0, omfData.size(), batchValues, level, json);
 	}
+	omfData.clear();
 
 #if INSTRUMENT
 	gettimeofday(&t3, NULL);
@@ -1463,6 +1700,11 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	if (compression)
 		readingData.push_back(pair<string, string>("compression", "gzip"));
 
+	if (!payloads.empty())
+	{
+		return sendConcurrentData(payloads, firstReadings, readings.size(), readingData);
+	}
+
 	// Build an HTTPS POST with 'readingData headers
 	// and 'allReadings' JSON payload
 	// Then get HTTPS POST ret code and return 0 to client on error
@@ -1516,7 +1758,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 								   timeT3,
 								   timeT4,
 								   readings.size(),
-								   json_not_compressed.length(),
+								   uncompressedLength,
 								   json.length()
 		);
 
@@ -1653,6 +1895,106 @@ string OMF::errorMessageHandler(const string &msg)
 	return(errorMsg);
 }
 
+/**
+ * Send a block of data split into several payloads, with up to
+ * m_maxConcurrentPosts of them in flight at once.
+ *
+ * The responses may arrive in any order, only the readings covered by
+ * the leading run of acknowledged posts are reported as sent. The caller
+ * uses this count to advance the last sent id, so it never moves past
+ * a reading the server has not accepted; any readings after the first
+ * failed post are sent again with the next block.
+ *
+ * @param payloads	The payloads, in reading order
+ * @param firstReadings	The index of the first reading in each payload
+ * @param readingCount	The number of readings in the block
+ * @param header	The HTTP headers for the data messages
+ * @return		Number of readings acknowledged
+ */
+uint32_t OMF::sendConcurrentData(const vector<string>& payloads,
+				 const vector<size_t>& firstReadings,
+				 size_t readingCount,
+				 const vector<pair<string, string>>& header)
+{
+	vector<HttpResult> results = m_sender.sendRequests("POST",
+							   m_path,
+							   header,
+							   payloads,
+							   m_maxConcurrentPosts);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const HttpResult& result = results[i];
+		if (result.httpCode >= 200 && result.httpCode <= 299)
+		{
+			continue;
+		}
+
+		if (result.httpCode == 400)
+		{
+			OMFError error(result.response);
+			if (error.hasErrors())
+			{
+				Logger::getLogger()->warn("The OMF endpoint reported a bad request when sending data: %d messages",
+						error.messageCount());
+				for (unsigned int j = 0; j < error.messageCount(); j++)
+				{
+					Logger::getLogger()->warn("Message %d: %s, %s, %s",
+							j, error.getEventSeverity(j).c_str(), error.getMessage(j).c_str(), error.getEventReason(j).c_str());
+				}
+			}
+
+			if (OMF::isDataTypeError(result.error.c_str()))
+			{
+				// Not blocking, see sendToServer. The readings in
+				// this post are skipped and considered sent
+				string errorMsg = errorMessageHandler(result.error);
+				Logger::getLogger()->warn("Sending JSON readings, "
+							  "not blocking issue: %s - %s %s",
+							  errorMsg.c_str(),
+							  m_sender.getHostPort().c_str(),
+							  m_path.c_str());
+
+				if (m_PIServerEndpoint == ENDPOINT_CR)
+				{
+					string assetName = OMF::getAssetNameFromError(result.error.c_str());
+					if (!assetName.empty())
+					{
+						// Remove data and keep type-id
+						OMF::clearCreatedTypes(assetName);
+					}
+				}
+				continue;
+			}
+		}
+
+		if (result.sent)
+		{
+			string errorMsg = errorMessageHandler(result.error);
+			Logger::getLogger()->error("Sending JSON data error : %s - %s %s",
+						   errorMsg.c_str(),
+						   m_sender.getHostPort().c_str(),
+						   m_path.c_str());
+		}
+		if (result.httpCode != 400)
+		{
+			m_connected = false;
+		}
+		m_lastError = true;
+		if (i > 0)
+		{
+			Logger::getLogger()->warn("%u of %u data posts acknowledged, %u readings will be sent again",
+						  (unsigned int)i,
+						  (unsigned int)results.size(),
+						  (unsigned int)(readingCount - firstReadings[i]));
+		}
+		return firstReadings[i];
+	}
+
+	// Reset error indicator
+	m_lastError = false;
+	return readingCount;
+}
+
 
 /**
  * Send all the readings to the PI Server.
@@ -1681,12 +2023,14 @@ uint32_t OMF::sendToServer(const vector<Reading>& readings,
 						    ++elem)
 	{
 		bool sendDataTypes;
-		OMFHints *hints = NULL;
+		shared_ptr<const OMFHints> hintsPtr;
+		const OMFHints *hints = NULL;
 
 		Datapoint *hintsdp = elem->getDatapoint(OMF_HINT);
 		if (hintsdp)
 		{
-			hints = new OMFHints(hintsdp->getData().toString());
+			hintsPtr = m_hintsCache.get(hintsdp->getData().toString());
+			hints = hintsPtr.get();
 		}
 
 		// Create the key for dataTypes sending once
@@ -1790,10 +2134,12 @@ uint32_t OMF::sendToServer(const Reading* reading,
 
 
 	Datapoint *hintsdp = reading->getDatapoint("OMFHint");
-	OMFHints *hints = NULL;
+	shared_ptr<const OMFHints> hintsPtr;
+	const OMFHints *hints = NULL;
 	if (hintsdp)
 	{
-		hints = new OMFHints(hintsdp->getData().toString());
+		hintsPtr = m_hintsCache.get(hintsdp->getData().toString());
+		hints = hintsPtr.get();
 	}
 	if (!OMF::handleDataTypes(key, *reading, skipSentDataTypes, hints))
 	{
@@ -1872,7 +2218,7 @@ const vector<pair<string, string>> OMF::createMessageHeader(const std::string& t
  * @param reading    A reading data
  * @return           Type JSON message as string
  */
-const std::string OMF::createTypeData(const Reading& reading, OMFHints *hints)
+const std::string OMF::createTypeData(const Reading& reading, const OMFHints *hints)
 {
 	// Build the Type data message (JSON Array)
 
@@ -1951,7 +2297,7 @@ const std::string OMF::createTypeData(const Reading& reading, OMFHints *hints)
 		string format = OMF::getFormatType(omfType);
 		if (hints && (omfType == OMF_TYPE_FLOAT || omfType == OMF_TYPE_INTEGER))
 		{
-			const vector<OMFHint *> omfHints = hints->getHints(dpName);
+			const vector<OMFHint *>& omfHints = hints->getHints(dpName);
 			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 			{
 				if (typeid(**it) == typeid(OMFNumberHint))
@@ -2001,7 +2347,7 @@ const std::string OMF::createTypeData(const Reading& reading, OMFHints *hints)
 	bool typeNameSet = false;
 	if (hints)
 	{
-		const vector<OMFHint *> omfHints = hints->getHints();
+		const vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 		{
 			if (typeid(**it) == typeid(OMFTypeNameHint))
@@ -2044,7 +2390,7 @@ const std::string OMF::createTypeData(const Reading& reading, OMFHints *hints)
  * @param reading    A reading data
  * @return           Type JSON message as string
  */
-const std::string OMF::createContainerData(const Reading& reading, OMFHints *hints)
+const std::string OMF::createContainerData(const Reading& reading, const OMFHints *hints)
 {
 	string assetName = m_assetName;
 
@@ -2056,7 +2402,7 @@ const std::string OMF::createContainerData(const Reading& reading, OMFHints *hin
 	string typeName = "";
 	if (hints)
 	{
-		const std::vector<OMFHint *> omfHints = hints->getHints();
+		const std::vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 		{
 			if (typeid(**it) == typeid(OMFTypeNameHint))
@@ -2083,7 +2429,7 @@ const std::string OMF::createContainerData(const Reading& reading, OMFHints *hin
 	// Apply any TagName hints to modify the containerid
 	if (hints)
 	{
-		const std::vector<OMFHint *> omfHints = hints->getHints();
+		const std::vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 		{
 			if (typeid(**it) == typeid(OMFTagNameHint))
@@ -2275,7 +2621,7 @@ const std::string OMF::createStaticData(const Reading& reading)
  * @param legacy     We are using legacy, complex types for this reading
  * @return           Type JSON message as string
  */
-std::string OMF::createLinkData(const Reading& reading,  std::string& AFHierarchyLevel, std::string&  AFHierarchyPrefix, std::string&  objectPrefix, OMFHints *hints, bool legacy)
+std::string OMF::createLinkData(const Reading& reading,  std::string& AFHierarchyLevel, std::string&  AFHierarchyPrefix, std::string&  objectPrefix, const OMFHints *hints, bool legacy)
 {
 	string targetTypeId;
 
@@ -2380,7 +2726,7 @@ std::string OMF::createLinkData(const Reading& reading,  std::string& AFHierarch
 		// Apply any TagName hints to modify the containerid
 		if (hints)
 		{
-			const std::vector<OMFHint *> omfHints = hints->getHints();
+			const std::vector<OMFHint *>& omfHints = hints->getHints();
 			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 			{
 				if (typeid(**it) == typeid(OMFTagNameHint))
@@ -2663,7 +3009,7 @@ std::string OMF::variableValueHandle(const Reading& reading, std::string &AFHier
 				propertyName = (*it)->getName();
 				if (propertyName.compare(propertyToSearch) == 0)
 				{
-					DatapointValue data = (*it)->getData();
+					const DatapointValue& data = (*it)->getData();
 					propertyValue = data.toString();
 					found = true;
 					foundProperty = true;
@@ -2895,7 +3241,7 @@ bool OMF::evaluateAFHierarchyRules(const string& assetName, const Reading& readi
 				for (auto itL2 = values.begin(); found == false && itL2 != values.end(); itL2++)
 				{
 					propertyName = (*itL2)->getName();
-					DatapointValue data = (*itL2)->getData();
+					const DatapointValue& data = (*itL2)->getData();
 					string dataValue = data.toString();
 					StringStripQuotes(dataValue);
 					if (propertyName.compare(rule) == 0)
@@ -2964,7 +3310,7 @@ bool OMF::evaluateAFHierarchyRules(const string& assetName, const Reading& readi
 
 					if (propertyName.compare(rule) == 0)
 					{
-						DatapointValue data = (*itL2)->getData();
+						const DatapointValue& data = (*itL2)->getData();
 						string dataValue = data.toString();
 						StringStripQuotes(dataValue);
 
@@ -3118,7 +3464,7 @@ void OMF::setAssetTypeTagNew(const string& assetName,
  * @return               True if data types have been sent or already sent.
  *                       False if the sending has failed.
  */ 
-bool OMF::handleDataTypes(const string keyComplete, const Reading& row, bool skipSending, OMFHints *hints)
+bool OMF::handleDataTypes(const string keyComplete, const Reading& row, bool skipSending, const OMFHints *hints)
 {
 	// Create the key for dataTypes sending once
 	const string key(skipSending ? (keyComplete) : "");
@@ -3480,7 +3826,7 @@ bool OMF::isDataTypeError(const char* message)
  * @return              True if data types with new-id
  *                      have been sent, false otherwise.
  */
-bool OMF::handleTypeErrors(const string& keyComplete, const Reading& reading, OMFHints *hints)
+bool OMF::handleTypeErrors(const string& keyComplete, const Reading& reading, const OMFHints *hints)
 {
 	Logger::getLogger()->debug("handleTypeErrors keyComplete :%s:", keyComplete.c_str());
 
@@ -3579,8 +3925,8 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 
 					if (hintsdp && (omfType == OMF_TYPE_FLOAT || omfType == OMF_TYPE_INTEGER))
 					{
-						OMFHints *hints = new OMFHints(hintsdp->getData().toString());
-						const vector<OMFHint *> omfHints = hints->getHints();
+						shared_ptr<const OMFHints> hints = m_hintsCache.get(hintsdp->getData().toString());
+						const vector<OMFHint *>& omfHints = hints->getHints();
 
 						for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 						{
@@ -3590,8 +3936,6 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 								break;
 							}
 						}
-
-						delete hints;
 					}
 				}
 
@@ -4218,7 +4562,7 @@ unsigned long OMF::calcTypeShort(const Reading& row)
  * @param row    The reading data row
  * @return       True, false if map pointer is NULL
  */
-bool OMF::setCreatedTypes(const Reading& row, OMFHints *hints)
+bool OMF::setCreatedTypes(const Reading& row, const OMFHints *hints)
 {
 	string types;
 	string keyComplete;
@@ -4256,7 +4600,7 @@ bool OMF::setCreatedTypes(const Reading& row, OMFHints *hints)
 	// We may need to add the hint to the key if we have a TypeName key
 	if (hints)
 	{
-		const vector<OMFHint *> omfHints = hints->getHints();
+		const vector<OMFHint *>& omfHints = hints->getHints();
 		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 		{
 			if (typeid(**it) == typeid(OMFTypeNameHint))
@@ -4307,7 +4651,7 @@ bool OMF::setCreatedTypes(const Reading& row, OMFHints *hints)
 		string format = OMF::getFormatType(omfType);
 		if (hints && (omfType == OMF_TYPE_FLOAT || omfType == OMF_TYPE_INTEGER))
 		{
-			const vector<OMFHint *> omfHints = hints->getHints(dpName);
+			const vector<OMFHint *>& omfHints = hints->getHints(dpName);
 			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 			{
 				if (typeid(**it) == typeid(OMFNumberHint))
@@ -4426,7 +4770,7 @@ void OMF::clearCreatedTypes(const string& keyComplete)
  *		 must be sent again with the new type-id.
  *               Return false if the key is not found or found but empty.
  */
-bool OMF::getCreatedTypes(const string& keyComplete, const Reading& row, OMFHints *hints)
+bool OMF::getCreatedTypes(const string& keyComplete, const Reading& row, const OMFHints *hints)
 {
 	unsigned long typesDefinition;
 	bool ret = false;
@@ -4776,7 +5120,7 @@ bool OMF::sendBaseTypes()
  * @param reading	The reading beign sent
  * @param hints		OMF Hints for this reading
  */
-string OMF::createAFLinks(Reading& reading, OMFHints *hints)
+string OMF::createAFLinks(Reading& reading, const OMFHints *hints)
 {
 string AFDataMessage;
 
@@ -338,3 +338,32 @@ const vector<OMFHint *>& OMFHints::getHints(const string& datapoint) const
 	}
 	return m_hints;
 }
+
+/**
+ * Return the parsed hints for the hint text, parsing it only if it is
+ * not already in the cache
+ *
+ * @param hint	The OMF hint in JSON format
+ * @return	The shared, parsed hints
+ */
+shared_ptr<const OMFHints> OMFHintsCache::get(const string& hint)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_index.find(hint);
+	if (it != m_index.end())
+	{
+		// Move the entry to the front of the list
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return it->second->second;
+	}
+
+	shared_ptr<const OMFHints> hints = make_shared<OMFHints>(hint);
+	m_entries.emplace_front(hint, hints);
+	m_index[hint] = m_entries.begin();
+	if (m_entries.size() > m_size)
+	{
+		m_index.erase(m_entries.back().first);
+		m_entries.pop_back();
+	}
+	return hints;
+}
@@ -0,0 +1,164 @@
+/*
+ * Fledge OSIsoft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+#include <string>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <omfpayload.h>
+
+using namespace std;
+
+#define GZIP_WINDOW_BITS	(15 + 16)	// Maximum window with a gzip header
+
+/**
+ * The zlib stream used by a thread to compress payloads
+ */
+class GzipStream {
+	public:
+		GzipStream() : m_initialised(false), m_level(0)
+		{
+			memset(&m_stream, 0, sizeof(m_stream));
+		};
+		~GzipStream()
+		{
+			if (m_initialised)
+				deflateEnd(&m_stream);
+		};
+		z_stream	*get(int level)
+		{
+			if (m_initialised && level != m_level)
+			{
+				deflateEnd(&m_stream);
+				m_initialised = false;
+			}
+			if (m_initialised)
+			{
+				deflateReset(&m_stream);
+			}
+			else
+			{
+				memset(&m_stream, 0, sizeof(m_stream));
+				if (deflateInit2(&m_stream, level, Z_DEFLATED,
+						GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+					throw runtime_error("deflateInit failed while compressing.");
+				m_initialised = true;
+				m_level = level;
+			}
+			return &m_stream;
+		};
+	private:
+		z_stream	m_stream;
+		bool		m_initialised;
+		int		m_level;
+};
+
+static thread_local GzipStream gzipStream;
+
+/**
+ * Construct a payload
+ *
+ * @param payload	The string the payload is written to
+ * @param level		The zlib compression level or OMF_NO_COMPRESSION
+ * @param sizeHint	The expected size of the uncompressed payload
+ */
+OMFPayload::OMFPayload(string& payload, int level, size_t sizeHint) :
+	m_payload(payload), m_compress(level != OMF_NO_COMPRESSION),
+	m_finished(false), m_stream(NULL), m_length(0)
+{
+	m_payload.clear();
+	if (m_compress)
+	{
+		m_stream = gzipStream.get(level);
+		m_pending.reserve(OMF_PAYLOAD_CHUNK);
+		// JSON typically compresses to well under a quarter of its size,
+		// the payload is sized to the compressed data in finish
+		m_payload.resize(sizeHint / 4 + 1024);
+	}
+	else
+	{
+		m_payload.reserve(sizeHint);
+	}
+}
+
+/**
+ * Append a part of the JSON to the payload
+ *
+ * @param part		The JSON to append
+ * @param length	The length of the JSON
+ */
+void OMFPayload::append(const char *part, size_t length)
+{
+	m_length += length;
+	if (!m_compress)
+	{
+		m_payload.append(part, length);
+		return;
+	}
+	m_pending.append(part, length);
+	if (m_pending.length() >= OMF_PAYLOAD_CHUNK)
+	{
+		deflateChunk(Z_NO_FLUSH);
+	}
+}
+
+/**
+ * Complete the payload, for a compressed payload the remaining JSON is
+ * compressed and the gzip trailer written.
+ */
+void OMFPayload::finish()
+{
+	if (m_finished)
+		return;
+	m_finished = true;
+	if (m_compress)
+	{
+		deflateChunk(Z_FINISH);
+	}
+}
+
+/**
+ * Compress the buffered JSON directly into the payload, growing the
+ * payload as required
+ *
+ * @param flush	The zlib flush mode, Z_FINISH for the final chunk
+ */
+void OMFPayload::deflateChunk(int flush)
+{
+	m_stream->next_in = (Bytef *)m_pending.data();
+	m_stream->avail_in = m_pending.length();
+
+	int ret;
+	do {
+		size_t used = m_stream->total_out;
+		if (m_payload.size() - used < 1024)
+		{
+			m_payload.resize(m_payload.size() * 2 + 1024);
+		}
+		m_stream->next_out = (Bytef *)&m_payload[used];
+		m_stream->avail_out = m_payload.size() - used;
+
+		ret = deflate(m_stream, flush);
+	} while (ret != Z_STREAM_ERROR &&
+			(m_stream->avail_out == 0 || (flush == Z_FINISH && ret == Z_OK)));
+
+	m_pending.clear();
+
+	if (ret == Z_STREAM_ERROR || (flush == Z_FINISH && ret != Z_STREAM_END))
+	{
+		ostringstream oss;
+		oss << "Exception during zlib compression: (" << ret << ") " << (m_stream->msg ? m_stream->msg : "");
+		throw runtime_error(oss.str());
+	}
+	if (flush == Z_FINISH)
+	{
+		m_payload.resize(m_stream->total_out);
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * Fledge OSIsoft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+#include <omfworkers.h>
+
+using namespace std;
+
+/**
+ * Construct the set of workers, no threads are created until
+ * they are needed
+ */
+OMFWorkers::OMFWorkers() : m_shutdown(false)
+{
+}
+
+/**
+ * Stop and join the worker threads
+ */
+OMFWorkers::~OMFWorkers()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+	}
+	m_workCv.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+/**
+ * Run a set of tasks in parallel and wait for them all to complete.
+ * The calling thread runs the first task, the remainder are given to
+ * the workers. More workers are created if there are fewer than the
+ * number of tasks passed to the workers.
+ *
+ * An exception raised by a task is rethrown by the calling thread
+ * once all the tasks have completed.
+ *
+ * @param tasks		The tasks to run
+ */
+void OMFWorkers::run(vector<function<void()>>& tasks)
+{
+	if (tasks.empty())
+	{
+		return;
+	}
+	vector<exception_ptr> errors(tasks.size());
+	size_t pending = tasks.size() - 1;
+	if (pending)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		while (m_threads.size() < pending)
+		{
+			m_threads.push_back(thread(&OMFWorkers::worker, this));
+		}
+		for (size_t i = 1; i < tasks.size(); i++)
+		{
+			m_jobs.push_back(Job(&tasks[i], &errors[i], &pending));
+		}
+	}
+	m_workCv.notify_all();
+
+	try {
+		tasks[0]();
+	} catch (...) {
+		errors[0] = current_exception();
+	}
+
+	{
+		unique_lock<mutex> lck(m_mutex);
+		m_doneCv.wait(lck, [&pending] { return pending == 0; });
+	}
+	for (auto& error : errors)
+	{
+		if (error)
+		{
+			rethrow_exception(error);
+		}
+	}
+}
+
+/**
+ * The worker thread, runs queued jobs until the workers are shutdown
+ */
+void OMFWorkers::worker()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		m_workCv.wait(lck, [this] { return m_shutdown || !m_jobs.empty(); });
+		if (m_jobs.empty())
+		{
+			return;
+		}
+		Job job = m_jobs.front();
+		m_jobs.pop_front();
+		lck.unlock();
+		try {
+			(*job.m_task)();
+		} catch (...) {
+			*job.m_error = current_exception();
+		}
+		lck.lock();
+		if (--(*job.m_pending) == 0)
+		{
+			m_doneCv.notify_all();
+		}
+	}
+}
@@ -44,6 +44,7 @@
 #include <plugin_exception.h>
 #include <iostream>
 #include <omf.h>
+#include <omfworkers.h>
 #include <piwebapi.h>
 #include <ocs.h>
 #include <simple_https.h>
@@ -276,6 +277,16 @@ const char *PLUGIN_DEFAULT_CONFIG_INFO = QUOTE(
 			"group": "Connection",
 			"displayName": "Compression"
 		},
+		"compressionLevel": {
+			"description": "Trade off between the time taken to compress the readings data and the size of the compressed data",
+			"type": "enumeration",
+			"default": "Default",
+			"options": ["Fastest", "Default", "Smallest"],
+			"order": "31",
+			"group": "Connection",
+			"displayName": "Compression Level",
+			"validity": "compression == \"true\""
+		},
 		"DefaultAFLocation": {
 			"description": "Defines the default location in the Asset Framework hierarchy in which the assets will be created, each level is separated by /, PI Web API only.",
 			"type": "string",
@@ -397,6 +408,24 @@ const char *PLUGIN_DEFAULT_CONFIG_INFO = QUOTE(
 			"order": "29",
 			"group": "Formats & Types",
 			"displayName": "Complex Types"
+		},
+		"BatchValues": {
+			"description": "Send the values of each data point in a block of readings as a single OMF data message, rather than one message per value. Applies only to linked types",
+			"type": "boolean",
+			"default": "false",
+			"order": "32",
+			"group": "Formats & Types",
+			"displayName": "Batch Values by Container"
+		},
+		"OMFMaxConcurrentPosts": {
+			"description": "Maximum number of data messages sent concurrently to the OMF endpoint, each block of readings is split across this number of messages. Values greater than 1 require an https URL",
+			"type": "integer",
+			"default": "1",
+			"minimum": "1",
+			"maximum": "16",
+			"order": "30",
+			"group": "Connection",
+			"displayName": "Concurrent Data Messages"
 		}
 	}
 );
@@ -412,11 +441,13 @@ typedef struct
 	OMF 		*omf;                   // OMF data protocol
 	bool		sendFullStructure;      // It sends the minimum OMF structural messages to load data into Data Archive if disabled
 	bool		compression;            // whether to compress readings' data
+	int		compressionLevel;	// zlib level used to compress readings' data
 	string		protocol;               // http / https
 	string		hostAndPort;            // hostname:port for SimpleHttps
 	unsigned int	retrySleepTime;     	// Seconds between each retry
 	unsigned int	maxRetry;	        // Max number of retries in the communication
 	unsigned int	timeout;	        // connect and operation timeout
+	unsigned int	maxConcurrentPosts;	// Max number of data messages in flight
 	string		path;		        // PI Server application path
 	long		typeId;		        // OMF protocol type-id prefix
 	string		producerToken;	        // PI Server connector token
@@ -458,6 +489,8 @@ typedef struct
 			assetsDataTypes;
 	string		omfversion;
 	bool		legacy;
+	bool		batchValues;		// Send the linked values with one message per container
+	OMFWorkers	*workers;		// Threads used to process a block in parallel
 	string		name;
 } CONNECTOR_INFO;
 
@@ -489,7 +522,7 @@ extern "C" {
 static PLUGIN_INFORMATION info = {
 	PLUGIN_NAME,			   // Name
 	VERSION,			   // Version
-	SP_PERSIST_DATA | SP_BUILTIN,	   // Flags
+	SP_PERSIST_DATA | SP_BUILTIN | SP_PARTIAL_SEND,	   // Flags
 	PLUGIN_TYPE_NORTH,		   // Type
 	"1.0.0",			   // Interface version
 	PLUGIN_DEFAULT_CONFIG_INFO	   // Configuration
@@ -523,6 +556,7 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 	// Allocate connector struct
 	CONNECTOR_INFO *connInfo = new CONNECTOR_INFO;
 	connInfo->name = configData->getName();
+	connInfo->workers = new OMFWorkers();
 
 	// PIServerEndpoint handling
 	string PIServerEndpoint = configData->getValue("PIServerEndpoint");
@@ -599,6 +633,13 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 	unsigned int retrySleepTime = atoi(configData->getValue("OMFRetrySleepTime").c_str());
 	unsigned int maxRetry = atoi(configData->getValue("OMFMaxRetry").c_str());
 	unsigned int timeout = atoi(configData->getValue("OMFHttpTimeout").c_str());
+	unsigned int maxConcurrentPosts = 1;
+	if (configData->itemExists("OMFMaxConcurrentPosts"))
+	{
+		maxConcurrentPosts = atoi(configData->getValue("OMFMaxConcurrentPosts").c_str());
+		if (maxConcurrentPosts < 1)
+			maxConcurrentPosts = 1;
+	}
 
 	string producerToken = configData->getValue("producerToken");
 
@@ -648,6 +689,7 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 	connInfo->retrySleepTime = retrySleepTime;
 	connInfo->maxRetry = maxRetry;
 	connInfo->timeout = timeout;
+	connInfo->maxConcurrentPosts = maxConcurrentPosts;
 	connInfo->typeId = TYPE_ID_DEFAULT;
 	connInfo->producerToken = producerToken;
 	connInfo->formatNumber = formatNumber;
@@ -700,6 +742,24 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 	else
 		connInfo->compression = false;
 
+	// Batch linked values by container ?
+	connInfo->batchValues = false;
+	if (configData->itemExists("BatchValues"))
+	{
+		string batch = configData->getValue("BatchValues");
+		connInfo->batchValues = (batch == "True" || batch == "true" || batch == "TRUE");
+	}
+
+	connInfo->compressionLevel = Z_DEFAULT_COMPRESSION;
+	if (configData->itemExists("compressionLevel"))
+	{
+		string level = configData->getValue("compressionLevel");
+		if (level.compare("Fastest") == 0)
+			connInfo->compressionLevel = Z_BEST_SPEED;
+		else if (level.compare("Smallest") == 0)
+			connInfo->compressionLevel = Z_BEST_COMPRESSION;
+	}
+
 	// Set the list of errors considered not blocking in the communication
 	// with the PI Server
 	if (connInfo->PIServerEndpoint == ENDPOINT_PIWEB_API)
@@ -917,11 +977,14 @@ uint32_t plugin_send(const PLUGIN_HANDLE handle,
 	 * the Libcurl integration implements only HTTPS not HTTP currently. We use SimpleHttp or
 	 * SimpleHttps, as appropriate for the URL given, if not using Kerberos
 	 *
+	 * LibcurlHttps is also used for HTTPS if more than one data message may be
+	 * in flight at once, as only it supports concurrent requests.
 	 *
 	 * The handler is allocated using "Hostname : port", connect_timeout and request_timeout.
 	 * Default is no timeout
 	 */
-	if (connInfo->PIWebAPIAuthMethod.compare("k") == 0)
+	if (connInfo->PIWebAPIAuthMethod.compare("k") == 0 ||
+		(connInfo->maxConcurrentPosts > 1 && connInfo->protocol.compare("https") == 0))
 	{
 		connInfo->sender = new LibcurlHttps(connInfo->hostAndPort,
 						    connInfo->timeout,
@@ -1019,6 +1082,11 @@ uint32_t plugin_send(const PLUGIN_HANDLE handle,
 	{
 		connInfo->omf->setLegacyMode(connInfo->legacy);
 	}
+	connInfo->omf->setMaxConcurrentPosts(connInfo->maxConcurrentPosts);
+	connInfo->omf->setCompressionLevel(connInfo->compressionLevel);
+	connInfo->omf->setBatchValues(connInfo->batchValues);
+	connInfo->omf->setWorkers(connInfo->workers);
+
 	// Send the readings data to the PI Server
 	uint32_t ret = connInfo->omf->sendToServer(readings,
 						   connInfo->compression);
@@ -1101,6 +1169,7 @@ string plugin_shutdown(PLUGIN_HANDLE handle)
 				   saveData.str().c_str());
 
 	// Delete plugin handle
+	delete connInfo->workers;
 	delete connInfo;
 
 #if INSTRUMENT
@@ -949,6 +949,11 @@ std::size_t arr = data.find("inserts");
 		ins++;
 	}
 
+	/*
+	 * The INSERT statements of all the rows are sent with a single
+	 * PQexec call, the server executes them in a single transaction
+	 * and the status reported is the one of the last statement.
+	 */
 	const char *query = sql.coalesce();
 	logSQL("CommonInsert", query);
 	PGresult *res = PQexec(dbConnection, query);
@@ -956,7 +961,7 @@ std::size_t arr = data.find("inserts");
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		PQclear(res);
-		return atoi(PQcmdTuples(res));
+		return ins;
 	}
  	raiseError("insert", PQerrorMessage(dbConnection));
 	PQclear(res);
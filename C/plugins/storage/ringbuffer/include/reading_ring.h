@@ -0,0 +1,139 @@
+#ifndef _READING_RING_H
+#define _READING_RING_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+#include <plugin_api.h>
+#include <reading_stream.h>
+#include <rapidjson/document.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+
+#define	STORAGE_PURGE_RETAIN_ANY 0x0001U
+#define	STORAGE_PURGE_RETAIN_ALL 0x0002U
+#define STORAGE_PURGE_SIZE	     0x0004U
+
+#define RING_SNAPSHOT_MAGIC	0x4e534252	// "RBSN"
+#define RING_SNAPSHOT_FILE	"ringbuffer.snapshot"
+
+/**
+ * An asset held in the ring. Entries are created the first time an
+ * asset is appended and live for the lifetime of the ring, the id of
+ * the most recent reading of the asset heads the per asset index that
+ * is chained through the records.
+ */
+class RingAsset {
+	public:
+		RingAsset(const std::string& name) : m_name(name), m_last(0) {};
+		const std::string		m_name;
+		mutable std::atomic<unsigned long>	m_last;
+};
+
+/**
+ * A single reading held in the ring. The datapoints are held as they were
+ * received, either as JSON text or using the binary encoding of the
+ * reading stream protocol, and are only converted when read.
+ */
+class RingRecord {
+	public:
+		unsigned long		m_id;
+		const RingAsset		*m_asset;
+		unsigned long		m_prevAsset;	// Previous reading of the same asset
+		struct timeval		m_userTs;
+		struct timeval		m_ts;
+		std::string		m_payload;
+};
+
+/**
+ * A fixed capacity, in memory ring of readings.
+ *
+ * Appends claim a range of reading ids with a single atomic increment,
+ * fill the slots for those ids and then commit them in id order, so
+ * readers only ever see a contiguous run of committed readings. Records
+ * are linked into the per asset index as they are committed, keeping
+ * each asset chain in id order. The
+ * slots hold shared pointers that are published and read atomically,
+ * a reader holds its own reference to a record that is overwritten or
+ * purged while it is being read. Appends and fetches do not lock the
+ * ring, purges are serialised with each other only.
+ *
+ * When the ring is full the oldest readings are overwritten.
+ */
+class ReadingRing {
+	public:
+		ReadingRing(unsigned long capacity, unsigned int snapshotInterval);
+		~ReadingRing();
+		int		appendReadings(const char *readings);
+		int		readingStream(ReadingStream **readings);
+		bool		fetchReadings(unsigned long id, unsigned int blksize,
+						std::string& resultSet);
+		void		fetchReadingsBinary(unsigned long id, unsigned int blksize,
+						std::string& block);
+		bool		retrieveReadings(const std::string& condition,
+						std::string& resultSet);
+		unsigned int	purgeReadings(unsigned long age, unsigned int flags,
+						unsigned long sent, std::string& results);
+		unsigned int	purgeReadingsByRows(unsigned long rows, unsigned int flags,
+						unsigned long sent, std::string& results);
+		unsigned int	purgeReadingsAsset(const std::string& asset);
+		bool		saveSnapshot(const std::string& path);
+		bool		loadSnapshot(const std::string& path);
+		void		shutdown();
+		PLUGIN_ERROR	*getError() { return &m_lastError; };
+
+	private:
+		typedef std::shared_ptr<const RingRecord>	RecordPtr;
+
+		const RingAsset	*asset(const std::string& name);
+		const RingAsset	*findAsset(const std::string& name);
+		void		append(std::vector<RingRecord *>& records);
+		RecordPtr	record(unsigned long id) const;
+		RecordPtr	waitRecord(unsigned long id) const;
+		void		advanceTail(unsigned long tail);
+		unsigned int	purgeTo(unsigned long tail, unsigned long sent,
+					unsigned long& unsentPurged);
+		void		purgeResult(unsigned int removed, unsigned long unsentPurged,
+					unsigned long sent, bool retain, std::string& results);
+		void		appendRow(const RingRecord& record,
+					const std::vector<std::pair<std::string, std::string>>& columns,
+					std::string& resultSet) const;
+		void		snapshotThread();
+		void		raiseError(const char *operation, const char *reason, ...);
+
+		const unsigned long	m_capacity;
+		RecordPtr		*m_slots;
+		std::atomic<unsigned long>
+					m_next;		// Next reading id to claim
+		std::atomic<unsigned long>
+					m_committed;	// All ids below this are readable
+		std::atomic<unsigned long>
+					m_tail;		// Oldest reading id held
+		std::atomic<long>	m_count;	// Readings currently held
+		std::mutex		m_assetsMutex;
+		std::unordered_map<std::string, std::unique_ptr<RingAsset>>
+					m_assets;
+		std::mutex		m_purgeMutex;
+		std::mutex		m_errorMutex;
+		PLUGIN_ERROR		m_lastError;
+		unsigned int		m_snapshotInterval;
+		std::string		m_snapshotPath;
+		bool			m_shutdown;
+		std::mutex		m_snapshotMutex;
+		std::condition_variable	m_snapshotCV;
+		std::thread		*m_snapshotThread;
+};
+#endif
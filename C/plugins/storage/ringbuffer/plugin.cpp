@@ -0,0 +1,216 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+#include <reading_ring.h>
+#include <plugin_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <config_category.h>
+#include <string>
+#include <logger.h>
+#include <reading_stream.h>
+
+using namespace std;
+
+/**
+ * The in memory ring buffer readings plugin interface
+ */
+extern "C" {
+
+const char *default_config = QUOTE({
+		"capacity" : {
+			"description" : "The maximum number of readings held in memory, the oldest readings are overwritten once the buffer is full",
+			"type" : "integer",
+			"default" : "1000000",
+			"minimum" : "1000",
+			"displayName" : "Buffer Capacity",
+			"order" : "1"
+		},
+		"snapshotInterval" : {
+			"description" : "The interval in seconds between snapshots of the readings to disk, the snapshot is reloaded when the storage service restarts. A value of 0 disables snapshots",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Snapshot Interval",
+			"order" : "2"
+		}
+});
+
+/**
+ * The plugin information structure
+ */
+static PLUGIN_INFORMATION info = {
+	"RingBuffer",		// Name
+	"1.0.0",		// Version
+	SP_READINGS|SP_BINARY_STREAM,	// Flags
+	PLUGIN_TYPE_STORAGE,	// Type
+	"1.6.0",		// Interface version
+	default_config
+};
+
+/**
+ * Return the information about this plugin
+ */
+PLUGIN_INFORMATION *plugin_info()
+{
+	return &info;
+}
+
+/**
+ * Initialise the plugin, called to get the plugin handle.
+ * The handle is the ring buffer that holds the readings.
+ *
+ * @param category	The plugin configuration category
+ */
+PLUGIN_HANDLE plugin_init(ConfigCategory *category)
+{
+unsigned long capacity = 1000000;
+unsigned int snapshotInterval = 0;
+
+	if (category->itemExists("capacity"))
+	{
+		capacity = strtoul(category->getValue("capacity").c_str(), NULL, 10);
+	}
+	if (category->itemExists("snapshotInterval"))
+	{
+		snapshotInterval = strtoul(category->getValue("snapshotInterval").c_str(), NULL, 10);
+	}
+	return new ReadingRing(capacity, snapshotInterval);
+}
+
+/**
+ * Append a sequence of readings to the readings buffer
+ */
+int plugin_reading_append(PLUGIN_HANDLE handle, char *readings)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+
+	return ring->appendReadings(readings);
+}
+
+/**
+ * Append a stream of readings to the readings buffer
+ */
+int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool commit)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+
+	(void)commit;
+	return ring->readingStream(readings);
+}
+
+/**
+ * Fetch a block of readings from the readings buffer
+ */
+char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+std::string	  resultSet;
+
+	ring->fetchReadings(id, blksize, resultSet);
+	return strdup(resultSet.c_str());
+}
+
+/**
+ * Fetch a block of readings from the readings buffer as a binary
+ * fetch block, the length of the block is returned via length
+ */
+char *plugin_reading_fetch_binary(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize, size_t *length)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+std::string	  block;
+
+	ring->fetchReadingsBinary(id, blksize, block);
+	char *result = (char *)malloc(block.length());
+	if (!result)
+	{
+		*length = 0;
+		return NULL;
+	}
+	memcpy(result, block.data(), block.length());
+	*length = block.length();
+	return result;
+}
+
+/**
+ * Retrieve some readings from the readings buffer
+ */
+char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+std::string results;
+
+	if (!ring->retrieveReadings(std::string(condition), results))
+	{
+		return NULL;
+	}
+	return strdup(results.c_str());
+}
+
+/**
+ * Purge readings from the buffer
+ */
+char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+std::string 	  results;
+
+	if (flags & STORAGE_PURGE_SIZE)	// Purge by size
+	{
+		(void)ring->purgeReadingsByRows(param, flags, sent, results);
+	}
+	else
+	{
+		(void)ring->purgeReadings(param, flags, sent, results);
+	}
+	return strdup(results.c_str());
+}
+
+/**
+ * Release a previously returned result set
+ */
+void plugin_release(PLUGIN_HANDLE handle, char *results)
+{
+	(void)handle;
+	free(results);
+}
+
+/**
+ * Return details on the last error that occured.
+ */
+PLUGIN_ERROR *plugin_last_error(PLUGIN_HANDLE handle)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+
+	return ring->getError();
+}
+
+/**
+ * Shutdown the plugin
+ */
+bool plugin_shutdown(PLUGIN_HANDLE handle)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+
+	ring->shutdown();
+	return true;
+}
+
+/**
+ * Purge given readings asset or all readings from the buffer
+ */
+unsigned int plugin_reading_purge_asset(PLUGIN_HANDLE handle, char *asset)
+{
+ReadingRing *ring = (ReadingRing *)handle;
+
+	return ring->purgeReadingsAsset(asset);
+}
+};
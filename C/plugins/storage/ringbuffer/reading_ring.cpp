@@ -0,0 +1,1373 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+#include <reading_ring.h>
+#include <reading.h>
+#include <reading_stream_codec.h>
+#include <logger.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/error/en.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+
+#define WAIT_RECORD_YIELDS	10000	// Yields before giving up on an uncommitted record
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * The subset of the query language supported by retrieveReadings
+ */
+class RingQuery {
+	public:
+		RingQuery() : m_hasAsset(false), m_minId(0), m_maxId(ULONG_MAX),
+			      m_newer(0), m_older(0), m_limit(0), m_skip(0),
+			      m_descending(false), m_count(false), m_groupAsset(false) {};
+		bool			m_hasAsset;
+		string			m_asset;
+		unsigned long		m_minId;
+		unsigned long		m_maxId;
+		time_t			m_newer;
+		time_t			m_older;
+		unsigned long		m_limit;
+		unsigned long		m_skip;
+		bool			m_descending;
+		bool			m_count;
+		bool			m_groupAsset;
+		string			m_countAlias;
+		vector<pair<string, string>>
+					m_columns;
+		string			m_error;
+
+		bool			matches(const RingRecord& record) const
+		{
+			if (record.m_id < m_minId || record.m_id > m_maxId)
+				return false;
+			if (m_newer && record.m_userTs.tv_sec < m_newer)
+				return false;
+			if (m_older && record.m_userTs.tv_sec >= m_older)
+				return false;
+			return true;
+		};
+};
+
+/**
+ * The columns returned for each reading by default
+ */
+static const vector<pair<string, string>> defaultColumns = {
+	{ "id", "id" },
+	{ "asset_code", "asset_code" },
+	{ "reading", "reading" },
+	{ "user_ts", "user_ts" },
+	{ "ts", "ts" }
+};
+
+/**
+ * Parse a timestamp of the form "2019-01-07 19:06:35.366100+01:00".
+ * The fraction and the timezone are optional, "now()" is the current time.
+ *
+ * @param str	The timestamp text
+ * @param tv	The parsed timestamp
+ * @return	False if the timestamp could not be parsed
+ */
+static bool parseTimestamp(const char *str, struct timeval *tv)
+{
+	if (strcmp(str, "now()") == 0)
+	{
+		gettimeofday(tv, NULL);
+		return true;
+	}
+
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	int consumed = 0;
+	if (sscanf(str, "%d-%d-%d %d:%d:%d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+				&tm.tm_hour, &tm.tm_min, &tm.tm_sec, &consumed) != 6)
+	{
+		return false;
+	}
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	const char *p = str + consumed;
+
+	long usec = 0;
+	if (*p == '.')
+	{
+		long scale = 100000;
+		for (p++; *p >= '0' && *p <= '9'; p++)
+		{
+			usec += (*p - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	long offset = 0;
+	if (*p == '+' || *p == '-')
+	{
+		int hours = 0, minutes = 0;
+		if (sscanf(p + 1, "%d:%d", &hours, &minutes) < 1)
+		{
+			return false;
+		}
+		offset = (hours * 60 + minutes) * 60;
+		if (*p == '-')
+			offset = -offset;
+	}
+
+	tv->tv_sec = timegm(&tm) - offset;
+	tv->tv_usec = usec;
+	return true;
+}
+
+/**
+ * Format a UTC timestamp as "2019-01-07 19:06:35.366100"
+ *
+ * @param tv		The timestamp
+ * @param digits	The number of digits of the fraction of a second, 3 or 6
+ * @param out		String to append the timestamp to
+ */
+static void formatTimestamp(const struct timeval& tv, int digits, string& out)
+{
+	struct tm tm;
+	char buf[64];
+
+	gmtime_r(&tv.tv_sec, &tm);
+	size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+	if (digits == 3)
+		snprintf(buf + len, sizeof(buf) - len, ".%03ld", (long)tv.tv_usec / 1000);
+	else
+		snprintf(buf + len, sizeof(buf) - len, ".%06ld", (long)tv.tv_usec);
+	out.append(buf);
+}
+
+/**
+ * Append a string to a JSON document as a quoted and escaped JSON string
+ *
+ * @param str	The string to append
+ * @param out	The JSON document
+ */
+static void appendJSONString(const string& str, string& out)
+{
+	out.push_back('"');
+	for (char c : str)
+	{
+		switch (c)
+		{
+			case '"':
+				out.append("\\\"");
+				break;
+			case '\\':
+				out.append("\\\\");
+				break;
+			case '\n':
+				out.append("\\n");
+				break;
+			case '\r':
+				out.append("\\r");
+				break;
+			case '\t':
+				out.append("\\t");
+				break;
+			default:
+				if ((unsigned char)c < 0x20)
+				{
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out.append(buf);
+				}
+				else
+				{
+					out.push_back(c);
+				}
+		}
+	}
+	out.push_back('"');
+}
+
+/**
+ * Parse a where clause into the query
+ *
+ * @param where	The where clause
+ * @param query	The query to populate
+ * @return	False if the clause uses conditions that are not supported
+ */
+static bool parseWhere(const Value& where, RingQuery& query)
+{
+	if (!where.IsObject() || !where.HasMember("column") || !where["column"].IsString() ||
+	    !where.HasMember("condition") || !where["condition"].IsString() ||
+	    !where.HasMember("value"))
+	{
+		query.m_error = "Malformed where clause";
+		return false;
+	}
+	if (where.HasMember("or"))
+	{
+		query.m_error = "The or condition is not supported";
+		return false;
+	}
+
+	string column = where["column"].GetString();
+	string condition = where["condition"].GetString();
+	const Value& value = where["value"];
+
+	if (column.compare("asset_code") == 0 && condition.compare("=") == 0 && value.IsString())
+	{
+		query.m_hasAsset = true;
+		query.m_asset = value.GetString();
+	}
+	else if (column.compare("user_ts") == 0 && value.IsNumber() &&
+		 (condition.compare("newer") == 0 || condition.compare("older") == 0))
+	{
+		time_t when = time(0) - (time_t)value.GetDouble();
+		if (condition.compare("newer") == 0)
+			query.m_newer = when;
+		else
+			query.m_older = when;
+	}
+	else if (column.compare("id") == 0 && value.IsNumber())
+	{
+		unsigned long id = (unsigned long)value.GetDouble();
+		if (condition.compare(">") == 0)
+			query.m_minId = id + 1;
+		else if (condition.compare(">=") == 0)
+			query.m_minId = id;
+		else if (condition.compare("<") == 0)
+			query.m_maxId = id ? id - 1 : 0;
+		else if (condition.compare("<=") == 0)
+			query.m_maxId = id;
+		else if (condition.compare("=") == 0)
+			query.m_minId = query.m_maxId = id;
+		else
+		{
+			query.m_error = "Unsupported condition " + condition + " on id";
+			return false;
+		}
+	}
+	else
+	{
+		query.m_error = "Unsupported condition " + condition + " on " + column;
+		return false;
+	}
+
+	if (where.HasMember("and"))
+	{
+		return parseWhere(where["and"], query);
+	}
+	return true;
+}
+
+/**
+ * Parse a query payload
+ *
+ * @param doc	The query payload
+ * @param query	The query to populate
+ * @return	False if the payload uses features that are not supported
+ */
+static bool parseQuery(const Document& doc, RingQuery& query)
+{
+	if (!doc.IsObject())
+	{
+		query.m_error = "Query must be a JSON object";
+		return false;
+	}
+	for (const char *unsupported : { "timebucket", "modifier", "join" })
+	{
+		if (doc.HasMember(unsupported))
+		{
+			query.m_error = string("Queries using ") + unsupported + " are not supported";
+			return false;
+		}
+	}
+	if (doc.HasMember("where") && !parseWhere(doc["where"], query))
+	{
+		return false;
+	}
+	if (doc.HasMember("limit") && doc["limit"].IsNumber())
+	{
+		query.m_limit = (unsigned long)doc["limit"].GetDouble();
+	}
+	if (doc.HasMember("skip") && doc["skip"].IsNumber())
+	{
+		query.m_skip = (unsigned long)doc["skip"].GetDouble();
+	}
+	if (doc.HasMember("sort"))
+	{
+		const Value& sort = doc["sort"].IsArray() && doc["sort"].Size() > 0 ?
+						doc["sort"][0] : doc["sort"];
+		if (sort.IsObject() && sort.HasMember("direction") && sort["direction"].IsString())
+		{
+			query.m_descending = strcasecmp(sort["direction"].GetString(), "desc") == 0;
+		}
+	}
+	if (doc.HasMember("aggregate"))
+	{
+		const Value& aggregate = doc["aggregate"].IsArray() && doc["aggregate"].Size() == 1 ?
+						doc["aggregate"][0] : doc["aggregate"];
+		if (!aggregate.IsObject() || !aggregate.HasMember("operation") ||
+		    !aggregate["operation"].IsString() ||
+		    strcmp(aggregate["operation"].GetString(), "count") != 0)
+		{
+			query.m_error = "Only the count aggregate is supported";
+			return false;
+		}
+		query.m_count = true;
+		if (aggregate.HasMember("alias") && aggregate["alias"].IsString())
+		{
+			query.m_countAlias = aggregate["alias"].GetString();
+		}
+		else
+		{
+			string column = aggregate.HasMember("column") && aggregate["column"].IsString() ?
+						aggregate["column"].GetString() : "*";
+			query.m_countAlias = "count_" + column;
+		}
+		if (doc.HasMember("group"))
+		{
+			const Value& group = doc["group"];
+			const char *column = group.IsString() ? group.GetString() :
+				(group.IsObject() && group.HasMember("column") && group["column"].IsString() ?
+					group["column"].GetString() : "");
+			if (strcmp(column, "asset_code") != 0)
+			{
+				query.m_error = "Only grouping by asset_code is supported";
+				return false;
+			}
+			query.m_groupAsset = true;
+		}
+	}
+	if (doc.HasMember("return") && doc["return"].IsArray())
+	{
+		for (auto& item : doc["return"].GetArray())
+		{
+			string column, alias;
+			if (item.IsString())
+			{
+				column = alias = item.GetString();
+			}
+			else if (item.IsObject() && item.HasMember("column") && item["column"].IsString())
+			{
+				column = alias = item["column"].GetString();
+				if (item.HasMember("alias") && item["alias"].IsString())
+					alias = item["alias"].GetString();
+			}
+			else
+			{
+				query.m_error = "Only plain columns may be returned";
+				return false;
+			}
+			bool known = false;
+			for (auto& c : defaultColumns)
+				known |= c.first.compare(column) == 0;
+			if (!known)
+			{
+				query.m_error = "Unknown column " + column;
+				return false;
+			}
+			query.m_columns.push_back(make_pair(column, alias));
+		}
+	}
+	if (query.m_columns.empty())
+	{
+		query.m_columns = defaultColumns;
+	}
+	return true;
+}
+
+/**
+ * Construct the ring of readings
+ *
+ * @param capacity		The maximum number of readings held
+ * @param snapshotInterval	The interval in seconds between snapshots
+ *				of the ring to disk, 0 disables snapshots
+ */
+ReadingRing::ReadingRing(unsigned long capacity, unsigned int snapshotInterval) :
+	m_capacity(capacity ? capacity : 1), m_next(1), m_committed(1), m_tail(1), m_count(0),
+	m_snapshotInterval(snapshotInterval), m_shutdown(false), m_snapshotThread(NULL)
+{
+	m_slots = new RecordPtr[m_capacity];
+	m_lastError.message = NULL;
+	m_lastError.entryPoint = NULL;
+	m_lastError.retryable = false;
+
+	const char *dataDir = getenv("FLEDGE_DATA");
+	if (dataDir)
+	{
+		m_snapshotPath = string(dataDir) + "/" RING_SNAPSHOT_FILE;
+	}
+	else
+	{
+		const char *rootDir = getenv("FLEDGE_ROOT");
+		m_snapshotPath = string(rootDir ? rootDir : "/usr/local/fledge") +
+					"/data/" RING_SNAPSHOT_FILE;
+	}
+
+	if (m_snapshotInterval)
+	{
+		loadSnapshot(m_snapshotPath);
+		m_snapshotThread = new thread(&ReadingRing::snapshotThread, this);
+	}
+}
+
+/**
+ * Destructor for the ring
+ */
+ReadingRing::~ReadingRing()
+{
+	shutdown();
+	delete[] m_slots;
+	free(m_lastError.message);
+	free(m_lastError.entryPoint);
+}
+
+/**
+ * Stop the snapshot thread, writing a final snapshot if snapshots
+ * are enabled
+ */
+void ReadingRing::shutdown()
+{
+	{
+		lock_guard<mutex> guard(m_snapshotMutex);
+		if (m_shutdown)
+			return;
+		m_shutdown = true;
+	}
+	m_snapshotCV.notify_all();
+	if (m_snapshotThread)
+	{
+		m_snapshotThread->join();
+		delete m_snapshotThread;
+		m_snapshotThread = NULL;
+		saveSnapshot(m_snapshotPath);
+	}
+}
+
+/**
+ * Return the asset entry for an asset name, creating it if required
+ *
+ * @param name	The asset name
+ * @return	The asset entry
+ */
+const RingAsset *ReadingRing::asset(const string& name)
+{
+	lock_guard<mutex> guard(m_assetsMutex);
+	auto it = m_assets.find(name);
+	if (it == m_assets.end())
+	{
+		it = m_assets.insert(make_pair(name, unique_ptr<RingAsset>(new RingAsset(name)))).first;
+	}
+	return it->second.get();
+}
+
+/**
+ * Return the asset entry for an asset name
+ *
+ * @param name	The asset name
+ * @return	The asset entry or NULL if the asset has never been appended
+ */
+const RingAsset *ReadingRing::findAsset(const string& name)
+{
+	lock_guard<mutex> guard(m_assetsMutex);
+	auto it = m_assets.find(name);
+	return it == m_assets.end() ? NULL : it->second.get();
+}
+
+/**
+ * Add a set of records to the ring. The ring takes ownership of the records.
+ *
+ * @param records	The records to add, in the order to assign ids
+ */
+void ReadingRing::append(vector<RingRecord *>& records)
+{
+	unsigned long n = records.size();
+	if (n == 0)
+	{
+		return;
+	}
+
+	// Hold a reference to each record until it is committed, a small ring
+	// may overwrite a record before the append that added it commits
+	vector<RecordPtr> held;
+	held.reserve(n);
+	unsigned long first = m_next.fetch_add(n);
+	long overwritten = 0;
+	for (unsigned long i = 0; i < n; i++)
+	{
+		RingRecord *record = records[i];
+		record->m_id = first + i;
+		held.push_back(RecordPtr(record));
+		RecordPtr old = atomic_exchange(&m_slots[record->m_id % m_capacity], held.back());
+		if (old)
+		{
+			overwritten++;
+		}
+	}
+	m_count += n - overwritten;
+	if (first + n > m_capacity)
+	{
+		advanceTail(first + n - m_capacity);
+	}
+
+	// Commit in id order, waiting for appends that claimed earlier ids.
+	// The records are linked into the per asset index as part of the
+	// commit so that each asset chain is in descending id order, which
+	// the walks in retrieveReadings and purgeReadingsAsset rely upon.
+	while (m_committed.load() != first)
+	{
+		this_thread::yield();
+	}
+	// Link each record before publishing it as the head of its asset
+	// chain, a concurrent walk may follow m_prevAsset as soon as the
+	// head is visible. Commits are serialised, so there is no other
+	// writer of m_last.
+	for (RingRecord *record : records)
+	{
+		record->m_prevAsset = record->m_asset->m_last.load(memory_order_relaxed);
+		record->m_asset->m_last.store(record->m_id, memory_order_release);
+	}
+	m_committed.store(first + n);
+}
+
+/**
+ * Return the record for a reading id
+ *
+ * @param id	The reading id
+ * @return	The record or an empty pointer if the reading is not held
+ */
+ReadingRing::RecordPtr ReadingRing::record(unsigned long id) const
+{
+	RecordPtr record = atomic_load(&m_slots[id % m_capacity]);
+	if (record && record->m_id == id)
+	{
+		return record;
+	}
+	return RecordPtr();
+}
+
+/**
+ * Return the record for a reading id, waiting for the append that claimed
+ * the id if it has not yet been committed. Used to follow the per asset
+ * index, whose head may be a reading that is still being appended.
+ *
+ * @param id	The reading id
+ * @return	The record or an empty pointer if the reading is not held
+ */
+ReadingRing::RecordPtr ReadingRing::waitRecord(unsigned long id) const
+{
+	for (int i = 0; i < WAIT_RECORD_YIELDS; i++)
+	{
+		RecordPtr r = record(id);
+		if (r || id < m_committed.load())
+		{
+			return r;
+		}
+		this_thread::yield();
+	}
+	return RecordPtr();
+}
+
+/**
+ * Move the tail of the ring forwards
+ *
+ * @param tail	The new oldest reading id
+ */
+void ReadingRing::advanceTail(unsigned long tail)
+{
+	unsigned long current = m_tail.load();
+	while (current < tail && !m_tail.compare_exchange_weak(current, tail))
+		;
+}
+
+/**
+ * Append a set of readings passed as a JSON document
+ *
+ * @param readings	The JSON document containing a readings array
+ * @return		The number of readings appended or -1 on error
+ */
+int ReadingRing::appendReadings(const char *readings)
+{
+	Document doc;
+	if (doc.Parse(readings).HasParseError())
+	{
+		raiseError("appendReadings", "%s", GetParseError_En(doc.GetParseError()));
+		return -1;
+	}
+	if (!doc.IsObject() || !doc.HasMember("readings") || !doc["readings"].IsArray())
+	{
+		raiseError("appendReadings", "Payload is missing the readings array");
+		return -1;
+	}
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	vector<RingRecord *> records;
+	records.reserve(doc["readings"].Size());
+	const RingAsset *last = NULL;
+	for (auto& reading : doc["readings"].GetArray())
+	{
+		if (!reading.IsObject() ||
+		    !reading.HasMember("asset_code") || !reading["asset_code"].IsString() ||
+		    !reading.HasMember("reading") || !reading["reading"].IsObject())
+		{
+			raiseError("appendReadings", "Each reading in the readings array must be an object "
+					"with an asset_code and a reading");
+			for (RingRecord *record : records)
+				delete record;
+			return -1;
+		}
+
+		RingRecord *record = new RingRecord();
+		record->m_ts = now;
+		if (reading.HasMember("user_ts") && reading["user_ts"].IsString())
+		{
+			if (!parseTimestamp(reading["user_ts"].GetString(), &record->m_userTs))
+			{
+				raiseError("appendReadings", "Invalid date |%s|", reading["user_ts"].GetString());
+				delete record;
+				continue;
+			}
+		}
+		else
+		{
+			record->m_userTs = now;
+		}
+
+		const char *assetCode = reading["asset_code"].GetString();
+		if (!last || last->m_name.compare(assetCode) != 0)
+		{
+			last = asset(assetCode);
+		}
+		record->m_asset = last;
+
+		StringBuffer buffer;
+		Writer<StringBuffer> writer(buffer);
+		reading["reading"].Accept(writer);
+		record->m_payload.assign(buffer.GetString(), buffer.GetSize());
+		records.push_back(record);
+	}
+
+	append(records);
+	return records.size();
+}
+
+/**
+ * Append a block of readings received on a reading stream. Payloads
+ * sent using the binary encoding are held in that encoding.
+ *
+ * @param readings	NULL terminated array of streamed readings
+ * @return		The number of readings appended
+ */
+int ReadingRing::readingStream(ReadingStream **readings)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	vector<RingRecord *> records;
+	const RingAsset *last = NULL;
+	for (int i = 0; readings[i]; i++)
+	{
+		ReadingStream *reading = readings[i];
+		const char *payload = &(reading->assetCode[0]) + reading->assetCodeLength;
+
+		RingRecord *record = new RingRecord();
+		record->m_ts = now;
+		record->m_userTs = reading->userTs;
+		if (!last || last->m_name.compare(reading->assetCode) != 0)
+		{
+			last = asset(reading->assetCode);
+		}
+		record->m_asset = last;
+		if (RDS_PAYLOAD_IS_BINARY(payload))
+			record->m_payload.assign(payload, reading->payloadLength);
+		else
+			record->m_payload.assign(payload, strnlen(payload, reading->payloadLength));
+		records.push_back(record);
+	}
+
+	append(records);
+	return records.size();
+}
+
+/**
+ * Append a reading to a JSON result set
+ *
+ * @param record	The reading
+ * @param columns	The columns to return and their aliases
+ * @param resultSet	The result set
+ */
+void ReadingRing::appendRow(const RingRecord& record,
+			    const vector<pair<string, string>>& columns,
+			    string& resultSet) const
+{
+	resultSet.push_back('{');
+	bool first = true;
+	for (auto& column : columns)
+	{
+		if (!first)
+			resultSet.push_back(',');
+		first = false;
+		appendJSONString(column.second, resultSet);
+		resultSet.push_back(':');
+		const string& name = column.first;
+		if (name.compare("id") == 0)
+		{
+			resultSet.append(to_string(record.m_id));
+		}
+		else if (name.compare("asset_code") == 0)
+		{
+			appendJSONString(record.m_asset->m_name, resultSet);
+		}
+		else if (name.compare("reading") == 0)
+		{
+			const string& payload = record.m_payload;
+			string json;
+			if (!payload.empty() && RDS_PAYLOAD_IS_BINARY(payload.c_str()))
+			{
+				if (!ReadingStreamCodec::toJSON(payload.c_str(), payload.length(), json))
+				{
+					json = "{}";
+				}
+				resultSet.append(json);
+			}
+			else
+			{
+				resultSet.append(payload.empty() ? "{}" : payload);
+			}
+		}
+		else if (name.compare("user_ts") == 0)
+		{
+			resultSet.push_back('"');
+			formatTimestamp(record.m_userTs, 6, resultSet);
+			resultSet.push_back('"');
+		}
+		else
+		{
+			resultSet.push_back('"');
+			formatTimestamp(record.m_ts, 3, resultSet);
+			resultSet.push_back('"');
+		}
+	}
+	resultSet.push_back('}');
+}
+
+/**
+ * Fetch a block of readings in id order
+ *
+ * @param id		The id of the first reading to return
+ * @param blksize	The maximum number of readings to return
+ * @param resultSet	The readings as a JSON result set
+ * @return		True, the fetch can not fail
+ */
+bool ReadingRing::fetchReadings(unsigned long id, unsigned int blksize, string& resultSet)
+{
+	unsigned long committed = m_committed.load();
+	unsigned long count = 0;
+	string rows;
+
+	for (unsigned long i = max(id, m_tail.load()); i < committed && count < blksize; i++)
+	{
+		RecordPtr r = record(i);
+		if (!r)
+		{
+			continue;
+		}
+		if (count)
+			rows.push_back(',');
+		appendRow(*r, defaultColumns, rows);
+		count++;
+	}
+
+	resultSet = "{\"count\":" + to_string(count) + ",\"rows\":[";
+	resultSet.append(rows);
+	resultSet.append("]}");
+	return true;
+}
+
+/**
+ * Fetch a block of readings as a binary fetch block. Readings that were
+ * appended using the binary stream encoding are copied into the block
+ * as they are, readings appended as JSON are encoded as they are copied.
+ *
+ * @param id		The id of the first reading to return
+ * @param blksize	The maximum number of readings to return
+ * @param block		The binary fetch block to populate
+ */
+void ReadingRing::fetchReadingsBinary(unsigned long id, unsigned int blksize, string& block)
+{
+	unsigned long committed = m_committed.load();
+	vector<RecordPtr> records;
+
+	for (unsigned long i = max(id, m_tail.load()); i < committed && records.size() < blksize; i++)
+	{
+		RecordPtr r = record(i);
+		if (r)
+			records.push_back(r);
+	}
+
+	ReadingStreamCodec::startBlock(block, (uint32_t)records.size());
+	string encoded;
+	for (auto& r : records)
+	{
+		const string& payload = r->m_payload;
+		if (!payload.empty() && RDS_PAYLOAD_IS_BINARY(payload.c_str()))
+		{
+			ReadingStreamCodec::appendBlockReading(block, r->m_id, r->m_userTs, r->m_ts,
+					r->m_asset->m_name, payload.data(), payload.length());
+			continue;
+		}
+		encoded.clear();
+		try {
+			Reading reading(r->m_asset->m_name, payload.empty() ? "{}" : payload);
+			ReadingStreamCodec::encode(reading, encoded);
+		} catch (exception& e) {
+			Logger::getLogger()->warn("Unable to encode reading %lu for a binary fetch: %s",
+					r->m_id, e.what());
+			encoded.clear();
+			Reading empty(r->m_asset->m_name, "{}");
+			ReadingStreamCodec::encode(empty, encoded);
+		}
+		ReadingStreamCodec::appendBlockReading(block, r->m_id, r->m_userTs, r->m_ts,
+				r->m_asset->m_name, encoded.data(), encoded.length());
+	}
+}
+
+/**
+ * Perform a query against the readings. A subset of the query language
+ * is supported: conditions on asset_code, id and the age of user_ts
+ * combined with "and", a count aggregate optionally grouped by asset_code,
+ * plain returned columns with aliases, sort direction, limit and skip.
+ * Readings are returned in the order they were appended, or the reverse
+ * order if a descending sort is requested. Conditions on asset_code are
+ * resolved using the per asset index.
+ *
+ * @param condition	The JSON query
+ * @param resultSet	The JSON result set
+ * @return		False if the query is not supported
+ */
+bool ReadingRing::retrieveReadings(const string& condition, string& resultSet)
+{
+	RingQuery query;
+	Document doc;
+	if (condition.empty())
+	{
+		doc.SetObject();
+	}
+	else if (doc.Parse(condition.c_str()).HasParseError())
+	{
+		raiseError("retrieve", "%s", GetParseError_En(doc.GetParseError()));
+		return false;
+	}
+	if (!parseQuery(doc, query))
+	{
+		raiseError("retrieve", "%s", query.m_error.c_str());
+		return false;
+	}
+
+	unsigned long committed = m_committed.load();
+	unsigned long tail = m_tail.load();
+	vector<RecordPtr> matched;
+	unordered_map<const RingAsset *, unsigned long> counts;
+	unsigned long total = 0;
+	unsigned long wanted = query.m_limit && !query.m_count ? query.m_skip + query.m_limit : ULONG_MAX;
+
+	if (query.m_hasAsset)
+	{
+		const RingAsset *asset = findAsset(query.m_asset);
+		unsigned long id = asset ? asset->m_last.load(memory_order_acquire) : 0;
+		while (id >= tail && id != 0)
+		{
+			RecordPtr r = waitRecord(id);
+			if (!r)
+			{
+				break;
+			}
+			id = r->m_prevAsset;
+			if (r->m_id >= committed || !query.matches(*r))
+			{
+				continue;
+			}
+			total++;
+			if (!query.m_count)
+			{
+				matched.push_back(r);
+				if (query.m_descending && matched.size() >= wanted)
+					break;
+			}
+		}
+		if (!query.m_descending)
+		{
+			reverse(matched.begin(), matched.end());
+		}
+		if (asset && total)
+		{
+			counts[asset] = total;
+		}
+	}
+	else
+	{
+		for (unsigned long n = tail; n < committed && matched.size() < wanted; n++)
+		{
+			RecordPtr r = record(query.m_descending ? committed - 1 - (n - tail) : n);
+			if (!r || !query.matches(*r))
+			{
+				continue;
+			}
+			total++;
+			if (query.m_count)
+				counts[r->m_asset]++;
+			else
+				matched.push_back(r);
+		}
+	}
+
+	string rows;
+	unsigned long count = 0;
+	if (query.m_count)
+	{
+		if (query.m_groupAsset)
+		{
+			for (auto& c : counts)
+			{
+				if (count++)
+					rows.push_back(',');
+				rows.append("{");
+				appendJSONString(query.m_countAlias, rows);
+				rows.append(":" + to_string(c.second) + ",\"asset_code\":");
+				appendJSONString(c.first->m_name, rows);
+				rows.append("}");
+			}
+		}
+		else
+		{
+			rows.append("{");
+			appendJSONString(query.m_countAlias, rows);
+			rows.append(":" + to_string(total) + "}");
+			count = 1;
+		}
+	}
+	else
+	{
+		for (unsigned long i = query.m_skip;
+		     i < matched.size() && (!query.m_limit || count < query.m_limit); i++)
+		{
+			if (count++)
+				rows.push_back(',');
+			appendRow(*matched[i], query.m_columns, rows);
+		}
+	}
+
+	resultSet = "{\"count\":" + to_string(count) + ",\"rows\":[";
+	resultSet.append(rows);
+	resultSet.append("]}");
+	return true;
+}
+
+/**
+ * Remove the readings below a new tail of the ring
+ *
+ * @param tail		The new oldest reading id
+ * @param sent		The id of the last reading sent onwards
+ * @param unsentPurged	Incremented by the number of unsent readings removed
+ * @return		The number of readings removed
+ */
+unsigned int ReadingRing::purgeTo(unsigned long tail, unsigned long sent, unsigned long& unsentPurged)
+{
+	unsigned int removed = 0;
+	for (unsigned long id = m_tail.load(); id < tail; id++)
+	{
+		RecordPtr *slot = &m_slots[id % m_capacity];
+		RecordPtr r = atomic_load(slot);
+		// The exchange fails if an append overwrote the reading meanwhile
+		if (r && r->m_id == id && atomic_compare_exchange_strong(slot, &r, RecordPtr()))
+		{
+			removed++;
+			if (id > sent)
+				unsentPurged++;
+		}
+	}
+	m_count -= removed;
+	advanceTail(tail);
+	return removed;
+}
+
+/**
+ * Create the JSON result of a purge
+ *
+ * @param removed	The number of readings removed
+ * @param unsentPurged	The number of unsent readings removed
+ * @param sent		The id of the last reading sent onwards
+ * @param retain	True if unsent readings are retained
+ * @param results	The JSON result
+ */
+void ReadingRing::purgeResult(unsigned int removed, unsigned long unsentPurged,
+			      unsigned long sent, bool retain, string& results)
+{
+	unsigned long committed = m_committed.load();
+	unsigned long firstUnsent = max(sent + 1, m_tail.load());
+	unsigned long unsentRetained = retain && committed > firstUnsent ? committed - firstUnsent : 0;
+
+	ostringstream convert;
+	convert << "{ \"removed\" : " << removed << ", ";
+	convert << " \"unsentPurged\" : " << unsentPurged << ", ";
+	convert << " \"unsentRetained\" : " << unsentRetained << ", ";
+	convert << " \"readings\" : " << max(m_count.load(), 0L) << " }";
+	results = convert.str();
+}
+
+/**
+ * Purge readings older than a given age
+ *
+ * @param age		The age in hours of the readings to remove, 0 removes
+ *			the oldest hour of readings
+ * @param flags		The purge flags
+ * @param sent		The id of the last reading sent onwards
+ * @param results	The JSON result of the purge
+ * @return		The number of readings removed
+ */
+unsigned int ReadingRing::purgeReadings(unsigned long age, unsigned int flags,
+					unsigned long sent, string& results)
+{
+	lock_guard<mutex> guard(m_purgeMutex);
+	bool retain = (flags & (STORAGE_PURGE_RETAIN_ANY | STORAGE_PURGE_RETAIN_ALL)) != 0;
+	unsigned long committed = m_committed.load();
+	unsigned long tail = m_tail.load();
+
+	time_t cutoff = time(0) - (time_t)age * 60 * 60;
+	if (age == 0)
+	{
+		cutoff = 0;
+		for (unsigned long id = tail; id < committed && cutoff == 0; id++)
+		{
+			RecordPtr r = record(id);
+			if (r)
+				cutoff = r->m_userTs.tv_sec + 60 * 60;
+		}
+	}
+
+	// Readings are purged from the tail until one that is too young
+	unsigned long newTail = tail;
+	for (; newTail < committed; newTail++)
+	{
+		if (retain && newTail > sent)
+		{
+			break;
+		}
+		RecordPtr r = record(newTail);
+		if (r && r->m_userTs.tv_sec >= cutoff)
+		{
+			break;
+		}
+	}
+
+	unsigned long unsentPurged = 0;
+	unsigned int removed = purgeTo(newTail, sent, unsentPurged);
+	purgeResult(removed, unsentPurged, sent, retain, results);
+	Logger::getLogger()->info("Purge by age complete: %s", results.c_str());
+	return removed;
+}
+
+/**
+ * Purge the oldest readings to leave at most a given number of readings
+ *
+ * @param rows		The number of readings to retain
+ * @param flags		The purge flags
+ * @param sent		The id of the last reading sent onwards
+ * @param results	The JSON result of the purge
+ * @return		The number of readings removed
+ */
+unsigned int ReadingRing::purgeReadingsByRows(unsigned long rows, unsigned int flags,
+					      unsigned long sent, string& results)
+{
+	lock_guard<mutex> guard(m_purgeMutex);
+	bool retain = (flags & (STORAGE_PURGE_RETAIN_ANY | STORAGE_PURGE_RETAIN_ALL)) != 0;
+	unsigned long committed = m_committed.load();
+	long excess = m_count.load() - (long)rows;
+
+	unsigned long newTail = m_tail.load();
+	for (; newTail < committed && excess > 0; newTail++)
+	{
+		if (retain && newTail > sent)
+		{
+			break;
+		}
+		if (record(newTail))
+		{
+			excess--;
+		}
+	}
+
+	unsigned long unsentPurged = 0;
+	unsigned int removed = purgeTo(newTail, sent, unsentPurged);
+	purgeResult(removed, unsentPurged, sent, retain, results);
+	Logger::getLogger()->info("Purge by Rows complete: %s", results.c_str());
+	return removed;
+}
+
+/**
+ * Purge all the readings of an asset, or all readings
+ *
+ * @param asset		The asset name, if empty all readings are removed
+ * @return		The number of readings removed
+ */
+unsigned int ReadingRing::purgeReadingsAsset(const string& asset)
+{
+	lock_guard<mutex> guard(m_purgeMutex);
+	unsigned long unsentPurged = 0;
+
+	if (asset.empty())
+	{
+		return purgeTo(m_committed.load(), 0, unsentPurged);
+	}
+
+	const RingAsset *entry = findAsset(asset);
+	if (!entry)
+	{
+		return 0;
+	}
+
+	unsigned int removed = 0;
+	unsigned long tail = m_tail.load();
+	unsigned long id = entry->m_last.load(memory_order_acquire);
+	while (id >= tail && id != 0)
+	{
+		RecordPtr r = waitRecord(id);
+		if (!r)
+		{
+			break;
+		}
+		id = r->m_prevAsset;
+		RecordPtr *slot = &m_slots[r->m_id % m_capacity];
+		if (atomic_compare_exchange_strong(slot, &r, RecordPtr()))
+		{
+			removed++;
+		}
+	}
+	m_count -= removed;
+	return removed;
+}
+
+/**
+ * Write the readings held in the ring to a snapshot file. The snapshot
+ * is written to a temporary file that replaces the previous snapshot
+ * once it is complete.
+ *
+ * The snapshot uses the layout of the binary reading fetch block, a
+ * header followed by a RDSFetchReadingHeader, the asset name and the
+ * payload of each reading.
+ *
+ * @param path	The snapshot file
+ * @return	True if the snapshot was written
+ */
+bool ReadingRing::saveSnapshot(const string& path)
+{
+	string tmpPath = path + ".tmp";
+	FILE *fp = fopen(tmpPath.c_str(), "w");
+	if (!fp)
+	{
+		Logger::getLogger()->error("Unable to create readings snapshot %s: %s",
+				tmpPath.c_str(), strerror(errno));
+		return false;
+	}
+
+	RDSFetchHeader hdr;
+	hdr.magic = RING_SNAPSHOT_MAGIC;
+	hdr.count = 0;
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+
+	unsigned long committed = m_committed.load();
+	for (unsigned long id = m_tail.load(); ok && id < committed; id++)
+	{
+		RecordPtr r = record(id);
+		if (!r)
+		{
+			continue;
+		}
+		RDSFetchReadingHeader rhdr;
+		rhdr.id = r->m_id;
+		rhdr.userTsSec = r->m_userTs.tv_sec;
+		rhdr.userTsUsec = r->m_userTs.tv_usec;
+		rhdr.tsSec = r->m_ts.tv_sec;
+		rhdr.tsUsec = r->m_ts.tv_usec;
+		rhdr.assetLength = r->m_asset->m_name.length();
+		rhdr.payloadLength = r->m_payload.length();
+		ok = fwrite(&rhdr, sizeof(rhdr), 1, fp) == 1 &&
+			fwrite(r->m_asset->m_name.data(), 1, rhdr.assetLength, fp) == rhdr.assetLength &&
+			fwrite(r->m_payload.data(), 1, rhdr.payloadLength, fp) == rhdr.payloadLength;
+		hdr.count++;
+	}
+	ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+	ok = (fclose(fp) == 0) && ok;
+
+	if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		Logger::getLogger()->error("Unable to write readings snapshot %s: %s",
+				path.c_str(), strerror(errno));
+		unlink(tmpPath.c_str());
+		return false;
+	}
+	Logger::getLogger()->debug("Readings snapshot of %u readings written", hdr.count);
+	return true;
+}
+
+/**
+ * Load the readings of a snapshot into an empty ring
+ *
+ * @param path	The snapshot file
+ * @return	True if a snapshot was loaded
+ */
+bool ReadingRing::loadSnapshot(const string& path)
+{
+	FILE *fp = fopen(path.c_str(), "r");
+	if (!fp)
+	{
+		return false;
+	}
+
+	// The counts and lengths in the snapshot are checked against the
+	// size of the file before any memory is allocated for them
+	struct stat st;
+	RDSFetchHeader hdr;
+	if (fstat(fileno(fp), &st) != 0 || fread(&hdr, sizeof(hdr), 1, fp) != 1
+			|| hdr.magic != RING_SNAPSHOT_MAGIC
+			|| hdr.count > (st.st_size - sizeof(hdr)) / sizeof(RDSFetchReadingHeader))
+	{
+		Logger::getLogger()->error("Readings snapshot %s is not valid", path.c_str());
+		fclose(fp);
+		return false;
+	}
+
+	vector<RingRecord *> records;
+	const RingAsset *last = NULL;
+	string name;
+	bool valid = true;
+	for (uint32_t i = 0; i < hdr.count; i++)
+	{
+		RDSFetchReadingHeader rhdr;
+		if (fread(&rhdr, sizeof(rhdr), 1, fp) != 1)
+			break;
+		long offset = ftell(fp);
+		if (offset < 0 || (uint64_t)rhdr.assetLength + rhdr.payloadLength > (uint64_t)(st.st_size - offset))
+		{
+			valid = false;
+			break;
+		}
+		name.resize(rhdr.assetLength);
+		RingRecord *record = new RingRecord();
+		record->m_payload.resize(rhdr.payloadLength);
+		if (fread(&name[0], 1, rhdr.assetLength, fp) != rhdr.assetLength ||
+		    fread(&record->m_payload[0], 1, rhdr.payloadLength, fp) != rhdr.payloadLength)
+		{
+			delete record;
+			break;
+		}
+		record->m_id = rhdr.id;
+		record->m_userTs.tv_sec = rhdr.userTsSec;
+		record->m_userTs.tv_usec = rhdr.userTsUsec;
+		record->m_ts.tv_sec = rhdr.tsSec;
+		record->m_ts.tv_usec = rhdr.tsUsec;
+		if (!last || last->m_name.compare(name) != 0)
+		{
+			last = asset(name);
+		}
+		record->m_asset = last;
+		records.push_back(record);
+	}
+	fclose(fp);
+
+	if (!valid)
+	{
+		Logger::getLogger()->error("Readings snapshot %s is not valid", path.c_str());
+		for (RingRecord *record : records)
+			delete record;
+		return false;
+	}
+	if (records.empty())
+	{
+		return false;
+	}
+
+	// Keep the reading ids, so north services continue from where they were
+	unsigned long next = records.back()->m_id + 1;
+	unsigned long tail = max(records.front()->m_id,
+				next > m_capacity ? next - m_capacity : 1UL);
+	long count = 0;
+	for (RingRecord *record : records)
+	{
+		if (record->m_id < tail)
+		{
+			delete record;
+			continue;
+		}
+		record->m_prevAsset = record->m_asset->m_last.load(memory_order_relaxed);
+		record->m_asset->m_last.store(record->m_id, memory_order_release);
+		atomic_store(&m_slots[record->m_id % m_capacity], RecordPtr(record));
+		count++;
+	}
+	m_tail = tail;
+	m_next = next;
+	m_committed = next;
+	m_count = count;
+
+	Logger::getLogger()->info("Loaded %ld readings from snapshot %s", count, path.c_str());
+	return true;
+}
+
+/**
+ * Thread that periodically writes a snapshot of the ring
+ */
+void ReadingRing::snapshotThread()
+{
+	unique_lock<mutex> lck(m_snapshotMutex);
+	while (!m_shutdown)
+	{
+		m_snapshotCV.wait_for(lck, chrono::seconds(m_snapshotInterval));
+		if (m_shutdown)
+		{
+			break;
+		}
+		lck.unlock();
+		saveSnapshot(m_snapshotPath);
+		lck.lock();
+	}
+}
+
+/**
+ * Record the last error of the plugin
+ *
+ * @param operation	The operation that failed
+ * @param reason	printf style format of the failure reason
+ */
+void ReadingRing::raiseError(const char *operation, const char *reason, ...)
+{
+	char tmpbuf[512];
+
+	va_list ap;
+	va_start(ap, reason);
+	vsnprintf(tmpbuf, sizeof(tmpbuf), reason, ap);
+	va_end(ap);
+	Logger::getLogger()->error("Ring buffer storage plugin raising error: %s", tmpbuf);
+
+	lock_guard<mutex> guard(m_errorMutex);
+	free(m_lastError.entryPoint);
+	free(m_lastError.message);
+	m_lastError.retryable = false;
+	m_lastError.entryPoint = strdup(operation);
+	m_lastError.message = strdup(tmpbuf);
+}
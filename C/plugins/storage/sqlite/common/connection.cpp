@@ -627,6 +627,7 @@ Connection::Connection()
  */
 Connection::~Connection()
 {
+	clearStreamStatements();
 	sqlite3_close_v2(dbHandle);
 }
 
@@ -1191,7 +1192,7 @@ int Connection::insert(const string& schema, const string& table, const string&
 {
 Document	document;
 ostringstream convert;
-sqlite3_stmt *stmt;
+sqlite3_stmt *stmt = NULL;
 int rc;
 std::size_t arr = data.find("inserts");
 
@@ -1230,7 +1231,21 @@ std::size_t arr = data.find("inserts");
 	// Number of inserts
 	int ins = 0;
 	int failedInsertCount = 0;
-	
+	string prevQuery;
+
+	/*
+	 * All the rows of the inserts array are added in a single transaction,
+	 * the prepared statement is reused by consecutive rows that insert the
+	 * same set of columns.
+	 */
+	if (sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("insert", sqlite3_errmsg(dbHandle));
+		return -1;
+	}
+
+	m_writeAccessOngoing.fetch_add(1);
+
 	// Generate sql query for prepared statement
 	for (Value::ConstValueIterator iter = inserts.Begin();
 					iter != inserts.End();
@@ -1240,142 +1255,145 @@ std::size_t arr = data.find("inserts");
 		{
 			raiseError("insert",
 				   "Each entry in the insert array must be an object");
-			return -1;
+			failedInsertCount++;
+			break;
 		}
 
+		int col = 0;
+		SQLBuffer sql;
+		sql.append("INSERT INTO " + schema + "." + table + " (");
+
+		for (Value::ConstMemberIterator itr = (*iter).MemberBegin();
+						itr != (*iter).MemberEnd();
+						++itr)
 		{
-			int col = 0;
-			SQLBuffer sql;
-			SQLBuffer values;
-			sql.append("INSERT INTO " + schema + "." + table + " (");
-			
-			for (Value::ConstMemberIterator itr = (*iter).MemberBegin();
-							itr != (*iter).MemberEnd();
-							++itr)
+			// Append column name
+			if (col)
 			{
-				// Append column name
-				if (col)
-				{
-					sql.append(", ");
-				}
-				sql.append(itr->name.GetString());
-				col++;
+				sql.append(", ");
 			}
-			
-			sql.append(") VALUES (");
-			for ( auto i = 0 ; i < col; i++ )
+			sql.append(itr->name.GetString());
+			col++;
+		}
+
+		sql.append(") VALUES (");
+		for ( auto i = 0 ; i < col; i++ )
+		{
+			if (i) 
 			{
-				if (i) 
-				{
-					sql.append(",");
-				}
-				sql.append("?");
+				sql.append(",");
+			}
+			sql.append("?");
+		}
+		sql.append(");");
+
+		const char *query = sql.coalesce();
+
+		if (stmt == NULL || prevQuery.compare(query) != 0)
+		{
+			if (stmt)
+			{
+				sqlite3_finalize(stmt);
 			}
-			sql.append(");");
-			
-			const char *query = sql.coalesce();
-			
 			rc = sqlite3_prepare_v2(dbHandle, query, -1, &stmt, NULL);
 			if (rc != SQLITE_OK)
 			{
 				raiseError("insert", sqlite3_errmsg(dbHandle));
 				Logger::getLogger()->error("SQL statement: %s", query);
-				return -1;
+				delete[] query;
+				stmt = NULL;
+				failedInsertCount++;
+				break;
 			}
+			prevQuery = query;
+		}
+		delete[] query;
+
+		// Bind columns with prepared sql query
+		int columID = 1;
+		for (Value::ConstMemberIterator itr = (*iter).MemberBegin();
+						itr != (*iter).MemberEnd();
+						++itr)
+		{
 
-			// Bind columns with prepared sql query
-			int columID = 1;
-			for (Value::ConstMemberIterator itr = (*iter).MemberBegin();
-							itr != (*iter).MemberEnd();
-							++itr)
+			if (itr->value.IsString())
 			{
-				
-				if (itr->value.IsString())
-				{
-					const char *str = itr->value.GetString();
-					if (strcmp(str, "now()") == 0)
-					{
-						sqlite3_bind_text(stmt, columID, SQLITE3_NOW, -1, SQLITE_TRANSIENT);
-					}
-					else
-					{	
-						sqlite3_bind_text(stmt, columID, escape(str).c_str(), -1, SQLITE_TRANSIENT);
-					}
-				}
-				else if (itr->value.IsDouble()) {
-					sqlite3_bind_double(stmt, columID,itr->value.GetDouble());
-				}
-					
-				else if (itr->value.IsInt64())
-				{
-					sqlite3_bind_int(stmt, columID,(long)itr->value.GetInt64());
-				}
-					
-				else if (itr->value.IsInt())
+				const char *str = itr->value.GetString();
+				if (strcmp(str, "now()") == 0)
 				{
-					sqlite3_bind_int(stmt, columID,itr->value.GetInt());
+					sqlite3_bind_text(stmt, columID, SQLITE3_NOW, -1, SQLITE_TRANSIENT);
 				}
-					
-				else if (itr->value.IsObject())
-				{
-					StringBuffer buffer;
-					Writer<StringBuffer> writer(buffer);
-					itr->value.Accept(writer);
-					sqlite3_bind_text(stmt, columID, buffer.GetString(), -1, SQLITE_TRANSIENT);
+				else
+				{	
+					sqlite3_bind_text(stmt, columID, escape(str).c_str(), -1, SQLITE_TRANSIENT);
 				}
-				columID++ ;
 			}
-			
-			if (sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
-			{
-				raiseError("insert", sqlite3_errmsg(dbHandle));
-				return -1;
+			else if (itr->value.IsDouble()) {
+				sqlite3_bind_double(stmt, columID,itr->value.GetDouble());
 			}
 
-			m_writeAccessOngoing.fetch_add(1);
-			
-			int sqlite3_resut = SQLstep(stmt);
-			
-			m_writeAccessOngoing.fetch_sub(1);
-			
-			if (sqlite3_resut == SQLITE_DONE)
+			else if (itr->value.IsInt64())
 			{
-				sqlite3_clear_bindings(stmt);
-				sqlite3_reset(stmt);
+				sqlite3_bind_int64(stmt, columID, (sqlite3_int64)itr->value.GetInt64());
 			}
-			else
+
+			else if (itr->value.IsInt())
 			{
-				failedInsertCount++;
-				raiseError("insert", sqlite3_errmsg(dbHandle));
-				Logger::getLogger()->error("SQL statement: %s", sqlite3_expanded_sql(stmt));
-				
-				// transaction is still open, do rollback
-				if (sqlite3_get_autocommit(dbHandle) == 0)
-				{
-					rc = sqlite3_exec(dbHandle,"ROLLBACK TRANSACTION;",NULL,NULL,NULL);
-					if (rc != SQLITE_OK)
-					{
-						raiseError("insert rollback", sqlite3_errmsg(dbHandle));
-					}
-				
-				}
+				sqlite3_bind_int(stmt, columID,itr->value.GetInt());
 			}
-			
 
-			if (sqlite3_exec(dbHandle, "COMMIT TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+			else if (itr->value.IsObject())
 			{
-				raiseError("insert", sqlite3_errmsg(dbHandle));
-				return -1;
+				StringBuffer buffer;
+				Writer<StringBuffer> writer(buffer);
+				itr->value.Accept(writer);
+				sqlite3_bind_text(stmt, columID, buffer.GetString(), -1, SQLITE_TRANSIENT);
 			}
-		
-			delete[] query;
+			columID++ ;
+		}
+
+		if (SQLstep(stmt) == SQLITE_DONE)
+		{
+			sqlite3_clear_bindings(stmt);
+			sqlite3_reset(stmt);
+		}
+		else
+		{
+			failedInsertCount++;
+			raiseError("insert", sqlite3_errmsg(dbHandle));
+			Logger::getLogger()->error("SQL statement: %s", sqlite3_expanded_sql(stmt));
+			break;
 		}
+
 		// Increment row count
 		ins++;
-		
 	}
 
-	sqlite3_finalize(stmt);
+	if (stmt)
+	{
+		sqlite3_finalize(stmt);
+	}
+
+	if (!failedInsertCount && sqlite3_exec(dbHandle, "COMMIT TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("insert", sqlite3_errmsg(dbHandle));
+		failedInsertCount++;
+	}
+
+	if (failedInsertCount)
+	{
+		// transaction is still open, do rollback
+		if (sqlite3_get_autocommit(dbHandle) == 0)
+		{
+			rc = sqlite3_exec(dbHandle,"ROLLBACK TRANSACTION;",NULL,NULL,NULL);
+			if (rc != SQLITE_OK)
+			{
+				raiseError("insert rollback", sqlite3_errmsg(dbHandle));
+			}
+		}
+	}
+
+	m_writeAccessOngoing.fetch_sub(1);
 
 	if (m_writeAccessOngoing == 0)
 		db_cv.notify_all();
@@ -274,6 +274,61 @@ bool ConnectionManager::detachNewDb(std::string &alias)
 }
 
 
+/**
+ * Detach a removed database from all the connections, the connections that have
+ * not attached the database yet only have their request to attach it cancelled.
+ * The caller must hold the AttachDbSync lock.
+ *
+ * @param dbId  - database id of the removed database
+ * @param alias - alias of the database to detach
+ * @return      True if the database is no longer attached to any connection
+ */
+bool ConnectionManager::detachRemovedDb(int dbId, std::string &alias)
+{
+	int rc;
+	std::string sqlCmd;
+	bool result;
+	char *zErrMsg = NULL;
+
+	result = true;
+
+	sqlCmd = "DETACH  DATABASE " + alias + ";";
+
+	idleLock.lock();
+	inUseLock.lock();
+
+	for (auto conns : { &idle, &inUse })
+	{
+		for (auto conn : *conns)
+		{
+			if (conn->cancelUsedDbId(dbId))
+			{
+				Logger::getLogger()->debug("detachRemovedDb - attach request cancelled dbHandle :%X: db :%s:", conn->getDbHandle(), alias.c_str());
+				continue;
+			}
+
+			// Release the stream statements that use the database, those
+			// of a connection in use are released by the connection itself
+			if (conns == &idle)
+				conn->clearStreamStatements(dbId);
+			else
+				conn->setRemovedDbId(dbId);
+
+			rc = SQLExec (conn->getDbHandle(), sqlCmd.c_str(), &zErrMsg);
+			if (rc != SQLITE_OK)
+			{
+				Logger::getLogger()->error("detachRemovedDb - It was not possible to detach the db :%s: from a connection, error :%s:", alias.c_str(), zErrMsg);
+				sqlite3_free(zErrMsg);
+				result = false;
+			}
+		}
+	}
+	idleLock.unlock();
+	inUseLock.unlock();
+
+	return (result);
+}
+
 /**
  * Adds to all the connections a request to attach a database
  *
@@ -156,6 +156,9 @@ class Connection {
 
 		sqlite3		*getDbHandle() {return dbHandle;};
 		void		setUsedDbId(int dbId);
+		bool		cancelUsedDbId(int dbId);
+		void		setRemovedDbId(int dbId);
+		void		clearStreamStatements(int dbId = -1);
 
 		void		shutdownAppendReadings();
 		unsigned int	purgeReadingsAsset(const std::string& asset);
@@ -168,6 +171,11 @@ class Connection {
 		       		m_NewDbIdList;            // Newly created databases that should be attached
 
 		bool		m_streamOpenTransaction;
+		std::vector<int>
+				m_RemovedDbIdList;	// Removed databases whose cached statements should be finalized
+		std::map<std::pair<int, int>, sqlite3_stmt *>
+				m_streamStmts;		// Cached readingStream inserts, keyed by database and table id
+		sqlite3_stmt	*getStreamStatement(int dbId, int tableId);
 		int		m_queuing;
 		std::mutex	m_qMutex;
 		int		SQLPrepare(sqlite3 *dbHandle, const char *sqlCmd, sqlite3_stmt **readingsStmt);
@@ -31,6 +31,7 @@ class ConnectionManager {
 		bool                      attachNewDb(std::string &path, std::string &alias);
 		bool                      attachRequestNewDb(int newDbId, sqlite3 *dbHandle);
 		bool 					  detachNewDb(std::string &alias);
+		bool                      detachRemovedDb(int dbId, std::string &alias);
 		void                      release(Connection *);
 		void			  shutdown();
 		void			  setError(const char *, const char *, bool);
@@ -12,6 +12,7 @@
 
 #include "connection.h"
 #include <thread>
+#include <climits>
 
 /**
  * This class handles per thread started transaction boundaries:
@@ -37,6 +38,7 @@ class TransactionBoundary {
  * - nDbPreallocate            = Number of databases to allocate in advance
  * - nDbLeftFreeBeforeAllocate = Number of free databases before a new allocation is executed
  * - nDbToAllocate             = Number of database to allocate each time
+ * - partitionWindow           = Hours of readings held in each partition, 0 disables the partitioning
  *
  */
 typedef struct
@@ -46,6 +48,7 @@ typedef struct
 	int nDbPreallocate = 3;
 	int nDbLeftFreeBeforeAllocate = 1;
 	int nDbToAllocate = 2;
+	int partitionWindow = 0;
 
 } STORAGE_CONFIGURATION;
 
@@ -90,6 +93,12 @@ typedef struct
  *   as the connections are handled in pool and it is not defined which one will be allocated
  *   moreover all the operations are executed in parallel in multi threads
  *
+ * 2) When a partition window is configured the databases are grouped in time partitions.
+ *    At the end of each window the databases in use are sealed and every asset is moved to a new
+ *    readings table in a new database the next time it is stored. The tables of the sealed partitions
+ *    are recorded in m_SealedReadingCatalogue and are still considered by the queries, the purge
+ *    detaches and removes the databases of a sealed partition once all of its readings have expired.
+ *
  */
 class ReadingsCatalogue {
 
@@ -100,6 +109,8 @@ public:
 
 	} tyReadingReference;
 
+	typedef std::map<int, unsigned long> tyPartitionCounts;   // Number of readings per database id
+
 	static ReadingsCatalogue *getInstance()
 	{
 		static ReadingsCatalogue *instance = 0;
@@ -139,6 +150,11 @@ public:
 	bool          attachDbsToAllConnections();
 	std::string   sqlConstructMultiDb(std::string &sqlCmdBase, std::vector<std::string>  &assetCodes, bool considerExclusion=false);
 	int           purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBase, char **errMsg = NULL, unsigned long *rowsAffected = NULL);
+	bool          isPartitioned() const { return m_partitionWindow > 0; };
+	unsigned long purgePartitions(sqlite3 *dbHandle, unsigned long age, unsigned long sent, bool retain, unsigned long *unsentPurged);
+	void          getSealedReadingReferences(const std::string& asset, std::vector<tyReadingReference>& refs);
+	void          addPartitionReadings(const tyPartitionCounts& appended);
+	void          removePartitionReadings(int dbId, unsigned long count);
 
 	bool          connectionAttachAllDbs(sqlite3 *dbHandle);
 	bool          connectionAttachDbList(sqlite3 *dbHandle, std::vector<int> &dbIdList);
@@ -176,6 +192,8 @@ private:
 
 	} tyReadingsAvailable;
 
+	typedef std::vector<std::pair<std::string, std::pair<int, int>>> tyReadingTables;
+
 	ReadingsCatalogue(){};
 
 	bool          createNewDB(sqlite3 *dbHandle, int newDbId,  int startId, NEW_DB_OPERATION attachAllDb);
@@ -210,6 +228,13 @@ private:
 	int           calcMaxReadingUsed();
 	void          dropReadingsTables(sqlite3 *dbHandle, int dbId, int idStart, int idEnd);
 
+	void          getReadingTables(tyReadingTables& tables);
+	bool          isSealed(int dbId) const { return dbId < m_partitionStartDb; };
+	bool          partitionExpired() const;
+	void          rotatePartition();
+	bool          dropPartitionDb(sqlite3 *dbHandle, int dbId);
+	bool          getPartitionCount(int dbId, unsigned long& count);
+
 
 	int                                           m_dbIdCurrent;            // Current database in use
 	int                                           m_dbIdLast;               // Last database available not already in use
@@ -223,6 +248,16 @@ private:
 		// asset_code  - reading Table Id, Db Id
 		// {"",         ,{1               ,1 }}
 	};
+
+	int                                           m_partitionWindow = 0;    // Seconds of readings held in each partition, 0 if not partitioned
+	std::atomic<time_t>                           m_partitionStart{0};      // Time at which the current partition was started
+	std::atomic<int>                              m_partitionStartDb{0};    // First database of the current partition
+	std::multimap <std::string, std::pair<int, int>> m_SealedReadingCatalogue; // Readings tables of the sealed partitions
+	tyPartitionCounts                             m_partitionCounts;        // Readings stored in each database, counted as they are appended and purged
+	int                                           m_countsStartDb = INT_MAX; // First database whose readings have all been counted in m_partitionCounts
+	std::mutex                                    m_partitionMutex;         // Protects m_SealedReadingCatalogue, m_partitionCounts and m_AssetReadingCatalogue
+
+	friend class ReadingsPartitionTest;                                     // Expires the partition without waiting for the window
 public:
 	TransactionBoundary				m_tx;
 
@@ -13,7 +13,9 @@
 #include <connection_manager.h>
 #include <common.h>
 #include <reading_stream.h>
+#include <reading_stream_codec.h>
 #include <random>
+#include <stdexcept>
 #include <utils.h>
 
 #include <sys/stat.h>
@@ -36,7 +38,7 @@
 // Decode stream data
 #define	RDS_USER_TIMESTAMP(stream, x) 	stream[x]->userTs
 #define	RDS_ASSET_CODE(stream, x)		stream[x]->assetCode
-#define	RDS_PAYLOAD(stream, x)			&(stream[x]->assetCode[0]) + stream[x]->assetCodeLength
+#define	RDS_PAYLOAD(stream, x, json)		rdsPayload(stream[x], json)
 
 //#ifndef PLUGIN_LOG_NAME
 //#define PLUGIN_LOG_NAME "SQLite 3"
@@ -49,6 +51,36 @@
 using namespace std;
 using namespace rapidjson;
 
+/**
+ * Return the JSON datapoints of a streamed reading. Payloads sent using the
+ * binary encoding of the stream protocol are converted to JSON, the stored
+ * representation of the reading, JSON payloads are returned as they are.
+ *
+ * A malformed binary payload fails the whole block rather than storing
+ * a reading that has lost its datapoints.
+ *
+ * @param reading	The streamed reading
+ * @param json		Buffer for the converted payload
+ * @return		The JSON text of the datapoints
+ * @throws runtime_error	If the binary payload can not be decoded
+ */
+static const char *rdsPayload(ReadingStream *reading, string& json)
+{
+	const char *payload = &(reading->assetCode[0]) + reading->assetCodeLength;
+
+	if (!RDS_PAYLOAD_IS_BINARY(payload))
+	{
+		return payload;
+	}
+	if (!ReadingStreamCodec::toJSON(payload, reading->payloadLength, json))
+	{
+		Logger::getLogger()->error("Malformed binary payload streamed for asset %s",
+				reading->assetCode);
+		throw runtime_error("Malformed binary reading payload");
+	}
+	return json.c_str();
+}
+
 #define CONNECT_ERROR_THRESHOLD		5*60	// 5 minutes
 
 
@@ -384,14 +416,71 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 }
 #endif
 
+/**
+ * Return the prepared insert statement for the readings table of the
+ * given database and table. Statements are prepared the first time a
+ * table is used by the connection and then cached until the connection
+ * is closed or the database is removed, so that streamed blocks do not
+ * repeat the prepare.
+ *
+ * @param dbId		The database id of the readings table
+ * @param tableId	The id of the readings table within the database
+ * @return		The prepared statement or NULL on error
+ */
+sqlite3_stmt *Connection::getStreamStatement(int dbId, int tableId)
+{
+	sqlite3_stmt *&stmt = m_streamStmts[make_pair(dbId, tableId)];
+	if (stmt == nullptr)
+	{
+		ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+		string dbName = readCatalogue->generateDbName(dbId);
+		string dbReadingsName = readCatalogue->generateReadingsName(dbId, tableId);
+		string sql_cmd = "INSERT INTO  " + dbName + "." + dbReadingsName + " ( id, user_ts, reading ) VALUES  (?,?,?)";
+
+		if (SQLPrepare(dbHandle, sql_cmd.c_str(), &stmt) != SQLITE_OK)
+		{
+			raiseError("readingStream", sqlite3_errmsg(dbHandle));
+			sqlite3_finalize(stmt);
+			m_streamStmts.erase(make_pair(dbId, tableId));
+			return nullptr;
+		}
+	}
+	return stmt;
+}
+
+/**
+ * Finalize the cached stream insert statements. All the statements are
+ * discarded when a statement fails, so that they are prepared again
+ * against the current schema, only those of a database when it is removed.
+ *
+ * @param dbId	The database whose statements are finalized, -1 for all
+ */
+void Connection::clearStreamStatements(int dbId)
+{
+	for (auto item = m_streamStmts.begin(); item != m_streamStmts.end(); )
+	{
+		if (dbId == -1 || item->first.first == dbId)
+		{
+			sqlite3_finalize(item->second);
+			item = m_streamStmts.erase(item);
+		}
+		else
+		{
+			++item;
+		}
+	}
+}
+
 /**
  * Append a stream of readings to SQLite db
  *
+ * The readings are written to the per asset readings tables that the
+ * ReadingsCatalogue allocates across the attached databases, in the
+ * same way as appendReadings, using prepared statements that are
+ * cached in the connection.
+ *
  * @param readings  readings to store into the SQLite db
  * @param commit    if true a database commit is executed and a new transaction will be opened at the next execution
- *
- * TODO: the current code should be adapted to use the multi databases/tables implementation
- *
  */
 int Connection::readingStream(ReadingStream **readings, bool commit)
 {
@@ -406,15 +495,20 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 	const char *asset_code;
 	const char *payload;
 	string reading;
+	string json;
+	string lastAsset;
+	int dbId = -1;
 
 	// Retry mechanism
 	int retries = 0;
 	int sleep_time_ms = 0;
 
 	// SQLite related
-	sqlite3_stmt *stmt;
+	sqlite3_stmt *stmt = NULL;
 	int sqlite3_resut;
-	int rowNumber = -1;
+	int rowNumber = 0;
+	std::thread::id tid = std::this_thread::get_id();
+	ReadingsCatalogue::tyPartitionCounts appended;
 
 	if (m_noReadings)
 	{
@@ -422,9 +516,15 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		return 0;
 	}
 
-	ostringstream threadId;
-	threadId << std::this_thread::get_id();
+	if (m_shutdown)
+	{
+		Logger::getLogger()->debug("readingStream - plugin is shutting down, operation cancelled");
+		return -1;
+	}
+	m_appendCount++;
+
 	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+	bool partitioned = readCatalogue->isPartitioned();
 
 	{
 		// Attaches the needed databases if the queue is not empty
@@ -435,35 +535,27 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		{
 			readCatalogue->connectionAttachDbList(this->getDbHandle(), m_NewDbIdList);
 		}
+		for (int removedId : m_RemovedDbIdList)
+		{
+			clearStreamStatements(removedId);
+		}
+		m_RemovedDbIdList.clear();
 		attachSync->unlock();
 	}
 
 #if INSTRUMENT
-	struct timeval start, t1, t2, t3, t4, t5;
+	struct timeval start, t1, t2;
 #endif
 
-	// * TODO: the current code should be adapted to use the multi databases/tables implementation
-	const char *sql_cmd = "INSERT INTO  " READINGS_DB ".readings_1 ( asset_code, reading, user_ts ) VALUES  (?,?,?)";
-
-	if (sqlite3_prepare_v2(dbHandle, sql_cmd, strlen(sql_cmd), &stmt, NULL) != SQLITE_OK)
-	{
-		raiseError("readingStream", sqlite3_errmsg(dbHandle));
-		return -1;
-	}
-
 	// The handling of the commit parameter is overridden as using a pool of connections every execution receives
 	// a differen one, so a commit at every run is executed.
-	m_streamOpenTransaction = true;
 	commit = true;
 
-	if (m_streamOpenTransaction)
+	if (sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
 	{
-		if (sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
-		{
-			raiseError("readingStream", sqlite3_errmsg(dbHandle));
-			return -1;
-		}
-		m_streamOpenTransaction = false;
+		raiseError("readingStream", sqlite3_errmsg(dbHandle));
+		m_appendCount--;
+		return -1;
 	}
 
 #if INSTRUMENT
@@ -479,8 +571,31 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 			// Handles - asset_code
 			asset_code = RDS_ASSET_CODE(readings, i);
 
+			// A different asset, find the readings table it is stored in
+			if (i == 0 || lastAsset.compare(asset_code) != 0)
+			{
+				ReadingsCatalogue::tyReadingReference ref;
+
+				ref = readCatalogue->getReadingReference(this, asset_code);
+				if (ref.tableId == -1)
+				{
+					Logger::getLogger()->warn("readingStream - It was not possible to insert the row for the asset_code :%s: into the readings, row ignored.", asset_code);
+					stmt = NULL;
+				}
+				else
+				{
+					stmt = getStreamStatement(ref.dbId, ref.tableId);
+					dbId = ref.dbId;
+				}
+				lastAsset = asset_code;
+			}
+			if (stmt == NULL)
+			{
+				continue;
+			}
+
 			// Handles - reading
-			payload = RDS_PAYLOAD(readings, i);
+			payload = RDS_PAYLOAD(readings, i, json);
 			reading = escape(payload);
 
 			// Handles - user_ts
@@ -492,101 +607,84 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 			formatted_date[0] = {0};
 			strncat(ts, micro_s, 10);
 			user_ts = ts;
-			if (strcmp(user_ts, "now()") == 0)
+			if (!formatDate(formatted_date, sizeof(formatted_date), user_ts))
 			{
-				getNow(now);
-				user_ts = now.c_str();
+				raiseError("readingStream", "Invalid date |%s|", user_ts);
+				add_row = false;
 			}
 			else
 			{
-				if (!formatDate(formatted_date, sizeof(formatted_date), user_ts))
-				{
-					raiseError("appendReadings", "Invalid date |%s|", user_ts);
-					add_row = false;
-				}
-				else
-				{
-					user_ts = formatted_date;
-				}
+				user_ts = formatted_date;
 			}
 
 			if (add_row)
 			{
-				if (stmt != NULL)
+				unsigned long readingId = readCatalogue->getIncGlobalId();
+				if (rowNumber == 0)
 				{
-					sqlite3_bind_text(stmt, 1, asset_code,      -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 2, reading.c_str(), -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 3, user_ts,         -1, SQLITE_STATIC);
-
-					retries =0;
-					sleep_time_ms = 0;
-
-					// Retry mechanism in case SQLlite DB is locked
-					do {
-						// Insert the row using a lock to ensure one insert at time
-						{
-							m_writeAccessOngoing.fetch_add(1);
-							//unique_lock<mutex> lck(db_mutex);
-
-							sqlite3_resut = sqlite3_step(stmt);
-
-							m_writeAccessOngoing.fetch_sub(1);
-							//db_cv.notify_all();
-						}
+					// Mark transaction start for this thread
+					readCatalogue->m_tx.SetThreadTransactionStart(tid, readingId);
+				}
+				sqlite3_bind_int64(stmt, 1, readingId);
+				sqlite3_bind_text(stmt, 2, user_ts,         -1, SQLITE_STATIC);
+				sqlite3_bind_text(stmt, 3, reading.c_str(), -1, SQLITE_STATIC);
 
-						if (sqlite3_resut == SQLITE_LOCKED  )
-						{
-							sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
-							retries++;
+				retries =0;
+				sleep_time_ms = 0;
 
-							Logger::getLogger()->info("SQLITE_LOCKED - record :%d: - retry number :%d: sleep time ms :%d:",i, retries, sleep_time_ms);
+				// Retry mechanism in case SQLlite DB is locked
+				do {
+					m_writeAccessOngoing.fetch_add(1);
+					sqlite3_resut = sqlite3_step(stmt);
+					m_writeAccessOngoing.fetch_sub(1);
 
-							std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
-						}
-						if (sqlite3_resut == SQLITE_BUSY)
-						{
-							ostringstream threadId;
-							threadId << std::this_thread::get_id();
+					if (sqlite3_resut == SQLITE_LOCKED || sqlite3_resut == SQLITE_BUSY)
+					{
+						sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
+						retries++;
 
-							sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
-							retries++;
+						Logger::getLogger()->info("%s - asset_code :%s: record :%d: - retry number :%d: sleep time ms :%d:",
+								sqlite3_resut == SQLITE_LOCKED ? "SQLITE_LOCKED" : "SQLITE_BUSY",
+								asset_code, i, retries, sleep_time_ms);
 
-							Logger::getLogger()->info("SQLITE_BUSY - thread :%s: - record :%d: - retry number :%d: sleep time ms :%d:", threadId.str().c_str() ,i , retries, sleep_time_ms);
+						std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
+					}
+				} while (retries < PREP_CMD_MAX_RETRIES && (sqlite3_resut == SQLITE_LOCKED || sqlite3_resut == SQLITE_BUSY));
 
-							std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
-						}
-					} while (retries < PREP_CMD_MAX_RETRIES && (sqlite3_resut == SQLITE_LOCKED || sqlite3_resut == SQLITE_BUSY));
+				if (sqlite3_resut == SQLITE_DONE)
+				{
+					rowNumber++;
+					if (partitioned)
+						appended[dbId]++;
 
-					if (sqlite3_resut == SQLITE_DONE)
-					{
-						rowNumber++;
+					sqlite3_clear_bindings(stmt);
+					sqlite3_reset(stmt);
+				}
+				else
+				{
+					raiseError("readingStream",
+							   "Inserting a row into SQLIte using a prepared command - asset_code :%s: error :%s: reading :%s: ",
+							   asset_code,
+							   sqlite3_errmsg(dbHandle),
+							   reading.c_str());
 
-						sqlite3_clear_bindings(stmt);
-						sqlite3_reset(stmt);
-					}
-					else
-					{
-						raiseError("appendReadings",
-								   "Inserting a row into SQLIte using a prepared command - asset_code :%s: error :%s: reading :%s: ",
-								   asset_code,
-								   sqlite3_errmsg(dbHandle),
-								   reading.c_str());
-
-						sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
-						m_streamOpenTransaction = true;
-						return -1;
-					}
+					sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+					clearStreamStatements();
+					readCatalogue->m_tx.ClearThreadTransaction(tid);
+					m_appendCount--;
+					return -1;
 				}
 			}
 		}
-		rowNumber = i;
 
 	} catch (exception e) {
 
-		raiseError("appendReadings", "Inserting a row into SQLIte using a prepared command - error :%s:", e.what());
+		raiseError("readingStream", "Inserting a row into SQLIte using a prepared command - error :%s:", e.what());
 
 		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
-		m_streamOpenTransaction = true;
+		clearStreamStatements();
+		readCatalogue->m_tx.ClearThreadTransaction(tid);
+		m_appendCount--;
 		return -1;
 	}
 
@@ -599,27 +697,26 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		sqlite3_resut = sqlite3_exec(dbHandle, "END TRANSACTION", NULL, NULL, NULL);
 		if (sqlite3_resut != SQLITE_OK)
 		{
-			raiseError("appendReadings", "Executing the commit of the transaction - error :%s:", sqlite3_errmsg(dbHandle));
+			raiseError("readingStream", "Executing the commit of the transaction - error :%s:", sqlite3_errmsg(dbHandle));
 			rowNumber = -1;
 		}
-		m_streamOpenTransaction = true;
-	}
-
-	if(stmt != NULL)
-	{
-		if (sqlite3_finalize(stmt) != SQLITE_OK)
+		else if (! appended.empty())
 		{
-			raiseError("appendReadings","freeing SQLite in memory structure - error :%s:", sqlite3_errmsg(dbHandle));
+			readCatalogue->addPartitionReadings(appended);
 		}
 	}
 
+	// Clear transaction boundary for this thread
+	readCatalogue->m_tx.ClearThreadTransaction(tid);
+	m_appendCount--;
+
 #if INSTRUMENT
 	gettimeofday(&t2, NULL);
 #endif
 
 #if INSTRUMENT
 	struct timeval tm;
-	double timeT1, timeT2, timeT3;
+	double timeT1, timeT2;
 
 	timersub(&t1, &start, &tm);
 	timeT1 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
@@ -629,7 +726,7 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 
 	Logger::getLogger()->debug("readingStream row count :%d:", rowNumber);
 
-	Logger::getLogger()->debug("readingStream Timing - stream handling %.3f seconds - commit/finalize %.3f seconds",
+	Logger::getLogger()->debug("readingStream Timing - stream handling %.3f seconds - commit %.3f seconds",
 							   timeT1,
 							   timeT2
 	);
@@ -647,6 +744,35 @@ void Connection::setUsedDbId(int dbId) {
 	m_NewDbIdList.push_back(dbId);
 }
 
+/**
+ * Cancel the request to attach a database that has been removed
+ *
+ * @param dbId	Database id of the removed database
+ * @return	True if the database was waiting to be attached to the connection
+ */
+bool Connection::cancelUsedDbId(int dbId) {
+
+	auto item = std::find(m_NewDbIdList.begin(), m_NewDbIdList.end(), dbId);
+	if (item == m_NewDbIdList.end())
+		return false;
+
+	m_NewDbIdList.erase(item);
+	return true;
+}
+
+/**
+ * Request the cached statements of a removed database are finalized,
+ * this is done the next time the connection streams readings as the
+ * connection may be in use by another thread.
+ * The caller must hold the AttachDbSync lock.
+ *
+ * @param dbId	Database id of the removed database
+ */
+void Connection::setRemovedDbId(int dbId) {
+
+	m_RemovedDbIdList.push_back(dbId);
+}
+
 /**
  * Wait until all the threads executing the appendReadings are shutted down
  */
@@ -702,6 +828,8 @@ int sleep_time_ms = 0;
 int stmtArraySize;
 std::thread::id tid = std::this_thread::get_id();
 ostringstream threadId;
+int dbId = -1;
+ReadingsCatalogue::tyPartitionCounts appended;
 
 	if (m_noReadings)
 	{
@@ -871,6 +999,7 @@ ostringstream threadId;
 						}
 					}
 					stmt = readingsStmt[idxReadings];
+					dbId = ref.dbId;
 
 					lastAsset = asset_code;
 				}
@@ -964,6 +1093,8 @@ ostringstream threadId;
 				if (sqlite3_resut == SQLITE_DONE)
 				{
 					row++;
+					if (readCatalogue->isPartitioned())
+						appended[dbId]++;
 
 					sqlite3_clear_bindings(stmt);
 					sqlite3_reset(stmt);
@@ -997,6 +1128,10 @@ ostringstream threadId;
 				sqlite3_errmsg(dbHandle));
 		row = -1;
 	}
+	else if (! appended.empty())
+	{
+		readCatalogue->addPartitionReadings(appended);
+	}
 
 	// Clear transaction boundary for this thread
 	readCatalogue->m_tx.ClearThreadTransaction(tid);
@@ -1758,6 +1893,7 @@ unsigned long rowidLimit = 0, minrowidLimit = 0, maxrowidLimit = 0, rowidMin;
 struct timeval startTv, endTv;
 int blocks = 0;
 bool flag_retain;
+unsigned long partitionRows = 0, partitionUnsent = 0;
 
 vector<string>  assetCodes;
 
@@ -1801,6 +1937,27 @@ vector<string>  assetCodes;
 
 	logger->info("Purge starting...");
 	gettimeofday(&startTv, NULL);
+
+	/*
+	 * When the readings are partitioned the partitions that hold only
+	 * expired readings are removed as a whole, the row by row purge
+	 * below then only has to handle the partitions at the age boundary.
+	 */
+	if (readCatalogue->isPartitioned() && age != 0)
+	{
+		partitionRows = readCatalogue->purgePartitions(dbHandle, age, sent, flag_retain, &partitionUnsent);
+		if (partitionRows > 0)
+		{
+			ostringstream convert;
+
+			convert << "{ \"removed\" : " << partitionRows << ", ";
+			convert << " \"unsentPurged\" : " << (sent == 0 ? partitionRows : partitionUnsent) << ", ";
+			convert << " \"unsentRetained\" : 0, ";
+			convert << " \"readings\" : 0 }";
+
+			result = convert.str();
+		}
+	}
 	/*
 	 * We fetch the current rowid and limit the purge process to work on just
 	 * those rows present in the database when the purge process started.
@@ -1984,7 +2141,7 @@ vector<string>  assetCodes;
 		if (l == r)
 		{
  			logger->info("No data to purge: min_id == max_id == %u", minrowidLimit);
-			return 0;
+			return partitionRows;
 		}
 
 		unsigned long m=l;
@@ -2067,7 +2224,7 @@ vector<string>  assetCodes;
 		if (minrowidLimit == rowidLimit)
 		{
 			logger->info("No data to purge");
-			return 0;
+			return partitionRows;
 		}
 
 		rowidMin = minrowidLimit;
@@ -2236,6 +2393,10 @@ vector<string>  assetCodes;
 
 	numReadings = maxrowidLimit +1 - minrowidLimit - deletedRows;
 
+	// Readings removed with the expired partitions
+	deletedRows += partitionRows;
+	unsentPurged += partitionUnsent;
+
 	if (sent == 0)	// Special case when not north process is used
 	{
 		unsentPurged = deletedRows;
@@ -2633,24 +2794,33 @@ sqlite3_stmt *stmt;
 	}
 	else
 	{
-		ReadingsCatalogue::tyReadingReference ref;
-		ref = readCat->getReadingReference(this, asset.c_str());
-		string dbReadingsName;
-		string dbName;
+		vector<ReadingsCatalogue::tyReadingReference> refs;
+		refs.push_back(readCat->getReadingReference(this, asset.c_str()));
 
-		string query = "DELETE FROM " + readCat->generateDbName(ref.dbId);
-		query += "." + readCat->generateReadingsName(ref.dbId, ref.tableId) + ";";
+		// The asset may also have readings in the sealed partitions
+		readCat->getSealedReadingReferences(asset, refs);
 
-		// Execute SQL statement via SQLExec wrapper
-		rc = readCat->SQLExec(dbHandle, query.c_str(), &zErrMsg);
-		if (rc != SQLITE_OK)
+		unsigned int removed = 0;
+		for (auto &ref : refs)
 		{
-			raiseError("ReadingsAssetPurge", sqlite3_errmsg(dbHandle));
-			sqlite3_free(zErrMsg);
-			return 0;
-		}
+			string query = "DELETE FROM " + readCat->generateDbName(ref.dbId);
+			query += "." + readCat->generateReadingsName(ref.dbId, ref.tableId) + ";";
+
+			// Execute SQL statement via SQLExec wrapper
+			rc = readCat->SQLExec(dbHandle, query.c_str(), &zErrMsg);
+			if (rc != SQLITE_OK)
+			{
+				raiseError("ReadingsAssetPurge", sqlite3_errmsg(dbHandle));
+				sqlite3_free(zErrMsg);
+				return 0;
+			}
 
-		// Get numbwer of affected rows
-                return (unsigned int)sqlite3_changes(dbHandle);
+			// Get numbwer of affected rows
+			unsigned int changes = (unsigned int)sqlite3_changes(dbHandle);
+			removed += changes;
+			if (readCat->isPartitioned())
+				readCat->removePartitionReadings(ref.dbId, changes);
+		}
+		return removed;
 	}
 }
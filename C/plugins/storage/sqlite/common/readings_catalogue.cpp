@@ -249,7 +249,9 @@ int ReadingsCatalogue::calculateGlobalId (sqlite3 *dbHandle)
 		)";
 
 		bool firstRow = true;
-		if (m_AssetReadingCatalogue.empty())
+		tyReadingTables tables;
+		getReadingTables(tables);
+		if (tables.empty())
 		{
 			string dbReadingsName = generateReadingsName(1, 1);
 
@@ -257,7 +259,7 @@ int ReadingsCatalogue::calculateGlobalId (sqlite3 *dbHandle)
 		}
 		else
 		{
-			for (auto &item : m_AssetReadingCatalogue)
+			for (auto &item : tables)
 			{
 				if (!firstRow)
 				{
@@ -328,7 +330,9 @@ int ReadingsCatalogue::getMinGlobalId (sqlite3 *dbHandle)
 		)";
 
 		bool firstRow = true;
-		if (m_AssetReadingCatalogue.empty())
+		tyReadingTables tables;
+		getReadingTables(tables);
+		if (tables.empty())
 		{
 			string dbReadingsName = generateReadingsName(1, 1);
 
@@ -336,7 +340,7 @@ int ReadingsCatalogue::getMinGlobalId (sqlite3 *dbHandle)
 		}
 		else
 		{
-			for (auto &item : m_AssetReadingCatalogue)
+			for (auto &item : tables)
 			{
 				if (!firstRow)
 				{
@@ -404,7 +408,7 @@ bool  ReadingsCatalogue::loadAssetReadingCatalogue()
 			db_id,
 			asset_code
 		FROM  )" READINGS_DB R"(.asset_reading_catalogue
-		ORDER BY table_id;
+		ORDER BY db_id, table_id;
 	)";
 
 
@@ -431,8 +435,18 @@ bool  ReadingsCatalogue::loadAssetReadingCatalogue()
 			Logger::getLogger()->debug("loadAssetReadingCatalogue - thread :%s: reading Id :%d: dbId :%d: asset name :%s: max db Id :%d:", threadId.str().c_str(), tableId, dbId,  asset_name, maxDbID);
 
 			auto newItem = make_pair(tableId,dbId);
-			auto newMapValue = make_pair(asset_name,newItem);
-			m_AssetReadingCatalogue.insert(newMapValue);
+			auto existing = m_AssetReadingCatalogue.find(asset_name);
+			if (existing != m_AssetReadingCatalogue.end())
+			{
+				// The asset has moved to a later partition, the earlier table belongs to a sealed one
+				m_SealedReadingCatalogue.insert(make_pair(string(asset_name), existing->second));
+				existing->second = newItem;
+			}
+			else
+			{
+				auto newMapValue = make_pair(asset_name,newItem);
+				m_AssetReadingCatalogue.insert(newMapValue);
+			}
 
 		}
 
@@ -486,6 +500,14 @@ void ReadingsCatalogue::prepareAllDbs() {
 		// Following runs - attaches all the databases
 		for (dbId = 2; dbId <= m_dbIdLast ; dbId++ )
 		{
+			struct stat st;
+
+			// The databases of the purged partitions no longer exist
+			if (isPartitioned() && stat(generateDbFilePah(dbId).c_str(), &st) != 0)
+			{
+				Logger::getLogger()->debug("prepareAllDbs - database :%d: removed by the partition purge", dbId);
+				continue;
+			}
 			m_dbIdList.push_back(dbId);
 		}
 		attachDbsToAllConnections();
@@ -533,7 +555,9 @@ void ReadingsCatalogue::getAllDbs(vector<int> &dbIdList) {
 
 	Logger::getLogger()->debug("getAllDbs - used db");
 
-	for (auto &item : m_AssetReadingCatalogue) {
+	tyReadingTables tables;
+	getReadingTables(tables);
+	for (auto &item : tables) {
 
 		dbId = item.second.second;
 		if (dbId > 1)
@@ -823,6 +847,13 @@ void ReadingsCatalogue::multipleReadingsInit(STORAGE_CONFIGURATION &storageConfi
 	m_storageConfigCurrent.nDbLeftFreeBeforeAllocate = storageConfig.nDbLeftFreeBeforeAllocate;
 	m_storageConfigCurrent.nDbToAllocate = storageConfig.nDbToAllocate;
 
+	if (storageConfig.partitionWindow < 0)
+	{
+		Logger::getLogger()->warn("%s - parameter partitionWindow not valid, use a value >= 0, 0 used ", __FUNCTION__);
+		storageConfig.partitionWindow = 0;
+	}
+	m_partitionWindow = storageConfig.partitionWindow * 3600;
+
 	try
 	{
 		configurationRetrieve(dbHandle);
@@ -849,6 +880,15 @@ void ReadingsCatalogue::multipleReadingsInit(STORAGE_CONFIGURATION &storageConfi
 		preallocateReadingsTables(0);   // on the last database
 
 		evaluateGlobalId();
+
+		// The time the current partition started is not known after a restart, a new one is started
+		if (isPartitioned())
+		{
+			rotatePartition();
+
+			// The readings of the databases used before the restart have not been counted
+			m_countsStartDb = m_partitionStartDb;
+		}
 	}
 	catch (exception& e)
 	{
@@ -1826,14 +1866,26 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 
 	Logger *logger = Logger::getLogger();
 
-	auto item = m_AssetReadingCatalogue.find(asset_code);
-	if (item != m_AssetReadingCatalogue.end())
+	// With partitioning the catalogue is changed under m_partitionMutex by rotatePartition
+	// and dropPartitionDb. Without it the fast path needs no lock, which keeps the
+	// appends of different connections apart.
+	bool managed = false;
 	{
-		//# An asset already  managed
-		ref.tableId = item->second.first;
-		ref.dbId = item->second.second;
+		unique_lock<mutex> guard(m_partitionMutex, defer_lock);
+		if (isPartitioned())
+		{
+			guard.lock();
+		}
+		auto item = m_AssetReadingCatalogue.find(asset_code);
+		if (item != m_AssetReadingCatalogue.end() && ! isSealed(item->second.second) && ! partitionExpired())
+		{
+			//# An asset already  managed
+			ref.tableId = item->second.first;
+			ref.dbId = item->second.second;
+			managed = true;
+		}
 	}
-	else
+	if (! managed)
 	{
 		Logger::getLogger()->debug("getReadingReference - before lock dbHandle :%X: threadId :%s:", dbHandle, threadId.str().c_str() );
 
@@ -1841,8 +1893,13 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 		attachSync->lock();
 		ReadingsCatalogue::tyReadingReference emptyTableReference = {-1, -1};
 
+		if (partitionExpired())
+		{
+			rotatePartition();
+		}
+
 		auto item = m_AssetReadingCatalogue.find(asset_code);
-		if (item != m_AssetReadingCatalogue.end())
+		if (item != m_AssetReadingCatalogue.end() && ! isSealed(item->second.second))
 		{
 			ref.tableId = item->second.first;
 			ref.dbId = item->second.second;
@@ -1915,9 +1972,10 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 							ref.dbId = m_dbIdCurrent;
 						}
 						
-						auto newItem = make_pair(ref.tableId, ref.dbId);
-						auto newMapValue = make_pair(asset_code, newItem);
-						m_AssetReadingCatalogue.insert(newMapValue);
+						// An asset of a sealed partition is moved to the new table,
+						// the sealed table is already in m_SealedReadingCatalogue
+						lock_guard<mutex> guard(m_partitionMutex);
+						m_AssetReadingCatalogue[asset_code] = make_pair(ref.tableId, ref.dbId);
 					}
 
 					Logger::getLogger()->debug("getReadingReference - allocate a new reading table for the asset :%s: db Id :%d: readings Id :%d: ", asset_code, ref.dbId, ref.tableId);
@@ -2104,7 +2162,9 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
 	bool firstRow;
 	int rc;
 
-	if (m_AssetReadingCatalogue.empty())
+	tyReadingTables tables;
+	getReadingTables(tables);
+	if (tables.empty())
 	{
 		Logger::getLogger()->debug("purgeAllReadings: no tables defined");
 		rc = SQLITE_OK;
@@ -2120,7 +2180,7 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
 		if  (rowsAffected != nullptr)
 			*rowsAffected = 0;
 
-		for (auto &item : m_AssetReadingCatalogue)
+		for (auto &item : tables)
 		{
 			if (exclusions && purgeConfig->isExcluded(item.first))
 			{
@@ -2147,9 +2207,14 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
 				sqlite3_free(zErrMsg);
 				break;
 			}
+			unsigned long changes = (unsigned long) sqlite3_changes(dbHandle);
 			if  (rowsAffected != nullptr) {
 
-				*rowsAffected += (unsigned long ) sqlite3_changes(dbHandle);
+				*rowsAffected += changes;
+			}
+			if (isPartitioned())
+			{
+				removePartitionReadings(item.second.second, changes);
 			}
 
 		}
@@ -2180,7 +2245,9 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 	bool addTable;
 	bool addedOne;
 
-	if (m_AssetReadingCatalogue.empty())
+	tyReadingTables tables;
+	getReadingTables(tables);
+	if (tables.empty())
 	{
 		Logger::getLogger()->debug("sqlConstructMultiDb: no tables defined");
 		sqlCmd = sqlCmdBase;
@@ -2202,7 +2269,7 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 		PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
 		bool exclusions = purgeConfig->hasExclusions();
 
-		for (auto &item : m_AssetReadingCatalogue)
+		for (auto &item : tables)
 		{
 			assetCode=item.first;
 			addTable = false;
@@ -2261,6 +2328,372 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 }
 
 
+/**
+ * Returns the readings tables in use, the tables of the current partition
+ * followed by the tables of the sealed partitions
+ *
+ * @param tables  returned by reference, asset code, table id and database id of each table
+ *
+ */
+void ReadingsCatalogue::getReadingTables(tyReadingTables& tables)
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+
+	tables.reserve(m_AssetReadingCatalogue.size() + m_SealedReadingCatalogue.size());
+	for (auto &item : m_AssetReadingCatalogue)
+	{
+		// Assets not stored since the partition was sealed are held in m_SealedReadingCatalogue
+		if (! isSealed(item.second.second))
+			tables.push_back(item);
+	}
+	for (auto &item : m_SealedReadingCatalogue)
+	{
+		tables.push_back(item);
+	}
+}
+
+/**
+ * Returns the readings tables of the sealed partitions that hold readings of the given asset
+ *
+ * @param asset  Asset code for which the tables must be returned
+ * @param refs   returned by reference, the tables are appended to the list
+ *
+ */
+void ReadingsCatalogue::getSealedReadingReferences(const string& asset, vector<tyReadingReference>& refs)
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+
+	auto range = m_SealedReadingCatalogue.equal_range(asset);
+	for (auto item = range.first; item != range.second; ++item)
+	{
+		tyReadingReference ref;
+		ref.tableId = item->second.first;
+		ref.dbId = item->second.second;
+		refs.push_back(ref);
+	}
+}
+
+/**
+ * Records the readings appended to the databases by a committed block, the counts
+ * are used when a partition is removed rather than counting the rows of its tables
+ *
+ * @param appended  Number of readings appended to each database
+ *
+ */
+void ReadingsCatalogue::addPartitionReadings(const tyPartitionCounts& appended)
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+
+	for (auto &item : appended)
+	{
+		m_partitionCounts[item.first] += item.second;
+	}
+}
+
+/**
+ * Records the readings of a database removed by a purge
+ *
+ * @param dbId   Database id from which the readings have been removed
+ * @param count  Number of readings removed
+ *
+ */
+void ReadingsCatalogue::removePartitionReadings(int dbId, unsigned long count)
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+
+	auto item = m_partitionCounts.find(dbId);
+	if (item != m_partitionCounts.end())
+	{
+		item->second -= std::min(count, item->second);
+	}
+}
+
+/**
+ * Returns the number of readings held by a database, if all of them have been counted
+ *
+ * @param dbId   Database id
+ * @param count  returned by reference, number of readings in the database
+ * @return       True if the readings of the database have been counted
+ *
+ */
+bool ReadingsCatalogue::getPartitionCount(int dbId, unsigned long& count)
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+
+	if (dbId < m_countsStartDb)
+	{
+		return false;
+	}
+	auto item = m_partitionCounts.find(dbId);
+	count = item != m_partitionCounts.end() ? item->second : 0;
+	return true;
+}
+
+/**
+ * Checks if the time window of the current partition has elapsed
+ *
+ * @return  True if a new partition must be started
+ */
+bool ReadingsCatalogue::partitionExpired() const
+{
+	return m_partitionWindow > 0 && time(NULL) >= m_partitionStart + m_partitionWindow;
+}
+
+/**
+ * Seals the current partition and starts a new one, the caller must hold the AttachDbSync lock.
+ *
+ * The tables in use are recorded as sealed and the next table allocation will use a new database,
+ * the assets are moved to the new partition the next time they are stored.
+ *
+ */
+void ReadingsCatalogue::rotatePartition()
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+
+	for (auto &item : m_AssetReadingCatalogue)
+	{
+		if (! isSealed(item.second.second))
+			m_SealedReadingCatalogue.insert(item);
+	}
+	m_partitionStartDb = m_dbIdCurrent + 1;
+	m_partitionStart = time(NULL);
+	m_nReadingsAvailable = 0;
+
+	Logger::getLogger()->info("Started a new readings partition from database :%d:, sealed tables :%d:", m_partitionStartDb.load(), m_SealedReadingCatalogue.size());
+}
+
+/**
+ * Removes the sealed partitions that only hold readings older than the given age,
+ * the databases of the partitions are detached and deleted rather than the readings
+ * being deleted row by row.
+ *
+ * @param dbHandle      Database connection to use for the operations
+ * @param age           Age in hours of the readings to purge
+ * @param sent          Last reading id sent by the north
+ * @param retain        True if the unsent readings must be retained
+ * @param unsentPurged  returned by reference, number of unsent readings removed
+ * @return              Number of readings removed
+ *
+ */
+unsigned long ReadingsCatalogue::purgePartitions(sqlite3 *dbHandle, unsigned long age, unsigned long sent, bool retain, unsigned long *unsentPurged)
+{
+	unsigned long removed = 0;
+	sqlite3_stmt *stmt;
+
+	*unsentPurged = 0;
+	if (! isPartitioned() || age == 0)
+	{
+		return 0;
+	}
+
+	// Seals the current partition even if no readings have been stored since it expired
+	{
+		AttachDbSync *attachSync = AttachDbSync::getInstance();
+		attachSync->lock();
+		if (partitionExpired())
+		{
+			rotatePartition();
+		}
+		attachSync->unlock();
+	}
+
+	// Groups the tables of the sealed partitions by database
+	map<int, vector<string>> partitions;
+	vector<int> excluded;
+	{
+		PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
+		bool exclusions = purgeConfig->hasExclusions();
+
+		lock_guard<mutex> guard(m_partitionMutex);
+		for (auto &item : m_SealedReadingCatalogue)
+		{
+			int dbId = item.second.second;
+
+			// The first database holds the catalogue and it is never removed
+			if (dbId == 1 || ! isSealed(dbId))
+				continue;
+
+			if (exclusions && purgeConfig->isExcluded(item.first))
+				excluded.push_back(dbId);
+
+			partitions[dbId].push_back(generateDbName(dbId) + "." + generateReadingsName(dbId, item.second.first));
+		}
+	}
+
+	for (auto &partition : partitions)
+	{
+		int dbId = partition.first;
+		string tables;
+
+		if (std::find(excluded.begin(), excluded.end(), dbId) != excluded.end())
+		{
+			Logger::getLogger()->info("Partition database :%d: holds assets excluded from purge, it is purged row by row", dbId);
+			continue;
+		}
+
+		for (auto &table : partition.second)
+		{
+			if (! tables.empty())
+				tables += " UNION ALL ";
+			tables += " SELECT MAX(id) id, MAX(user_ts) user_ts FROM " + table + " ";
+		}
+
+		// Only the newest reading of each table is evaluated to decide if the partition has expired
+		string sql_cmd = "SELECT IFNULL(MAX(id), 0), IFNULL(MAX(user_ts) < datetime('now' , '-" + to_string(age) + " hours'), 1) FROM (" + tables + ");";
+
+		unsigned long maxId = 0;
+		bool expired = false;
+		if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("purgePartitions", sqlite3_errmsg(dbHandle));
+			break;
+		}
+		if (SQLStep(stmt) == SQLITE_ROW)
+		{
+			maxId = (unsigned long)sqlite3_column_int64(stmt, 0);
+			expired = sqlite3_column_int(stmt, 1) != 0;
+		}
+		sqlite3_finalize(stmt);
+
+		if (! expired || (retain && maxId > sent))
+		{
+			Logger::getLogger()->debug("purgePartitions - partition database :%d: retained, expired :%d: max id :%lu:", dbId, expired, maxId);
+			continue;
+		}
+
+		// The readings appended since the restart have been counted, only the unsent ones
+		// are counted here using the primary key. The databases used before the restart
+		// are counted row by row.
+		unsigned long count = 0, unsent = 0;
+		bool counted = getPartitionCount(dbId, count);
+		if (! counted || maxId > sent)
+		{
+			tables.clear();
+			for (auto &table : partition.second)
+			{
+				if (! tables.empty())
+					tables += " UNION ALL ";
+				if (counted)
+					tables += " SELECT id FROM " + table + " WHERE id > " + to_string(sent) + " ";
+				else
+					tables += " SELECT id FROM " + table + " ";
+			}
+			if (counted)
+				sql_cmd = "SELECT 0, COUNT(*) FROM (" + tables + ");";
+			else
+				sql_cmd = "SELECT COUNT(*), IFNULL(SUM(id > " + to_string(sent) + "), 0) FROM (" + tables + ");";
+
+			if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+			{
+				raiseError("purgePartitions", sqlite3_errmsg(dbHandle));
+				break;
+			}
+			if (SQLStep(stmt) == SQLITE_ROW)
+			{
+				if (! counted)
+					count = (unsigned long)sqlite3_column_int64(stmt, 0);
+				unsent = (unsigned long)sqlite3_column_int64(stmt, 1);
+			}
+			sqlite3_finalize(stmt);
+		}
+
+		if (! dropPartitionDb(dbHandle, dbId))
+		{
+			break;
+		}
+
+		Logger::getLogger()->info("Purged partition database :%d: holding :%lu: readings", dbId, count);
+		removed += count;
+		if (sent != 0)
+			*unsentPurged += unsent;
+	}
+
+	return removed;
+}
+
+/**
+ * Removes the database of a sealed partition, the readings tables are removed
+ * from the catalogue before the database is detached from all the connections
+ * and its file deleted.
+ *
+ * @param dbHandle  Database connection to use for the operations
+ * @param dbId      Database id to remove
+ * @return          True of success, false on any error
+ *
+ */
+bool ReadingsCatalogue::dropPartitionDb(sqlite3 *dbHandle, int dbId)
+{
+	string sql_cmd;
+	string dbAlias;
+	string dbPath;
+
+	sql_cmd = "DELETE FROM " READINGS_DB ".asset_reading_catalogue WHERE db_id = " + to_string(dbId) + ";";
+	if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+	{
+		raiseError("dropPartitionDb", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	dbAlias = generateDbAlias(dbId);
+	dbPath  = generateDbFilePah(dbId);
+
+	Logger::getLogger()->debug("dropPartitionDb - db alias :%s: db path :%s:", dbAlias.c_str(), dbPath.c_str());
+
+	// The assets not stored since the partition was sealed still reference
+	// the database in m_AssetReadingCatalogue, they are allocated a new table
+	// the next time they are stored. Neither the new connections nor the ones
+	// with a pending attach request must attach the database again.
+	bool detached;
+	{
+		AttachDbSync *attachSync = AttachDbSync::getInstance();
+		attachSync->lock();
+		{
+			lock_guard<mutex> guard(m_partitionMutex);
+			for (auto item = m_SealedReadingCatalogue.begin(); item != m_SealedReadingCatalogue.end(); )
+			{
+				if (item->second.second == dbId)
+					item = m_SealedReadingCatalogue.erase(item);
+				else
+					++item;
+			}
+			for (auto item = m_AssetReadingCatalogue.begin(); item != m_AssetReadingCatalogue.end(); )
+			{
+				if (item->second.second == dbId)
+					item = m_AssetReadingCatalogue.erase(item);
+				else
+					++item;
+			}
+			m_partitionCounts.erase(dbId);
+		}
+		m_dbIdList.erase(std::remove(m_dbIdList.begin(), m_dbIdList.end(), dbId), m_dbIdList.end());
+
+		detached = ConnectionManager::getInstance()->detachRemovedDb(dbId, dbAlias);
+		attachSync->unlock();
+	}
+
+	if (! detached)
+	{
+		Logger::getLogger()->warn("dropPartitionDb - database :%s: is still attached to a connection, its space is released when the connection is closed", dbAlias.c_str());
+	}
+
+	try
+	{
+		dbFileDelete(dbPath);
+		if (detached)
+		{
+			remove((dbPath + "-wal").c_str());
+			remove((dbPath + "-shm").c_str());
+		}
+	}
+	catch (exception& e)
+	{
+		Logger::getLogger()->error("dropPartitionDb - %s", e.what());
+	}
+
+	return true;
+}
+
+
 /**
  * Generates a SQLIte db alis from the database id
  *
@@ -87,6 +87,14 @@ const char *default_config = QUOTE({
 			"default" : "6",
 			"displayName" : "Vacuum Interval",
 			"order" : "7"
+		},
+		"partitionWindow" : {
+			"description" : "The number of hours of readings held in each partition of readings databases, the purge process removes a partition as a whole once all its readings have expired. A value of 0 disables the partitioning",
+			"type" : "integer",
+			"minimum" : "0",
+			"default" : "0",
+			"displayName" : "Partition Window",
+			"order" : "8"
 		}
 
 });
@@ -97,7 +105,7 @@ const char *default_config = QUOTE({
 static PLUGIN_INFORMATION info = {
 	"SQLite3",                // Name
 	"1.2.0",                  // Version
-	SP_COMMON|SP_READINGS,    // Flags
+	SP_COMMON|SP_READINGS|SP_BINARY_STREAM,    // Flags
 	PLUGIN_TYPE_STORAGE,      // Type
 	"1.6.0",                  // Interface version
 	default_config
@@ -150,6 +158,11 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 		storageConfig.nDbToAllocate = strtol(category->getValue("nDbToAllocate").c_str(), NULL, 10);
 	}
 
+	if (category->itemExists("partitionWindow"))
+	{
+		storageConfig.partitionWindow = strtol(category->getValue("partitionWindow").c_str(), NULL, 10);
+	}
+
 	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
 	readCat->multipleReadingsInit(storageConfig);
 
@@ -13,7 +13,9 @@
 #include <connection_manager.h>
 #include <common.h>
 #include <reading_stream.h>
+#include <reading_stream_codec.h>
 #include <random>
+#include <stdexcept>
 
 // 1 enable performance tracking
 #define INSTRUMENT	0
@@ -45,7 +47,7 @@
 // Decode stream data
 #define	RDS_USER_TIMESTAMP(stream, x) 		stream[x]->userTs
 #define	RDS_ASSET_CODE(stream, x)		stream[x]->assetCode
-#define	RDS_PAYLOAD(stream, x)			&(stream[x]->assetCode[0]) + stream[x]->assetCodeLength
+#define	RDS_PAYLOAD(stream, x, json)		rdsPayload(stream[x], json)
 
 // Retry mechanism
 #define PREP_CMD_MAX_RETRIES		20	    // Maximum no. of retries when a lock is encountered
@@ -84,6 +86,36 @@
 using namespace std;
 using namespace rapidjson;
 
+/**
+ * Return the JSON datapoints of a streamed reading. Payloads sent using the
+ * binary encoding of the stream protocol are converted to JSON, the stored
+ * representation of the reading, JSON payloads are returned as they are.
+ *
+ * A malformed binary payload fails the whole block rather than storing
+ * a reading that has lost its datapoints.
+ *
+ * @param reading	The streamed reading
+ * @param json		Buffer for the converted payload
+ * @return		The JSON text of the datapoints
+ * @throws runtime_error	If the binary payload can not be decoded
+ */
+static const char *rdsPayload(ReadingStream *reading, string& json)
+{
+	const char *payload = &(reading->assetCode[0]) + reading->assetCodeLength;
+
+	if (!RDS_PAYLOAD_IS_BINARY(payload))
+	{
+		return payload;
+	}
+	if (!ReadingStreamCodec::toJSON(payload, reading->payloadLength, json))
+	{
+		Logger::getLogger()->error("Malformed binary payload streamed for asset %s",
+				reading->assetCode);
+		throw runtime_error("Malformed binary reading payload");
+	}
+	return json.c_str();
+}
+
 #define CONNECT_ERROR_THRESHOLD		5*60	// 5 minutes
 
 
@@ -406,6 +438,7 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 	const char *asset_code;
 	const char *payload;
 	string reading;
+	string json;
 
 	// Retry mechanism
 	int retries = 0;
@@ -474,7 +507,7 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 				asset_code = RDS_ASSET_CODE(readings, curReading);
 
 				// Handles - reading
-				payload = RDS_PAYLOAD(readings, curReading);
+				payload = RDS_PAYLOAD(readings, curReading, json);
 				reading = escape(payload);
 
 				// Handles - user_ts
@@ -585,7 +618,7 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 			asset_code = RDS_ASSET_CODE(readings, curReading);
 
 			// Handles - reading
-			payload = RDS_PAYLOAD(readings, curReading);
+			payload = RDS_PAYLOAD(readings, curReading, json);
 			reading = escape(payload);
 
 			// Handles - user_ts
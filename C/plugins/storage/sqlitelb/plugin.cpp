@@ -58,7 +58,7 @@ const char *default_config = QUOTE({
 static PLUGIN_INFORMATION info = {
 	"SQLiteLb",               // Name
 	"1.2.0",                  // Version
-	SP_COMMON|SP_READINGS,    // Flags
+	SP_COMMON|SP_READINGS|SP_BINARY_STREAM,    // Flags
 	PLUGIN_TYPE_STORAGE,      // Type
 	"1.6.0",                  // Interface version
 	default_config
@@ -51,7 +51,7 @@ const char *default_config = QUOTE({
 static PLUGIN_INFORMATION info = {
 	"SQLite3",		// Name
 	"1.1.0",		// Version
-	SP_READINGS,		// Flags
+	SP_READINGS|SP_BINARY_STREAM,	// Flags
 	PLUGIN_TYPE_STORAGE,	// Type
 	"1.6.0",		// Interface version
 	default_config
@@ -97,6 +97,10 @@ typedef enum controlDestination {
 #define SP_BUILTIN		0x0100
 /** The plugin supports control data */
 #define SP_CONTROL		0x1000
+/** The north plugin may return a count that acknowledges only the leading readings of a block */
+#define SP_PARTIAL_SEND		0x2000
+/** The storage plugin accepts binary encoded reading payloads on its reading stream */
+#define SP_BINARY_STREAM	0x4000
 
 /**
  * Plugin types
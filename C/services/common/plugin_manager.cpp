@@ -92,7 +92,8 @@ void updateJsonPluginConfig(PLUGIN_INFORMATION *info, string json_plugin_name, s
 	static const char* kTypeNames[] = { "Null", "False", "True", "Object", "Array", "String", "Number" };
 
 	DefaultConfigCategory basePluginCc("base", string(info->config));
-	logger->debug("Original basePluginCc=%s", basePluginCc.toJSON().c_str());
+	if (logger->isDebugEnabled())
+		logger->debug("Original basePluginCc=%s", basePluginCc.toJSON().c_str());
 		
 	// Iterate over overlay config and find same item in base config and update their default from overlay to base config
 	for (auto& m : doc.GetObject())
@@ -38,6 +38,12 @@ extern void logErrorMessage();
 extern PLUGIN_INFORMATION *plugin_info_fn();
 extern void plugin_shutdown_fn(PLUGIN_HANDLE);
 
+/**
+ * Output streams of the filter plugin handles, used to pass on data
+ * processed by the columnar 'plugin_ingest_columns' entry point
+ */
+static map<PLUGIN_HANDLE, pair<OUTPUT_HANDLE *, OUTPUT_STREAM>> outputStreams;
+
 
 /**
  * Function to invoke 'plugin_reconfigure' function in python plugin
@@ -178,6 +184,91 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 	PyGILState_Release(state);
 }
 
+/**
+ * Add the asset tracking tuples for the readings passing through a filter
+ *
+ * @param    module     The Python module of the filter
+ * @param    data       The ReadingSet data to filter
+ */
+static void trackAssets(PythonModule *module, READINGSET *data)
+{
+	AssetTracker* atr = AssetTracker::getAssetTracker();
+	if (!atr)
+	{
+		return;
+	}
+	vector<Reading *>* readings = ((ReadingSet *)data)->getAllReadingsPtr();
+	for (vector<Reading *>::const_iterator elem = readings->begin();
+						      elem != readings->end();
+						      ++elem)
+	{
+		atr->addAssetTrackingTuple(module->getCategoryName(),
+					   (*elem)->getAssetName(),
+					   string("Filter"));
+	}
+}
+
+/**
+ * Ingest data into filters chain using the columnar interface.
+ *
+ * The plugin 'plugin_ingest_columns' method is passed the readings as a
+ * dict, keyed by asset name, of dicts of numpy arrays and returns the
+ * columns to pass on, typically the same dict modified in place, or
+ * None to pass nothing on. The returned columns are written back into
+ * the readings, which are then sent to the output stream without any
+ * per reading conversion to and from Python objects.
+ *
+ * The caller must hold the GIL.
+ *
+ * @param    handle     The plugin handle returned from plugin_init
+ * @param    pFunc      The plugin_ingest_columns method
+ * @param    pName      The plugin name
+ * @param    module     The Python module of the filter
+ * @param    data       The ReadingSet data to filter
+ */
+static void filter_plugin_ingest_columns(PLUGIN_HANDLE handle,
+					 PyObject *pFunc,
+					 const string& pName,
+					 PythonModule *module,
+					 READINGSET *data)
+{
+	trackAssets(module, data);
+
+	PythonReadingSet *pyReadingSet = (PythonReadingSet *) data;
+	PyObject* columns = pyReadingSet->toColumns();
+
+	PyObject* pReturn = PyObject_CallFunction(pFunc,
+						  "OO",
+						  handle,
+						  columns);
+	Py_CLEAR(columns);
+
+	if (!pReturn)
+	{
+		Logger::getLogger()->error("Called python script method plugin_ingest_columns "
+					   ": error while getting result object, plugin '%s'",
+					   pName.c_str());
+		logErrorMessage();
+		delete (ReadingSet *)data;
+		return;
+	}
+
+	auto output = outputStreams.find(handle);
+	if (pReturn != Py_None &&
+	    output != outputStreams.end() &&
+	    pyReadingSet->fromColumns(pReturn) &&
+	    data->getCount() > 0)
+	{
+		// The output stream takes ownership of the data
+		(*output->second.second)(output->second.first, data);
+	}
+	else
+	{
+		delete (ReadingSet *)data;
+	}
+	Py_CLEAR(pReturn);
+}
+
 /**
  * Ingest data into filters chain
  *
@@ -217,6 +308,18 @@ void filter_plugin_ingest_fn(PLUGIN_HANDLE handle, READINGSET *data)
 	PyObject* pFunc;
 	PyGILState_STATE state = PyGILState_Ensure();
 
+	// Use the columnar entry point if the plugin provides one
+	pFunc = PyObject_GetAttrString(it->second->m_module, "plugin_ingest_columns");
+	if (pFunc && PyCallable_Check(pFunc))
+	{
+		filter_plugin_ingest_columns(handle, pFunc, pName, it->second, data);
+		Py_CLEAR(pFunc);
+		PyGILState_Release(state);
+		return;
+	}
+	PyErr_Clear();
+	Py_CLEAR(pFunc);
+
 	// Fetch required method in loaded object
 	pFunc = PyObject_GetAttrString(it->second->m_module, "plugin_ingest");
 	if (!pFunc)
@@ -245,21 +348,7 @@ void filter_plugin_ingest_fn(PLUGIN_HANDLE handle, READINGSET *data)
 	}
 
 	// Call asset tracker
-	// int i=0;
-	vector<Reading *>* readings = ((ReadingSet *)data)->getAllReadingsPtr();
-	for (vector<Reading *>::const_iterator elem = readings->begin();
-						      elem != readings->end();
-						      ++elem)
-	{
-		// Logger::getLogger()->debug("Reading %d: %s", i++, (*elem)->toJSON().c_str());
-		AssetTracker* atr = AssetTracker::getAssetTracker();
-		if (atr)
-		{
-			AssetTracker::getAssetTracker()->addAssetTrackingTuple(it->second->getCategoryName(),
-										(*elem)->getAssetName(),
-										string("Filter"));
-		}
-	}
+	trackAssets(it->second, data);
 
 	Logger::getLogger()->debug("C2Py: filter_plugin_ingest_fn():L%d: data->getCount()=%d", __LINE__, data->getCount());
 
@@ -528,6 +617,7 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 
 		if (ret.second)
 		{
+			outputStreams[(PLUGIN_HANDLE)pReturn] = make_pair(outHandle, output);
 			Logger::getLogger()->debug("plugin_handle: filter_plugin_init_fn(): "
 						   "handle %p of python plugin '%s' "
 						   "added to pythonHandles map",
@@ -693,6 +783,28 @@ void *PluginInterfaceInit(const char *pluginName, const char * pluginPathName)
 	return pModule;
 }
 
+/**
+ * Function to invoke 'plugin_shutdown' function in python plugin,
+ * forgetting the output stream of the plugin handle first
+ *
+ * @param    handle     The plugin handle from plugin_init_fn
+ */
+static void filter_plugin_shutdown_fn(PLUGIN_HANDLE handle)
+{
+	if (handle && Py_IsInitialized())
+	{
+		// The output streams are accessed with the GIL held
+		PyGILState_STATE state = PyGILState_Ensure();
+		outputStreams.erase(handle);
+		PyGILState_Release(state);
+	}
+	else if (handle)
+	{
+		outputStreams.erase(handle);
+	}
+	plugin_shutdown_fn(handle);
+}
+
 /**
  * Returns function pointer that can be invoked to call '_sym' function
  * in python plugin
@@ -709,7 +821,7 @@ void *PluginInterfaceResolveSymbol(const char *_sym, const string& pName)
 	else if (!sym.compare("plugin_init"))
 		return (void *) filter_plugin_init_fn;
 	else if (!sym.compare("plugin_shutdown"))
-		return (void *) plugin_shutdown_fn;
+		return (void *) filter_plugin_shutdown_fn;
 	else if (!sym.compare("plugin_reconfigure"))
 		return (void *) filter_plugin_reconfigure_fn;
 	else if (!sym.compare("plugin_ingest"))
@@ -10,6 +10,7 @@
 
 #include <data_load.h>
 #include <north_service.h>
+#include <climits>
 
 using namespace std;
 
@@ -26,7 +27,9 @@ static void threadMain(void *arg)
  */
 DataLoad::DataLoad(const string& name, long streamId, StorageClient *storage) : 
 	m_name(name), m_streamId(streamId), m_storage(storage), m_shutdown(false),
-	m_readRequest(0), m_dataSource(SourceReadings), m_pipeline(NULL)
+	m_readRequest(0), m_dataSource(SourceReadings), m_queuedBlocks(0), m_queuedBytes(0), m_queuedReadings(0),
+	m_pipeline(NULL), m_prefetchBlocks(DEFAULT_PREFETCH_BLOCKS),
+	m_prefetchMemory(DEFAULT_PREFETCH_MEMORY * 1024 * 1024), m_reportedPrefetch(ULONG_MAX)
 {
 	m_blockSize = DEFAULT_BLOCK_SIZE;
 
@@ -113,18 +116,24 @@ void DataLoad::loadThread()
 }
 
 /**
- * Wait for a read request to be made
+ * Wait until there is a need to read a block of data. This is either
+ * because a read has been requested or because there is room in the
+ * prefetch buffer for another block.
+ *
+ * The prefetch buffer is bounded both by a number of blocks and by
+ * the approximate memory used by the readings in those blocks.
  *
  * @return int	The size of the block to read
  */
 unsigned int DataLoad::waitForReadRequest()
 {
 	unique_lock<mutex> lck(m_mutex);
-	while (m_shutdown == false && m_readRequest == 0)
+	while (m_shutdown == false && m_readRequest == 0 &&
+			(m_queuedBlocks >= m_prefetchBlocks || m_queuedBytes >= m_prefetchMemory))
 	{
 		m_cv.wait(lck);
 	}
-	unsigned int rval =  m_readRequest;
+	unsigned int rval =  m_readRequest ? m_readRequest : m_blockSize;
 	m_readRequest = 0;
 	Logger::getLogger()->debug("DataLoad received read request for %d readings", rval);
 	return rval;
@@ -140,6 +149,20 @@ void DataLoad::triggerRead(unsigned int blockSize)
 	m_cv.notify_all();
 }
 
+/**
+ * Set the depth of the prefetch buffer
+ *
+ * @param blocks	The maximum number of blocks to read ahead of the sender
+ * @param memory	The maximum memory in megabytes to use for blocks read ahead
+ */
+void DataLoad::setPrefetch(unsigned int blocks, unsigned long memory)
+{
+	unique_lock<mutex> lck(m_mutex);
+	m_prefetchBlocks = blocks;
+	m_prefetchMemory = memory * 1024 * 1024;
+	m_cv.notify_all();
+}
+
 /**
  * Read a block of readings from the storage service
  *
@@ -327,9 +350,84 @@ void DataLoad::bufferReadings(ReadingSet *readings)
 			return;
 		}
 	}
-	unique_lock<mutex> lck(m_qMutex);
-	m_queue.push_back(readings);
+	queueBlock(readings);
 	Logger::getLogger()->debug("Buffered %d readings for north processing", readings->getCount());
+}
+
+/**
+ * Return an approximation of the memory used by a datapoint value
+ *
+ * @param value	The datapoint value
+ * @return size_t	The approximate size in bytes
+ */
+static size_t valueSize(DatapointValue& value)
+{
+	size_t size = sizeof(DatapointValue);
+	switch (value.getType())
+	{
+		case DatapointValue::T_STRING:
+			size += value.toStringValue().length();
+			break;
+		case DatapointValue::T_FLOAT_ARRAY:
+			size += value.getDpArr()->size() * sizeof(double);
+			break;
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+			for (auto dp : *value.getDpVec())
+			{
+				size += sizeof(Datapoint) + dp->getName().length() + valueSize(dp->getData());
+			}
+			break;
+		case DatapointValue::T_IMAGE:
+		{
+			DPImage *image = value.getImage();
+			size += (size_t)image->getWidth() * (size_t)image->getHeight() * (size_t)(image->getDepth() / 8);
+			break;
+		}
+		case DatapointValue::T_DATABUFFER:
+		{
+			DataBuffer *buffer = value.getDataBuffer();
+			size += buffer->getItemSize() * buffer->getItemCount();
+			break;
+		}
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			const Float2DArray *array = value.get2DArray();
+			for (size_t row = 0; row < array->rows(); row++)
+			{
+				size += array->rowLength(row) * sizeof(double);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return size;
+}
+
+/**
+ * Add a block of readings to the queue of blocks waiting for the
+ * sending thread. The approximate memory used by the block is
+ * recorded so that prefetching can be bounded by memory.
+ *
+ * @param readings	The block of readings
+ */
+void DataLoad::queueBlock(ReadingSet *readings)
+{
+	size_t size = 0;
+	for (auto reading : readings->getAllReadings())
+	{
+		size += sizeof(Reading) + reading->getAssetName().length();
+		for (auto dp : reading->getReadingData())
+		{
+			size += sizeof(Datapoint) + dp->getName().length() + valueSize(dp->getData());
+		}
+	}
+	unique_lock<mutex> lck(m_qMutex);
+	m_queue.push_back(make_pair(readings, size));
+	m_queuedBlocks++;
+	m_queuedBytes += size;
+	m_queuedReadings += readings->getCount();
 	m_fetchCV.notify_all();
 }
 
@@ -354,9 +452,16 @@ ReadingSet *DataLoad::fetchReadings(bool wait)
 			return NULL;
 		}
 	}
-	ReadingSet *rval = m_queue.front();
+	ReadingSet *rval = m_queue.front().first;
+	m_queuedBlocks--;
+	m_queuedBytes -= m_queue.front().second;
+	m_queuedReadings -= rval->getCount();
 	m_queue.pop_front();
-	triggerRead(m_blockSize);
+	lck.unlock();
+
+	// Wake the loading thread as there is now room to prefetch another block
+	unique_lock<mutex> rlck(m_mutex);
+	m_cv.notify_all();
 	return rval;
 }
 
@@ -518,9 +623,7 @@ void DataLoad::pipelineEnd(OUTPUT_HANDLE *outHandle,
 		load->updateLastSentId(load->m_lastFetched);
 	}
 
-	unique_lock<mutex> lck(load->m_qMutex);
-	load->m_queue.push_back(readingSet);
-	load->m_fetchCV.notify_all();
+	load->queueBlock(readingSet);
 }
 
 /**
@@ -534,6 +637,56 @@ void DataLoad::updateStatistics(uint32_t increment)
 	updateStatistic("Readings Sent", "Readings Sent North", increment);
 }
 
+/**
+ * Report the number of readings in the prefetch buffer. This is
+ * called periodically by the service rather than by the sending
+ * thread and only writes the statistic when the level has changed.
+ */
+void DataLoad::reportPrefetch()
+{
+	unsigned long prefetched = m_queuedReadings;
+	if (prefetched != m_reportedPrefetch)
+	{
+		setStatistic(m_name + "-Prefetch", m_name + " Readings Prefetched", prefetched);
+		m_reportedPrefetch = prefetched;
+	}
+}
+
+/**
+ * Set a statistic that records a level rather than a count
+ *
+ * @param key		The statistic key
+ * @param description	The statistic description
+ * @param value		The new value of the statistic
+ */
+void DataLoad::setStatistic(const string& key, const string& description, unsigned long value)
+{
+	const Condition conditionStat(Equals);
+	Where wStat("key", conditionStat, key);
+
+	InsertValues updateValue;
+	updateValue.push_back(InsertValue("value", (long)value));
+
+	// Perform UPDATE fledge.statistics SET value = x WHERE key = 'name'
+	int row_affected = m_storage->updateTable("statistics", updateValue, wStat);
+
+	if (row_affected < 1)
+	{
+		Logger::getLogger()->info("Adding a new row into the statistics as it is not present yet, key -%s- description -%s-",
+				key.c_str(), description.c_str());
+		InsertValues values;
+		values.push_back(InsertValue("key",         key));
+		values.push_back(InsertValue("description", description));
+		values.push_back(InsertValue("value",       (long)value));
+		string table = "statistics";
+
+		if (m_storage->insertTable(table, values) != 1)
+		{
+			Logger::getLogger()->error("Failed to insert a new row into the %s", table.c_str());
+		}
+	}
+}
+
 /**
  * Update a particular statstatistic
  *
@@ -120,12 +120,13 @@ unsigned long DataSender::send(ReadingSet *readings)
 	blockPause();
 	uint32_t sent = m_plugin->send(readings->getAllReadings());
 	releasePause();
-	unsigned long lastSent = readings->getReadingId(sent);
+	// A plugin that supports partial sends may acknowledge only the
+	// leading part of the block, the last sent id is then that of the
+	// last reading acknowledged
+	unsigned long lastSent = readings->getLastSentId(sent, m_plugin->partialSend());
 
 	if (sent > 0)
 	{
-		lastSent = readings->getLastId();
-
 		// Update asset tracker table/cache, if required
 		vector<Reading *> *vec = readings->getAllReadingsPtr();
 
@@ -6,12 +6,17 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <atomic>
 #include <storage_client.h>
 #include <reading.h>
 #include <filter_pipeline.h>
 #include <service_handler.h>
 
 #define DEFAULT_BLOCK_SIZE 100
+#define DEFAULT_PREFETCH_BLOCKS	2	// Blocks read ahead of the sending thread
+#define DEFAULT_PREFETCH_MEMORY	32	// Megabytes of readings read ahead of the sending thread
+#define PREFETCH_REPORT_INTERVAL	15	// Seconds between reports of the prefetch buffer level
+
 
 /**
  * A class used in the North service to load data from the buffer
@@ -32,6 +37,7 @@ class DataLoad : public ServiceHandler {
 		void			updateLastSentId(unsigned long id);
 		ReadingSet		*fetchReadings(bool wait);
 		void			updateStatistics(uint32_t increment);
+		void			reportPrefetch();
 		static void		passToOnwardFilter(OUTPUT_HANDLE *outHandle,
 						READINGSET* readings);
 		static void		pipelineEnd(OUTPUT_HANDLE *outHandle,
@@ -47,6 +53,7 @@ class DataLoad : public ServiceHandler {
 					{
 						m_blockSize = blockSize;
 					};
+		void			setPrefetch(unsigned int blocks, unsigned long memory);
 
 	private:
 		void			readBlock(unsigned int blockSize);
@@ -56,8 +63,10 @@ class DataLoad : public ServiceHandler {
 		ReadingSet		*fetchStatistics(unsigned int blockSize);
 		ReadingSet		*fetchAudit(unsigned int blockSize);
 		void			bufferReadings(ReadingSet *readings);
+		void			queueBlock(ReadingSet *readings);
 		bool			loadFilters(const std::string& category);
 		void			updateStatistic(const std::string& key, const std::string& description, uint32_t increment);
+		void			setStatistic(const std::string& key, const std::string& description, unsigned long value);
 	private:
 		const std::string&	m_name;
 		long			m_streamId;
@@ -71,11 +80,20 @@ class DataLoad : public ServiceHandler {
 		enum { SourceReadings, SourceStatistics, SourceAudit }
 					m_dataSource;
 		unsigned long		m_lastFetched;
-		std::deque<ReadingSet *>
+		// Blocks waiting to be sent and their approximate size in bytes
+		std::deque<std::pair<ReadingSet *, size_t>>
 					m_queue;
+		std::atomic<unsigned int>
+					m_queuedBlocks;
+		std::atomic<size_t>	m_queuedBytes;
+		std::atomic<unsigned long>
+					m_queuedReadings;
 		std::mutex		m_qMutex;
 		FilterPipeline		*m_pipeline;
 		std::mutex		m_pipelineMutex;
 		unsigned long		m_blockSize;
+		unsigned int		m_prefetchBlocks;
+		size_t			m_prefetchMemory;
+		unsigned long		m_reportedPrefetch;
 };
 #endif
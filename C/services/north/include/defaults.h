@@ -17,6 +17,10 @@ static struct {
 	const char	*type;
 	const char	*value;
 } defaults[] = {
+	{ "prefetchBlocks", "Prefetch Blocks",
+		"The number of blocks of data to read ahead of sending", "integer", "2" },
+	{ "prefetchMemory", "Prefetch Memory",
+		"The maximum memory in megabytes to use for data read ahead of sending", "integer", "32" },
 	{ NULL, NULL, NULL, NULL, NULL }
 };
 #endif
@@ -55,6 +55,7 @@ class NorthService : public ServiceAuthHandler {
 		void				setDryRun() { m_dryRun = true; };
 	private:
 		void				addConfigDefaults(DefaultConfigCategory& defaults);
+		void				setPrefetch();
 		bool 				loadPlugin();
 		void 				createConfigCategories(DefaultConfigCategory configCategory, std::string parent_name,std::string current_name);
 		void				restartPlugin();
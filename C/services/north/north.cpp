@@ -438,6 +438,7 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 				m_dataLoad->setBlockSize(newBlock);
 			}
 		}
+		setPrefetch();
 		m_dataSender = new DataSender(northPlugin, m_dataLoad, this);
 
 		if (!m_dryRun)
@@ -449,8 +450,17 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 			unique_lock<mutex> lck(m_mutex);
 			while (!m_shutdown)
 			{
-				m_cv.wait(lck);
-				logger->debug("North main thread woken up, shutdown %s", m_shutdown ? "true" : "false");
+				if (m_cv.wait_for(lck, chrono::seconds(PREFETCH_REPORT_INTERVAL)) == cv_status::timeout)
+				{
+					// Report the prefetch buffer level away from the sending thread
+					lck.unlock();
+					m_dataLoad->reportPrefetch();
+					lck.lock();
+				}
+				else
+				{
+					logger->debug("North main thread woken up, shutdown %s", m_shutdown ? "true" : "false");
+				}
 				if (m_shutdown == false && m_restartPlugin)
 				{
 					restartPlugin();
@@ -761,6 +771,7 @@ void NorthService::configChange(const string& categoryName, const string& catego
 				m_dataLoad->setBlockSize(newBlock);
 			}
 		}
+		setPrefetch();
 	}
 
 	// Update the  Security category
@@ -829,6 +840,29 @@ void NorthService::restartPlugin()
 	}
 }
 
+/**
+ * Configure the prefetching of readings by the data load class from
+ * the advanced configuration category
+ */
+void NorthService::setPrefetch()
+{
+	unsigned long blocks = DEFAULT_PREFETCH_BLOCKS;
+	unsigned long memory = DEFAULT_PREFETCH_MEMORY;
+	if (m_configAdvanced.itemExists("prefetchBlocks"))
+	{
+		blocks = strtoul(m_configAdvanced.getValue("prefetchBlocks").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("prefetchMemory"))
+	{
+		memory = strtoul(m_configAdvanced.getValue("prefetchMemory").c_str(), NULL, 10);
+	}
+	if (blocks < 1)
+	{
+		blocks = 1;
+	}
+	m_dataLoad->setPrefetch(blocks, memory);
+}
+
 /**
  * Add the generic north service configuration options to the advanced
  * category
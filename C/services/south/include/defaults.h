@@ -25,6 +25,10 @@ static struct {
 			"Enable flow control by reducing the poll rate", "boolean", "false" },
 	{ "readingsPerSec",	"Reading Rate",
 			"Number of readings to generate per interval", "integer", "1" },
+	{ "spillBuffer",	"Spill To Disk",
+			"Buffer readings that can not be sent to storage on disk", "boolean", "false" },
+	{ "spillBufferSize",	"Spill Buffer Size (MB)",
+			"Maximum disk space used to buffer readings that can not be sent to storage", "integer", "1024" },
 	{ NULL, NULL, NULL, NULL, NULL }
 };
 #endif
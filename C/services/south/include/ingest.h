@@ -14,17 +14,23 @@
 #include <logger.h>
 #include <vector>
 #include <queue>
+#include <deque>
 #include <thread>
 #include <chrono>
 #include <mutex>
 #include <sstream>
 #include <unordered_set>
+#include <unordered_map>
 #include <condition_variable>
 #include <filter_plugin.h>
 #include <filter_pipeline.h>
 #include <asset_tracking.h>
 #include <service_handler.h>
+#include <spill_buffer.h>
+#include <ingest_queue.h>
 #include <set>
+#include <map>
+#include <atomic>
 
 #define SERVICE_NAME  "Fledge South"
 
@@ -32,11 +38,17 @@
 
 #define STATS_UPDATE_FAIL_THRESHOLD 10	// After this many update fails try creatign new stats
 
+#define INGEST_STORE_BLOCKS	2	// Filtered blocks that may wait for the storage thread
+
+#define ASSET_SCHEMA_CACHE	64	// Datapoint fingerprints cached per asset
+
 /**
  * The ingest class is used to ingest asset readings.
  * It maintains a queue of readings to be sent to storage,
- * these are sent using a background thread that regularly
- * wakes up and sends the queued readings.
+ * these are filtered by a background thread that regularly
+ * wakes up and processes the queued readings. The filtered
+ * readings are sent to storage by a second thread, so that
+ * filtering and sending overlap.
  */
 class Ingest : public ServiceHandler {
 
@@ -50,11 +62,15 @@ public:
 	~Ingest();
 
 	void		ingest(const Reading& reading);
+	void		ingest(Reading&& reading);
 	void		ingest(const std::vector<Reading *> *vec);
+	void		ingest(std::vector<Reading *>&& vec);
 	bool		running();
     	bool		isStopping();
 	bool		isRunning() { return !m_shutdown; };
 	void		processQueue();
+	void		processStore();
+	void		processAssetTracking();
 	void		waitForQueue();
 	size_t		queueLength();
 	void		updateStats(void);
@@ -79,6 +95,7 @@ public:
 	void            unDeprecateStorageAssetTrackingRecord(StorageAssetTrackingTuple* currentTuple,
                                                         const std::string& assetName, const std::string&, const unsigned int&);
 	void		setStatistics(const std::string& option);
+	void		setSpillBuffer(bool enable, unsigned long size);
 
 	std::string  	getStringFromSet(const std::set<std::string> &dpSet);
 
@@ -94,6 +111,15 @@ private:
 						m_discardedReadings++;
 					};
 	long				calculateWaitTime();
+	void				readingsQueued(size_t queued, size_t added);
+	void				storedReadings(std::vector<Reading *> *readings);
+	void				checkSpillBuffer();
+	void				queueForStore(std::vector<Reading *> *block);
+	void				resendReadings();
+	void				storeBlock(std::vector<Reading *> *block);
+	void				trackAsset(const std::string& assetName,
+						const std::set<std::string>& newDatapoints);
+	bool				spillReadings(std::vector<Reading *> *readings);
 	int 				createServiceStatsDbEntry();
 
 	StorageClient&			m_storage;
@@ -105,22 +131,39 @@ private:
 	std::string 			m_pluginName;
 	ManagementClient		*m_mgtClient;
 	// New data: queued
-	std::vector<Reading *>*		m_queue;
-	std::mutex			m_qMutex;
+	IngestQueue			m_queue;
 	std::mutex			m_statsMutex;
 	std::mutex			m_pipelineMutex;
 	std::thread*			m_thread;
 	std::thread*			m_statsThread;
+	std::thread*			m_storeThread;
 	Logger*				m_logger;
 	std::condition_variable		m_cv;
+	std::mutex			m_queueMutex;	// Used with m_cv to wait for the queue to fill
 	std::condition_variable		m_statsCv;
 	// Data ready to be filtered/sent
 	std::vector<Reading *>*		m_data;
+	// Filtered data waiting for the storage thread
+	std::deque<std::vector<Reading *>*>
+					m_storeQueue;
+	std::mutex			m_storeMutex;
+	std::condition_variable		m_storeCv;
+	std::condition_variable		m_storeSpaceCv;
+	bool				m_storeStop;
 	std::vector<std::vector<Reading *>*>
 					m_resendQueues;
-	std::queue<std::vector<Reading *>*>
-					m_fullQueues;
-	std::mutex			m_fqMutex;
+	// Datapoint fingerprints seen per asset, used by the storage thread
+	std::unordered_map<std::string, std::unordered_set<uint64_t>>
+					m_assetSchemas;
+	// Assets waiting for the asset tracking thread
+	std::map<std::string, std::set<std::string>>
+					m_trackingPending;
+	std::map<std::string, std::set<std::string>>
+					m_trackedDatapoints;
+	std::mutex			m_trackingMutex;
+	std::condition_variable		m_trackingCv;
+	std::thread*			m_trackingThread;
+	bool				m_trackingStop;
 	unsigned int			m_discardedReadings; // discarded readings since last update to statistics table
 	FilterPipeline*			m_filterPipeline;
 	
@@ -133,6 +176,9 @@ private:
 	int				m_statsUpdateFails;
 	enum { STATS_BOTH, STATS_ASSET, STATS_SERVICE }
 					m_statisticsOption;
+	SpillBuffer			*m_spill;
+	std::atomic<bool>		m_spillEnabled;
+	std::atomic<unsigned long>	m_spillSize;
 };
 
 #endif
@@ -0,0 +1,57 @@
+#ifndef _INGEST_QUEUE_H
+#define _INGEST_QUEUE_H
+/*
+ * Fledge reading ingest.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <vector>
+#include <atomic>
+
+/**
+ * A lock free, multiple producer, single consumer queue of readings.
+ *
+ * Any number of threads may add readings to the queue, either one at
+ * a time or as a batch, without taking a lock. A single thread, the
+ * thread that sends readings to the storage service, removes them.
+ *
+ * The queue is a linked list of batches, a single reading or the
+ * vector of readings passed in a single call, so a producer adding
+ * a block of readings performs a single atomic exchange. A single
+ * reading costs the allocation of one small batch, readings are not
+ * held back per producer waiting for a batch to fill.
+ */
+class IngestQueue {
+	public:
+		IngestQueue();
+		~IngestQueue();
+		size_t		push(Reading *reading);
+		size_t		push(const std::vector<Reading *>& readings);
+		size_t		push(std::vector<Reading *>&& readings);
+		size_t		drain(std::vector<Reading *>& readings, size_t max);
+		Reading		*oldest();
+		size_t		size() { return m_count; };
+	private:
+		class Batch {
+			public:
+				Batch() : m_next(NULL), m_reading(NULL) {};
+				std::atomic<Batch *>	m_next;
+				Reading			*m_reading;
+				std::vector<Reading *>	m_readings;
+		};
+		size_t		push(Batch *batch, size_t count);
+		Batch		*pop();
+	private:
+		// Written by the producers
+		std::atomic<Batch *>	m_head;
+		// Only accessed by the consumer
+		Batch			*m_tail;
+		Batch			m_stub;
+		std::atomic<size_t>	m_count;
+};
+#endif
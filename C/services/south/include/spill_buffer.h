@@ -0,0 +1,121 @@
+#ifndef _SPILL_BUFFER_H
+#define _SPILL_BUFFER_H
+/*
+ * Fledge reading ingest.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <stdint.h>
+
+#define SPILL_SEGMENT_MAGIC	0x4c495053	// "SPIL"
+#define SPILL_RECORD_MAGIC	0x44524352	// "RCRD"
+#define SPILL_VERSION		2	// Version 2 stores the asset name length as 32 bits
+#define SPILL_SEGMENT_SIZE	(16 * 1024 * 1024)	// Largest size of a segment file
+#define SPILL_MIN_SEGMENT_SIZE	(64 * 1024)		// Smallest size of a segment file
+#define SPILL_SEGMENTS		4			// Segments the disk space is divided into
+
+/**
+ * The header at the start of each segment of the spill buffer.
+ * The read offset is updated once the readings before it have
+ * been successfully sent to the storage service.
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	readOffset;
+} SpillSegmentHeader;
+
+/**
+ * The header of each record in a segment. A record holds the
+ * readings of one block that failed to be sent to the storage service.
+ *
+ * The magic is written last, a record whose magic is not set
+ * or whose checksum does not match is treated as the end of the
+ * segment. This allows a record that was being written when the
+ * service failed to be detected and ignored.
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	length;		// Length of the record body
+	uint32_t	count;		// Number of readings in the record
+	uint32_t	checksum;	// FNV-1a checksum of the record body
+} SpillRecordHeader;
+
+/**
+ * An append only, memory mapped log of blocks of readings that the
+ * south service has failed to send to the storage service.
+ *
+ * The log is split into segment files in a directory, segments are
+ * removed once all the readings they contain have been sent. Only
+ * the segment being read and the segment being written are mapped
+ * into memory, so the memory used by the buffer is bounded however
+ * long the storage service is unavailable. The disk space used is
+ * also bounded, once the limit is reached the oldest segment is
+ * discarded.
+ *
+ * Readings are stored in the binary datapoint encoding of the
+ * reading stream protocol.
+ */
+class SpillBuffer {
+	public:
+		SpillBuffer(const std::string& directory, size_t maxSize);
+		~SpillBuffer();
+		bool		append(const std::vector<Reading *>& readings,
+					unsigned long& discarded);
+		std::vector<Reading *>
+				*read();
+		void		commit();
+		bool		empty() { return m_readings == 0; };
+		unsigned long	size() { return m_readings; };
+		void		setMaxSize(size_t maxSize) { m_maxSize = maxSize; };
+	private:
+		class Segment {
+			public:
+				Segment(const std::string& path, uint32_t seq);
+				~Segment();
+				bool		create(size_t size);
+				bool		open();
+				bool		map();
+				void		unmap();
+				void		closeFile();
+				void		setReadOffset(uint64_t offset);
+				SpillSegmentHeader
+						*header() { return (SpillSegmentHeader *)m_base; };
+				std::string	m_path;
+				uint32_t	m_seq;
+				int		m_fd;
+				char		*m_base;
+				size_t		m_size;
+				size_t		m_writeOffset;
+				unsigned long	m_unread;
+		};
+		void		recover();
+		Segment		*newSegment(size_t minSize);
+		size_t		segmentSize();
+		void		removeHead();
+		bool		scan(Segment *segment);
+		static uint32_t	checksum(const char *data, size_t length);
+		static void	encode(Reading *reading, std::string& body);
+		static Reading	*decode(const char *& p, const char *end);
+	private:
+		std::string	m_directory;
+		size_t		m_maxSize;
+		size_t		m_diskSize;
+		std::deque<Segment *>
+				m_segments;
+		uint32_t	m_nextSeq;
+		uint64_t	m_pendingOffset;
+		unsigned long	m_pendingCount;
+		std::atomic<unsigned long>
+				m_readings;
+};
+#endif
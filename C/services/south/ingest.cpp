@@ -13,7 +13,9 @@
 #include <thread>
 #include <logger.h>
 #include <storage_asset_tracking.h>
+#include <utils.h>
 #include <set>
+#include <algorithm>
 
 using namespace std;
 
@@ -37,6 +39,22 @@ static void ingestThread(Ingest *ingest)
 	}
 }
 
+/**
+ * Thread to send filtered blocks of readings to the storage layer
+ */
+static void storeThread(Ingest *ingest)
+{
+	ingest->processStore();
+}
+
+/**
+ * Thread to update the asset tracking records of ingested assets
+ */
+static void assetTrackingThread(Ingest *ingest)
+{
+	ingest->processAssetTracking();
+}
+
 /**
  * Thread to update statistics table in DB
  */
@@ -280,12 +298,18 @@ Ingest::Ingest(StorageClient& storage,
 			m_failCnt(0),
 			m_storageFailed(false),
 			m_storesFailed(0),
-			m_statisticsOption(STATS_BOTH)
+			m_statisticsOption(STATS_BOTH),
+			m_spill(NULL),
+			m_spillEnabled(false),
+			m_spillSize(0)
 {
 	m_shutdown = false;
 	m_running = true;
-	m_queue = new vector<Reading *>();
+	m_storeStop = false;
 	m_thread = new thread(ingestThread, this);
+	m_storeThread = new thread(storeThread, this);
+	m_trackingStop = false;
+	m_trackingThread = new thread(assetTrackingThread, this);
 	m_statsThread = new thread(statsThread, this);
 	m_logger = Logger::getLogger();
 	m_data = NULL;
@@ -307,22 +331,40 @@ Ingest::Ingest(StorageClient& storage,
  *
  * Set's the running flag to false. This will
  * cause the processing thread to drain the queue
- * and then exit.
- * Once this thread has exited the destructor will
+ * and then exit. The storage thread then sends the
+ * remaining filtered blocks before it exits.
+ * Once these threads have exited the destructor will
  * return.
  */
 Ingest::~Ingest()
 {
 	m_shutdown = true;
-	m_running = false;
+	{
+		lock_guard<mutex> guard(m_queueMutex);
+		m_running = false;
+	}
 	m_cv.notify_one();
 	m_thread->join();
 	processQueue();
+	{
+		lock_guard<mutex> guard(m_storeMutex);
+		m_storeStop = true;
+	}
+	m_storeCv.notify_one();
+	m_storeThread->join();
+	{
+		lock_guard<mutex> guard(m_trackingMutex);
+		m_trackingStop = true;
+	}
+	m_trackingCv.notify_one();
+	m_trackingThread->join();
 	m_statsCv.notify_one();
 	m_statsThread->join();
 	updateStats();
-	delete m_queue;
+	delete m_spill;
 	delete m_thread;
+	delete m_storeThread;
+	delete m_trackingThread;
 	delete m_statsThread;
 	//delete m_data;
 	
@@ -359,81 +401,75 @@ bool Ingest::isStopping()
  */
 void Ingest::ingest(const Reading& reading)
 {
-vector<Reading *> *fullQueue = 0;
+	size_t queued = m_queue.push(new Reading(reading));
+	readingsQueued(queued, 1);
+}
 
-	{
-		lock_guard<mutex> guard(m_qMutex);
-		m_queue->emplace_back(new Reading(reading));
-		if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
-		{
-			fullQueue = m_queue;
-			m_queue = new vector<Reading *>;
-		}
-	}
-	if (fullQueue)
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		m_fullQueues.push(fullQueue);
-	}
-	if (m_fullQueues.size())
-		m_cv.notify_all();
+/**
+ * Add a reading to the reading queue, the content of the reading
+ * is moved into the queue rather than copied.
+ */
+void Ingest::ingest(Reading&& reading)
+{
+	size_t queued = m_queue.push(new Reading(std::move(reading)));
+	readingsQueued(queued, 1);
 }
 
 /**
- * Add a set of readings to the reading queue
+ * Add a set of readings to the reading queue. The queue takes
+ * ownership of the readings but not of the vector.
  */
 void Ingest::ingest(const vector<Reading *> *vec)
 {
-vector<Reading *> *fullQueue = 0;
-size_t qSize;
-unsigned int nFullQueues = 0;
+	size_t queued = m_queue.push(*vec);
+	readingsQueued(queued, vec->size());
+}
 
+/**
+ * Add a set of readings to the reading queue. The vector is moved
+ * into the queue, which takes ownership of the readings.
+ */
+void Ingest::ingest(vector<Reading *>&& vec)
+{
+	size_t added = vec.size();
+	size_t queued = m_queue.push(std::move(vec));
+	readingsQueued(queued, added);
+}
+
+/**
+ * Wake the thread that sends the readings to storage if adding
+ * readings to the queue has taken it past the buffer threshold.
+ * Only the call that crosses the threshold wakes the thread, rather
+ * than every call after it. The notification is made holding the
+ * mutex the thread waits with, so that it can not be lost between
+ * the thread checking the queue size and starting to wait.
+ *
+ * @param queued	The number of queued readings after the addition
+ * @param added		The number of readings added
+ */
+void Ingest::readingsQueued(size_t queued, size_t added)
+{
+	if ((queued >= m_queueSizeThreshold && queued - added < m_queueSizeThreshold)
+			|| m_running == false)
 	{
-		lock_guard<mutex> guard(m_qMutex);
-		
-		// Get the readings in the set
-		for (auto & rdng : *vec)
-		{
-			m_queue->push_back(rdng);
-		}
-		if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
-		{
-			fullQueue = m_queue;
-			m_queue = new vector<Reading *>;
-		}
-		qSize = m_queue->size();
-	}
-	if (fullQueue)
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		m_fullQueues.push(fullQueue);
-		nFullQueues = m_fullQueues.size();
-	}
-	else
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		nFullQueues = m_fullQueues.size();
-	}
-	if (nFullQueues != 0 || qSize > m_queueSizeThreshold * 3 / 4)
-	{
+		lock_guard<mutex> guard(m_queueMutex);
 		m_cv.notify_all();
 	}
 }
 
 /**
- * Work out how long to wait based on age of oldest queued reading
- * We do this in a seperaste function so that we can
- * lock the qMutex to access the oldest element in the queue
+ * Work out how long to wait based on age of oldest queued reading.
+ * This is only called by the thread that processes the queue, so
+ * it may look at the oldest element in the queue without a lock.
  *
  * @return the tiem to wait
  */
 long Ingest::calculateWaitTime()
 {
 	long timeout = m_timeout;
-	lock_guard<mutex> guard(m_qMutex);
-	if (!m_queue->empty())
+	Reading *reading = m_queue.oldest();
+	if (reading)
 	{
-		Reading *reading = (*m_queue)[0];
 		struct timeval tm, now;
 		reading->getUserTimestamp(&tm);
 		gettimeofday(&now, NULL);
@@ -449,16 +485,17 @@ long Ingest::calculateWaitTime()
  */
 void Ingest::waitForQueue()
 {
-	if (m_fullQueues.size() > 0 || m_resendQueues.size() > 0)
+	if (m_queue.size() >= m_queueSizeThreshold)
 		return;
-	if (m_running && m_queue->size() < m_queueSizeThreshold)
+	if (m_running && m_queue.size() < m_queueSizeThreshold)
 	{
 		long timeout = calculateWaitTime();
 		if (timeout > 0)
 		{
-			mutex mtx;
-			unique_lock<mutex> lck(mtx);
-			m_cv.wait_for(lck,chrono::milliseconds((3 * timeout) / 4));
+			unique_lock<mutex> lck(m_queueMutex);
+			m_cv.wait_for(lck, chrono::milliseconds((3 * timeout) / 4), [this] {
+					return m_queue.size() >= m_queueSizeThreshold || !m_running;
+				});
 		}
 	}
 }
@@ -466,183 +503,25 @@ void Ingest::waitForQueue()
 /**
  * Process the queue of readings.
  *
- * Send them to the storage layer as a block. If the append call
- * fails requeue the readings for the next transmission.
+ * This is the first stage of a two stage pipeline. Readings are taken
+ * from the ingest queue a block at a time and passed through the filter
+ * pipeline, the filtered block is then handed to the storage thread
+ * which sends it to the storage layer. Filtering of the next block
+ * therefore overlaps with the sending of the previous one.
  *
- * In order not to lock the queue for an excessie time a new queue
- * is created and the old one moved to a local variable. This minimise
- * the time we hold the queue mutex to the time it takes to swap two
- * variables.
+ * The queue is lock free, readings are removed from it a block at a
+ * time whilst the producers continue to add new readings.
  */
 void Ingest::processQueue()
 {
-
-/*	typedef struct{
-                std::set<std::string> setDp;
-                unsigned int          count;
-        }dpCountObj;
-*/
-
 	do {
 		/*
-		 * If we have some data that has been previously filtered but failed to send,
-		 * then first try to send that data.
+		 * Take up to a buffer threshold of readings from the queue, the
+		 * producers continue to add to the queue while we process them.
 		 */
-		while (m_resendQueues.size() > 0)
-		{
-			vector<Reading *> *q = *m_resendQueues.begin();
-			if (m_storage.readingAppend(*q) == false)
-			{
-				if (!m_storageFailed)
-					m_logger->info("Still unable to resend buffered data, leaving on resend queue.");
-				m_storageFailed = true;
-				m_storesFailed++;
-				m_failCnt++;
-				if (m_failCnt > 5)
-				{
-					m_logger->info("Too many failures with block of readings. Removing readings from block");
-					for (int cnt = 5; cnt > 0 && q->size() > 0; cnt--)
-					{
-						Reading *reading = q->front();
-						m_logger->info("Remove reading: %s",
-								reading->toJSON().c_str());
-						delete reading;
-						q->erase(q->begin());
-						logDiscardedStat();
-					}
-					if (q->size() == 0)
-					{
-						delete q;
-						m_resendQueues.erase(m_resendQueues.begin());
-					}
-					m_failCnt = 0;
-				}
-			}
-			else
-			{
-
-				if (m_storageFailed)
-				{
-					m_logger->warn("Storage operational after %d failures", m_storesFailed);
-					m_storageFailed = false;
-					m_storesFailed = 0;
-				}
-				m_failCnt = 0;
-				std::map<std::string, int>		statsEntriesCurrQueue;
-				AssetTracker *tracker = AssetTracker::getAssetTracker();
-				StorageAssetTracker *satracker = StorageAssetTracker::getStorageAssetTracker();
-				if ( satracker == nullptr)
-                                {
-                                        Logger::getLogger()->error("%s could not initialize satracker ", __FUNCTION__);
-					return;
-                                }
-
-				string lastAsset = "";
-				int *lastStat = NULL;
-				std::map <std::string , std::set<std::string> > assetDatapointMap;
-
-				for (vector<Reading *>::iterator it = q->begin();
-							 it != q->end(); ++it)
-				{
-					Reading *reading = *it;
-					string assetName = reading->getAssetName();
-                                        const std::vector<Datapoint *> dpVec = reading->getReadingData();
-					std::string temp;
-					std::set<std::string> tempSet;
-					// first sort the individual datapoints 
-					// e.g. dp2, dp3, dp1 push them in a set,to make them 
-					// dp1,dp2,dp3
-                                        for ( auto dp : dpVec)
-                                        {
-						temp.clear();
-                                                temp.append(dp->getName());
-						tempSet.insert(temp);
-                                        }
-
-					temp.clear();
-
-					// Push them in a set so as to avoid duplication of datapoints
-					// a reading of d1, d2, d3 and another d2,d3,d1 , second will be discarded
-					//
-					for (auto dp: tempSet)
-					{
-						set<string> &s= assetDatapointMap[assetName];
-						if (s.find(dp) == s.end())
-						{
-							s.insert(dp);
-						}
-					}
-
-					if (lastAsset.compare(assetName))
-					{
-						AssetTrackingTuple tuple(m_serviceName,
-									m_pluginName,
-									assetName,
-									"Ingest");
-
-						// Check Asset record exists
-						AssetTrackingTuple* res = tracker->findAssetTrackingCache(tuple);
-						if (res == NULL)
-						{
-							// Record non in cache, add it
-							tracker->addAssetTrackingTuple(tuple);
-						}
-						else
-						{
-							// Possibly Un-deprecate asset tracking record
-							unDeprecateAssetTrackingRecord(res,
-											assetName,
-											"Ingest");
-						}
-						lastAsset = assetName;
-						lastStat = &(statsEntriesCurrQueue[assetName]);
-						(*lastStat)++;
-					}
-					else if (lastStat)
-					{
-						(*lastStat)++;
-					}
-					delete reading;
-				}
-
-				for (auto itr : assetDatapointMap)
-                                {
-                                        std::set<string> &s = itr.second;
-                                        unsigned int count = s.size();
-                                        StorageAssetTrackingTuple storageTuple(m_serviceName,m_pluginName, itr.first, "store", false, "",count);
-                                        StorageAssetTrackingTuple *ptr = &storageTuple;
-                                        satracker->updateCache(s, ptr);
-                                        bool deprecated = satracker->getDeprecated(ptr);
-                                        if (deprecated == true)
-                                        {
-                                                unDeprecateStorageAssetTrackingRecord(ptr, itr.first, getStringFromSet(s), count);
-                                        }
-                                }
-
-				delete q;
-				m_resendQueues.erase(m_resendQueues.begin());
-				unique_lock<mutex> lck(m_statsMutex);
-				for (auto &it : statsEntriesCurrQueue)
-					statsPendingEntries[it.first] += it.second;
-			}
-		}
-
-		{
-			lock_guard<mutex> fqguard(m_fqMutex);
-			if (m_fullQueues.empty())
-			{
-				// Block of code to execute holding the mutex
-				lock_guard<mutex> guard(m_qMutex);
-				std::vector<Reading *> *newQ = new vector<Reading *>;
-				m_data = m_queue;
-				m_queue = newQ;
-			}
-			else
-			{
-				m_data = m_fullQueues.front();
-				m_fullQueues.pop();
-			}
-		}
+		m_data = new vector<Reading *>;
+		m_data->reserve(m_queueSizeThreshold);
+		m_queue.drain(*m_data, m_queueSizeThreshold);
 		
 		/*
 		 * Create a ReadingSet from m_data readings if we have filters.
@@ -681,13 +560,13 @@ void Ingest::processQueue()
 
 					/*
 					 * If filtering removed all the readings then simply clean up m_data and
-					 * return.
+					 * move on to the next block.
 					 */
 					if (m_data->size() == 0)
 					{
 						delete m_data;
 						m_data = NULL;
-						return;
+						continue;
 					}
 				}
 			}
@@ -719,140 +598,499 @@ void Ingest::processQueue()
 			}
 		}
 			
-		/**
-		 * 'm_data' vector is ready to be sent to storage service.
-		 *
-		 * Note: m_data might contain:
-		 * - Readings set by the configured service "plugin" 
-		 * OR
-		 * - filtered readings by filter plugins in 'readingSet' object:
-		 *	1- values only
-		 *	2- some readings removed
-		 *	3- New set of readings
+		/*
+		 * Pass the block to the storage thread, this will block if the
+		 * storage thread has fallen behind.
 		 */
-		if (!m_data->empty())
+		if (m_data->empty())
+		{
+			delete m_data;
+		}
+		else
+		{
+			queueForStore(m_data);
+		}
+		m_data = NULL;
+	} while (m_queue.size() >= m_queueSizeThreshold || (m_running == false && m_queue.size() > 0));
+}
+
+/**
+ * Add a filtered block of readings to the queue of blocks waiting to
+ * be sent to the storage layer. If the queue is full wait for the
+ * storage thread to take a block, this stops the filter stage running
+ * ahead of the storage service and leaves the readings in the ingest
+ * queue, where they count towards the throttling of the plugin.
+ *
+ * @param block	The block of readings, ownership passes to the storage thread
+ */
+void Ingest::queueForStore(vector<Reading *> *block)
+{
+	unique_lock<mutex> lck(m_storeMutex);
+	m_storeSpaceCv.wait(lck, [this] {
+			return m_storeQueue.size() < INGEST_STORE_BLOCKS || m_storeStop;
+			});
+	m_storeQueue.push_back(block);
+	m_storeCv.notify_one();
+}
+
+/**
+ * The second stage of the ingest pipeline, run by the storage thread.
+ *
+ * Blocks of filtered readings are sent to the storage layer in the
+ * order in which they were filtered. Any readings waiting to be resent,
+ * or in the spill buffer, are always sent before the next block.
+ *
+ * When there are no new blocks the thread wakes periodically to retry
+ * sending any readings that previously failed. Once the ingest class is
+ * stopping the remaining blocks are sent and the thread returns.
+ */
+void Ingest::processStore()
+{
+	while (true)
+	{
+		vector<Reading *> *block = NULL;
+		bool stopping;
 		{
-			if (m_storage.readingAppend(*m_data) == false)
+			unique_lock<mutex> lck(m_storeMutex);
+			long timeout = m_timeout > 0 ? m_timeout : 1000;
+			m_storeCv.wait_for(lck, chrono::milliseconds(timeout), [this] {
+					return !m_storeQueue.empty() || m_storeStop;
+					});
+			if (!m_storeQueue.empty())
 			{
-				if (!m_storageFailed)
-					m_logger->warn("Failed to write readings to storage layer, queue for resend");
-				m_storageFailed = true;
-				m_storesFailed++;
-				m_resendQueues.push_back(m_data);
-				m_data = NULL;
-				m_failCnt = 1;
+				block = m_storeQueue.front();
+				m_storeQueue.pop_front();
+				m_storeSpaceCv.notify_one();
 			}
-			else
+			stopping = m_storeStop && m_storeQueue.empty();
+		}
+		resendReadings();
+		if (block)
+		{
+			storeBlock(block);
+			signalStatsUpdate();
+		}
+		if (stopping && !block)
+		{
+			return;
+		}
+	}
+}
+
+/**
+ * Send any readings that previously failed to be sent to the storage
+ * layer. Called by the storage thread only.
+ */
+void Ingest::resendReadings()
+{
+	/*
+	 * If we have some data that has been previously filtered but failed to send,
+	 * then first try to send that data.
+	 */
+	while (m_resendQueues.size() > 0)
+	{
+		vector<Reading *> *q = *m_resendQueues.begin();
+		if (m_storage.readingAppend(*q) == false)
+		{
+			if (!m_storageFailed)
+				m_logger->info("Still unable to resend buffered data, leaving on resend queue.");
+			m_storageFailed = true;
+			m_storesFailed++;
+			m_failCnt++;
+			if (m_failCnt > 5)
 			{
-				if (m_storageFailed)
+				m_logger->info("Too many failures with block of readings. Removing readings from block");
+				for (int cnt = 5; cnt > 0 && q->size() > 0; cnt--)
 				{
-					m_logger->warn("Storage operational after %d failures", m_storesFailed);
-					m_storageFailed = false;
-					m_storesFailed = 0;
+					Reading *reading = q->front();
+					if (m_logger->isInfoEnabled())
+						m_logger->info("Remove reading: %s",
+							reading->toJSON().c_str());
+					delete reading;
+					q->erase(q->begin());
+					logDiscardedStat();
 				}
-				m_failCnt = 0;
-				std::map<std::string, int>		statsEntriesCurrQueue;
-				// check if this requires addition of a new asset tracker tuple
-				// Remove the Readings in the vector
-				AssetTracker *tracker = AssetTracker::getAssetTracker();
-				StorageAssetTracker *satracker = StorageAssetTracker::getStorageAssetTracker();
-
-				string lastAsset;
-				int *lastStat = NULL;
-				std::map <std::string, std::set<std::string> > assetDatapointMap;
-				for (vector<Reading *>::iterator it = m_data->begin(); it != m_data->end(); ++it)
+				if (q->size() == 0)
 				{
-		               	        Reading *reading = *it;
-					string	assetName = reading->getAssetName();
-					const std::vector<Datapoint *> dpVec = reading->getReadingData();
-					std::string temp;
-                                        std::set<std::string> tempSet;
-                                        // first sort the individual datapoints
-                                        // e.g. dp2, dp3, dp1 push them in a set,to make them
-                                        // dp1,dp2,dp3
-                                        for ( auto dp : dpVec)
-                                        {
-                                                temp.clear();
-                                                temp.append(dp->getName());
-                                                tempSet.insert(temp);
-                                        }
-
-                                        temp.clear();
-
-                                        // Push them in a set so as to avoid duplication of datapoints
-                                        // a reading of d1, d2, d3 and another d2,d3,d1 , second will be discarded
-                                        //
-                                        for (auto dp: tempSet)
-                                        {
-                                                set<string> &s= assetDatapointMap[assetName];
-                                                if (s.find(dp) == s.end())
-                                                {
-                                                        s.insert(dp);
-                                                }
-                                        }
-
-                                        if (lastAsset.compare(assetName))
-                                        {
-						AssetTrackingTuple tuple(m_serviceName,
-									m_pluginName,
-									assetName,
-									"Ingest");
-
-						// Check Asset record exists
-						AssetTrackingTuple* res = tracker->findAssetTrackingCache(tuple);
-						if (res == NULL)
-						{
-							// Record not in cache, add it
-							tracker->addAssetTrackingTuple(tuple);
-						}
-						else
-						{
-							// Un-deprecate asset tracking record
-							unDeprecateAssetTrackingRecord(res,
-											assetName,
-											"Ingest");
-						}
-
-						lastAsset = assetName;
-                                                  lastStat = &statsEntriesCurrQueue[assetName];
-                                                  (*lastStat)++;
-                                          }
-                                          else if (lastStat)
-                                          {
-                                                  (*lastStat)++;
-                                          }
-                                          delete reading;
-
+					delete q;
+					m_resendQueues.erase(m_resendQueues.begin());
 				}
+				m_failCnt = 0;
+			}
+		}
+		else
+		{
 
-			        for (auto itr : assetDatapointMap)
-                                {
-                                        std::set<string> &s = itr.second;
-				        unsigned int count = s.size();
-				        StorageAssetTrackingTuple storageTuple(m_serviceName,m_pluginName, itr.first, "store", false, "",count);
-					StorageAssetTrackingTuple *ptr = &storageTuple;
-                                        satracker->updateCache(s, ptr);
-					bool deprecated = satracker->getDeprecated(ptr);
-					if (deprecated == true)
-					{
-						unDeprecateStorageAssetTrackingRecord(ptr, itr.first, getStringFromSet(s), count);
-					}
-                                }
+			if (m_storageFailed)
+			{
+				m_logger->warn("Storage operational after %d failures", m_storesFailed);
+				m_storageFailed = false;
+				m_storesFailed = 0;
+			}
+			m_failCnt = 0;
+			storedReadings(q);
+			delete q;
+			m_resendQueues.erase(m_resendQueues.begin());
+		}
+	}
+
+	/*
+	 * Readings that have been spilled to disk are sent next, in the
+	 * order in which they were spilled. If the storage service is
+	 * still unavailable they are left in the spill buffer.
+	 */
+	checkSpillBuffer();
+	while (m_spill && !m_spill->empty())
+	{
+		vector<Reading *> *q = m_spill->read();
+		if (!q)
+		{
+			break;
+		}
+		if (m_storage.readingAppend(*q) == false)
+		{
+			if (!m_storageFailed)
+				m_logger->warn("Still unable to send spilled data, %lu readings in spill buffer", m_spill->size());
+			m_storageFailed = true;
+			m_storesFailed++;
+			for (auto reading : *q)
+			{
+				delete reading;
+			}
+			delete q;
+			break;
+		}
+		m_spill->commit();
+		if (m_storageFailed)
+		{
+			m_logger->warn("Storage operational after %d failures", m_storesFailed);
+			m_storageFailed = false;
+			m_storesFailed = 0;
+		}
+		storedReadings(q);
+		delete q;
+	}
+}
+
+/**
+ * Send a block of filtered readings to the storage layer. If the append
+ * fails the readings are spilled to disk, if the spill buffer is enabled,
+ * or queued for resend. Called by the storage thread only.
+ *
+ * @param block	The block of readings to send, this is deleted once sent
+ */
+void Ingest::storeBlock(vector<Reading *> *block)
+{
+	/**
+	 * 'block' vector is ready to be sent to storage service.
+	 *
+	 * Note: block might contain:
+	 * - Readings set by the configured service "plugin" 
+	 * OR
+	 * - filtered readings by filter plugins in 'readingSet' object:
+	 *	1- values only
+	 *	2- some readings removed
+	 *	3- New set of readings
+	 */
+	if (!block->empty())
+	{
+		if (m_spill && !m_spill->empty() && spillReadings(block))
+		{
+			// These readings must follow those already in the spill buffer
+		}
+		else if (m_storage.readingAppend(*block) == false)
+		{
+			if (!m_storageFailed)
+				m_logger->warn("Failed to write readings to storage layer, queue for resend");
+			m_storageFailed = true;
+			m_storesFailed++;
+			if (!m_spill || !spillReadings(block))
+			{
+				m_resendQueues.push_back(block);
+				block = NULL;
+				m_failCnt = 1;
+			}
+		}
+		else
+		{
+			if (m_storageFailed)
+			{
+				m_logger->warn("Storage operational after %d failures", m_storesFailed);
+				m_storageFailed = false;
+				m_storesFailed = 0;
+			}
+			m_failCnt = 0;
+			storedReadings(block);
+		}
+	}
+
+	if (block)
+	{
+		delete block;
+	}
+}
+
+/**
+ * Calculate a fingerprint of the set of datapoint names in a reading.
+ *
+ * The hashes of the names are combined in a way that does not depend
+ * upon the order of the datapoints, so the result is the same as a hash
+ * of the sorted names but no copy or sort of the names is required.
+ *
+ * @param datapoints	The datapoints of the reading
+ * @return uint64_t	The fingerprint
+ */
+static uint64_t schemaFingerprint(const vector<Datapoint *>& datapoints)
+{
+	uint64_t fingerprint = datapoints.size();
+	for (auto dp : datapoints)
+	{
+		// FNV-1a hash of the name, mixed so that the sum of the hashes is well distributed
+		uint64_t h = 0xcbf29ce484222325ULL;
+		for (char c : dp->getName())
+		{
+			h ^= (unsigned char)c;
+			h *= 0x100000001b3ULL;
+		}
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		fingerprint += h;
+	}
+	return fingerprint;
+}
+
+/**
+ * Called once a block of readings has been sent to the storage service.
+ * Update the pending statistics, pass the assets in the block to the
+ * asset tracking thread and then delete the readings. The vector itself
+ * remains owned by the caller.
+ *
+ * The set of datapoint names in each reading is reduced to a fingerprint,
+ * these are cached per asset so that the datapoint names are only passed
+ * to the asset tracking thread when a reading has a set of datapoints
+ * that has not been seen before for the asset.
+ *
+ * @param readings	The readings that have been stored
+ */
+void Ingest::storedReadings(vector<Reading *> *readings)
+{
+	std::map<std::string, int>		statsEntriesCurrQueue;
+	std::map<std::string, std::set<std::string> >	newDatapoints;
+	const string *lastAsset = NULL;
+	int *lastStat = NULL;
+	unordered_set<uint64_t> *schemas = NULL;
+	uint64_t lastFingerprint = 0;
+	for (auto reading : *readings)
+	{
+		const string& assetName = reading->getAssetName();
+		const vector<Datapoint *>& datapoints = reading->getReadingData();
+		uint64_t fingerprint = schemaFingerprint(datapoints);
+
+		if (lastAsset == NULL || lastAsset->compare(assetName))
+		{
+			lastStat = &statsEntriesCurrQueue[assetName];
+			schemas = &m_assetSchemas[assetName];
+			lastFingerprint = ~fingerprint;
+		}
+		(*lastStat)++;
+
+		if (fingerprint != lastFingerprint)
+		{
+			if (schemas->find(fingerprint) == schemas->end())
+			{
+				if (schemas->size() >= ASSET_SCHEMA_CACHE)
+				{
+					schemas->clear();
+				}
+				schemas->insert(fingerprint);
+				set<string>& names = newDatapoints[assetName];
+				for (auto dp : datapoints)
 				{
-					unique_lock<mutex> lck(m_statsMutex);
-					for (auto &it : statsEntriesCurrQueue)
-						statsPendingEntries[it.first] += it.second;
+					names.insert(dp->getName());
 				}
 			}
+			lastFingerprint = fingerprint;
 		}
+		lastAsset = &assetName;
+		// Readings are deleted after the loop as lastAsset refers to the asset name
+	}
 
-		if (m_data)
+	{
+		lock_guard<mutex> guard(m_trackingMutex);
+		for (auto& it : statsEntriesCurrQueue)
 		{
-			delete m_data;
-			m_data = NULL;
+			set<string>& pending = m_trackingPending[it.first];
+			auto dps = newDatapoints.find(it.first);
+			if (dps != newDatapoints.end())
+			{
+				pending.insert(dps->second.begin(), dps->second.end());
+			}
+		}
+	}
+	m_trackingCv.notify_one();
+
+	for (auto reading : *readings)
+	{
+		delete reading;
+	}
+
+	{
+		unique_lock<mutex> lck(m_statsMutex);
+		for (auto &it : statsEntriesCurrQueue)
+			statsPendingEntries[it.first] += it.second;
+	}
+}
+
+/**
+ * The asset tracking thread. Waits for assets to be passed to it by
+ * the storage thread and updates the asset tracking and storage asset
+ * tracking records for those assets. Assets passed whilst the thread is
+ * busy are merged, so the work done is bounded by the number of assets
+ * rather than the rate of ingest.
+ *
+ * Once the ingest class is stopping any remaining assets are processed
+ * and the thread returns.
+ */
+void Ingest::processAssetTracking()
+{
+	while (true)
+	{
+		map<string, set<string> > pending;
+		bool stopping;
+		{
+			unique_lock<mutex> lck(m_trackingMutex);
+			m_trackingCv.wait(lck, [this] {
+					return !m_trackingPending.empty() || m_trackingStop;
+					});
+			pending.swap(m_trackingPending);
+			stopping = m_trackingStop;
+		}
+		for (auto& it : pending)
+		{
+			trackAsset(it.first, it.second);
+		}
+		if (stopping && pending.empty())
+		{
+			return;
+		}
+	}
+}
+
+/**
+ * Update the asset tracking records for an asset that has been
+ * ingested. Called by the asset tracking thread only.
+ *
+ * @param assetName	The name of the asset
+ * @param newDatapoints	Datapoint names not previously seen for the asset
+ */
+void Ingest::trackAsset(const string& assetName, const set<string>& newDatapoints)
+{
+	AssetTracker *tracker = AssetTracker::getAssetTracker();
+	AssetTrackingTuple tuple(m_serviceName,
+				m_pluginName,
+				assetName,
+				"Ingest");
+
+	// Check Asset record exists
+	AssetTrackingTuple* res = tracker->findAssetTrackingCache(tuple);
+	if (res == NULL)
+	{
+		// Record not in cache, add it
+		tracker->addAssetTrackingTuple(tuple);
+	}
+	else
+	{
+		// Un-deprecate asset tracking record
+		unDeprecateAssetTrackingRecord(res,
+						assetName,
+						"Ingest");
+	}
+
+	StorageAssetTracker *satracker = StorageAssetTracker::getStorageAssetTracker();
+	if (satracker == nullptr)
+	{
+		Logger::getLogger()->error("%s could not initialize satracker ", __FUNCTION__);
+		return;
+	}
+	set<string>& s = m_trackedDatapoints[assetName];
+	s.insert(newDatapoints.begin(), newDatapoints.end());
+	unsigned int count = s.size();
+	StorageAssetTrackingTuple storageTuple(m_serviceName,m_pluginName, assetName, "store", false, "",count);
+	StorageAssetTrackingTuple *ptr = &storageTuple;
+	if (!newDatapoints.empty())
+	{
+		satracker->updateCache(s, ptr);
+	}
+	bool deprecated = satracker->getDeprecated(ptr);
+	if (deprecated == true)
+	{
+		unDeprecateStorageAssetTrackingRecord(ptr, assetName, getStringFromSet(s), count);
+	}
+}
+
+/**
+ * Enable or disable the spill buffer. The buffer itself is created,
+ * or removed, by the storage thread, since that is the only thread
+ * that accesses it.
+ *
+ * @param enable	Spill readings that can not be sent to disk
+ * @param size		The maximum size of the spill buffer in megabytes
+ */
+void Ingest::setSpillBuffer(bool enable, unsigned long size)
+{
+	m_spillSize = size;
+	m_spillEnabled = enable;
+}
+
+/**
+ * Create the spill buffer if it has been enabled, or remove it once
+ * it is empty if it has been disabled.
+ */
+void Ingest::checkSpillBuffer()
+{
+	if (m_spillEnabled && !m_spill)
+	{
+		string name = m_serviceName;
+		replace(name.begin(), name.end(), '/', '_');
+		m_spill = new SpillBuffer(getDataDir() + "/buffers/" + name, m_spillSize * 1024 * 1024);
+	}
+	else if (m_spill && !m_spillEnabled && m_spill->empty())
+	{
+		delete m_spill;
+		m_spill = NULL;
+	}
+	else if (m_spill)
+	{
+		m_spill->setMaxSize(m_spillSize * 1024 * 1024);
+	}
+}
+
+/**
+ * Write a block of readings to the spill buffer. If the readings are
+ * written they are deleted and the vector emptied.
+ *
+ * @param readings	The readings to spill
+ * @return bool		True if the readings were spilled
+ */
+bool Ingest::spillReadings(vector<Reading *> *readings)
+{
+	unsigned long discarded = 0;
+	bool rval = m_spill->append(*readings, discarded);
+	if (discarded)
+	{
+		lock_guard<mutex> guard(m_statsMutex);
+		m_discardedReadings += discarded;
+	}
+	if (rval)
+	{
+		for (auto reading : *readings)
+		{
+			delete reading;
 		}
-		signalStatsUpdate();
-	} while (! m_fullQueues.empty());
+		readings->clear();
+	}
+	return rval;
 }
 
 /**
@@ -1043,10 +1281,13 @@ void Ingest::configChange(const string& category, const string& newConfig)
  */
 size_t Ingest::queueLength()
 {
-	size_t	len = m_queue->size();
+	size_t	len = m_queue.size();
 
-	// Approximate the amount of data in the full queues
-	len += m_fullQueues.size() * m_queueSizeThreshold;
+	// Approximate the amount of data waiting to be stored or resent
+	{
+		lock_guard<mutex> guard(m_storeMutex);
+		len += m_storeQueue.size() * m_queueSizeThreshold;
+	}
 	len += m_resendQueues.size() * m_queueSizeThreshold;
 
 	return len;
@@ -0,0 +1,206 @@
+/*
+ * Fledge reading ingest.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <ingest_queue.h>
+
+using namespace std;
+
+/**
+ * Construct an empty queue. The queue always contains a stub
+ * batch so that the producers and the consumer never contend on
+ * the same pointer.
+ */
+IngestQueue::IngestQueue() : m_head(&m_stub), m_tail(&m_stub), m_count(0)
+{
+}
+
+/**
+ * Destroy the queue and any readings that remain in it
+ */
+IngestQueue::~IngestQueue()
+{
+	vector<Reading *> readings;
+	drain(readings, m_count);
+	for (auto reading : readings)
+	{
+		delete reading;
+	}
+}
+
+/**
+ * Add a single reading to the queue. The queue takes ownership
+ * of the reading.
+ *
+ * @param reading	The reading to add
+ * @return size_t	The number of readings in the queue
+ */
+size_t IngestQueue::push(Reading *reading)
+{
+	Batch *batch = new Batch;
+	batch->m_reading = reading;
+	return push(batch, 1);
+}
+
+/**
+ * Add a set of readings to the queue. The queue takes ownership of
+ * the readings but not of the vector.
+ *
+ * @param readings	The readings to add
+ * @return size_t	The number of readings in the queue
+ */
+size_t IngestQueue::push(const vector<Reading *>& readings)
+{
+	if (readings.empty())
+	{
+		return m_count;
+	}
+	Batch *batch = new Batch;
+	batch->m_readings = readings;
+	return push(batch, readings.size());
+}
+
+/**
+ * Add a set of readings to the queue, the vector is moved into the
+ * queue rather than copied. The queue takes ownership of the readings.
+ *
+ * @param readings	The readings to add
+ * @return size_t	The number of readings in the queue
+ */
+size_t IngestQueue::push(vector<Reading *>&& readings)
+{
+	if (readings.empty())
+	{
+		return m_count;
+	}
+	size_t count = readings.size();
+	Batch *batch = new Batch;
+	batch->m_readings = std::move(readings);
+	return push(batch, count);
+}
+
+/**
+ * Link a batch onto the head of the queue.
+ *
+ * The exchange makes the batch the new head, the link from the previous
+ * head is made afterwards. Until that link is made the consumer sees the
+ * queue end at the previous head, so a batch is never seen before
+ * it is complete.
+ *
+ * @param batch	The batch to add
+ * @param count	The number of readings in the batch
+ * @return size_t	The number of readings in the queue
+ */
+size_t IngestQueue::push(Batch *batch, size_t count)
+{
+	batch->m_next.store(NULL, memory_order_relaxed);
+	size_t queued = m_count.fetch_add(count) + count;
+	Batch *prev = m_head.exchange(batch, memory_order_acq_rel);
+	prev->m_next.store(batch, memory_order_release);
+	return queued;
+}
+
+/**
+ * Remove the oldest batch from the queue. Must only be called by
+ * the consumer.
+ *
+ * @return Batch	The oldest batch or NULL if none is available
+ */
+IngestQueue::Batch *IngestQueue::pop()
+{
+	Batch *tail = m_tail;
+	Batch *next = tail->m_next.load(memory_order_acquire);
+	if (tail == &m_stub)
+	{
+		if (!next)
+		{
+			return NULL;
+		}
+		m_tail = next;
+		tail = next;
+		next = next->m_next.load(memory_order_acquire);
+	}
+	if (next)
+	{
+		m_tail = next;
+		return tail;
+	}
+	if (tail != m_head.load(memory_order_acquire))
+	{
+		// A producer is part way through adding a batch
+		return NULL;
+	}
+	// Put the stub back so that the last batch can be removed
+	push(&m_stub, 0);
+	next = tail->m_next.load(memory_order_acquire);
+	if (next)
+	{
+		m_tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+/**
+ * Move readings from the queue to the vector passed in. Batches are
+ * always moved as a whole, so more than the maximum may be returned.
+ * Must only be called by the consumer.
+ *
+ * @param readings	The vector to append the readings to
+ * @param max		The number of readings wanted
+ * @return size_t	The number of readings moved
+ */
+size_t IngestQueue::drain(vector<Reading *>& readings, size_t max)
+{
+	size_t n = 0;
+	while (n < max)
+	{
+		Batch *batch = pop();
+		if (!batch)
+		{
+			break;
+		}
+		if (batch->m_reading)
+		{
+			readings.push_back(batch->m_reading);
+			n++;
+		}
+		else
+		{
+			readings.insert(readings.end(), batch->m_readings.begin(), batch->m_readings.end());
+			n += batch->m_readings.size();
+		}
+		delete batch;
+	}
+	m_count -= n;
+	return n;
+}
+
+/**
+ * Return the oldest reading in the queue without removing it. Must
+ * only be called by the consumer.
+ *
+ * @return Reading	The oldest reading or NULL if the queue is empty
+ */
+Reading *IngestQueue::oldest()
+{
+	Batch *batch = m_tail;
+	if (batch == &m_stub)
+	{
+		batch = batch->m_next.load(memory_order_acquire);
+	}
+	if (!batch || batch == &m_stub)
+	{
+		return NULL;
+	}
+	if (batch->m_reading)
+	{
+		return batch->m_reading;
+	}
+	return batch->m_readings.empty() ? NULL : batch->m_readings[0];
+}
@@ -197,7 +197,7 @@ int	size;
  */
 void doIngest(Ingest *ingest, Reading reading)
 {
-	ingest->ingest(reading);
+	ingest->ingest(std::move(reading));
 }
 
 void doIngestV2(Ingest *ingest, ReadingSet *set)
@@ -213,13 +213,13 @@ void doIngestV2(Ingest *ingest, ReadingSet *set)
     {
         for (auto & r : *vec)
         {
-            Reading *r2 = new Reading(*r); // Need to copy reading objects here, since "del set" below would remove encapsulated reading objects also
+            Reading *r2 = new Reading(std::move(*r)); // Move the content of the reading objects here, since "del set" below would remove encapsulated reading objects also
             vec2->emplace_back(r2);
         }
     }
     Logger::getLogger()->debug("%s:%d: V2 async ingest method returned: vec->size()=%d", __FUNCTION__, __LINE__, vec->size());
 
-	ingest->ingest(vec2);
+	ingest->ingest(std::move(*vec2));
 	delete vec2; 	// each reading object inside vector has been allocated on heap and moved to Ingest class's internal queue
 	delete set;
 }
@@ -401,6 +401,7 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 		{
 			m_ingest->setStatistics(m_configAdvanced.getValue("statistics"));
 		}
+		setSpillBuffer();
 
 		try {
 			m_readingsPerSec = 1;
@@ -538,7 +539,7 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 							Reading reading = southPlugin->poll();
 							if (reading.getDatapointCount())
 							{
-								ingest.ingest(reading);
+								ingest.ingest(std::move(reading));
 							}
 							++pollCount;
 						}
@@ -574,13 +575,13 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				    {
 					for (auto & r : *vec)
 					{
-					    Reading *r2 = new Reading(*r); // Need to copy reading objects here, since "del set" below would remove encapsulated reading objects
+					    Reading *r2 = new Reading(std::move(*r)); // Move the content of the reading objects here, since "del set" below would remove encapsulated reading objects
 					    vec2->emplace_back(r2);
 					}
 				    }
 
-							ingest.ingest(vec2);
 							pollCount += (int) vec2->size();
+							ingest.ingest(std::move(*vec2));
 							delete vec2; 	// each reading object inside vector has been allocated on heap and moved to Ingest class's internal queue
 							delete set;
 				}
@@ -944,6 +945,7 @@ void SouthService::processConfigChange(const string& categoryName, const string&
 		{
 			m_ingest->setTimeout(strtol(m_configAdvanced.getValue("maxSendLatency").c_str(), NULL, 10));
 		}
+		setSpillBuffer();
 		if (m_configAdvanced.itemExists("logLevel"))
 		{
 			string prevLogLevel = logger->getMinLevel();
@@ -1100,6 +1102,9 @@ void SouthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 
 		}
 	}
+	defaultConfig.setItemAttribute("spillBufferSize", ConfigCategory::MINIMUM_ATTR, "1");
+	defaultConfig.setItemAttribute("spillBufferSize",
+			ConfigCategory::VALIDITY_ATTR, "spillBuffer == \"true\"");
 
 	if (!isAsync)
 	{
@@ -1164,6 +1169,28 @@ void SouthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 	defaultConfig.setItemDisplayName("statistics", "Statistics Collection");
 }
 
+/**
+ * Configure the spill buffer of the ingest class from the advanced
+ * configuration of the service
+ */
+void SouthService::setSpillBuffer()
+{
+	bool enable = false;
+	unsigned long size = 1024;
+	if (m_configAdvanced.itemExists("spillBuffer"))
+	{
+		string spill = m_configAdvanced.getValue("spillBuffer");
+		enable = (spill[0] == 't' || spill[0] == 'T');
+	}
+	if (m_configAdvanced.itemExists("spillBufferSize"))
+	{
+		size = strtoul(m_configAdvanced.getValue("spillBufferSize").c_str(), NULL, 10);
+		if (size < 1)
+			size = 1;
+	}
+	m_ingest->setSpillBuffer(enable, size);
+}
+
 /**
  * Create a timer FD on which a read would return data every time the given 
  * interval elapses
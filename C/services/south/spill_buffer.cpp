@@ -0,0 +1,605 @@
+/*
+ * Fledge reading ingest.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <spill_buffer.h>
+#include <reading_stream_codec.h>
+#include <logger.h>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+
+/**
+ * Construct a spill buffer in the given directory. Any segments left
+ * in the directory by a previous run of the service are recovered so
+ * that the readings they hold are sent once the storage service is
+ * available.
+ *
+ * @param directory	The directory to hold the segment files
+ * @param maxSize	The maximum disk space in bytes to use
+ */
+SpillBuffer::SpillBuffer(const string& directory, size_t maxSize) :
+	m_directory(directory), m_maxSize(maxSize), m_diskSize(0), m_nextSeq(0),
+	m_pendingOffset(0), m_pendingCount(0), m_readings(0)
+{
+	recover();
+}
+
+/**
+ * Destroy the spill buffer. The segment files are left in place, any
+ * readings not yet sent will be recovered when the buffer is next
+ * created.
+ */
+SpillBuffer::~SpillBuffer()
+{
+	for (auto segment : m_segments)
+	{
+		delete segment;
+	}
+}
+
+/**
+ * Recover the segments in the spill directory, creating the directory
+ * if it does not exist.
+ */
+void SpillBuffer::recover()
+{
+	// Create the directory, and any missing parents
+	for (size_t pos = 1; pos != string::npos; )
+	{
+		pos = m_directory.find('/', pos + 1);
+		string dir = m_directory.substr(0, pos);
+		if (mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST)
+		{
+			Logger::getLogger()->error("Unable to create spill buffer directory %s: %s",
+					dir.c_str(), strerror(errno));
+			return;
+		}
+	}
+
+	DIR *dir = opendir(m_directory.c_str());
+	if (!dir)
+	{
+		Logger::getLogger()->error("Unable to open spill buffer directory %s: %s",
+				m_directory.c_str(), strerror(errno));
+		return;
+	}
+	vector<uint32_t> sequences;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		uint32_t seq;
+		char suffix[8];
+		if (sscanf(entry->d_name, "segment-%u.%7s", &seq, suffix) == 2
+				&& strcmp(suffix, "spill") == 0)
+		{
+			sequences.push_back(seq);
+		}
+	}
+	closedir(dir);
+	sort(sequences.begin(), sequences.end());
+
+	for (auto seq : sequences)
+	{
+		char name[40];
+		snprintf(name, sizeof(name), "/segment-%08u.spill", seq);
+		Segment *segment = new Segment(m_directory + name, seq);
+		if (!segment->open() || !scan(segment) || segment->m_unread == 0)
+		{
+			unlink(segment->m_path.c_str());
+			delete segment;
+			continue;
+		}
+		segment->unmap();
+		m_segments.push_back(segment);
+		m_diskSize += segment->m_size;
+		m_readings += segment->m_unread;
+		m_nextSeq = seq + 1;
+	}
+	if (m_readings)
+	{
+		Logger::getLogger()->warn("Recovered %lu readings from the spill buffer in %s",
+				(unsigned long)m_readings, m_directory.c_str());
+	}
+}
+
+/**
+ * Scan the records of a segment to find the end of the valid data
+ * in the segment and the number of readings that have not been sent.
+ *
+ * @param segment	The segment to scan
+ * @return bool		False if the segment is not a valid segment
+ */
+bool SpillBuffer::scan(Segment *segment)
+{
+	SpillSegmentHeader *hdr = segment->header();
+	if (segment->m_size < sizeof(SpillSegmentHeader) || hdr->magic != SPILL_SEGMENT_MAGIC
+			|| hdr->version != SPILL_VERSION)
+	{
+		Logger::getLogger()->error("Spill buffer segment %s is not valid and will be removed",
+				segment->m_path.c_str());
+		return false;
+	}
+	size_t offset = sizeof(SpillSegmentHeader);
+	segment->m_unread = 0;
+	while (offset + sizeof(SpillRecordHeader) <= segment->m_size)
+	{
+		SpillRecordHeader *rec = (SpillRecordHeader *)(segment->m_base + offset);
+		if (rec->magic != SPILL_RECORD_MAGIC
+				|| rec->length > segment->m_size - offset - sizeof(SpillRecordHeader)
+				|| checksum(segment->m_base + offset + sizeof(SpillRecordHeader), rec->length) != rec->checksum)
+		{
+			break;
+		}
+		if (offset >= hdr->readOffset)
+		{
+			segment->m_unread += rec->count;
+		}
+		offset += sizeof(SpillRecordHeader) + rec->length;
+	}
+	segment->m_writeOffset = offset;
+	if (hdr->readOffset > offset)
+	{
+		segment->setReadOffset(offset);
+	}
+	return true;
+}
+
+/**
+ * Append a block of readings to the spill buffer. The readings
+ * remain owned by the caller.
+ *
+ * If adding a new segment would take the buffer beyond the maximum
+ * disk space, or there is no space left on the disk for a new segment,
+ * then the oldest segments are discarded.
+ *
+ * @param readings	The readings to append
+ * @param discarded	Incremented by the number of readings discarded
+ * @return bool		True if the readings were written to the buffer
+ */
+bool SpillBuffer::append(const vector<Reading *>& readings, unsigned long& discarded)
+{
+	string body;
+	for (auto reading : readings)
+	{
+		encode(reading, body);
+	}
+	size_t length = sizeof(SpillRecordHeader) + body.length();
+
+	Segment *tail = m_segments.empty() ? NULL : m_segments.back();
+	if (!tail || tail->m_writeOffset + length > tail->m_size)
+	{
+		while ((tail = newSegment(length)) == NULL)
+		{
+			if (errno != ENOSPC || m_segments.empty())
+			{
+				return false;
+			}
+			// The disk is full, make room by discarding the oldest segment
+			discarded += m_segments.front()->m_unread;
+			Logger::getLogger()->warn("No space left for the spill buffer, discarding %lu readings",
+					m_segments.front()->m_unread);
+			removeHead();
+		}
+	}
+	if (!tail->m_base && !tail->map())
+	{
+		return false;
+	}
+
+	SpillRecordHeader *rec = (SpillRecordHeader *)(tail->m_base + tail->m_writeOffset);
+	rec->length = body.length();
+	rec->count = readings.size();
+	rec->checksum = checksum(body.data(), body.length());
+	memcpy(tail->m_base + tail->m_writeOffset + sizeof(SpillRecordHeader), body.data(), body.length());
+	// Setting the magic last marks the record as complete
+	__atomic_store_n(&rec->magic, SPILL_RECORD_MAGIC, __ATOMIC_RELEASE);
+
+	// Schedule the write back of the record, it is already safe from a crash of the service
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = tail->m_writeOffset & ~(page - 1);
+	msync(tail->m_base + start, tail->m_writeOffset + length - start, MS_ASYNC);
+
+	tail->m_writeOffset += length;
+	tail->m_unread += readings.size();
+	m_readings += readings.size();
+
+	// Discard anything over the limit, other than the segment just written
+	while (m_diskSize > m_maxSize && m_segments.size() > 1)
+	{
+		discarded += m_segments.front()->m_unread;
+		Logger::getLogger()->warn("Spill buffer exceeds %lu bytes, discarding %lu readings",
+				m_maxSize, m_segments.front()->m_unread);
+		removeHead();
+	}
+	return true;
+}
+
+/**
+ * Read the oldest block of readings from the spill buffer. The block
+ * is not removed from the buffer until commit is called, if the
+ * readings can not be sent the next call to read will return the
+ * same block.
+ *
+ * @return vector	The readings, or NULL if the buffer is empty
+ */
+vector<Reading *> *SpillBuffer::read()
+{
+	while (!m_segments.empty())
+	{
+		Segment *head = m_segments.front();
+		if (!head->m_base && !head->map())
+		{
+			return NULL;
+		}
+		uint64_t offset = head->header()->readOffset;
+		if (offset >= head->m_writeOffset)
+		{
+			if (head == m_segments.back())
+			{
+				return NULL;
+			}
+			removeHead();
+			continue;
+		}
+		SpillRecordHeader *rec = (SpillRecordHeader *)(head->m_base + offset);
+		const char *p = head->m_base + offset + sizeof(SpillRecordHeader);
+		const char *end = p + rec->length;
+		vector<Reading *> *readings = new vector<Reading *>;
+		for (uint32_t i = 0; i < rec->count; i++)
+		{
+			Reading *reading = decode(p, end);
+			if (!reading)
+			{
+				break;
+			}
+			readings->push_back(reading);
+		}
+		if (readings->size() != rec->count)
+		{
+			Logger::getLogger()->error("Corrupt record in spill buffer segment %s, %lu readings lost",
+					head->m_path.c_str(), head->m_unread);
+			for (auto reading : *readings)
+			{
+				delete reading;
+			}
+			delete readings;
+			m_readings -= head->m_unread;
+			head->m_unread = 0;
+			head->setReadOffset(head->m_writeOffset);
+			continue;
+		}
+		m_pendingOffset = offset + sizeof(SpillRecordHeader) + rec->length;
+		m_pendingCount = rec->count;
+		return readings;
+	}
+	return NULL;
+}
+
+/**
+ * Remove the block returned by the last call to read from the spill
+ * buffer, the readings have been sent to the storage service.
+ */
+void SpillBuffer::commit()
+{
+	if (m_segments.empty() || m_pendingCount == 0)
+	{
+		return;
+	}
+	Segment *head = m_segments.front();
+	head->setReadOffset(m_pendingOffset);
+	head->m_unread -= m_pendingCount;
+	m_readings -= m_pendingCount;
+	m_pendingCount = 0;
+	if (head->m_unread == 0 && head != m_segments.back())
+	{
+		removeHead();
+	}
+}
+
+/**
+ * Return the size of the segments to create. The maximum disk space is
+ * divided into SPILL_SEGMENTS segments so that discarding the oldest
+ * segment keeps the buffer within the maximum, the segment size is
+ * bounded by SPILL_MIN_SEGMENT_SIZE and SPILL_SEGMENT_SIZE.
+ *
+ * @return size_t	The size of a new segment
+ */
+size_t SpillBuffer::segmentSize()
+{
+	size_t size = m_maxSize / SPILL_SEGMENTS;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size = (size + page - 1) & ~(page - 1);
+	return min(max(size, (size_t)SPILL_MIN_SEGMENT_SIZE), (size_t)SPILL_SEGMENT_SIZE);
+}
+
+/**
+ * Create a new segment at the end of the buffer. A record larger than
+ * the segment size is given a segment of its own.
+ *
+ * @param minSize	The size of the record that must fit in the segment
+ * @return Segment	The new segment or NULL on failure, errno gives the cause
+ */
+SpillBuffer::Segment *SpillBuffer::newSegment(size_t minSize)
+{
+	size_t size = max(segmentSize(), minSize + sizeof(SpillSegmentHeader));
+	char name[40];
+	snprintf(name, sizeof(name), "/segment-%08u.spill", m_nextSeq);
+	Segment *segment = new Segment(m_directory + name, m_nextSeq);
+	if (!segment->create(size))
+	{
+		int err = errno;
+		Logger::getLogger()->error("Unable to create spill buffer segment %s: %s",
+				segment->m_path.c_str(), strerror(err));
+		delete segment;
+		errno = err;
+		return NULL;
+	}
+	m_nextSeq++;
+	if (!m_segments.empty() && m_segments.back() != m_segments.front())
+	{
+		// Only the head and tail segments are kept mapped
+		m_segments.back()->unmap();
+	}
+	m_segments.push_back(segment);
+	m_diskSize += size;
+	return segment;
+}
+
+/**
+ * Remove the oldest segment from the buffer and the disk
+ */
+void SpillBuffer::removeHead()
+{
+	Segment *head = m_segments.front();
+	m_segments.pop_front();
+	m_readings -= head->m_unread;
+	m_diskSize -= head->m_size;
+	m_pendingCount = 0;
+	unlink(head->m_path.c_str());
+	delete head;
+}
+
+/**
+ * Append the encoded form of a reading to a record body
+ *
+ * @param reading	The reading to encode
+ * @param body		The record body to append to
+ */
+void SpillBuffer::encode(Reading *reading, string& body)
+{
+	struct timeval tv;
+	int64_t times[4];
+	reading->getUserTimestamp(&tv);
+	times[0] = tv.tv_sec;
+	times[1] = tv.tv_usec;
+	reading->getTimestamp(&tv);
+	times[2] = tv.tv_sec;
+	times[3] = tv.tv_usec;
+	body.append((const char *)times, sizeof(times));
+
+	const string& asset = reading->getAssetName();
+	uint32_t assetLength = asset.length();
+	body.append((const char *)&assetLength, sizeof(assetLength));
+	body.append(asset.data(), assetLength);
+
+	string payload;
+	ReadingStreamCodec::encode(*reading, payload);
+	uint32_t payloadLength = payload.length();
+	body.append((const char *)&payloadLength, sizeof(payloadLength));
+	body.append(payload);
+}
+
+/**
+ * Decode a reading from a record body
+ *
+ * @param p	The position in the body, advanced past the reading
+ * @param end	The end of the record body
+ * @return Reading	The reading or NULL if the record is corrupt
+ */
+Reading *SpillBuffer::decode(const char *& p, const char *end)
+{
+	int64_t times[4];
+	uint32_t assetLength;
+	uint32_t payloadLength;
+
+	if (end - p < (long)(sizeof(times) + sizeof(assetLength)))
+		return NULL;
+	memcpy(times, p, sizeof(times));
+	p += sizeof(times);
+	memcpy(&assetLength, p, sizeof(assetLength));
+	p += sizeof(assetLength);
+	if ((size_t)(end - p) < (size_t)assetLength + sizeof(payloadLength))
+		return NULL;
+	string asset(p, assetLength);
+	p += assetLength;
+	memcpy(&payloadLength, p, sizeof(payloadLength));
+	p += sizeof(payloadLength);
+	if (end - p < (long)payloadLength)
+		return NULL;
+	vector<Datapoint *> *datapoints = ReadingStreamCodec::decode(p, payloadLength);
+	p += payloadLength;
+	if (!datapoints)
+		return NULL;
+
+	Reading *reading = new Reading(asset, *datapoints);
+	delete datapoints;
+	struct timeval tv;
+	tv.tv_sec = times[0];
+	tv.tv_usec = times[1];
+	reading->setUserTimestamp(tv);
+	tv.tv_sec = times[2];
+	tv.tv_usec = times[3];
+	reading->setTimestamp(tv);
+	return reading;
+}
+
+/**
+ * Calculate the FNV-1a checksum of a record body
+ *
+ * @param data		The data to checksum
+ * @param length	The length of the data
+ */
+uint32_t SpillBuffer::checksum(const char *data, size_t length)
+{
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)data[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/**
+ * Construct a segment
+ *
+ * @param path	The path of the segment file
+ * @param seq	The sequence number of the segment
+ */
+SpillBuffer::Segment::Segment(const string& path, uint32_t seq) : m_path(path), m_seq(seq),
+	m_fd(-1), m_base(NULL), m_size(0), m_writeOffset(0), m_unread(0)
+{
+}
+
+/**
+ * Destroy a segment, unmapping and closing the file
+ */
+SpillBuffer::Segment::~Segment()
+{
+	unmap();
+	closeFile();
+}
+
+/**
+ * Close the segment file if it is open
+ */
+void SpillBuffer::Segment::closeFile()
+{
+	if (m_fd != -1)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+/**
+ * Create a new segment file of the given size and write the
+ * segment header. The disk blocks of the segment are allocated up
+ * front, a sparse file would fault with SIGBUS when a page of the
+ * mapping is first written to a full disk. On failure the file is
+ * removed and errno is set to the cause of the failure.
+ *
+ * @param size	The size of the segment
+ * @return bool	True if the segment was created
+ */
+bool SpillBuffer::Segment::create(size_t size)
+{
+	if ((m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600)) == -1)
+	{
+		return false;
+	}
+	int err = posix_fallocate(m_fd, 0, (off_t)size);
+	if (err != 0)
+	{
+		closeFile();
+		unlink(m_path.c_str());
+		errno = err;
+		return false;
+	}
+	m_size = size;
+	if (!map())
+	{
+		err = errno;
+		closeFile();
+		unlink(m_path.c_str());
+		errno = err;
+		return false;
+	}
+	SpillSegmentHeader *hdr = header();
+	hdr->version = SPILL_VERSION;
+	hdr->readOffset = sizeof(SpillSegmentHeader);
+	hdr->magic = SPILL_SEGMENT_MAGIC;
+	m_writeOffset = sizeof(SpillSegmentHeader);
+	return true;
+}
+
+/**
+ * Open an existing segment file
+ *
+ * @return bool	True if the segment was opened and mapped
+ */
+bool SpillBuffer::Segment::open()
+{
+	struct stat st;
+	if ((m_fd = ::open(m_path.c_str(), O_RDWR)) == -1)
+	{
+		return false;
+	}
+	if (fstat(m_fd, &st) == -1 || st.st_size < (off_t)sizeof(SpillSegmentHeader))
+	{
+		closeFile();
+		return false;
+	}
+	m_size = (size_t)st.st_size;
+	if (!map())
+	{
+		closeFile();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Map the segment file into memory
+ *
+ * @return bool	True if the segment was mapped
+ */
+bool SpillBuffer::Segment::map()
+{
+	void *base = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (base == MAP_FAILED)
+	{
+		Logger::getLogger()->error("Unable to map spill buffer segment %s: %s",
+				m_path.c_str(), strerror(errno));
+		return false;
+	}
+	m_base = (char *)base;
+	return true;
+}
+
+/**
+ * Unmap the segment file, it is mapped again when next required
+ */
+void SpillBuffer::Segment::unmap()
+{
+	if (m_base)
+	{
+		munmap(m_base, m_size);
+		m_base = NULL;
+	}
+}
+
+/**
+ * Record the offset of the next record to be sent in the
+ * segment header.
+ *
+ * @param offset	The new read offset
+ */
+void SpillBuffer::Segment::setReadOffset(uint64_t offset)
+{
+	header()->readOffset = offset;
+}
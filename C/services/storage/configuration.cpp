@@ -33,7 +33,7 @@ static const char *defaultConfiguration = QUOTE({
 		"default" : "Use main plugin",
 		"description" : "The storage plugin to load for readings data.",
 		"type" : "enumeration",
-		"options" : [ "Use main plugin", "sqlite", "sqlitelb", "sqlitememory", "postgres" ],
+		"options" : [ "Use main plugin", "sqlite", "sqlitelb", "sqlitememory", "ringbuffer", "postgres" ],
 		"displayName" : "Readings Plugin",
 		"order" : "2"
 		},
@@ -77,6 +77,34 @@ static const char *defaultConfiguration = QUOTE({
 		"displayName" : "Log Level",
 		"options" : [ "error", "warning", "info", "debug" ],
 		"order" : "7"
+	},
+	"streamThreads" : {
+		"value" : "1",
+		"default" : "1",
+		"description" : "The number of threads used to receive and insert the readings of high speed ingest streams",
+		"type" : "integer",
+		"displayName" : "Stream threads",
+		"minimum" : "1",
+		"maximum" : "16",
+		"order" : "8"
+	},
+	"workerThreads" : {
+		"value" : "5",
+		"default" : "5",
+		"description" : "The number of threads used to execute readings append, fetch and purge requests",
+		"type" : "integer",
+		"displayName" : "Worker threads",
+		"minimum" : "1",
+		"order" : "9"
+	},
+	"workerQueue" : {
+		"value" : "100",
+		"default" : "100",
+		"description" : "The maximum number of readings requests that may wait for a worker thread before requests are rejected",
+		"type" : "integer",
+		"displayName" : "Worker queue size",
+		"minimum" : "1",
+		"order" : "10"
 	}
 });
 
@@ -15,6 +15,8 @@
 #include <storage_stats.h>
 #include <storage_registry.h>
 #include <stream_handler.h>
+#include <storage_workers.h>
+#include <functional>
 
 using namespace std;
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
@@ -26,6 +28,7 @@ using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 #define COMMON_QUERY		"^/storage/table/([A-Za-z][a-zA-Z_0-9]*)/query$"
 #define READING_ACCESS  	"^/storage/reading$"
 #define READING_QUERY   	"^/storage/reading/query"
+#define READING_FETCH_BINARY	"^/storage/reading/binary$"
 #define READING_PURGE   	"^/storage/reading/purge"
 #define READING_INTEREST	"^/storage/reading/interest/([A-Za-z\\*][a-zA-Z0-9_%\\.\\-]*)$"
 #define TABLE_INTEREST		"^/storage/table/interest/([A-Za-z\\*][a-zA-Z0-9_%\\.\\-]*)$"
@@ -64,6 +67,12 @@ public:
 	void	initResources();
 	void	setPlugin(StoragePlugin *);
 	void	setReadingPlugin(StoragePlugin *);
+	void	setStreamThreads(unsigned int threads) { m_streamThreads = threads; };
+	void	setWorkers(unsigned int threads, unsigned int queue)
+		{
+			m_workerThreads = threads;
+			m_workerQueue = queue;
+		};
 	void	start();
 	void	startServer();
 	void	wait();
@@ -76,7 +85,8 @@ public:
 	void	commonDelete(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	defaultResource(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingAppend(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
-	void	readingFetch(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	readingFetch(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request,
+				bool binary = false);
 	void	readingQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingPurge(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingRegister(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
@@ -99,15 +109,18 @@ public:
 
 	void	printList();
 	bool	createSchema(const std::string& schema);
-
-public:
-	std::atomic<int>        m_workers_count;
+	bool	queueRequest(shared_ptr<HttpServer::Response> response,
+			StorageWorkers::Priority priority, std::function<void()> work);
 
 private:
         static StorageApi       *m_instance;
         HttpServer              *m_server;
 	unsigned short          m_port;
 	unsigned int		m_threads;
+	unsigned int		m_streamThreads;
+	unsigned int		m_workerThreads;
+	unsigned int		m_workerQueue;
+	StorageWorkers		*m_workers;
         thread                  *m_thread;
 	StoragePlugin		*plugin;
 	StoragePlugin		*readingPlugin;
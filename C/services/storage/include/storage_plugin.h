@@ -43,6 +43,8 @@ public:
 	int		commonDelete(const std::string& table, const std::string& payload, const char *schema = nullptr);
 	int		readingsAppend(const std::string& payload);
 	char		*readingsFetch(unsigned long id, unsigned int blksize);
+	bool		hasBinaryFetch() { return readingsFetchBinaryPtr != NULL; };
+	char		*readingsFetchBinary(unsigned long id, unsigned int blksize, size_t *length);
 	char		*readingsRetrieve(const std::string& payload);
 	char		*readingsPurge(unsigned long age, unsigned int flags, unsigned long sent);
 	long		*readingsPurge();
@@ -54,6 +56,7 @@ public:
 	char		*getTableSnapshots(const std::string& table);
 	PLUGIN_ERROR	*lastError();
 	bool		hasStreamSupport() { return readingStreamPtr != NULL; };
+	bool		acceptsBinaryStream();
 	int		readingStream(ReadingStream **stream, bool commit);
 	bool		pluginShutdown();
 	int 		createSchema(const std::string& payload);
@@ -72,6 +75,7 @@ private:
         int             (*storageSchemaDeletePtr)(PLUGIN_HANDLE, const char *, const char *, const char*) = nullptr;
 	int		(*readingsAppendPtr)(PLUGIN_HANDLE, const char *);
 	char		*(*readingsFetchPtr)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize);
+	char		*(*readingsFetchBinaryPtr)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize, size_t *length);
 	char		*(*readingsRetrievePtr)(PLUGIN_HANDLE, const char *payload);
 	char		*(*readingsPurgePtr)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent);
 	unsigned int	(*readingsPurgeAssetPtr)(PLUGIN_HANDLE, const char *asset);
@@ -12,6 +12,9 @@
 #include <json_provider.h>
 #include <string>
 
+class StreamHandler;
+class StorageWorkers;
+
 class StorageStats : public JSONProvider {
 	public:
 		StorageStats();
@@ -25,5 +28,7 @@ class StorageStats : public JSONProvider {
 		unsigned int readingFetch;
 		unsigned int readingQuery;
 		unsigned int readingPurge;
+		StreamHandler *streamHandler;
+		StorageWorkers *workers;
 };
 #endif
@@ -0,0 +1,67 @@
+#ifndef _STORAGE_WORKERS_H
+#define _STORAGE_WORKERS_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#define DEFAULT_WORKER_THREADS	5	// Default number of worker threads
+#define DEFAULT_WORKER_QUEUE	100	// Default number of requests that may be queued
+
+/**
+ * A bounded pool of worker threads used to execute the readings
+ * requests of the storage API.
+ *
+ * Requests are queued with a priority, the workers always take the
+ * highest priority request that is waiting. Low priority requests,
+ * such as purges, are never allowed to occupy every worker, so one
+ * long running purge can not stall the ingest of readings. Once the
+ * queue is full further requests are rejected and the caller is
+ * expected to ask the client to retry later.
+ */
+class StorageWorkers {
+	public:
+		enum Priority { High = 0, Normal, Low, NumPriorities };
+
+		StorageWorkers(unsigned int threads, unsigned int maxQueued);
+		~StorageWorkers();
+		bool		submit(Priority priority, std::function<void()> work);
+		unsigned int	queued();
+		unsigned int	active() { return m_active; };
+		unsigned long	rejected() { return m_rejected; };
+		unsigned int	threads() { return m_numThreads; };
+	private:
+		void		worker();
+		bool		runnable(Priority& priority);
+	private:
+		std::deque<std::function<void()> >
+				m_queues[NumPriorities];
+		unsigned int	m_queued;
+		unsigned int	m_maxQueued;
+		unsigned int	m_activeLow;
+		const unsigned int
+				m_numThreads;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_cv;
+		std::vector<std::thread>
+				m_threads;
+		bool		m_shutdown;
+		std::atomic<unsigned int>
+				m_active;
+		std::atomic<unsigned long>
+				m_rejected;
+};
+#endif
@@ -14,34 +14,63 @@
 #include <condition_variable>
 #include <vector>
 #include <map>
+#include <deque>
+#include <atomic>
+#include <string>
 #include <sys/epoll.h>
 #include <reading_stream.h>
 
 #define MAX_EVENTS	  40	// Number of epoll events in one epoll_wait call
 #define RDS_BLOCK	 10000	// Number of readings to insert in each call to the storage plugin
 #define BLOCK_POOL_SIZES 512	// Increments of block sizes in a block pool
+#define MAX_QUEUED_BLOCKS  4	// Maximum number of blocks a stream may have waiting for insert
+#define MAX_STREAM_THREADS 16	// Upper limit on the number of stream reactor threads
 
 class StorageApi;
 
+/**
+ * The stream handler is responsible for the high speed reading streams
+ * that clients create with the storage service.
+ *
+ * Streams are distributed over a number of reactors. Each reactor has a
+ * thread that uses epoll to parse the stream protocol for the streams
+ * pinned to it and a second thread that passes the parsed blocks of
+ * readings to the storage plugin. Socket handling and database inserts
+ * therefore overlap and one slow insert does not stall the streams
+ * served by other reactors.
+ */
 class StreamHandler {
 	public:
-		StreamHandler(StorageApi *);
+		StreamHandler(StorageApi *, unsigned int threads = 1);
 		~StreamHandler();
-		void			handler();
 		uint32_t		createStream(uint32_t *token);
+		void			statsJSON(std::string& json);
 	private:
+		class Reactor;
+		class Stream;
+		void			destroyStream(Stream *stream);
 		class Stream {
 			public:
-				Stream();
+				Stream(Reactor *reactor);
 				~Stream();
 				uint32_t	create(int epollfd, uint32_t *token);
-				void		handleEvent(int epollfd, StorageApi *api, uint32_t events);
+				void		handleEvent(int epollfd, uint32_t events);
+				void		inserted(ReadingStream **readings, unsigned int nReadings,
+							unsigned long usecs);
+				void		statsJSON(std::string& json);
+				bool		isClosed() { return m_closed; };
+				bool		detach();
+				bool		blockInserted();
+				void		pause(int epollfd);
+				void		resume(int epollfd);
 			private:
 				/**
 				 * A simple memory pool we use to store the messages we receive.
 				 * We use this rather than malloc because it let's us avoid the overhead of
 				 * the more complex heap mamagement and also because it means we avoid
-				 * taking out a process wide mutex.
+				 * taking out a process wide mutex. The pool is shared between
+				 * the reactor thread that allocates the blocks and the insert
+				 * thread that releases them, hence it has its own lock.
 				 */
 				class MemoryPool {
 						public:
@@ -60,13 +89,16 @@ class StreamHandler {
 							size_t		m_blkIncr;
 							std::map<size_t, std::vector<void *>* >
 									m_pool;
+							std::mutex	m_poolMutex;
 					};
 					void		setNonBlocking(int fd);
 					unsigned int	available(int fd);
-					void		queueInsert(StorageApi *api, unsigned int nReadings, bool commit);
+					bool		queueInsert(unsigned int nReadings, bool commit);
+					void		closeSocket(int epollfd, const char *reason);
 					void		dump(int n);
 					enum { Closed, Listen, AwaitingToken, Connected }
 				       			m_status;
+					int		m_protocol;
 					int		m_socket;
 					uint16_t	m_port;
 					uint32_t	m_token;
@@ -83,14 +115,68 @@ class StreamHandler {
 					MemoryPool	*m_blockPool;
 					std::string	m_lastAsset;
 					bool		m_sameAsset;
+					Reactor		*m_reactor;
+					bool		m_paused;	// Protected by the reactor queue mutex
+					bool		m_detached;	// Protected by the reactor queue mutex
+					std::atomic<bool>
+							m_closed;
+				public:
+					std::atomic<unsigned int>
+							m_queued;
+					std::atomic<unsigned long>
+							m_blocksInserted;
+					std::atomic<unsigned long>
+							m_readingsInserted;
+					std::atomic<unsigned long>
+							m_lastInsertUsecs;
+					std::atomic<unsigned long>
+							m_totalInsertUsecs;
+		};
+		/**
+		 * A block of readings waiting to be inserted into the
+		 * storage plugin
+		 */
+		class InsertBlock {
+			public:
+				Stream			*m_stream;
+				std::vector<ReadingStream *>
+							m_readings;
+				bool			m_commit;
+		};
+		/**
+		 * A reactor, the epoll thread for a set of streams and the
+		 * insert thread that writes the readings of those streams
+		 */
+		class Reactor {
+			public:
+				Reactor(StreamHandler *handler);
+				~Reactor();
+				void			poll();
+				void			insert();
+				void			addStream();
+				void			removeStream();
+				void			releaseStream(Stream *stream);
+				bool			queueInsert(InsertBlock *block);
+				unsigned int		streamCount() { return m_nStreams; };
+				int			pollfd() { return m_pollfd; };
+			private:
+				StreamHandler		*m_handler;
+				int			m_pollfd;
+				std::atomic<unsigned int>
+							m_nStreams;
+				std::mutex		m_streamsMutex;
+				std::condition_variable	m_streamsCV;
+				std::deque<InsertBlock *>
+							m_queue;
+				std::mutex		m_queueMutex;
+				std::condition_variable	m_queueCV;
+				std::thread		m_pollThread;
+				std::thread		m_insertThread;
 		};
 		StorageApi		*m_api;
-		std::thread		m_handlerThread;
-		int			m_tokens;
-		std::condition_variable	m_streamsCV;
 		std::mutex		m_streamsMutex;
 		std::vector<Stream *>	m_streams;
-		bool			m_running;
-		int			m_pollfd;
+		std::vector<Reactor *>	m_reactors;
+		std::atomic<bool>	m_running;
 };
 #endif
@@ -226,6 +226,21 @@ unsigned short servicePort;
 	{
 		threads = (unsigned int)atoi(config->getValue("threads"));
 	}
+	unsigned int workerThreads = DEFAULT_WORKER_THREADS;
+	if (config->hasValue("workerThreads"))
+	{
+		workerThreads = (unsigned int)atoi(config->getValue("workerThreads"));
+	}
+	unsigned int workerQueue = DEFAULT_WORKER_QUEUE;
+	if (config->hasValue("workerQueue"))
+	{
+		workerQueue = (unsigned int)atoi(config->getValue("workerQueue"));
+	}
+	unsigned int streamThreads = 1;
+	if (config->hasValue("streamThreads"))
+	{
+		streamThreads = (unsigned int)atoi(config->getValue("streamThreads"));
+	}
 	if (config->hasValue("logLevel"))
 	{
 		logger->setMinLevel(config->getValue("logLevel"));
@@ -237,6 +252,8 @@ unsigned short servicePort;
 
 
 	api = new StorageApi(servicePort, threads);
+	api->setStreamThreads(streamThreads);
+	api->setWorkers(workerThreads, workerQueue);
 }
 
 /**
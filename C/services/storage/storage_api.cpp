@@ -26,12 +26,14 @@
 #endif
 
 #include <string_utils.h>
+#include <reading_stream_codec.h>
+#include <reading_set.h>
 
-// Enable worker threads for readings append and fetch
+// Enable worker threads for readings append, fetch and purge
 #define WORKER_THREADS		1
 
-// Threshold for logging number of threads in use for some "readings" wrappers
-#define MAX_WORKER_THREADS	5
+// Number of seconds a client is asked to wait when the workers are busy
+#define WORKER_RETRY_AFTER	1
 
 /**
  * Definition of the Storage Service REST API
@@ -122,30 +124,10 @@ void readingAppendWrapper(shared_ptr<HttpServer::Response> response,
 {
 	StorageApi *api = StorageApi::getInstance();
 #if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
+	api->queueRequest(response, StorageWorkers::High, [api, response, request]
 	{
-		Logger::getLogger()->warn("Storage API: readingAppend() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
-	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
 		api->readingAppend(response, request);
-
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
 	});
-	// Detach the new thread
-	work_thread.detach();
 #else
 	api->readingAppend(response, request);
 #endif
@@ -159,35 +141,32 @@ void readingFetchWrapper(shared_ptr<HttpServer::Response> response,
 {
 	StorageApi *api = StorageApi::getInstance();
 #if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
-	{
-		Logger::getLogger()->warn("Storage API: readingFetch() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
+	api->queueRequest(response, StorageWorkers::Normal, [api, response, request]
 	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
 		api->readingFetch(response, request);
-
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
 	});
-	// Detach the new thread
-	work_thread.detach();
 #else
 	api->readingFetch(response, request);
 #endif
 }
 
+/**
+ * Wrapper function for the binary reading fetch API call.
+ */
+void readingFetchBinaryWrapper(shared_ptr<HttpServer::Response> response,
+			 shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+#if WORKER_THREADS
+	api->queueRequest(response, StorageWorkers::Normal, [api, response, request]
+	{
+		api->readingFetch(response, request, true);
+	});
+#else
+	api->readingFetch(response, request, true);
+#endif
+}
+
 /**
  * Wrapper function for the reading query API call.
  */
@@ -206,29 +185,10 @@ void readingPurgeWrapper(shared_ptr<HttpServer::Response> response,
 {
 	StorageApi *api = StorageApi::getInstance();
 #if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
+	api->queueRequest(response, StorageWorkers::Low, [api, response, request]
 	{
-		Logger::getLogger()->warn("Storage API: readingPurge() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
-	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
 		api->readingPurge(response, request);
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
 	});
-	// Detach the new thread
-	work_thread.detach();
 #else
 	api->readingPurge(response, request);
 #endif
@@ -385,7 +345,9 @@ void storageTableQueryWrapper(shared_ptr<HttpServer::Response> response,
 /**
  * Construct the singleton Storage API 
  */
-StorageApi::StorageApi(const unsigned short port, const unsigned int threads) : readingPlugin(0), streamHandler(0)
+StorageApi::StorageApi(const unsigned short port, const unsigned int threads) : m_streamThreads(1),
+	m_workerThreads(DEFAULT_WORKER_THREADS), m_workerQueue(DEFAULT_WORKER_QUEUE), m_workers(0),
+	readingPlugin(0), streamHandler(0)
 {
 
 	m_port = port;
@@ -422,8 +384,9 @@ unsigned short StorageApi::getListenerPort()
  */
 void StorageApi::initResources()
 {
-	// Initialise workers threads counter
-	m_workers_count = ATOMIC_VAR_INIT(0);
+	// Create the pool of workers that execute the readings requests
+	m_workers = new StorageWorkers(m_workerThreads, m_workerQueue);
+	stats.workers = m_workers;
 
 	// Initialise the API entry points
 	m_server->resource[COMMON_ACCESS]["POST"] = commonInsertWrapper;
@@ -449,6 +412,7 @@ void StorageApi::initResources()
 
 	m_server->resource[READING_ACCESS]["POST"] = readingAppendWrapper;
 	m_server->resource[READING_ACCESS]["GET"] = readingFetchWrapper;
+	m_server->resource[READING_FETCH_BINARY]["GET"] = readingFetchBinaryWrapper;
 	m_server->resource[READING_QUERY]["PUT"] = readingQueryWrapper;
 	m_server->resource[READING_PURGE]["PUT"] = readingPurgeWrapper;
 
@@ -523,6 +487,34 @@ void StorageApi::respond(shared_ptr<HttpServer::Response> response, const string
 }
 
 
+/**
+ * Queue a readings request for execution by the pool of worker threads.
+ * If the pool already has the maximum number of requests waiting then
+ * respond with a 503 and a Retry-After header so that the client backs
+ * off rather than adding to the contention on the storage plugin.
+ *
+ * @param response	The response stream to send the response on
+ * @param priority	The priority of the request
+ * @param work		The work to execute for the request
+ * @return bool		True if the request was queued
+ */
+bool StorageApi::queueRequest(shared_ptr<HttpServer::Response> response,
+			StorageWorkers::Priority priority, std::function<void()> work)
+{
+	if (m_workers->submit(priority, work))
+	{
+		return true;
+	}
+	Logger::getLogger()->warn("Storage API: worker queue is full, %d requests waiting, %d workers busy",
+			m_workers->queued(), m_workers->active());
+	string payload = "{ \"entryPoint\" : \"readings\", \"message\" : \"Storage service is busy, retry later\", \"retryable\" : true }";
+	*response << "HTTP/1.1 " << status_code(SimpleWeb::StatusCode::server_error_service_unavailable)
+		<< "\r\nContent-Length: " << payload.length() << "\r\n"
+		<< "Retry-After: " << WORKER_RETRY_AFTER << "\r\n"
+		<<  "Content-type: application/json\r\n\r\n" << payload;
+	return false;
+}
+
 /**
  * Construct an HTTP response with the specified return code using the payload
  * provided.
@@ -852,11 +844,21 @@ string  responsePayload;
 /**
  * Fetch a block of readings.
  *
+ * The readings are returned either as a JSON document or, if binary
+ * is true, as a binary fetch block that the client can decode into
+ * readings without parsing JSON. Plugins that provide the binary fetch
+ * entry point build the block themselves and it is written to the
+ * response as it is. For other plugins the JSON result of the plugin
+ * is parsed and encoded as a block by the storage service, which saves
+ * the client from parsing the JSON but not the service.
+ *
  * @param response	The response stream to send the response on
  * @param request	The HTTP request
+ * @param binary	Return a binary fetch block
  */
 void StorageApi::readingFetch(shared_ptr<HttpServer::Response> response,
-			      shared_ptr<HttpServer::Request> request)
+			      shared_ptr<HttpServer::Request> request,
+			      bool binary)
 {
 SimpleWeb::CaseInsensitiveMultimap query;
 unsigned long			   id = 0;
@@ -892,8 +894,50 @@ unsigned long			   count = 0;
 			count = (unsigned)atol(search->second.c_str());
 		}
 
+		StoragePlugin *fetchPlugin = readingPlugin ? readingPlugin : plugin;
+		if (binary && fetchPlugin->hasBinaryFetch())
+		{
+			size_t length = 0;
+			char *block = fetchPlugin->readingsFetchBinary(id, count, &length);
+			if (!block)
+			{
+				string payload = "{ \"error\" : \"Unable to fetch readings\" }";
+				respond(response,
+					SimpleWeb::StatusCode::server_error_internal_server_error,
+					payload);
+				return;
+			}
+			*response << "HTTP/1.1 200 OK\r\nContent-Length: " << length << "\r\n"
+				 <<  "Content-type: application/octet-stream\r\n\r\n";
+			response->write(block, (streamsize)length);
+			free(block);
+			return;
+		}
+
 		// Get plugin data
-		char *responsePayload = (readingPlugin ? readingPlugin : plugin)->readingsFetch(id, count);
+		char *responsePayload = fetchPlugin->readingsFetch(id, count);
+		if (binary)
+		{
+			string block;
+			try {
+				ReadingSet readings(responsePayload);
+				ReadingStreamCodec::encodeBlock(readings.getAllReadings(), block);
+			} catch (ReadingSetException *ex) {
+				free(responsePayload);
+				string payload = "{ \"error\" : \"";
+				payload += ex->what();
+				payload += "\" }";
+				delete ex;
+				respond(response,
+					SimpleWeb::StatusCode::server_error_internal_server_error,
+					payload);
+				return;
+			}
+			free(responsePayload);
+			*response << "HTTP/1.1 200 OK\r\nContent-Length: " << block.length() << "\r\n"
+				 <<  "Content-type: application/octet-stream\r\n\r\n" << block;
+			return;
+		}
 		string res = responsePayload;
 
 		// Reply to client
@@ -1231,7 +1275,8 @@ string	responsePayload;
 	try {
 		if (!streamHandler)
 		{
-			streamHandler = new StreamHandler(this);
+			streamHandler = new StreamHandler(this, m_streamThreads);
+			stats.streamHandler = streamHandler;
 		}
 		uint32_t token;
 		uint32_t port = streamHandler->createStream(&token);
@@ -1241,6 +1286,10 @@ string	responsePayload;
 			responsePayload += to_string(port);
 			responsePayload += ", \"token\":"; 
 			responsePayload += to_string(token);
+			responsePayload += ", \"protocol\":"; 
+			StoragePlugin *streamPlugin = readingPlugin ? readingPlugin : plugin;
+			responsePayload += to_string(streamPlugin->acceptsBinaryStream()
+					? RDS_PROTOCOL_VERSION : RDS_PROTOCOL_JSON);
 			responsePayload += " }";
 			respond(response, responsePayload);
 		}
@@ -1271,6 +1320,7 @@ bool StorageApi::readingStream(ReadingStream **readings, bool commit)
 		// Plugin does not support streaming input
 		ostringstream convert;
 		char	ts[60], micro_s[10];
+		string	json;
 		
 
 		convert << "{\"readings\":[";
@@ -1287,7 +1337,21 @@ bool StorageApi::readingStream(ReadingStream **readings, bool commit)
 			snprintf(micro_s, sizeof(micro_s), ".%06lu", readings[i]->userTs.tv_usec);
 			convert << ts << micro_s;
 			convert << "\",\"reading\":";
-			convert << &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+			const char *payload = &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+			if (RDS_PAYLOAD_IS_BINARY(payload))
+			{
+				if (!ReadingStreamCodec::toJSON(payload, readings[i]->payloadLength, json))
+				{
+					Logger::getLogger()->error("Malformed binary payload in stream for asset %s, the block of readings has been discarded",
+							readings[i]->assetCode);
+					return false;
+				}
+				convert << json;
+			}
+			else
+			{
+				convert << payload;
+			}
 			convert << "}";
 		}
 		convert << "]}";
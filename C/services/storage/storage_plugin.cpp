@@ -104,6 +104,8 @@ StoragePlugin::StoragePlugin(const string& name, PLUGIN_HANDLE handle) : Plugin(
 				manager->resolveSymbol(handle, "plugin_reading_append");
 	readingsFetchPtr = (char * (*)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize))
 				manager->resolveSymbol(handle, "plugin_reading_fetch");
+	readingsFetchBinaryPtr = (char * (*)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize, size_t *length))
+				manager->resolveSymbol(handle, "plugin_reading_fetch_binary");
 	readingsRetrievePtr = (char * (*)(PLUGIN_HANDLE, const char *))
 				manager->resolveSymbol(handle, "plugin_reading_retrieve");
 	readingsPurgePtr = (char * (*)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent))
@@ -220,6 +222,16 @@ char * StoragePlugin::readingsFetch(unsigned long id, unsigned int blksize)
 	return this->readingsFetchPtr(instance, id, blksize);
 }
 
+/**
+ * Call the binary readings fetch method in the plugin. The plugin
+ * returns a binary fetch block and its length, the caller must
+ * free the block.
+ */
+char * StoragePlugin::readingsFetchBinary(unsigned long id, unsigned int blksize, size_t *length)
+{
+	return this->readingsFetchBinaryPtr(instance, id, blksize, length);
+}
+
 /**
  * Call the readings retrieve method in the plugin
  */
@@ -314,6 +326,20 @@ int StoragePlugin::readingStream(ReadingStream **stream, bool commit)
         return this->readingStreamPtr(instance, stream, commit);
 }
 
+/**
+ * Return true if binary encoded reading payloads may be sent to the
+ * plugin via the reading stream. Plugins without stream support are
+ * fed JSON converted by the storage service, plugins that implement
+ * the stream entry point must declare SP_BINARY_STREAM to receive
+ * the binary encoding.
+ */
+bool StoragePlugin::acceptsBinaryStream()
+{
+	if (!hasStreamSupport())
+		return true;
+	return (getInfo()->options & SP_BINARY_STREAM) != 0;
+}
+
 /**
  * Call the shutdown entry point of the plugin
  */
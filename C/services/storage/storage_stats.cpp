@@ -8,6 +8,8 @@
  * Author: Mark Riddoch
  */
 #include <storage_stats.h>
+#include <stream_handler.h>
+#include <storage_workers.h>
 #include <string>
 #include <sstream>
 
@@ -19,7 +21,8 @@ using namespace std;
 StorageStats::StorageStats() : commonInsert(0), commonSimpleQuery(0),
 				commonQuery(0), commonUpdate(0), commonDelete(0),
 				readingAppend(0), readingFetch(0),
-				readingQuery(0), readingPurge(0)
+				readingQuery(0), readingPurge(0), streamHandler(NULL),
+				workers(NULL)
 {
 }
 
@@ -38,7 +41,20 @@ ostringstream convert;   // stream used for the conversion
 	convert << " \"readingAppend\" : " << readingAppend << ",";
 	convert << " \"readingFetch\" : " << readingFetch << ",";
 	convert << " \"readingQuery\" : " << readingQuery << ",";
-	convert << " \"readingPurge\" : " << readingPurge << " }";
+	convert << " \"readingPurge\" : " << readingPurge;
+	if (workers)
+	{
+		convert << ", \"workerQueued\" : " << workers->queued();
+		convert << ", \"workerActive\" : " << workers->active();
+		convert << ", \"workerRejected\" : " << workers->rejected();
+	}
+	if (streamHandler)
+	{
+		string streams;
+		streamHandler->statsJSON(streams);
+		convert << ", \"streams\" : " << streams;
+	}
+	convert << " }";
 
 	json = convert.str();
 }
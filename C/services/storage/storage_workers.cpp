@@ -0,0 +1,149 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <storage_workers.h>
+#include <logger.h>
+
+using namespace std;
+
+/**
+ * Construct the worker pool and start the worker threads
+ *
+ * @param threads	The number of worker threads
+ * @param maxQueued	The maximum number of requests that may be waiting
+ */
+StorageWorkers::StorageWorkers(unsigned int threads, unsigned int maxQueued) :
+	m_queued(0), m_maxQueued(maxQueued), m_activeLow(0),
+	m_numThreads(threads < 1 ? 1 : threads), m_shutdown(false),
+	m_active(0), m_rejected(0)
+{
+	Logger::getLogger()->info("Starting %d storage worker threads with a queue of %d requests",
+			m_numThreads, maxQueued);
+	// The workers only use m_numThreads, never m_threads, which is
+	// modified here while the earlier workers are already running
+	m_threads.reserve(m_numThreads);
+	for (unsigned int i = 0; i < m_numThreads; i++)
+	{
+		m_threads.push_back(thread(&StorageWorkers::worker, this));
+	}
+}
+
+/**
+ * Destroy the worker pool. Requests that are already queued are
+ * executed before the worker threads terminate.
+ */
+StorageWorkers::~StorageWorkers()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+	}
+	m_cv.notify_all();
+	for (auto& t : m_threads)
+	{
+		t.join();
+	}
+}
+
+/**
+ * Queue a request for execution by the worker threads
+ *
+ * @param priority	The priority of the request
+ * @param work		The work to execute
+ * @return bool		False if the queue is full and the request was rejected
+ */
+bool StorageWorkers::submit(Priority priority, function<void()> work)
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (m_queued >= m_maxQueued)
+		{
+			m_rejected++;
+			return false;
+		}
+		m_queues[priority].push_back(work);
+		m_queued++;
+	}
+	m_cv.notify_one();
+	return true;
+}
+
+/**
+ * Return the number of requests waiting for a worker
+ */
+unsigned int StorageWorkers::queued()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_queued;
+}
+
+/**
+ * Find the highest priority queue with a request that may be run
+ * now. Low priority requests are held back if running them would
+ * leave no worker free for other requests. Must be called with the
+ * mutex held.
+ *
+ * @param priority	Set to the priority of the queue to take from
+ * @return bool		True if a request may be run
+ */
+bool StorageWorkers::runnable(Priority& priority)
+{
+	for (int i = High; i < NumPriorities; i++)
+	{
+		if (m_queues[i].empty())
+			continue;
+		if (i == Low && m_numThreads > 1 && m_activeLow >= m_numThreads - 1)
+			continue;
+		priority = (Priority)i;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * The worker thread, take requests from the queues in priority order
+ * and execute them.
+ */
+void StorageWorkers::worker()
+{
+	while (true)
+	{
+		function<void()> work;
+		Priority priority;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_cv.wait(lock, [this, &priority] {
+					return runnable(priority) || (m_shutdown && m_queued == 0);
+					});
+			if (m_queued == 0)
+				return;
+			work = move(m_queues[priority].front());
+			m_queues[priority].pop_front();
+			m_queued--;
+			if (priority == Low)
+				m_activeLow++;
+		}
+		m_active++;
+		try {
+			work();
+		} catch (exception& e) {
+			Logger::getLogger()->error("Storage worker request failed: %s", e.what());
+		}
+		m_active--;
+		if (priority == Low)
+		{
+			{
+				lock_guard<mutex> guard(m_mutex);
+				m_activeLow--;
+			}
+			// A held back low priority request may now be runnable
+			m_cv.notify_all();
+		}
+	}
+}
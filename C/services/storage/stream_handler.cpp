@@ -9,7 +9,6 @@
  */
 #include <stream_handler.h>
 #include <storage_api.h>
-#include <storage_api.h>
 #include <reading_stream.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -17,6 +16,7 @@
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <chrono>
+#include <algorithm>
 #include <unistd.h>
 #include <errno.h>
 
@@ -24,50 +24,203 @@
 using namespace std;
 
 /**
- * C wrapper for the handler thread we use to handle the polling of
- * the stream ingestion protocol.
+ * Constructor for the StreamHandler class
  *
- * @param handler	The SgtreamHanler instance that started this thread
+ * @param api		The storage API instance
+ * @param threads	The number of reactors to distribute streams over
  */
-static void threadWrapper(void *handler)
+StreamHandler::StreamHandler(StorageApi *api, unsigned int threads) : m_api(api), m_running(true)
 {
-	((StreamHandler *)handler)->handler();
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_STREAM_THREADS)
+		threads = MAX_STREAM_THREADS;
+	Logger::getLogger()->info("Creating %d stream reactor threads", threads);
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		m_reactors.push_back(new Reactor(this));
+	}
 }
 
+
 /**
- * Constructor for the StreamHandler class
+ * Destructor for the StreamHandler. Close down the reactors and wait
+ * for the handler threads to terminate.
  */
-StreamHandler::StreamHandler(StorageApi *api) : m_api(api), m_running(true)
+StreamHandler::~StreamHandler()
 {
-	m_pollfd = epoll_create(1);
-	m_handlerThread = thread(threadWrapper, this);
+	m_running = false;
+	for (auto reactor : m_reactors)
+	{
+		delete reactor;
+	}
+	for (auto stream : m_streams)
+	{
+		delete stream;
+	}
 }
 
+/**
+ * Create a new stream and add it to the epoll mechanism of the
+ * reactor with the fewest streams. The stream remains pinned to
+ * that reactor for its lifetime so that the readings of a stream
+ * are always inserted in the order they were received.
+ *
+ * @param token		The single use connection token the client should send
+ * @param The port on which this stream is listening
+ */
+uint32_t StreamHandler::createStream(uint32_t *token)
+{
+	Reactor *reactor = m_reactors[0];
+	for (auto r : m_reactors)
+	{
+		if (r->streamCount() < reactor->streamCount())
+			reactor = r;
+	}
+	Stream *stream = new Stream(reactor);
+	uint32_t port = stream->create(reactor->pollfd(), token);
+	{
+		std::unique_lock<std::mutex> lock(m_streamsMutex);
+		m_streams.push_back(stream);
+	}
+
+	reactor->addStream();
+
+	return port;
+}
 
 /**
- * Destructor for the StreamHandler. Close down the epoll
- * system and wait for the handler thread to terminate.
+ * Return the statistics of the streams as a JSON array
+ *
+ * @param json	The string to which the JSON is written
  */
-StreamHandler::~StreamHandler()
+void StreamHandler::statsJSON(string& json)
 {
-	m_running = false;
+	std::unique_lock<std::mutex> lock(m_streamsMutex);
+	json = "[";
+	bool first = true;
+	for (auto stream : m_streams)
+	{
+		if (stream->isClosed())
+			continue;
+		if (!first)
+			json += ", ";
+		first = false;
+		stream->statsJSON(json);
+	}
+	json += "]";
+}
+
+/**
+ * Remove a stream that has been closed and whose readings have all
+ * been inserted, and free it
+ *
+ * @param stream	The stream to destroy
+ */
+void StreamHandler::destroyStream(Stream *stream)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_streamsMutex);
+		for (auto it = m_streams.begin(); it != m_streams.end(); ++it)
+		{
+			if (*it == stream)
+			{
+				m_streams.erase(it);
+				break;
+			}
+		}
+	}
+	delete stream;
+}
+
+/**
+ * Construct a reactor, create the epoll descriptor and start the
+ * poll and insert threads.
+ *
+ * @param handler	The stream handler that owns the reactor
+ */
+StreamHandler::Reactor::Reactor(StreamHandler *handler) : m_handler(handler), m_nStreams(0)
+{
+	m_pollfd = epoll_create(1);
+	m_pollThread = thread(&StreamHandler::Reactor::poll, this);
+	m_insertThread = thread(&StreamHandler::Reactor::insert, this);
+}
+
+/**
+ * Destroy a reactor. The owning stream handler has already cleared
+ * the running flag, wake the threads and wait for them to terminate.
+ * Any blocks that are still queued are inserted before the insert
+ * thread exits.
+ */
+StreamHandler::Reactor::~Reactor()
+{
+	m_streamsCV.notify_all();
+	m_queueCV.notify_all();
+	m_pollThread.join();
+	m_insertThread.join();
 	close(m_pollfd);
-	m_handlerThread.join();
 }
 
 /**
- * The handler method for the stream handler. This is run in its own thread
+ * Record the addition of a stream to this reactor. The stream has
+ * already been added to the epoll descriptor, wake the poll thread
+ * if it is waiting for the first stream.
+ */
+void StreamHandler::Reactor::addStream()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_streamsMutex);
+		m_nStreams++;
+	}
+	m_streamsCV.notify_all();
+}
+
+/**
+ * Record the removal of a stream from this reactor when the stream
+ * is closed, so that it no longer counts towards the load of the reactor
+ */
+void StreamHandler::Reactor::removeStream()
+{
+	std::unique_lock<std::mutex> lock(m_streamsMutex);
+	if (m_nStreams > 0)
+		m_nStreams--;
+}
+
+/**
+ * Called by the poll thread once it has finished with a stream that
+ * has been closed. The stream is destroyed now if none of its blocks
+ * are waiting to be inserted, otherwise by the insert thread once the
+ * last of them has been inserted.
+ *
+ * @param stream	The closed stream
+ */
+void StreamHandler::Reactor::releaseStream(Stream *stream)
+{
+	bool idle;
+	{
+		std::unique_lock<std::mutex> lock(m_queueMutex);
+		idle = stream->detach();
+	}
+	if (idle)
+	{
+		m_handler->destroyStream(stream);
+	}
+}
+
+/**
+ * The poll method for a reactor. This is run in its own thread
  * and is responsible for using epoll to gather events on the descriptors and
- * to dispatch them to the individual streams
+ * to dispatch them to the individual streams. Streams closed by an event
+ * are released once all the events returned with it have been handled.
  */
-void StreamHandler::handler()
+void StreamHandler::Reactor::poll()
 {
 	struct epoll_event events[MAX_EVENTS];
-	while (m_running)
+	while (m_handler->m_running)
 	{
-		std::unique_lock<std::mutex> lock(m_streamsMutex);
-		if (m_streams.size() == 0)
+		if (m_nStreams == 0)
 		{
+			std::unique_lock<std::mutex> lock(m_streamsMutex);
 			Logger::getLogger()->debug("Waiting for first stream to be created");
 			m_streamsCV.wait_for(lock, chrono::milliseconds(500));
 		}
@@ -85,14 +238,24 @@ void StreamHandler::handler()
 			}
 			if (nfds == -1)
 			{
-				Logger::getLogger()->error("Stream epoll error: %s", strerror(errno));
+				if (errno != EINTR)
+					Logger::getLogger()->error("Stream epoll error: %s", strerror(errno));
 			}
 			else
 			{
+				vector<Stream *> closed;
 				for (int i = 0; i < nfds; i++)
 				{
 					Stream *stream = (Stream *)events[i].data.ptr;
-					stream->handleEvent(m_pollfd, m_api, events[i].events);
+					stream->handleEvent(m_pollfd, events[i].events);
+					if (stream->isClosed() && find(closed.begin(), closed.end(), stream) == closed.end())
+					{
+						closed.push_back(stream);
+					}
+				}
+				for (auto stream : closed)
+				{
+					releaseStream(stream);
 				}
 			}
 		}
@@ -100,29 +263,80 @@ void StreamHandler::handler()
 }
 
 /**
- * Create a new stream and add it to the epoll mechanism for the stream handler
+ * Queue a block of readings for the insert thread of the reactor.
  *
- * @param token		The single use connection token the client should send
- * @param The port on which this stream is listening
+ * If the stream now has MAX_QUEUED_BLOCKS blocks waiting then its socket
+ * is removed from the poll set until the insert thread catches up. This
+ * stops us reading from that socket and applies back pressure to the
+ * client via TCP flow control rather than growing the memory pools
+ * without bound, whilst the other streams of the reactor carry on.
+ *
+ * @param block	The block of readings to insert
+ * @return	True if the stream has been paused
  */
-uint32_t StreamHandler::createStream(uint32_t *token)
+bool StreamHandler::Reactor::queueInsert(InsertBlock *block)
 {
-	Stream *stream = new Stream();
-	uint32_t port = stream->create(m_pollfd, token);
+	bool paused = false;
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	block->m_stream->m_queued++;
+	if (block->m_stream->m_queued >= MAX_QUEUED_BLOCKS)
 	{
-		std::unique_lock<std::mutex> lock(m_streamsMutex);
-		m_streams.push_back(stream);
+		block->m_stream->pause(m_pollfd);
+		paused = true;
 	}
+	m_queue.push_back(block);
+	m_queueCV.notify_one();
+	return paused;
+}
 
-	m_streamsCV.notify_all();
-
-	return port;
+/**
+ * The insert method of a reactor. This is run in its own thread and
+ * passes the blocks of readings queued by the poll thread to the
+ * storage plugin.
+ */
+void StreamHandler::Reactor::insert()
+{
+	while (true)
+	{
+		InsertBlock *block;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			while (m_queue.empty() && m_handler->m_running)
+			{
+				m_queueCV.wait_for(lock, chrono::milliseconds(500));
+			}
+			if (m_queue.empty())
+			{
+				return;
+			}
+			block = m_queue.front();
+			m_queue.pop_front();
+		}
+		auto start = chrono::steady_clock::now();
+		m_handler->m_api->readingStream(block->m_readings.data(), block->m_commit);
+		unsigned long usecs = (unsigned long)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+		block->m_stream->inserted(block->m_readings.data(), block->m_readings.size() - 1, usecs);
+		bool idle;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			idle = block->m_stream->blockInserted();
+		}
+		if (idle)
+		{
+			m_handler->destroyStream(block->m_stream);
+		}
+		delete block;
+	}
 }
 
 /**
  * Create a stream object to deal with the stream protocol
+ *
+ * @param reactor	The reactor the stream is pinned to
  */
-StreamHandler::Stream::Stream() : m_status(Closed)
+StreamHandler::Stream::Stream(Reactor *reactor) : m_status(Closed), m_protocol(RDS_PROTOCOL_JSON),
+	m_reactor(reactor), m_paused(false), m_detached(false), m_closed(false), m_queued(0), m_blocksInserted(0), m_readingsInserted(0),
+	m_lastInsertUsecs(0), m_totalInsertUsecs(0)
 {
 }
 
@@ -224,45 +438,37 @@ void StreamHandler::Stream::setNonBlocking(int fd)
  * reading the block header the individual reading headers and the
  * readings themselves. 
  *
- * TODO Improve memory handling, use seperate threads for inserts, send acknowledgements
+ * Binary encoded reading payloads are accepted on connections that
+ * negotiated version 2 of the protocol, they are passed through to
+ * the storage plugin which converts them to its stored representation.
+ *
+ * Completed blocks of readings are queued to the insert thread of the reactor
+ * the stream is pinned to, the poll thread continues with the next block.
+ *
+ * TODO Improve memory handling, send acknowledgements
  *
  * @param epollfd	The epoll file descriptor
+ * @param events	The epoll events for the stream
  */
-void StreamHandler::Stream::handleEvent(int epollfd, StorageApi *api, uint32_t events)
+void StreamHandler::Stream::handleEvent(int epollfd, uint32_t events)
 {
 ssize_t n;
 
 	if (events & EPOLLRDHUP)
 	{
-		// TODO mark this stream for destruction
-		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
-		close(m_socket);
-		Logger::getLogger()->error("Closing stream...");
-		m_status = Closed;
+		closeSocket(epollfd, "Closing stream...");
 	}
 	if (events & EPOLLHUP)
 	{
-		// TODO mark this stream for destruction
-		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
-		close(m_socket);
-		Logger::getLogger()->error("Hangup on socket Closing stream...");
-		m_status = Closed;
+		closeSocket(epollfd, "Hangup on socket Closing stream...");
 	}
 	if (events & EPOLLPRI)
 	{
-		// TODO mark this stream for destruction
-		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
-		close(m_socket);
-		Logger::getLogger()->error("Eceptional condition  on socket Closing stream...");
-		m_status = Closed;
+		closeSocket(epollfd, "Eceptional condition  on socket Closing stream...");
 	}
 	if (events & EPOLLERR)
 	{
-		// TODO mark this stream for destruction
-		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
-		close(m_socket);
-		m_status = Closed;
-		Logger::getLogger()->error("Error condition  on socket Closing stream...");
+		closeSocket(epollfd, "Error condition  on socket Closing stream...");
 	}
 	if (events & EPOLLIN)
 	{
@@ -304,13 +510,16 @@ ssize_t n;
 				Logger::getLogger()->warn("Token exchange failed: Short read of %d bytes: %s", n, strerror(errno));
 				return;
 			}
-			if (hdr.magic == RDS_CONNECTION_MAGIC && hdr.token == m_token)
+			if ((hdr.magic == RDS_CONNECTION_MAGIC || hdr.magic == RDS_CONNECTION_MAGIC_V2)
+					&& hdr.token == m_token)
 			{
+				m_protocol = hdr.magic == RDS_CONNECTION_MAGIC_V2 ?
+						RDS_PROTOCOL_BINARY : RDS_PROTOCOL_JSON;
 				m_status = Connected;
 				m_blockNo = 0;
 				m_readingNo = 0;
 				m_protocolState = BlkHdr;
-				Logger::getLogger()->info("Token for streaming socket exchanged");
+				Logger::getLogger()->info("Token for streaming socket exchanged, protocol version %d", m_protocol);
 			}
 			else
 			{
@@ -393,7 +602,8 @@ ssize_t n;
 						Logger::getLogger()->warn("Not enough bytes read %d for reading header", n);
 						return;
 					}
-					if (rdhdr.magic != RDS_READING_MAGIC)
+					if (rdhdr.magic != RDS_READING_MAGIC &&
+						(rdhdr.magic != RDS_BINARY_READING_MAGIC || m_protocol != RDS_PROTOCOL_BINARY))
 					{
 						Logger::getLogger()->error("Expected reading header %d of %d in block %d, but incorrect header found 0x%x", m_readingNo, m_blockSize, m_blockNo, rdhdr.magic);
 						dump(10);
@@ -462,19 +672,16 @@ ssize_t n;
 					}
 					m_readingNo++;
 					m_protocolState = RdHdr;
+					bool paused = false;
 					if ((m_readingNo % RDS_BLOCK) == 0)
 					{
-						queueInsert(api, RDS_BLOCK, false);
-						for (int i = 0; i < RDS_BLOCK; i++)
-							m_blockPool->release(m_readings[i]);
+						paused = queueInsert(RDS_BLOCK, false);
 					}
 					else if (m_readingNo == m_blockSize)
 					{
 						// We have completed the block, insert readings and wait
 						// for a block header
-						queueInsert(api, m_readingNo % RDS_BLOCK, true);
-						for (uint32_t i = 0; i < m_readingNo % RDS_BLOCK; i++)
-							m_blockPool->release(m_readings[i]);
+						paused = queueInsert(m_readingNo % RDS_BLOCK, true);
 						m_protocolState = BlkHdr;
 						Logger::getLogger()->warn("Waiting for the next block header");
 					}
@@ -482,23 +689,159 @@ ssize_t n;
 					{
 						Logger::getLogger()->error("Too many readings in block");
 					}
+					if (paused)
+					{
+						// The socket is read again once it is
+						// returned to the poll set
+						return;
+					}
 				}
 			}
 		}
 	}
 }
 
+/**
+ * Remove the socket of the stream from the epoll set and close it.
+ * The stream no longer counts towards the load of its reactor, it is
+ * destroyed once the poll thread has released it and its queued blocks
+ * have been inserted.
+ *
+ * @param epollfd	The epoll file descriptor
+ * @param reason	The message to log
+ */
+void StreamHandler::Stream::closeSocket(int epollfd, const char *reason)
+{
+	if (m_closed)
+		return;
+	epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
+	close(m_socket);
+	Logger::getLogger()->error(reason);
+	m_status = Closed;
+	m_closed = true;
+	m_reactor->removeStream();
+}
+
+/**
+ * Mark a closed stream as no longer used by the poll thread. Called
+ * with the reactor queue mutex held.
+ *
+ * @return	True if no blocks of the stream are waiting to be inserted
+ *		and the stream may be destroyed
+ */
+bool StreamHandler::Stream::detach()
+{
+	m_detached = true;
+	return m_queued == 0;
+}
+
+/**
+ * Record that a block of the stream has been inserted, returning the
+ * socket to the poll set if the stream was paused. Called with the
+ * reactor queue mutex held.
+ *
+ * @return	True if the stream has been released by the poll thread
+ *		and this was its last queued block
+ */
+bool StreamHandler::Stream::blockInserted()
+{
+	m_queued--;
+	resume(m_reactor->pollfd());
+	return m_detached && m_queued == 0;
+}
+
+/**
+ * Stop polling the socket of the stream whilst it has too many blocks
+ * waiting to be inserted. Called with the reactor queue mutex held.
+ *
+ * @param epollfd	The epoll file descriptor
+ */
+void StreamHandler::Stream::pause(int epollfd)
+{
+	if (!m_paused && !m_closed)
+	{
+		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
+		m_paused = true;
+	}
+}
+
+/**
+ * Return the socket of a paused stream to the poll set once the insert
+ * thread has caught up. Any data that arrived whilst the stream was
+ * paused is reported by epoll as soon as the socket is added back.
+ * Called with the reactor queue mutex held.
+ *
+ * @param epollfd	The epoll file descriptor
+ */
+void StreamHandler::Stream::resume(int epollfd)
+{
+	if (m_paused && m_queued < MAX_QUEUED_BLOCKS)
+	{
+		m_paused = false;
+		if (!m_closed && epoll_ctl(epollfd, EPOLL_CTL_ADD, m_socket, &m_event) == -1)
+		{
+			Logger::getLogger()->error("Failed to return stream socket to epoll set: %s",
+					strerror(errno));
+		}
+	}
+}
+
 /**
  * Queue a block of readings to be inserted into the database. The readings
- * are available via the m_readings array.
+ * are available via the m_readings array, the pointers are copied into
+ * the block so that m_readings may be reused for the next block whilst
+ * the insert is in progress.
  *
  * @param nReadings	The number of readings to insert
  * @param commit	Perform commit at end of this block
+ * @return		True if the stream has been paused
+ */
+bool StreamHandler::Stream::queueInsert(unsigned int nReadings, bool commit)
+{
+	InsertBlock *block = new InsertBlock;
+	block->m_stream = this;
+	block->m_commit = commit;
+	block->m_readings.reserve(nReadings + 1);
+	block->m_readings.assign(&m_readings[0], &m_readings[nReadings]);
+	block->m_readings.push_back(NULL);
+	return m_reactor->queueInsert(block);
+}
+
+/**
+ * Called by the insert thread once a block of readings has been
+ * inserted. Update the statistics of the stream and return the
+ * memory of the readings to the block pool.
+ *
+ * @param readings	The readings that have been inserted
+ * @param nReadings	The number of readings
+ * @param usecs		The time taken by the insert in microseconds
+ */
+void StreamHandler::Stream::inserted(ReadingStream **readings, unsigned int nReadings,
+				unsigned long usecs)
+{
+	for (unsigned int i = 0; i < nReadings; i++)
+		m_blockPool->release(readings[i]);
+	m_blocksInserted++;
+	m_readingsInserted += nReadings;
+	m_lastInsertUsecs = usecs;
+	m_totalInsertUsecs += usecs;
+}
+
+/**
+ * Append the statistics of this stream to a JSON document
+ *
+ * @param json	The JSON document to append to
  */
-void StreamHandler::Stream::queueInsert(StorageApi *api, unsigned int nReadings, bool commit)
+void StreamHandler::Stream::statsJSON(string& json)
 {
-	m_readings[nReadings] = NULL;
-	api->readingStream(m_readings, commit);
+	unsigned long blocks = m_blocksInserted;
+	char buf[256];
+	snprintf(buf, sizeof(buf), "{ \"port\" : %u, \"queued\" : %u, \"blocks\" : %lu, "
+			"\"readings\" : %lu, \"lastInsertUsecs\" : %lu, \"averageInsertUsecs\" : %lu }",
+			m_port, (unsigned int)m_queued, blocks, (unsigned long)m_readingsInserted,
+			(unsigned long)m_lastInsertUsecs,
+			blocks ? (unsigned long)m_totalInsertUsecs / blocks : 0UL);
+	json += buf;
 }
 
 /**
@@ -544,6 +887,7 @@ StreamHandler::Stream::MemoryPool::~MemoryPool()
  */
 void *StreamHandler::Stream::MemoryPool::allocate(size_t size)
 {
+	std::lock_guard<std::mutex> guard(m_poolMutex);
 	size = rndSize(size);
 	auto blkpool = m_pool.find(size);
 	if (blkpool == m_pool.end())
@@ -555,7 +899,8 @@ void *StreamHandler::Stream::MemoryPool::allocate(size_t size)
 	}
 	if (blkpool->second->empty())
 	{
-		Logger::getLogger()->warn("Extending block pool for %d bytes", size);
+		static LogThrottle throttle(60);
+		Logger::getLogger()->warn(throttle, "Extending block pool for %d bytes", size);
 		growPool(blkpool->second, size);
 	}
 	void *memory = blkpool->second->back();
@@ -571,6 +916,7 @@ void *StreamHandler::Stream::MemoryPool::allocate(size_t size)
  */
 void StreamHandler::Stream::MemoryPool::release(void *memory)
 {
+	std::lock_guard<std::mutex> guard(m_poolMutex);
 	size_t poolSize = ((size_t *)memory)[-1];
 	auto blkpool = m_pool.find(poolSize);
 	if (blkpool == m_pool.end())
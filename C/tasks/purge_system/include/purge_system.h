@@ -25,6 +25,8 @@
 
 #define UTILITIES_CATEGORY	  "Utilities"
 
+#define STORE_DATA_BLOCK_SIZE	1000	// Maximum number of rows inserted by a single storage request
+
 
 class PurgeSystem : public FledgeProcess
 {
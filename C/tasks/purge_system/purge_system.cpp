@@ -307,6 +307,9 @@ ResultSet *PurgeSystem::extractData(const std::string& tableName, const std::str
 /**
  * Store the content of the provided recordset in the given table
  *
+ * The rows are sent to the storage service in blocks of STORE_DATA_BLOCK_SIZE
+ * rows, each block is inserted by the storage plugin in a single transaction.
+ *
  * @param   tableDest  Name of the table in which the recordset should be stored
  * @param   data       recordset to store on the table tableDest
  */
@@ -319,12 +322,28 @@ void PurgeSystem::storeData(const std::string& tableDest, ResultSet *data)
 
 	int affected = 0;
 
-	bool retrieved;
+	unsigned int dateColumn, keyColumn, valueColumn;
+	bool valueIsString;
+
+	vector<InsertValues> rows;
 
 	try
 	{
 		m_logger->debug("%s - storing in :%s: rows :%d:", __FUNCTION__, tableDest.c_str(), data->rowCount() );
 
+		// SQLite and PostgreSQL plugins name and type the aggregated columns differently,
+		// the columns are resolved once for the whole recordset
+		try {
+			dateColumn = data->findColumn("date(history_ts)");
+		} catch (...) {
+			dateColumn = data->findColumn("date");
+		}
+		keyColumn = data->findColumn("key");
+		valueColumn = data->findColumn("sum_value");
+		valueIsString = data->columnType(valueColumn) == STRING_COLUMN;
+
+		rows.reserve(min(data->rowCount(), (unsigned int)STORE_DATA_BLOCK_SIZE));
+
 		ResultSet::RowIterator item = data->firstRow();
 		do
 		{
@@ -332,34 +351,17 @@ void PurgeSystem::storeData(const std::string& tableDest, ResultSet *data)
 
 			if (row)
 			{
-				// SQLite and PostgreSQL plugins behave differently, it initially tries the code for SQLite and in case
-				// of an error it executes the PostgreSQL one
-				try {
-					fieldDate = row->getColumn("date(history_ts)")->getString();
-					retrieved = true;
-
-				} catch (...) {
-					retrieved = false;
-				}
-				if (! retrieved)
-				{
-					fieldDate = row->getColumn("date")->getString();
-				}
-
+				fieldDate = row->getColumn(dateColumn)->getString();
 				fieldYear = strtol(fieldDate.substr(0, 4).c_str(), nullptr, 10);
-				fieldKey = row->getColumn("key")->getString();
-
-				// SQLite and PostgreSQL plugins behave differently, it initially tries the code for SQLite and in case
-				// of an error it executes the PostgreSQL one
-				try {
-					fieldValue = row->getColumn("sum_value")->getInteger();
-					retrieved = true;
-				} catch (...) {
-					retrieved = false;
+				fieldKey = row->getColumn(keyColumn)->getString();
+
+				if (valueIsString)
+				{
+					fieldValue = strtol(row->getColumn(valueColumn)->getString(), nullptr, 10);
 				}
-				if (! retrieved)
+				else
 				{
-					fieldValue = strtol(row->getColumn("sum_value")->getString(), nullptr, 10);
+					fieldValue = row->getColumn(valueColumn)->getInteger();
 				}
 
 				InsertValues values;
@@ -367,18 +369,19 @@ void PurgeSystem::storeData(const std::string& tableDest, ResultSet *data)
 				values.push_back(InsertValue("day", fieldDate) );
 				values.push_back(InsertValue("key", fieldKey) );
 				values.push_back(InsertValue("value", fieldValue) );
+				rows.push_back(values);
+			}
 
-				m_logger->debug("%s - :%s: inserting :%ld: :%s: :%s: :%ld:  ", __FUNCTION__, tableDest.c_str()
-					, fieldYear
-					, fieldDate.c_str()
-					, fieldKey.c_str()
-					, fieldValue);
+			if (rows.size() == STORE_DATA_BLOCK_SIZE || (data->isLastRow(item) && !rows.empty()))
+			{
+				m_logger->debug("%s - :%s: inserting :%d: rows", __FUNCTION__, tableDest.c_str(), rows.size());
 
-				affected = m_storage->insertTable(tableDest, values);
+				affected = m_storage->insertTable(tableDest, rows);
 				if (affected == -1)
 				{
 					raiseError ("Failure inserting rows into :%s: ", tableDest.c_str() );
 				}
+				rows.clear();
 			}
 
 		} while (!data->isLastRow(item++));
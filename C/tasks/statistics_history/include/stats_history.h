@@ -12,6 +12,7 @@
  */
 
 #include <process.h>
+#include <vector>
 
 
 /**
@@ -25,10 +26,12 @@ class StatsHistory : public FledgeProcess
 		// Destructor
 		~StatsHistory();
 
-		void			run() const;
+		bool			run() const;
 
 	private:
-		void	processKey(const std::string& key) const;
+		void	processKey(ResultSet::Row *row,
+				std::vector<InsertValues>& historyRows,
+				std::vector<std::pair<InsertValues *, Where *>>& updates) const;
 };
 
 #endif
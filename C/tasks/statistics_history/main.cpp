@@ -19,7 +19,11 @@ int main(int argc, char** argv)
 		// Instantiate StatsHistory class
 		StatsHistory statisticsHistory(argc, argv);
 
-		statisticsHistory.run();
+		if (!statisticsHistory.run())
+		{
+			// Return failure so the partial run is reported
+			exit(1);
+		}
 
 	}
 	catch (const std::exception& e)
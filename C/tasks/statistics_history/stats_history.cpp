@@ -42,8 +42,20 @@ StatsHistory::~StatsHistory()
 /**
  * Statisitics History run method, called by the base class
  * to start the process and do the actual work.
+ *
+ * The statistics are read with a single query, the history rows for
+ * all the keys are then written with a single insert request and the
+ * previous values with a single batched update request, rather than
+ * making a round trip to the storage service per key and operation.
+ *
+ * The storage service has no transaction that spans the two requests,
+ * the previous values are only updated once all the history rows have
+ * been inserted so that a failed insert is retried by the next run
+ * rather than the deltas being lost.
+ *
+ * @return	True if the statistics history has been written
  */
-void StatsHistory::run() const
+bool StatsHistory::run() const
 {
 	// We handle these signals, add more if needed
 	std::signal(SIGINT,  signalHandler);
@@ -51,66 +63,95 @@ void StatsHistory::run() const
 	std::signal(SIGTERM, signalHandler);
 
 	if (m_dryRun)
-		return;
+		return true;
 
-	// Get the set of distinct statistics keys
+	// Snapshot the current and previous values of all the statistics
 	Query query(new Returns("key"));
-	query.distinct();
-	ResultSet *keySet = getStorageClient()->queryTable("statistics", query);
+	query.returns(new Returns("value"));
+	query.returns(new Returns("previous_value"));
+	ResultSet *values = getStorageClient()->queryTable("statistics", query);
+	if (!values)
+	{
+		getLogger()->error("Failed to fetch the statistics");
+		return false;
+	}
+
+	vector<InsertValues> historyRows;
+	vector<pair<InsertValues *, Where *>> updates;
+	historyRows.reserve(values->rowCount());
+	updates.reserve(values->rowCount());
 
-	ResultSet::RowIterator rowIter = keySet->firstRow();
+	if (values->rowCount() > 0)
+	{
+		ResultSet::RowIterator rowIter = values->firstRow();
+		do {
+			try {
+				processKey(*rowIter, historyRows, updates);
+			} catch (exception& e) {
+				getLogger()->error("Failed to process statisitics row, %s", e.what());
+			}
+			if (!values->hasNextRow(rowIter))
+				break;
+			rowIter = values->nextRow(rowIter);
+		} while (true);
+	}
+	delete values;
 
-        do {
-		string key = (*rowIter)->getColumn("key")->getString();
+	bool success = true;
+	if (!historyRows.empty())
+	{
+		// The updates must be freed even if the storage requests fail
 		try {
-			processKey(key);
-		} catch (exception e) {
-			getLogger()->error("Failed to process statisitics key %s, %s", key, e.what());
+			int n_rows;
+			if ((n_rows = getStorageClient()->insertTable("statistics_history", historyRows)) != (int)historyRows.size())
+			{
+				getLogger()->error("Failed to insert %d rows to statisitics history table, %d inserted, the previous values are not updated", (int)historyRows.size(), n_rows);
+				success = false;
+			}
+			else if ((n_rows = getStorageClient()->updateTable("statistics", updates)) != (int)updates.size())
+			{
+				getLogger()->error("Failed to update %d rows of the statisitics table, %d updated", (int)updates.size(), n_rows);
+				success = false;
+			}
+		} catch (exception& e) {
+			getLogger()->error("Failed to write the statisitics history, %s", e.what());
+			success = false;
 		}
-                rowIter = keySet->nextRow(rowIter);
-	} while (keySet->hasNextRow(rowIter));
+	}
 
-	delete keySet;
+	for (auto& update : updates)
+	{
+		delete update.first;
+		delete update.second;
+	}
+	return success;
 }
 
 /**
- * Process a single statistics key
+ * Process a single statistics row, adding the history row and the
+ * update of the previous value for the key to the batches to write
  *
- * @param key	The statistics key to process
+ * @param row		The statistics row to process
+ * @param historyRows	The statistics history rows to insert
+ * @param updates	The previous value updates, owned by the caller
  */
-void StatsHistory::processKey(const string& key) const
+void StatsHistory::processKey(ResultSet::Row *row,
+			vector<InsertValues>& historyRows,
+			vector<pair<InsertValues *, Where *>>& updates) const
 {
-Query	query(new Where("key", Equals, key));
+	string key = row->getColumn("key")->getString();
+	long val = row->getColumn("value")->getInteger();
+	long prev = row->getColumn("previous_value")->getInteger();
 
-	// Fetch the current and previous valaues for the key
-	query.returns(new Returns("value"));
-	query.returns(new Returns("previous_value"));
-	ResultSet *values = getStorageClient()->queryTable("statistics", query);
-	if (values->rowCount() != 1)
-	{
-		getLogger()->error("Internal error, failed to get statisitics for key %s", key.c_str());
-		return;
-	}
-	int val = ((*values)[0])->getColumn("value")->getInteger();
-	int prev = ((*values)[0])->getColumn("previous_value")->getInteger();
-	delete values;
-	
-	// Insert the row into the configuration history
+	// The row for the statistics history
 	InsertValues historyValues;
 	historyValues.push_back(InsertValue("key", key.c_str()));
 	historyValues.push_back(InsertValue("value", val - prev));
 	historyValues.push_back(InsertValue("history_ts", "now()"));
-	int n_rows;
-	if ((n_rows = getStorageClient()->insertTable("statistics_history", historyValues)) != 1)
-	{
-		getLogger()->error("Failed to insert single row to statisitics history table for key %s", key.c_str());
-	}
+	historyRows.push_back(historyValues);
 
-	// Update the previous value in the statistics row
-	InsertValues updateValues;
-	updateValues.push_back(InsertValue("previous_value", val));
-	if (getStorageClient()->updateTable("statistics", updateValues, Where("key", Equals, key)) != 1)
-	{
-		getLogger()->error("Failed to update single row to statisitics table for key %s", key.c_str());
-	}
+	// The update of the previous value in the statistics row
+	InsertValues *previousValue = new InsertValues;
+	previousValue->push_back(InsertValue("previous_value", val));
+	updates.push_back(make_pair(previousValue, new Where("key", Equals, key)));
 }
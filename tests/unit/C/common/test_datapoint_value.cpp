@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <thread>
+
+using namespace std;
+
+TEST(DatapointValueTest, MoveString)
+{
+	string text(100, 'x');
+	DatapointValue value(text);
+	DatapointValue moved(std::move(value));
+
+	ASSERT_EQ(moved.getType(), DatapointValue::T_STRING);
+	ASSERT_EQ(moved.getStringRef(), text);
+	ASSERT_EQ(value.getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(value.toInt(), 0);
+}
+
+TEST(DatapointValueTest, MoveAssign)
+{
+	vector<double> values = { 1.0, 2.0, 3.0 };
+	DatapointValue array(std::move(values));
+	DatapointValue target(string("replaced"));
+
+	target = std::move(array);
+	ASSERT_EQ(target.getType(), DatapointValue::T_FLOAT_ARRAY);
+	ASSERT_EQ(target.getDpArr()->size(), 3U);
+	ASSERT_EQ(array.getType(), DatapointValue::T_INTEGER);
+}
+
+TEST(DatapointValueTest, MoveAssignNested)
+{
+	DatapointValue inner(string("nested value"));
+	vector<Datapoint *> *dps = new vector<Datapoint *>;
+	dps->push_back(new Datapoint("child", inner));
+	DatapointValue dict(dps, true);
+
+	// The value moved from is deleted along with the dict it belongs to
+	dict = std::move((*dict.getDpVec())[0]->getData());
+	ASSERT_EQ(dict.getType(), DatapointValue::T_STRING);
+	ASSERT_EQ(dict.getStringRef(), "nested value");
+}
+
+TEST(DatapointValueTest, SetValueReplacesString)
+{
+	DatapointValue value(string("a string value"));
+	value.setValue(3.5);
+	ASSERT_EQ(value.getType(), DatapointValue::T_FLOAT);
+	ASSERT_EQ(value.toDouble(), 3.5);
+	value.setValue(7L);
+	ASSERT_EQ(value.toInt(), 7);
+}
+
+TEST(DatapointValueTest, StringRef)
+{
+	DatapointValue value(string("short"));
+	const Datapoint dp("name", value);
+
+	ASSERT_EQ(dp.getData().getStringRef(), "short");
+	ASSERT_EQ(dp.getData().toStringValue(), "short");
+	ASSERT_EQ(dp.getData().toString(), "\"short\"");
+}
+
+TEST(DatapointValueTest, Float2DArray)
+{
+	Float2DArray array;
+	double row0[] = { 1.0, 2.0 };
+	array.addRow(row0, 2);
+	double *row1 = array.appendRow(3);
+	row1[0] = 3.0; row1[1] = 4.0; row1[2] = 5.0;
+
+	ASSERT_EQ(array.rows(), 2U);
+	ASSERT_EQ(array.rowLength(0), 2U);
+	ASSERT_EQ(array.rowLength(1), 3U);
+	// Rows are stored contiguously
+	ASSERT_EQ(array.row(0) + 2, array.row(1));
+
+	DatapointValue value(std::move(array));
+	ASSERT_EQ(value.getType(), DatapointValue::T_2D_FLOAT_ARRAY);
+	ASSERT_EQ(value.toString(), "[ [1.0, 2.0], [3.0, 4.0, 5.0] ]");
+
+	const vector<vector<double> *> *rows = value.getDp2DArr();
+	ASSERT_EQ(rows->size(), 2U);
+	ASSERT_EQ((*rows)[1]->at(2), 5.0);
+
+	DatapointValue copy(value);
+	ASSERT_EQ(copy.get2DArray()->rows(), 2U);
+	ASSERT_NE(copy.get2DArray()->row(0), value.get2DArray()->row(0));
+	ASSERT_EQ(copy.toString(), value.toString());
+}
+
+TEST(DatapointValueTest, Float2DArrayChangeRows)
+{
+	vector<double> r0 = { 1.0, 2.0 };
+	vector<vector<double> *> rows = { &r0 };
+	DatapointValue value(rows);
+
+	// Changes made through the rows are part of the value
+	vector<vector<double> *> *a2d = value.getDp2DArr();
+	a2d->at(0)->at(1) = 2.5;
+	a2d->push_back(new vector<double>({ 3.0 }));
+	ASSERT_EQ(value.get2DArray()->rows(), 2U);
+	ASSERT_EQ(value.toString(), "[ [1.0, 2.5], [3.0] ]");
+
+	DatapointValue copy(value);
+	ASSERT_EQ(copy.toString(), value.toString());
+}
+
+TEST(DatapointValueTest, Float2DArrayAppendAfterView)
+{
+	Float2DArray array;
+	double row0[] = { 1.0, 2.0 };
+	array.addRow(row0, 2);
+	ASSERT_EQ(array.view()->size(), 1U);
+
+	// Rows added once the rows have been created are part of them
+	double *row1 = array.appendRow(1);
+	row1[0] = 3.0;
+	ASSERT_EQ(array.rows(), 2U);
+	ASSERT_EQ(array.view()->size(), 2U);
+	ASSERT_EQ(array.view()->at(1)->at(0), 3.0);
+	ASSERT_EQ(array.row(1)[0], 3.0);
+}
+
+TEST(DatapointValueTest, Float2DArrayConcurrentView)
+{
+	Float2DArray array;
+	double values[] = { 1.0, 2.0, 3.0 };
+	for (int i = 0; i < 100; i++)
+		array.addRow(values, 3);
+	const DatapointValue value(std::move(array));
+
+	// All the readers of the const value see the same rows
+	vector<const vector<vector<double> *> *> views(4);
+	vector<thread> threads;
+	for (size_t t = 0; t < views.size(); t++)
+		threads.push_back(thread([&value, &views, t]() { views[t] = value.getDp2DArr(); }));
+	for (auto& t : threads)
+		t.join();
+	for (auto view : views)
+	{
+		ASSERT_EQ(view, views[0]);
+		ASSERT_EQ(view->size(), 100U);
+	}
+}
+
+TEST(DatapointValueTest, Float2DArrayFromRows)
+{
+	vector<double> r0 = { 1.5 }, r1 = { 2.5, 3.5 };
+	vector<vector<double> *> rows = { &r0, &r1 };
+	DatapointValue value(rows);
+
+	ASSERT_EQ(value.get2DArray()->rows(), 2U);
+	ASSERT_EQ(value.get2DArray()->row(1)[1], 3.5);
+}
+
+TEST(DatapointValueTest, AssignDictIsDeep)
+{
+	DatapointValue inner((long) 42);
+	vector<Datapoint *> *dps = new vector<Datapoint *>;
+	dps->push_back(new Datapoint("answer", inner));
+	DatapointValue dict(dps, true);
+	DatapointValue target((long) 0);
+
+	target = dict;
+	ASSERT_EQ(target.getType(), DatapointValue::T_DP_DICT);
+	ASSERT_NE(target.getDpVec(), dict.getDpVec());
+	ASSERT_NE((*target.getDpVec())[0], (*dict.getDpVec())[0]);
+	ASSERT_EQ(target.toString(), dict.toString());
+}
+
+TEST(DatapointValueTest, DatapointFromMovedValue)
+{
+	Datapoint dp("text", DatapointValue(string("moved in")));
+	ASSERT_EQ(dp.getData().getStringRef(), "moved in");
+}
@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <logger.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <mutex>
+#include <string>
+#include <stdio.h>
+
+using namespace std;
+
+/**
+ * Captures the messages logged by the tests rather than writing them
+ * to syslog
+ */
+class LoggerSinkTest : public testing::Test {
+ protected:
+	void SetUp() override
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_messages.clear();
+		Logger::setSink(capture);
+	}
+
+	void TearDown() override
+	{
+		Logger::getLogger()->flush();
+		Logger::setSink(NULL);
+	}
+
+	static void capture(int, const char *message)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_messages.push_back(message);
+	}
+
+	static vector<string> messages()
+	{
+		lock_guard<mutex> guard(m_mutex);
+		return m_messages;
+	}
+
+	static mutex		m_mutex;
+	static vector<string>	m_messages;
+};
+
+mutex LoggerSinkTest::m_mutex;
+vector<string> LoggerSinkTest::m_messages;
+
+TEST(LoggerTest, Levels)
+{
+	Logger *logger = Logger::getLogger();
+
+	logger->setMinLevel("warning");
+	ASSERT_FALSE(logger->isDebugEnabled());
+	ASSERT_FALSE(logger->isInfoEnabled());
+	ASSERT_EQ(logger->getMinLevel(), "warning");
+	logger->setMinLevel("info");
+	ASSERT_FALSE(logger->isDebugEnabled());
+	ASSERT_TRUE(logger->isInfoEnabled());
+	logger->setMinLevel("unknown");
+	ASSERT_EQ(logger->getMinLevel(), "info");
+	logger->setMinLevel("debug");
+	ASSERT_TRUE(logger->isDebugEnabled());
+}
+
+TEST(LoggerTest, Throttle)
+{
+	LogThrottle throttle(3600);
+	unsigned int suppressed = 99;
+
+	ASSERT_TRUE(throttle.allow(suppressed));
+	ASSERT_EQ(suppressed, 0U);
+	for (int i = 0; i < 10; i++)
+		ASSERT_FALSE(throttle.allow(suppressed));
+
+	LogThrottle every(0);
+	ASSERT_TRUE(every.allow(suppressed));
+	ASSERT_TRUE(every.allow(suppressed));
+	ASSERT_EQ(suppressed, 0U);
+}
+
+TEST_F(LoggerSinkTest, FormatOverloads)
+{
+	Logger *logger = Logger::getLogger();
+	LogThrottle throttle(0);
+	string format("string format %d");
+
+	// Formats passed as literals and as strings are logged alike
+	logger->setMinLevel("info");
+	logger->debug("literal debug %d", 1);
+	logger->debug(format, 2);
+	logger->info("literal info %d", 3);
+	logger->info(format, 4);
+	logger->warn(throttle, "literal warn %d", 5);
+	logger->error(throttle, format, 6);
+	logger->setMinLevel("debug");
+	logger->flush();
+
+	// Only look at the messages of this test, setMinLevel may log too
+	vector<string> logged;
+	for (auto& message : messages())
+		if (message.compare(0, 7, "literal") == 0 || message.compare(0, 13, "string format") == 0)
+			logged.push_back(message);
+	ASSERT_EQ(logged.size(), 4U);
+	ASSERT_EQ(logged[0], "literal info 3");
+	ASSERT_EQ(logged[1], "string format 4");
+	ASSERT_EQ(logged[2], "literal warn 5");
+	ASSERT_EQ(logged[3], "string format 6");
+}
+
+TEST_F(LoggerSinkTest, ConcurrentLogging)
+{
+	Logger *logger = Logger::getLogger();
+	vector<thread> threads;
+
+	// Log more messages than the queue holds, from several threads
+	logger->setMinLevel("debug");
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(thread([logger, t]() {
+			static LogThrottle throttle(3600);
+			for (int i = 0; i < 300; i++)
+			{
+				logger->debug("Thread %d message %d", t, i);
+				logger->info(throttle, "Throttled message %d", i);
+			}
+		}));
+	}
+	for (auto& t : threads)
+		t.join();
+	logger->flush();
+
+	// Every message is written once, in the order each thread logged
+	// them, and the throttle allows at most one message per hour
+	int next[4] = { 0, 0, 0, 0 };
+	int throttled = 0;
+	for (auto& message : messages())
+	{
+		int t, i;
+		if (sscanf(message.c_str(), "Thread %d message %d", &t, &i) == 2)
+		{
+			ASSERT_TRUE(t >= 0 && t < 4);
+			ASSERT_EQ(i, next[t]);
+			next[t]++;
+		}
+		else if (message.compare(0, 17, "Throttled message") == 0)
+		{
+			throttled++;
+		}
+	}
+	for (int t = 0; t < 4; t++)
+		ASSERT_EQ(next[t], 300);
+	ASSERT_LE(throttled, 1);
+}
+
+TEST_F(LoggerSinkTest, Fork)
+{
+	Logger *logger = Logger::getLogger();
+	logger->setMinLevel("debug");
+	logger->info("Before fork");
+
+	pid_t pid = fork();
+	ASSERT_NE(pid, -1);
+	if (pid == 0)
+	{
+		// The child starts its own writer thread
+		size_t before = messages().size();
+		for (int i = 0; i < 100; i++)
+			logger->info("Child message %d", i);
+		logger->flush();
+		_exit(messages().size() == before + 100 ? 0 : 1);
+	}
+	logger->info("Parent after fork");
+	int status;
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	ASSERT_TRUE(WIFEXITED(status));
+	ASSERT_EQ(WEXITSTATUS(status), 0);
+
+	// The messages queued before the fork are written by the parent only
+	logger->flush();
+	vector<string> logged = messages();
+	ASSERT_EQ(count(logged.begin(), logged.end(), "Before fork"), 1);
+	ASSERT_EQ(count(logged.begin(), logged.end(), "Parent after fork"), 1);
+	for (auto& message : logged)
+		ASSERT_EQ(message.find("Child message"), string::npos);
+}
+
+/**
+ * Cost of the messages that are discarded before they are written.
+ * Disabled by default as the unit tests are repeated, run it with
+ * --gtest_also_run_disabled_tests --gtest_filter=*Benchmark
+ */
+TEST_F(LoggerSinkTest, DISABLED_Benchmark)
+{
+	Logger *logger = Logger::getLogger();
+	const int iterations = 100000;
+	string value(200, 'x');
+
+	logger->setMinLevel("warning");
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		logger->debug("Disabled message %d %s %f", i, value.c_str(), 1.5);
+	auto end = chrono::steady_clock::now();
+	cout << "[ BENCH    ] disabled debug " <<
+		chrono::duration_cast<chrono::nanoseconds>(end - start).count() / iterations <<
+		"ns per message" << endl;
+
+	static LogThrottle throttle(60);
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		logger->warn(throttle, "Throttled message %d %s", i, value.c_str());
+	end = chrono::steady_clock::now();
+	cout << "[ BENCH    ] throttled warning " <<
+		chrono::duration_cast<chrono::nanoseconds>(end - start).count() / iterations <<
+		"ns per message" << endl;
+	logger->setMinLevel("debug");
+}
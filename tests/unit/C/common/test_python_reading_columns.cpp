@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <pythonreadingset.h>
+#include <string.h>
+#include <string>
+#include <logger.h>
+#include <pyruntime.h>
+
+using namespace std;
+
+namespace {
+
+const char *script = R"(
+def describe(columns):
+    return ";".join(asset + ":" + ",".join(name + "=" + str(array.dtype)
+            for name, array in sorted(values.items()))
+        for asset, values in sorted(columns.items()))
+
+def unchanged(columns):
+    return columns
+
+def promote(columns):
+    columns["pump"]["flow"] = columns["pump"]["flow"] * 1.5
+    return columns
+
+def drop(columns):
+    del columns["valve"]
+    return columns
+
+def add(columns):
+    columns["pump"]["double"] = columns["pump"]["flow"] * 2
+    return columns
+
+def shift(columns):
+    columns["pump"]["user_ts"] = columns["pump"]["user_ts"] - 2500000
+    return columns
+)";
+
+class  PythonReadingColumnsTest : public testing::Test {
+ protected:
+	void SetUp() override
+	{
+		m_python = PythonRuntime::getPythonRuntime();
+		m_python->execute(script);
+
+		// The flow is in every pump reading, the pressure is an integer in
+		// one reading and a float in the other and the speed and state are
+		// in only one reading
+		vector<Reading *> readings;
+		vector<Datapoint *> first;
+		first.push_back(new Datapoint("flow", DatapointValue((long) 1)));
+		first.push_back(new Datapoint("pressure", DatapointValue(1.5)));
+		first.push_back(new Datapoint("state", DatapointValue(string("running"))));
+		readings.push_back(new Reading("pump", first));
+		vector<Datapoint *> second;
+		second.push_back(new Datapoint("flow", DatapointValue((long) 2)));
+		second.push_back(new Datapoint("pressure", DatapointValue((long) 2)));
+		second.push_back(new Datapoint("speed", DatapointValue((long) 5)));
+		readings.push_back(new Reading("pump", second));
+		readings.push_back(new Reading("valve", new Datapoint("open", DatapointValue((long) 1))));
+
+		struct timeval tv;
+		tv.tv_sec = 1;
+		tv.tv_usec = 200000;
+		readings[0]->setUserTimestamp(tv);
+		tv.tv_sec = 1700000000;
+		tv.tv_usec = 999999;
+		readings[1]->setUserTimestamp(tv);
+		for (size_t i = 0; i < readings.size(); i++)
+			readings[i]->setId(i + 1);
+		m_set = new ReadingSet(&readings);
+	}
+
+	void TearDown() override
+	{
+		delete m_set;
+	}
+
+	PythonRuntime	*m_python;
+	ReadingSet	*m_set;
+
+   public:
+	/**
+	 * Pass the columns of the set through a Python function and update
+	 * the set from the result
+	 */
+	bool apply(const char *name)
+	{
+		PyGILState_STATE state = PyGILState_Ensure();
+		PyObject *columns = ((PythonReadingSet *)m_set)->toColumns();
+		PyObject *result = m_python->call(name, "(O)", columns);
+		bool rval = result && ((PythonReadingSet *)m_set)->fromColumns(result);
+		Py_CLEAR(result);
+		Py_CLEAR(columns);
+		PyGILState_Release(state);
+		return rval;
+	}
+
+	const DatapointValue& value(size_t reading, const char *name)
+	{
+		return m_set->getAllReadings()[reading]->getDatapoint(name)->getData();
+	}
+};
+
+TEST_F(PythonReadingColumnsTest, Columns)
+{
+	PyGILState_STATE state = PyGILState_Ensure();
+	PyObject *columns = ((PythonReadingSet *)m_set)->toColumns();
+	PyObject *obj = m_python->call("describe", "(O)", columns);
+	ASSERT_NE(obj, (PyObject *)NULL);
+	string description = PyUnicode_AsUTF8(obj);
+	Py_CLEAR(obj);
+	Py_CLEAR(columns);
+	PyGILState_Release(state);
+
+	// Datapoints missing from a reading or not numeric have no column,
+	// the mixed integer and float datapoint is promoted to float
+	EXPECT_STREQ(description.c_str(),
+		"pump:flow=int64,pressure=float64,user_ts=int64;valve:open=int64,user_ts=int64");
+}
+
+TEST_F(PythonReadingColumnsTest, Unchanged)
+{
+	ASSERT_TRUE(apply("unchanged"));
+	ASSERT_EQ(m_set->getCount(), 3UL);
+	EXPECT_EQ(value(0, "flow").getType(), DatapointValue::T_INTEGER);
+	EXPECT_EQ(value(1, "flow").toInt(), 2);
+	EXPECT_EQ(value(0, "pressure").toDouble(), 1.5);
+	EXPECT_EQ(value(1, "pressure").getType(), DatapointValue::T_FLOAT);
+	EXPECT_EQ(value(0, "state").toStringValue(), "running");
+	EXPECT_EQ(value(1, "speed").toInt(), 5);
+
+	struct timeval tv;
+	m_set->getAllReadings()[1]->getUserTimestamp(&tv);
+	EXPECT_EQ(tv.tv_sec, 1700000000);
+	EXPECT_EQ(tv.tv_usec, 999999);
+}
+
+TEST_F(PythonReadingColumnsTest, TypePromotion)
+{
+	ASSERT_TRUE(apply("promote"));
+	EXPECT_EQ(value(0, "flow").getType(), DatapointValue::T_FLOAT);
+	EXPECT_EQ(value(0, "flow").toDouble(), 1.5);
+	EXPECT_EQ(value(1, "flow").toDouble(), 3.0);
+}
+
+TEST_F(PythonReadingColumnsTest, DroppedAsset)
+{
+	ASSERT_EQ(m_set->getLastId(), 3UL);
+	ASSERT_TRUE(apply("drop"));
+	ASSERT_EQ(m_set->getCount(), 2UL);
+	for (auto reading : m_set->getAllReadings())
+		EXPECT_EQ(reading->getAssetName(), "pump");
+	// The last id is that of the last reading that remains
+	EXPECT_EQ(m_set->getLastId(), 2UL);
+}
+
+TEST_F(PythonReadingColumnsTest, NewDatapoint)
+{
+	ASSERT_TRUE(apply("add"));
+	EXPECT_EQ(value(0, "double").getType(), DatapointValue::T_INTEGER);
+	EXPECT_EQ(value(0, "double").toInt(), 2);
+	EXPECT_EQ(value(1, "double").toInt(), 4);
+	EXPECT_EQ(m_set->getAllReadings()[2]->getDatapoint("double"), (Datapoint *)NULL);
+}
+
+TEST_F(PythonReadingColumnsTest, UserTimestampBeforeEpoch)
+{
+	ASSERT_TRUE(apply("shift"));
+
+	// 1.2 seconds less 2.5 seconds is 0.7 seconds after -2 seconds
+	struct timeval tv;
+	m_set->getAllReadings()[0]->getUserTimestamp(&tv);
+	EXPECT_EQ(tv.tv_sec, -2);
+	EXPECT_EQ(tv.tv_usec, 700000);
+	m_set->getAllReadings()[1]->getUserTimestamp(&tv);
+	EXPECT_EQ(tv.tv_sec, 1699999998);
+	EXPECT_EQ(tv.tv_usec, 499999);
+}
+
+TEST_F(PythonReadingColumnsTest, NotADict)
+{
+	PyGILState_STATE state = PyGILState_Ensure();
+	PyObject *list = PyList_New(0);
+	EXPECT_FALSE(((PythonReadingSet *)m_set)->fromColumns(list));
+	Py_CLEAR(list);
+	PyGILState_Release(state);
+	EXPECT_EQ(m_set->getCount(), 3UL);
+}
+}
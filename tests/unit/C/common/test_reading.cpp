@@ -43,7 +43,7 @@ TEST(ReadingTest, FloatArray)
 	Reading reading(string("test55"), new Datapoint("a", value));
 	string json = reading.toJSON();
 	ASSERT_NE(json.find(string("\"asset_code\":\"test55\"")), std::string::npos);
-	ASSERT_NE(json.find(string("\"reading\":{\"a\":[3.1415, -128, 0, -0.0021, 0.2345]}")), std::string::npos);
+	ASSERT_NE(json.find(string("\"reading\":{\"a\":[3.1415, -128.0, 0.0, -0.0021, 0.2345]}")), std::string::npos);
 	ASSERT_NE(json.find(string("\"user_ts\":")), std::string::npos);
 }
 
@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <interned_string.h>
+#include <reading_arena.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char *arenaReadings = R"(
+{
+	"count" : 2, "rows" : [
+		{
+			"id": 1, "asset_code": "pump",
+			"reading": { "flow": 12.5, "state": "on", "info": { "rpm": 1500 } },
+			"user_ts": "2019-01-10 10:01:03.123456+00:00",
+			"ts": "2019-01-10 10:01:03.123456+00:00"
+		},
+		{
+			"id": 2, "asset_code": "pump",
+			"reading": { "flow": 13.5, "state": "off", "info": { "rpm": 0 } },
+			"user_ts": "2019-01-10 10:01:04.123456+00:00",
+			"ts": "2019-01-10 10:01:04.123456+00:00"
+		}
+	]
+}
+)";
+
+TEST(InternedStringTest, SameNameSamePointer)
+{
+	InternedString a("temperature");
+	InternedString b(string("temperature"));
+	InternedString c("humidity");
+
+	ASSERT_TRUE(a == b);
+	ASSERT_EQ(&a.str(), &b.str());
+	ASSERT_TRUE(a != c);
+	ASSERT_TRUE(a == "temperature");
+	ASSERT_TRUE(string("humidity") == c);
+	ASSERT_EQ(a.length(), 11U);
+}
+
+TEST(InternedStringTest, DatapointNames)
+{
+	DatapointValue v1((long) 1), v2((long) 2);
+	Datapoint dp1("speed", v1);
+	Datapoint dp2(string("speed"), v2);
+
+	ASSERT_EQ(dp1.getName(), "speed");
+	ASSERT_EQ(&dp1.getName(), &dp2.getName());
+	dp2.setName("velocity");
+	ASSERT_EQ(dp2.getName(), "velocity");
+	ASSERT_EQ(dp1.getName(), "speed");
+}
+
+TEST(InternedStringTest, AssetNames)
+{
+	DatapointValue value((long) 1);
+	Reading r1("asset", new Datapoint("x", value));
+	Reading r2(string("asset"), new Datapoint("x", value));
+
+	ASSERT_EQ(&r1.getAssetName(), &r2.getAssetName());
+	r2.setAssetName("renamed");
+	ASSERT_EQ(r2.getAssetName(), "renamed");
+	ASSERT_EQ(r1.getAssetName(), "asset");
+}
+
+TEST(InternedStringTest, TableFull)
+{
+EXPECT_EXIT({
+	InternedString first("first name");
+	size_t count = InternedString::count();
+	for (size_t i = count; i < INTERN_MAX_NAMES; i++)
+		InternedString name(string("name") + to_string(i));
+	if (InternedString::count() != INTERN_MAX_NAMES)
+	{
+		cerr << "The table holds " << InternedString::count() << " names" << endl;
+		exit(1);
+	}
+
+	// Names seen before are still shared, new names are held by the string
+	InternedString a("first name");
+	InternedString b("not interned");
+	InternedString c("not interned");
+	InternedString d(b);
+	if (!a.isInterned() || &a.str() != &first.str() || b.isInterned() || d.isInterned()
+			|| &b.str() == &c.str() || !(b == c) || !(b == d) || b == a
+			|| d.str() != "not interned" || InternedString::count() != INTERN_MAX_NAMES)
+	{
+		cerr << "Names not held as expected once the table is full" << endl;
+		exit(1);
+	}
+	c = a;
+	if (!c.isInterned() || c != a)
+	{
+		cerr << "Assignment of an interned name failed" << endl;
+		exit(1);
+	}
+	exit(0);
+	}, ::testing::ExitedWithCode(0), "");
+}
+
+TEST(ReadingArenaTest, ReadingSetInArena)
+{
+	ReadingSet heap(arenaReadings);
+	ReadingSet *arena = new ReadingSet(arenaReadings, true);
+
+	ASSERT_EQ(arena->getCount(), 2U);
+	ASSERT_EQ(arena->getLastId(), 2U);
+	const vector<Reading *>& readings = arena->getAllReadings();
+	ASSERT_EQ(readings[0]->getAssetName(), "pump");
+	ASSERT_EQ(readings[1]->getDatapoint("state")->getData().toStringValue(), "off");
+	for (int i = 0; i < 2; i++)
+		ASSERT_EQ(readings[i]->toJSON(), heap.getAllReadings()[i]->toJSON());
+	delete arena;
+}
+
+TEST(ReadingArenaTest, ReadingsOutliveSet)
+{
+	ReadingSet *set = new ReadingSet(arenaReadings, true);
+	vector<Reading *> kept = set->getAllReadings();
+	set->clear();
+	delete set;
+
+	// The readings, now owned by the caller, keep the arena alive
+	ASSERT_EQ(kept[0]->getDatapoint("flow")->getData().toDouble(), 12.5);
+	Reading *copy = new Reading(*kept[1]);
+	for (auto reading : kept)
+		delete reading;
+	ASSERT_EQ(copy->getDatapoint("flow")->getData().toDouble(), 13.5);
+	delete copy;
+}
+
+TEST(ReadingArenaTest, Scope)
+{
+	ReadingArena *arena = new ReadingArena(1024);
+	vector<Datapoint *> values;
+	{
+		ReadingArena::Scope scope(arena);
+		for (int i = 0; i < 100; i++)
+		{
+			DatapointValue value((long) i);
+			values.push_back(new Datapoint("n", value));
+		}
+	}
+	arena->release();
+	Reading *reading = new Reading("counts", values);
+	ASSERT_EQ(reading->getDatapointCount(), 100U);
+	ASSERT_EQ(reading->getReadingData()[99]->getData().toInt(), 99);
+	delete reading;
+}
+
+TEST(ReadingArenaTest, ValuePayloads)
+{
+	ReadingArena *arena = new ReadingArena();
+	Datapoint *array, *nested;
+	{
+		ReadingArena::Scope scope(arena);
+		vector<double> values = { 1.0, 2.0, 3.0 };
+		DatapointValue arrayValue(values);
+		array = new Datapoint("array", arrayValue);
+		vector<Datapoint *> *children = ReadingArena::create<vector<Datapoint *>>();
+		DatapointValue child((long) 7);
+		children->push_back(new Datapoint("child", child));
+		DatapointValue dict(children, true);
+		nested = new Datapoint("nested", std::move(dict));
+	}
+	arena->release();
+
+	// Copies made outside the scope are heap allocated and outlive the arena
+	Datapoint *arrayCopy = new Datapoint(*array);
+	Datapoint *nestedCopy = new Datapoint(*nested);
+	delete array;
+	delete nested;
+	ASSERT_EQ(arrayCopy->getData().getDpArr()->size(), 3U);
+	ASSERT_EQ((*arrayCopy->getData().getDpArr())[2], 3.0);
+	ASSERT_EQ((*nestedCopy->getData().getDpVec())[0]->getData().toInt(), 7);
+	delete arrayCopy;
+	delete nestedCopy;
+}
+
+TEST(ReadingArenaTest, HeapObjectsWhileArenaLive)
+{
+	ReadingArena *arena = new ReadingArena(1024);
+	Datapoint *inArena;
+	{
+		ReadingArena::Scope scope(arena);
+		DatapointValue value((long) 1);
+		inArena = new Datapoint("in", value);
+	}
+
+	// Objects created outside the scope, or by new, are heap objects
+	DatapointValue value((long) 2);
+	Datapoint *onHeap = new Datapoint("out", value);
+	vector<Datapoint *> *children = new vector<Datapoint *>;
+	children->push_back(new Datapoint("child", value));
+	DatapointValue dict(children, true);
+	Datapoint *nested = new Datapoint("nested", std::move(dict));
+	delete onHeap;
+	delete nested;
+
+	ASSERT_EQ(inArena->getData().toInt(), 1);
+	delete inArena;
+	arena->release();
+}
+
+TEST(ReadingArenaTest, ChunksReused)
+{
+	for (int i = 0; i < 1000; i++)
+	{
+		ReadingArena *arena = new ReadingArena(1024);
+		vector<Datapoint *> values;
+		{
+			ReadingArena::Scope scope(arena);
+			for (int j = 0; j < 50; j++)
+			{
+				DatapointValue value((long) j);
+				values.push_back(new Datapoint("n", value));
+			}
+		}
+		arena->release();
+		ASSERT_EQ(values[49]->getData().toInt(), 49);
+		for (auto dp : values)
+			delete dp;
+	}
+}
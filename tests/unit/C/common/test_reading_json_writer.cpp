@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_json_writer.h>
+#include <rapidjson/document.h>
+#include <string.h>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * The ostringstream based serialisation of a datapoint value that
+ * DatapointValue::toString used before ReadingJSONWriter, kept as the
+ * baseline for the throughput benchmark.
+ */
+static string legacyValue(DatapointValue& value);
+
+static string legacyProperty(Datapoint *dp)
+{
+	return "\"" + dp->getName() + "\":" + legacyValue(dp->getData());
+}
+
+static string legacyValue(DatapointValue& value)
+{
+	ostringstream ss;
+
+	switch (value.getType())
+	{
+	case DatapointValue::T_INTEGER:
+		ss << value.toInt();
+		return ss.str();
+	case DatapointValue::T_FLOAT:
+		{
+			char tmpBuffer[100];
+			snprintf(tmpBuffer, sizeof(tmpBuffer), "%.10f", value.toDouble());
+			string s = tmpBuffer;
+			if (s[s.size()-1] == '0')
+			{
+				s.erase(s.find_last_not_of('0') + 1, string::npos);
+				if (s[s.size()-1] == '.')
+					s.append("0");
+			}
+			return s;
+		}
+	case DatapointValue::T_STRING:
+		ss << "\"" << value.toStringValue() << "\"";
+		return ss.str();
+	case DatapointValue::T_DP_DICT:
+	case DatapointValue::T_DP_LIST:
+		{
+			bool dict = value.getType() == DatapointValue::T_DP_DICT;
+			ss << (dict ? '{' : '[');
+			for (auto it = value.getDpVec()->begin(); it != value.getDpVec()->end(); ++it)
+			{
+				if (it != value.getDpVec()->begin())
+					ss << ", ";
+				ss << (dict ? legacyProperty(*it) : legacyValue((*it)->getData()));
+			}
+			ss << (dict ? '}' : ']');
+			return ss.str();
+		}
+	default:
+		return value.toString();
+	}
+}
+
+static string legacyReading(Reading& reading)
+{
+	ostringstream convert;
+
+	convert << "{\"asset_code\":\"" << reading.getAssetName();
+	convert << "\",\"user_ts\":\"" << reading.getAssetDateUserTime(Reading::FMT_DEFAULT) << "+00:00";
+	convert << "\",\"ts\":\"" << reading.getAssetDateTime(Reading::FMT_DEFAULT) << "+00:00";
+	convert << "\",\"reading\":{";
+	vector<Datapoint *>& values = reading.getReadingData();
+	for (auto it = values.begin(); it != values.end(); ++it)
+	{
+		if (it != values.begin())
+			convert << ",";
+		convert << legacyProperty(*it);
+	}
+	convert << "}}";
+	return convert.str();
+}
+
+/**
+ * Create a reading with a mixture of datapoint types, including a
+ * nested dictionary
+ */
+static Reading *sampleReading(int n)
+{
+	vector<Datapoint *> values;
+	DatapointValue i((long) n);
+	values.push_back(new Datapoint("count", i));
+	DatapointValue f(20.5 + n / 1000.0);
+	values.push_back(new Datapoint("temperature", f));
+	DatapointValue h(0.000123456789 * n);
+	values.push_back(new Datapoint("humidity", h));
+	DatapointValue s(string("running"));
+	values.push_back(new Datapoint("state", s));
+
+	vector<Datapoint *> *nested = new vector<Datapoint *>;
+	DatapointValue x(1.5 * n);
+	nested->push_back(new Datapoint("x", x));
+	DatapointValue y((long) -n);
+	nested->push_back(new Datapoint("y", y));
+	DatapointValue dict(nested, true);
+	values.push_back(new Datapoint("position", dict));
+
+	Reading *reading = new Reading("sensor", values);
+	struct timeval tv = { 1700000000 + n / 100, (n % 100) * 10000 };
+	reading->setUserTimestamp(tv);
+	reading->setTimestamp(tv);
+	return reading;
+}
+
+TEST(ReadingJSONWriterTest, RoundTripDouble)
+{
+	double values[] = { 0.1, 1.0 / 3.0, 1e-12, 123456789.123456789, 1e300, -2.5e-310, 5.0 };
+	for (auto d : values)
+	{
+		string json;
+		ReadingJSONWriter::appendDouble(json, d);
+		Document doc;
+		doc.Parse<kParseFullPrecisionFlag>(json.c_str());
+		ASSERT_FALSE(doc.HasParseError()) << json;
+		ASSERT_TRUE(doc.IsDouble()) << json;
+		ASSERT_EQ(doc.GetDouble(), d) << json;
+		ASSERT_EQ(strtod(json.c_str(), NULL), d) << json;
+	}
+	string json;
+	ReadingJSONWriter::appendDouble(json, 5.0);
+	ASSERT_EQ(json, "5.0");
+}
+
+TEST(ReadingJSONWriterTest, NotFinite)
+{
+	string json;
+	ReadingJSONWriter::appendDouble(json, 0.0 / 0.0);
+	ASSERT_EQ(json, "null");
+}
+
+TEST(ReadingJSONWriterTest, Strings)
+{
+	string json;
+	ReadingJSONWriter::appendString(json, string("say \"hi\""));
+	ASSERT_EQ(json, "\"say \\\"hi\\\"\"");
+
+	json.clear();
+	ReadingJSONWriter::appendString(json, string("already \\\"escaped\\\""));
+	ASSERT_EQ(json, "\"already \\\"escaped\\\"\"");
+
+	json.clear();
+	ReadingJSONWriter::appendString(json, string("line\nbreak\x01"));
+	ASSERT_EQ(json, "\"line\\nbreak\\u0001\"");
+}
+
+TEST(ReadingJSONWriterTest, ReusedBuffer)
+{
+	Reading *reading = sampleReading(42);
+	string buffer;
+	ReadingJSONWriter writer(buffer);
+	writer.reading(*reading);
+	string first = buffer;
+	size_t capacity = buffer.capacity();
+	buffer.clear();
+	writer.reading(*reading);
+	ASSERT_EQ(buffer, first);
+	ASSERT_EQ(buffer.capacity(), capacity);
+	ASSERT_EQ(buffer, reading->toJSON());
+
+	Document doc;
+	doc.Parse<kParseFullPrecisionFlag>(buffer.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_STREQ(doc["asset_code"].GetString(), "sensor");
+	ASSERT_EQ(doc["reading"]["count"].GetInt64(), 42);
+	ASSERT_EQ(doc["reading"]["temperature"].GetDouble(), 20.5 + 42 / 1000.0);
+	ASSERT_EQ(doc["reading"]["humidity"].GetDouble(), 0.000123456789 * 42);
+	ASSERT_EQ(doc["reading"]["position"]["y"].GetInt64(), -42);
+	delete reading;
+}
+
+TEST(ReadingJSONWriterTest, List)
+{
+	vector<Datapoint *> *list = new vector<Datapoint *>;
+	DatapointValue a((long) 1);
+	list->push_back(new Datapoint("a", a));
+	DatapointValue b(string("two"));
+	list->push_back(new Datapoint("b", b));
+	DatapointValue value(list, false);
+	ASSERT_EQ(value.toString(), "[1, \"two\"]");
+}
+
+/**
+ * Throughput benchmark of ReadingJSONWriter, serialising a block of
+ * readings into a reused buffer, against the ostringstream based
+ * serialisation it replaced.
+ * Disabled by default as the unit tests are repeated, run it with
+ * --gtest_also_run_disabled_tests --gtest_filter=*Benchmark
+ */
+TEST(ReadingJSONWriterTest, DISABLED_Benchmark)
+{
+	const int count = 20000;
+	vector<Reading *> readings;
+	for (int i = 0; i < count; i++)
+		readings.push_back(sampleReading(i));
+
+	size_t bytes = 0;
+	auto start = chrono::steady_clock::now();
+	for (auto reading : readings)
+		bytes += legacyReading(*reading).length();
+	auto legacy = chrono::steady_clock::now() - start;
+
+	string buffer;
+	ReadingJSONWriter writer(buffer);
+	start = chrono::steady_clock::now();
+	for (auto reading : readings)
+	{
+		buffer.clear();
+		writer.reading(*reading);
+		bytes += buffer.length();
+	}
+	auto streamed = chrono::steady_clock::now() - start;
+
+	double legacyNs = (double)chrono::duration_cast<chrono::nanoseconds>(legacy).count() / count;
+	double streamedNs = (double)chrono::duration_cast<chrono::nanoseconds>(streamed).count() / count;
+	cout << "[ BENCH    ] ostringstream " << legacyNs << " ns/reading ("
+		<< 1e9 / legacyNs << " readings/s), ReadingJSONWriter " << streamedNs
+		<< " ns/reading (" << 1e9 / streamedNs << " readings/s)" << endl;
+	ASSERT_GT(bytes, 0U);
+
+	for (auto reading : readings)
+		delete reading;
+}
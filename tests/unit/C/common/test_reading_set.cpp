@@ -60,3 +60,15 @@ TEST(ReadingSet, NotificationIndex)
 	ASSERT_NE(json.find(string("\"readkey\" : ")), 0);
 	ASSERT_NE(json.find(string("\"user_ts\" : \"2017-09-22 14:47:18.872708\"")), 0);
 }
+
+TEST(ReadingSet, LastSentId)
+{
+	ReadingSet readingSet(input);
+	ASSERT_EQ(0, readingSet.getLastSentId(0, true));
+	ASSERT_EQ(0, readingSet.getLastSentId(0, false));
+	// Only a partial send acknowledges the leading readings of the set
+	ASSERT_EQ(1, readingSet.getLastSentId(1, true));
+	ASSERT_EQ(2, readingSet.getLastSentId(1, false));
+	ASSERT_EQ(2, readingSet.getLastSentId(2, true));
+	ASSERT_EQ(2, readingSet.getLastSentId(2, false));
+}
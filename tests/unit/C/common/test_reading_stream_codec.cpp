@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_stream_codec.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void checkJSON(Reading& reading)
+{
+	string payload, json;
+	ReadingStreamCodec::encode(reading, payload);
+	ASSERT_TRUE(RDS_PAYLOAD_IS_BINARY(payload.data()));
+	ASSERT_TRUE(ReadingStreamCodec::toJSON(payload.data(), payload.length(), json));
+	ASSERT_EQ(json, reading.getDatapointsJSON());
+}
+
+TEST(ReadingStreamCodecTest, Scalars)
+{
+	vector<Datapoint *> values;
+	DatapointValue i((long) -42);
+	values.push_back(new Datapoint("int", i));
+	DatapointValue f(3.1415);
+	values.push_back(new Datapoint("float", f));
+	DatapointValue z(0.0);
+	values.push_back(new Datapoint("zero", z));
+	DatapointValue s("a \"quoted\" string");
+	values.push_back(new Datapoint("str", s));
+	Reading reading(string("test"), values);
+	checkJSON(reading);
+}
+
+TEST(ReadingStreamCodecTest, Arrays)
+{
+	vector<double> v {3.1415, -128, 0, -0.0021, 0.2345};
+	DatapointValue a(v);
+	Reading reading(string("test"), new Datapoint("a", a));
+	checkJSON(reading);
+}
+
+TEST(ReadingStreamCodecTest, Nested)
+{
+	vector<Datapoint *> *inner = new vector<Datapoint *>;
+	DatapointValue x((long) 1);
+	inner->push_back(new Datapoint("x", x));
+	DatapointValue y(2.5);
+	inner->push_back(new Datapoint("y", y));
+	DatapointValue dict(inner, true);
+	vector<Datapoint *> *items = new vector<Datapoint *>;
+	DatapointValue one((long) 1);
+	items->push_back(new Datapoint("0", one));
+	DatapointValue two("two");
+	items->push_back(new Datapoint("1", two));
+	DatapointValue list(items, false);
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint("dict", dict));
+	values.push_back(new Datapoint("list", list));
+	Reading reading(string("test"), values);
+	checkJSON(reading);
+}
+
+TEST(ReadingStreamCodecTest, Decode)
+{
+	vector<Datapoint *> values;
+	DatapointValue i((long) 1234567890123);
+	values.push_back(new Datapoint("int", i));
+	DatapointValue f(1.0e-12);
+	values.push_back(new Datapoint("float", f));
+	uint8_t pixels[4] = { 1, 2, 3, 4 };
+	DPImage *image = new DPImage(2, 2, 8, pixels);
+	DatapointValue img(image);
+	values.push_back(new Datapoint("image", img));
+	Reading reading(string("test"), values);
+
+	string payload;
+	ReadingStreamCodec::encode(reading, payload);
+	vector<Datapoint *> *decoded = ReadingStreamCodec::decode(payload.data(), payload.length());
+	ASSERT_NE(decoded, (vector<Datapoint *> *)NULL);
+	ASSERT_EQ(decoded->size(), 3);
+	ASSERT_EQ((*decoded)[0]->getName(), "int");
+	ASSERT_EQ((*decoded)[0]->getData().toInt(), 1234567890123);
+	ASSERT_EQ((*decoded)[1]->getData().toDouble(), 1.0e-12);
+	DPImage *result = (*decoded)[2]->getData().getImage();
+	ASSERT_EQ(result->getWidth(), 2);
+	ASSERT_EQ(result->getDepth(), 8);
+	ASSERT_EQ(memcmp(result->getData(), pixels, sizeof(pixels)), 0);
+	for (auto dp : *decoded)
+		delete dp;
+	delete decoded;
+}
+
+TEST(ReadingStreamCodecTest, LongName)
+{
+	string name(70000, 'n');
+	DatapointValue i((long) 7);
+	Reading reading(string("test"), new Datapoint(name, i));
+	checkJSON(reading);
+	string payload;
+	ReadingStreamCodec::encode(reading, payload);
+	vector<Datapoint *> *decoded = ReadingStreamCodec::decode(payload.data(), payload.length());
+	ASSERT_NE(decoded, (vector<Datapoint *> *)NULL);
+	ASSERT_EQ((*decoded)[0]->getName(), name);
+	ASSERT_EQ((*decoded)[0]->getData().toInt(), 7);
+	for (auto dp : *decoded)
+		delete dp;
+	delete decoded;
+}
+
+TEST(ReadingStreamCodecTest, Truncated)
+{
+	DatapointValue s("some string data");
+	Reading reading(string("test"), new Datapoint("str", s));
+	string payload, json;
+	ReadingStreamCodec::encode(reading, payload);
+	ASSERT_FALSE(ReadingStreamCodec::toJSON(payload.data(), payload.length() - 4, json));
+	ASSERT_EQ(ReadingStreamCodec::decode(payload.data(), payload.length() - 4), (vector<Datapoint *> *)NULL);
+}
+
+TEST(ReadingStreamCodecTest, Block)
+{
+	vector<Reading *> readings;
+	for (int n = 0; n < 3; n++)
+	{
+		DatapointValue i((long) n);
+		Reading *reading = new Reading(string("asset") + to_string(n), new Datapoint("n", i));
+		struct timeval tv = { 1690000000 + n, 123456 };
+		reading->setId(100 + n);
+		reading->setUserTimestamp(tv);
+		tv.tv_usec = 654321;
+		reading->setTimestamp(tv);
+		readings.push_back(reading);
+	}
+	string block;
+	ReadingStreamCodec::encodeBlock(readings, block);
+	vector<Reading *> *decoded = ReadingStreamCodec::decodeBlock(block.data(), block.length());
+	ASSERT_NE(decoded, (vector<Reading *> *)NULL);
+	ASSERT_EQ(decoded->size(), 3);
+	for (int n = 0; n < 3; n++)
+	{
+		Reading *reading = (*decoded)[n];
+		struct timeval userTs, ts;
+		reading->getUserTimestamp(&userTs);
+		reading->getTimestamp(&ts);
+		ASSERT_EQ(reading->getAssetName(), readings[n]->getAssetName());
+		ASSERT_EQ(reading->getId(), 100 + n);
+		ASSERT_EQ(userTs.tv_sec, 1690000000 + n);
+		ASSERT_EQ(userTs.tv_usec, 123456);
+		ASSERT_EQ(ts.tv_usec, 654321);
+		ASSERT_EQ(reading->getDatapointsJSON(), readings[n]->getDatapointsJSON());
+		delete reading;
+		delete readings[n];
+	}
+	delete decoded;
+	ASSERT_EQ(ReadingStreamCodec::decodeBlock(block.data(), block.length() - 1), (vector<Reading *> *)NULL);
+}
+
+template<typename T> static void append(string& payload, T value)
+{
+	payload.append((const char *)&value, sizeof(T));
+}
+
+TEST(ReadingStreamCodecTest, Malformed)
+{
+	// An image whose dimensions overflow 32 bits, with no pixel data
+	string payload;
+	payload.push_back(RDS_PAYLOAD_BINARY_V1);
+	append<uint32_t>(payload, 1);
+	append<uint32_t>(payload, 5);
+	payload.append("image");
+	payload.push_back(RDS_DP_IMAGE);
+	append<uint32_t>(payload, 0x10000);
+	append<uint32_t>(payload, 0x10000);
+	append<uint32_t>(payload, 32);
+	append<uint32_t>(payload, 0);
+	ASSERT_EQ(ReadingStreamCodec::decode(payload.data(), payload.length()), (vector<Datapoint *> *)NULL);
+
+	// A depth that is not a whole number of bytes
+	payload.resize(payload.length() - 4 * sizeof(uint32_t));
+	append<uint32_t>(payload, 1);
+	append<uint32_t>(payload, 1);
+	append<uint32_t>(payload, 4);
+	append<uint32_t>(payload, 0);
+	ASSERT_EQ(ReadingStreamCodec::decode(payload.data(), payload.length()), (vector<Datapoint *> *)NULL);
+
+	// Counts far larger than the payload could hold
+	payload.clear();
+	payload.push_back(RDS_PAYLOAD_BINARY_V1);
+	append<uint32_t>(payload, 0xffffffff);
+	ASSERT_EQ(ReadingStreamCodec::decode(payload.data(), payload.length()), (vector<Datapoint *> *)NULL);
+
+	string block;
+	append<uint32_t>(block, RDS_FETCH_MAGIC);
+	append<uint32_t>(block, 0xffffffff);
+	ASSERT_EQ(ReadingStreamCodec::decodeBlock(block.data(), block.length()), (vector<Reading *> *)NULL);
+}
@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * The mutex protected, strptime based conversion that Reading used
+ * before the hand written parser, kept here as the baseline for the
+ * microbenchmark.
+ */
+static void legacyStringToTimestamp(const string& timestamp, struct timeval *ts)
+{
+	static std::mutex mtx;
+	static char cached_timestamp_upto_min[32] = "";
+	static unsigned long cached_sec_since_epoch = 0;
+
+	const int timestamp_str_len_till_min = 16;
+	const int timestamp_str_len_till_sec = 19;
+
+	char date_time [DATE_TIME_BUFFER_LEN];
+
+	strcpy (date_time, timestamp.c_str());
+
+	{
+		lock_guard<mutex> guard(mtx);
+
+		char timestamp_sec[32];
+		strncpy(timestamp_sec, date_time, timestamp_str_len_till_sec);
+		timestamp_sec[timestamp_str_len_till_sec] = '\0';
+		if(*cached_timestamp_upto_min && cached_sec_since_epoch && (strncmp(timestamp_sec, cached_timestamp_upto_min, timestamp_str_len_till_min) == 0))
+		{
+			int sec_part = strtoul(timestamp_sec+timestamp_str_len_till_min+1, NULL, 10);
+			ts->tv_sec = cached_sec_since_epoch + sec_part;
+		}
+		else
+		{
+			struct tm tm;
+			memset(&tm, 0, sizeof(struct tm));
+			strptime(date_time, "%Y-%m-%d %H:%M:%S", &tm);
+			ts->tv_sec = mktime(&tm);
+
+			extern long timezone;
+			ts->tv_sec -= timezone;
+
+			strncpy(cached_timestamp_upto_min, timestamp_sec, timestamp_str_len_till_min);
+			cached_timestamp_upto_min[timestamp_str_len_till_min] = '\0';
+			cached_sec_since_epoch = ts->tv_sec - tm.tm_sec;
+		}
+	}
+
+	const char *ptr = date_time;
+	while (*ptr && *ptr != '.')
+		ptr++;
+	if (*ptr)
+	{
+		char *eptr;
+		ts->tv_usec = strtol(ptr + 1, &eptr, 10);
+		int digits = eptr - (ptr + 1);
+		while (digits < 6)
+		{
+			digits++;
+			ts->tv_usec *= 10;
+		}
+	}
+	else
+	{
+		ts->tv_usec = 0;
+	}
+
+	ptr = date_time + 10;
+	while (*ptr && *ptr != '-' && *ptr != '+')
+		ptr++;
+	if (*ptr)
+	{
+		int h, m;
+		int sign = (*ptr == '+' ? -1 : +1);
+		h = strtoul(ptr+1, NULL, 10);
+		m = strtoul(ptr+4, NULL, 10);
+		ts->tv_sec += sign * ((3600 * h) + (60 * m));
+	}
+}
+
+/**
+ * Parse a timestamp through Reading::setUserTimestamp
+ */
+static struct timeval parse(Reading& reading, const string& timestamp)
+{
+	struct timeval tv;
+	reading.setUserTimestamp(timestamp);
+	reading.getUserTimestamp(&tv);
+	return tv;
+}
+
+/**
+ * Build a set of timestamps a few milliseconds apart, as a south
+ * service would produce them
+ */
+static vector<string> sampleTimestamps(int count)
+{
+	vector<string> timestamps;
+	time_t base = 1700000000;
+	for (int i = 0; i < count; i++)
+	{
+		time_t sec = base + (i * 7) / 1000;
+		struct tm tm;
+		gmtime_r(&sec, &tm);
+		char buf[64], out[80];
+		strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+		snprintf(out, sizeof(out), "%s.%06d+00:00", buf, ((i * 7) % 1000) * 1000);
+		timestamps.push_back(out);
+	}
+	return timestamps;
+}
+
+TEST(TimestampParseTest, Formats)
+{
+	DatapointValue value((long) 1);
+	Reading reading("test", new Datapoint("x", value));
+	struct timeval tv;
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456+00:00");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 123456);
+
+	tv = parse(reading, "2019-01-10T10:01:03.123456Z");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 123456);
+
+	tv = parse(reading, "2019-01-10 10:01:03");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 0);
+
+	tv = parse(reading, "2019-01-10 10:01:03 +0000");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 0);
+
+	tv = parse(reading, "2019-01-10 10:01:03.5");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 500000);
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456789");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 123456);
+}
+
+TEST(TimestampParseTest, Timezones)
+{
+	DatapointValue value((long) 1);
+	Reading reading("test", new Datapoint("x", value));
+	struct timeval tv;
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456+0:00");
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456-1:00");
+	ASSERT_EQ(tv.tv_sec, 1547114463 + 3600);
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456+08:00");
+	ASSERT_EQ(tv.tv_sec, 1547114463 - 8 * 3600);
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456-05:30");
+	ASSERT_EQ(tv.tv_sec, 1547114463 + 5 * 3600 + 30 * 60);
+
+	tv = parse(reading, "2019-01-10 10:01:03.123456+0530");
+	ASSERT_EQ(tv.tv_sec, 1547114463 - 5 * 3600 - 30 * 60);
+
+	tv = parse(reading, "2019-01-10 10:01:03-05");
+	ASSERT_EQ(tv.tv_sec, 1547114463 + 5 * 3600);
+	ASSERT_EQ(tv.tv_usec, 0);
+}
+
+TEST(TimestampParseTest, Dates)
+{
+	DatapointValue value((long) 1);
+	Reading reading("test", new Datapoint("x", value));
+
+	ASSERT_EQ(parse(reading, "1970-01-01 00:00:00").tv_sec, 0);
+	ASSERT_EQ(parse(reading, "2000-02-29 12:00:00").tv_sec, 951825600);
+	ASSERT_EQ(parse(reading, "2000-03-01 00:00:00").tv_sec, 951868800);
+	ASSERT_EQ(parse(reading, "2100-03-01 00:00:00").tv_sec, 4107542400);
+	ASSERT_EQ(parse(reading, "1969-12-31 23:59:59").tv_sec, -1);
+	// Same day as the previous call, served from the per thread cache
+	ASSERT_EQ(parse(reading, "1969-12-31 00:00:00").tv_sec, -86400);
+}
+
+TEST(TimestampParseTest, MatchesLegacy)
+{
+	DatapointValue value((long) 1);
+	Reading reading("test", new Datapoint("x", value));
+	vector<string> timestamps = sampleTimestamps(5000);
+	for (auto& timestamp : timestamps)
+	{
+		struct timeval expected, actual;
+		legacyStringToTimestamp(timestamp, &expected);
+		actual = parse(reading, timestamp);
+		ASSERT_EQ(actual.tv_sec, expected.tv_sec) << timestamp;
+		ASSERT_EQ(actual.tv_usec, expected.tv_usec) << timestamp;
+	}
+}
+
+TEST(TimestampParseTest, Threads)
+{
+	vector<string> timestamps = sampleTimestamps(20000);
+	vector<thread> threads;
+	bool failed[4] = { false, false, false, false };
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&timestamps, &failed, t]() {
+			DatapointValue value((long) 1);
+			Reading reading("test", new Datapoint("x", value));
+			for (size_t i = 0; i < timestamps.size(); i++)
+			{
+				struct timeval tv = parse(reading, timestamps[i]);
+				if (tv.tv_sec != 1700000000 + (time_t)((i * 7) / 1000))
+					failed[t] = true;
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	for (int t = 0; t < 4; t++)
+		ASSERT_FALSE(failed[t]);
+}
+
+/**
+ * Microbenchmark of the timestamp parser against the previous mutex
+ * protected implementation. Reports nanoseconds per timestamp for a
+ * single thread and for several threads parsing concurrently.
+ * Disabled by default as the unit tests are repeated, run it with
+ * --gtest_also_run_disabled_tests --gtest_filter=*Benchmark
+ */
+TEST(TimestampParseTest, DISABLED_Benchmark)
+{
+	const int count = 200000;
+	const int nThreads = 4;
+	vector<string> timestamps = sampleTimestamps(count);
+
+	auto run = [&timestamps](bool legacy, int nThreads) {
+		auto start = chrono::steady_clock::now();
+		vector<thread> threads;
+		for (int t = 0; t < nThreads; t++)
+		{
+			threads.emplace_back([&timestamps, legacy]() {
+				DatapointValue value((long) 1);
+				Reading reading("test", new Datapoint("x", value));
+				struct timeval tv;
+				for (auto& timestamp : timestamps)
+				{
+					if (legacy)
+						legacyStringToTimestamp(timestamp, &tv);
+					else
+						reading.setUserTimestamp(timestamp);
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		auto elapsed = chrono::steady_clock::now() - start;
+		return (double)chrono::duration_cast<chrono::nanoseconds>(elapsed).count()
+			/ ((double)timestamps.size() * nThreads);
+	};
+
+	double legacy1 = run(true, 1);
+	double parser1 = run(false, 1);
+	double legacyN = run(true, nThreads);
+	double parserN = run(false, nThreads);
+
+	cout << "[ BENCH    ] 1 thread:  legacy " << legacy1 << " ns/timestamp, parser "
+		<< parser1 << " ns/timestamp" << endl;
+	cout << "[ BENCH    ] " << nThreads << " threads: legacy " << legacyN
+		<< " ns/timestamp, parser " << parserN << " ns/timestamp" << endl;
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <omfpayload.h>
+#include <zlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <stdexcept>
+/*
+ * Fledge OMF payload unit tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+using namespace std;
+
+/**
+ * Decompress a gzip payload
+ *
+ * @param payload	The compressed payload
+ * @return		The uncompressed data
+ */
+static string gunzip(const string& payload)
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	if (inflateInit2(&stream, 15 + 16) != Z_OK)
+		throw runtime_error("inflateInit failed");
+	stream.next_in = (Bytef *)payload.data();
+	stream.avail_in = payload.length();
+
+	string result;
+	char buffer[16384];
+	int ret;
+	do {
+		stream.next_out = (Bytef *)buffer;
+		stream.avail_out = sizeof(buffer);
+		ret = inflate(&stream, Z_NO_FLUSH);
+		result.append(buffer, sizeof(buffer) - stream.avail_out);
+	} while (ret == Z_OK);
+	bool complete = ret == Z_STREAM_END && stream.avail_in == 0;
+	inflateEnd(&stream);
+	if (!complete)
+		throw runtime_error("payload is not a complete gzip stream");
+	return result;
+}
+
+/**
+ * Create a payload of OMF like JSON, appended a value at a time
+ *
+ * @param payload	The string to write the payload to
+ * @param level		The compression level
+ * @param values	The number of values
+ * @param json		Set to the uncompressed JSON
+ * @return		The uncompressed length reported by the payload
+ */
+static size_t createPayload(string& payload, int level, int values, string& json)
+{
+	OMFPayload omf(payload, level, 100);
+	json = "[";
+	omf.append("[", 1);
+	for (int i = 0; i < values; i++)
+	{
+		string value = (i ? ", " : "") + string("{\"containerid\": \"pump") + to_string(i % 7) +
+			"\", \"values\": [{\"Time\": \"2026-01-01T00:00:00Z\", \"flow\": " + to_string(i * 31 % 1009) + "}]}";
+		json += value;
+		omf.append(value);
+	}
+	json += "]";
+	omf.append(string("]"));
+	omf.finish();
+	return omf.length();
+}
+
+TEST(OMF_payload, Uncompressed)
+{
+	string payload, json;
+	size_t length = createPayload(payload, OMF_NO_COMPRESSION, 100, json);
+	ASSERT_EQ(length, json.length());
+	ASSERT_EQ(payload, json);
+}
+
+TEST(OMF_payload, GzipRoundTrip)
+{
+	string payload, json;
+
+	// Several chunks of JSON, well beyond the initial size of the payload
+	size_t length = createPayload(payload, Z_DEFAULT_COMPRESSION, 20000, json);
+	ASSERT_GT(json.length(), 4 * OMF_PAYLOAD_CHUNK);
+	ASSERT_EQ(length, json.length());
+	ASSERT_LT(payload.length(), json.length());
+	ASSERT_EQ(gunzip(payload), json);
+
+	// A payload smaller than a single chunk
+	createPayload(payload, Z_BEST_SPEED, 3, json);
+	ASSERT_EQ(gunzip(payload), json);
+
+	// An empty payload is still a valid gzip stream
+	{
+		OMFPayload empty(payload, Z_DEFAULT_COMPRESSION);
+		empty.finish();
+		empty.finish();
+	}
+	ASSERT_EQ(gunzip(payload), "");
+}
+
+TEST(OMF_payload, StreamReuse)
+{
+	string payload, json;
+
+	// The stream of the thread is reset for each payload, including after
+	// a payload that was abandoned part way through and a change of level
+	{
+		OMFPayload abandoned(payload, Z_DEFAULT_COMPRESSION);
+		abandoned.append(string(3 * OMF_PAYLOAD_CHUNK, 'x'));
+	}
+	int levels[] = { Z_DEFAULT_COMPRESSION, Z_DEFAULT_COMPRESSION, OMF_NO_COMPRESSION,
+			Z_BEST_SPEED, Z_BEST_COMPRESSION, Z_DEFAULT_COMPRESSION };
+	for (int i = 0; i < 6; i++)
+	{
+		createPayload(payload, levels[i], 1000 * (i + 1), json);
+		if (levels[i] == OMF_NO_COMPRESSION)
+			ASSERT_EQ(payload, json);
+		else
+			ASSERT_EQ(gunzip(payload), json);
+	}
+
+	// Each thread has a stream of its own
+	string other, otherJson;
+	thread worker([&other, &otherJson]() {
+			for (int i = 0; i < 3; i++)
+				createPayload(other, Z_DEFAULT_COMPRESSION, 5000, otherJson);
+		});
+	createPayload(payload, Z_DEFAULT_COMPRESSION, 7000, json);
+	worker.join();
+	ASSERT_EQ(gunzip(payload), json);
+	ASSERT_EQ(gunzip(other), otherJson);
+}
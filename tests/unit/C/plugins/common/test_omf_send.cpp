@@ -0,0 +1,273 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <omf.h>
+#include <http_sender.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+/*
+ * Fledge OMF concurrent data posts unit tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * An HttpSender that accepts all requests other than the data posts,
+ * the outcome of each data post is set by the test
+ */
+class DataPostSender : public HttpSender
+{
+	public:
+		DataPostSender(const vector<int>& codes) : m_codes(codes), m_posts(0) {};
+
+		void setProxy(const string&) {};
+		int sendRequest(const string& method, const string& path,
+				const vector<pair<string, string>>& headers,
+				const string& payload)
+		{
+			for (auto& header : headers)
+			{
+				if (header.first == "messagetype" && header.second == "Data")
+				{
+					// Data posts fail with the code given by the test
+					m_lastPayload = payload;
+					int code = m_posts < m_codes.size() ? m_codes[m_posts] : 200;
+					m_posts++;
+					if (code == 400)
+						throw BadRequest("bad data");
+					if (code < 200 || code > 299)
+						throw runtime_error("data post failed");
+					return code;
+				}
+			}
+			return 200;
+		};
+		string getHostPort() { return "localhost:0"; };
+		string getHTTPResponse() { return ""; };
+		void setAuthMethod(string&) {};
+		void setAuthBasicCredentials(string&) {};
+		void setOCSNamespace(string&) {};
+		void setOCSTenantId(string&) {};
+		void setOCSClientId(string&) {};
+		void setOCSClientSecret(string&) {};
+		void setOCSToken(string&) {};
+
+		unsigned int	posts() const { return m_posts; };
+		const string&	lastPayload() const { return m_lastPayload; };
+	private:
+		vector<int>	m_codes;
+		unsigned int	m_posts;
+		string		m_lastPayload;
+};
+
+/**
+ * An HttpSender that returns the results of the concurrent data posts
+ * given by the test, the responses may arrive in any order
+ */
+class ConcurrentPostSender : public DataPostSender
+{
+	public:
+		ConcurrentPostSender(const vector<int>& codes) : DataPostSender({}), m_codes(codes) {};
+
+		vector<HttpResult> sendRequests(const string& method, const string& path,
+				const vector<pair<string, string>>& headers,
+				const vector<string>& payloads,
+				unsigned int maxInFlight)
+		{
+			m_payloads = payloads.size();
+			vector<HttpResult> results(payloads.size());
+			for (size_t i = 0; i < results.size() && i < m_codes.size(); i++)
+			{
+				results[i].sent = true;
+				results[i].httpCode = m_codes[i];
+			}
+			return results;
+		};
+
+		size_t		payloads() const { return m_payloads; };
+	private:
+		vector<int>	m_codes;
+		size_t		m_payloads;
+};
+
+/**
+ * Send a block of eight readings with up to four data posts in flight
+ *
+ * @param sender	The sender of the requests
+ * @return		The number of readings acknowledged
+ */
+static uint32_t sendBlock(HttpSender& sender)
+{
+	map<string, OMFDataTypes> types;
+	vector<pair<string, string>> staticData;
+	vector<string> notBlocking;
+	string version("1.0");
+	string format("float64");
+
+	OMF omf("test", sender, "/", types, "ABC");
+	omf.setConnected(true);
+	omf.setSendFullStructure(false);
+	omf.setPIServerEndpoint(ENDPOINT_CR);
+	omf.setOMFVersion(version);
+	omf.setFormatType(OMF_TYPE_FLOAT, format);
+	omf.setStaticData(&staticData);
+	omf.setNotBlockingErrors(notBlocking);
+	omf.setLegacyMode(true);
+	omf.setMaxConcurrentPosts(4);
+
+	vector<Reading *> readings;
+	for (long i = 0; i < 8; i++)
+	{
+		DatapointValue value(i);
+		readings.push_back(new Reading("pump", new Datapoint("flow", value)));
+	}
+	uint32_t sent = omf.sendToServer(readings, false);
+	for (auto reading : readings)
+		delete reading;
+	return sent;
+}
+
+TEST(OMF_concurrent, AllAcknowledged)
+{
+	ConcurrentPostSender sender({ 200, 204, 200, 202 });
+	ASSERT_EQ(8, sendBlock(sender));
+	ASSERT_EQ(4, sender.payloads());
+}
+
+TEST(OMF_concurrent, LeadingRun)
+{
+	// Only the readings of the posts before the first failure are sent,
+	// however many of the later posts were acknowledged
+	ConcurrentPostSender failThird({ 200, 200, 500, 200 });
+	ASSERT_EQ(4, sendBlock(failThird));
+
+	ConcurrentPostSender failFirst({ 503, 200, 200, 200 });
+	ASSERT_EQ(0, sendBlock(failFirst));
+
+	ConcurrentPostSender notSent({ 200 });
+	ASSERT_EQ(2, sendBlock(notSent));
+}
+
+TEST(OMF_concurrent, SequentialPosts)
+{
+	// The default sendRequests stops at the first failure
+	DataPostSender sender({ 200, 200, 500, 200 });
+	ASSERT_EQ(4, sendBlock(sender));
+	ASSERT_EQ(3, sender.posts());
+}
+
+/**
+ * The data messages of a payload, the values sent to each container
+ * and the other messages in the order they were sent
+ */
+class DataMessages
+{
+	public:
+		DataMessages(const string& payload)
+		{
+			Document doc;
+			doc.Parse(payload.c_str());
+			EXPECT_FALSE(doc.HasParseError());
+			EXPECT_TRUE(doc.IsArray());
+			for (auto& message : doc.GetArray())
+			{
+				if (!message.HasMember("containerid"))
+				{
+					m_other.push_back(toString(message));
+					continue;
+				}
+				vector<string>& values = m_values[message["containerid"].GetString()];
+				for (auto& value : message["values"].GetArray())
+					values.push_back(toString(value));
+				m_messages++;
+			}
+		};
+		static string	toString(const Value& value)
+		{
+			StringBuffer buffer;
+			Writer<StringBuffer> writer(buffer);
+			value.Accept(writer);
+			return buffer.GetString();
+		};
+		map<string, vector<string>>	m_values;
+		vector<string>			m_other;
+		size_t				m_messages = 0;
+};
+
+/**
+ * Send a block of readings using linked types
+ *
+ * @param readings	The readings to send
+ * @param batchValues	Batch the values by container
+ * @return		The data payload that was sent
+ */
+static string sendLinked(const vector<Reading *>& readings, bool batchValues)
+{
+	DataPostSender sender({});
+	map<string, OMFDataTypes> types;
+	vector<pair<string, string>> staticData;
+	vector<string> notBlocking;
+	string version("1.2");
+	string format("float64");
+
+	OMF omf("test", sender, "/", types, "ABC");
+	omf.setConnected(true);
+	omf.setSendFullStructure(false);
+	omf.setPIServerEndpoint(ENDPOINT_OCS);
+	omf.setOMFVersion(version);
+	omf.setFormatType(OMF_TYPE_FLOAT, format);
+	omf.setStaticData(&staticData);
+	omf.setNotBlockingErrors(notBlocking);
+	omf.setLegacyMode(false);
+	omf.setBatchValues(batchValues);
+	EXPECT_EQ(readings.size(), omf.sendToServer(readings, false));
+	return sender.lastPayload();
+}
+
+TEST(OMF_batch, SameValues)
+{
+	// Readings of two assets, not all of the pump readings have every datapoint
+	vector<Reading *> readings;
+	for (long i = 0; i < 20; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue flow(i);
+		values.push_back(new Datapoint("flow", flow));
+		if (i % 3)
+		{
+			DatapointValue temperature(20.5 + i);
+			values.push_back(new Datapoint("temperature", temperature));
+		}
+		readings.push_back(new Reading("pump", values));
+		if (i % 4 == 0)
+		{
+			DatapointValue state(string(i % 8 ? "open" : "closed"));
+			readings.push_back(new Reading("valve", new Datapoint("state", state)));
+		}
+	}
+	DataMessages unbatched(sendLinked(readings, false));
+	DataMessages batched(sendLinked(readings, true));
+	for (auto reading : readings)
+		delete reading;
+
+	// The same values are sent to each container, in the same order,
+	// with a single message per container when they are batched
+	ASSERT_EQ(3, unbatched.m_values.size());
+	ASSERT_EQ(20, unbatched.m_values["pump.flow"].size());
+	ASSERT_EQ(unbatched.m_values, batched.m_values);
+	ASSERT_FALSE(unbatched.m_other.empty());
+	ASSERT_EQ(unbatched.m_other, batched.m_other);
+	ASSERT_EQ(3, batched.m_messages);
+	ASSERT_GT(unbatched.m_messages, batched.m_messages);
+}
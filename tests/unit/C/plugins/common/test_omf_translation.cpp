@@ -615,6 +615,31 @@ TEST(PiServer_NamingRules, Prefix)
 	}
 }
 
+TEST(OMF_hints, cache)
+{
+	OMFHintsCache cache(2);
+	string tag("{\"tag\":\"sinusoid\"}");
+	string number("{\"number\":\"float32\"}");
+	string integer("{\"integer\":\"int32\"}");
+
+	shared_ptr<const OMFHints> tagHints = cache.get(tag);
+	ASSERT_EQ(tagHints->getHints().size(), 1);
+	ASSERT_EQ(tagHints->getHints()[0]->getHint(), "sinusoid");
+
+	// The same hint text returns the already parsed hints
+	ASSERT_EQ(cache.get(tag), tagHints);
+
+	cache.get(number);
+	ASSERT_EQ(cache.size(), 2);
+
+	// Adding a third hint discards the least recently used
+	cache.get(tag);
+	cache.get(integer);
+	ASSERT_EQ(cache.size(), 2);
+	ASSERT_EQ(cache.get(tag), tagHints);
+	ASSERT_EQ(tagHints->getHints()[0]->getHint(), "sinusoid");
+}
+
 TEST(OMF_hints, m_chksum)
 {
 	string asset;
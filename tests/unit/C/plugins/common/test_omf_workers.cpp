@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <omfworkers.h>
+#include <atomic>
+#include <set>
+#include <stdexcept>
+/*
+ * Fledge OMF worker threads unit tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Massimiliano Pinto
+ */
+
+using namespace std;
+
+TEST(OMFWorkers, RunAllTasks)
+{
+	OMFWorkers workers;
+	for (int block = 0; block < 20; block++)
+	{
+		vector<int> results(8, 0);
+		vector<function<void()>> tasks;
+		for (int i = 0; i < 8; i++)
+		{
+			tasks.push_back([&results, i, block]() { results[i] = i + block; });
+		}
+		workers.run(tasks);
+		for (int i = 0; i < 8; i++)
+		{
+			ASSERT_EQ(results[i], i + block);
+		}
+	}
+}
+
+TEST(OMFWorkers, ThreadsReused)
+{
+	OMFWorkers workers;
+	mutex idMutex;
+	set<thread::id> ids;
+	for (int block = 0; block < 10; block++)
+	{
+		vector<function<void()>> tasks;
+		for (int i = 0; i < 4; i++)
+		{
+			tasks.push_back([&idMutex, &ids]() {
+					lock_guard<mutex> guard(idMutex);
+					ids.insert(this_thread::get_id());
+				});
+		}
+		workers.run(tasks);
+	}
+	// The calling thread and at most three workers
+	ASSERT_LE(ids.size(), 4);
+}
+
+TEST(OMFWorkers, Exception)
+{
+	OMFWorkers workers;
+	atomic<int> completed(0);
+	vector<function<void()>> tasks;
+	for (int i = 0; i < 4; i++)
+	{
+		tasks.push_back([&completed, i]() {
+				if (i == 2)
+					throw runtime_error("task failed");
+				completed++;
+			});
+	}
+	ASSERT_THROW(workers.run(tasks), runtime_error);
+	ASSERT_EQ(completed, 3);
+}
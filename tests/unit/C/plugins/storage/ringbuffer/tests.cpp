@@ -0,0 +1,312 @@
+#include <gtest/gtest.h>
+#include <reading_ring.h>
+#include <reading_stream_codec.h>
+#include <reading.h>
+#include <rapidjson/document.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+using namespace std;
+using namespace rapidjson;
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+static const char *readings = R"({ "readings" : [
+	{ "asset_code" : "pump", "user_ts" : "2023-01-01 10:00:00.100000+00:00", "reading" : { "flow" : 1 } },
+	{ "asset_code" : "valve", "user_ts" : "2023-01-01 10:00:01.200000+00:00", "reading" : { "open" : "yes" } },
+	{ "asset_code" : "pump", "user_ts" : "2023-01-01 12:00:02.300000+02:00", "reading" : { "flow" : 3 } }
+	] })";
+
+TEST(RingBuffer, AppendFetch)
+{
+	ReadingRing ring(100, 0);
+	ASSERT_EQ(3, ring.appendReadings(readings));
+
+	string result;
+	ASSERT_TRUE(ring.fetchReadings(2, 10, result));
+	Document doc;
+	ASSERT_FALSE(doc.Parse(result.c_str()).HasParseError());
+	ASSERT_EQ(2, doc["count"].GetInt());
+	ASSERT_EQ(2, doc["rows"][0]["id"].GetInt());
+	ASSERT_STREQ("valve", doc["rows"][0]["asset_code"].GetString());
+	ASSERT_STREQ("yes", doc["rows"][0]["reading"]["open"].GetString());
+	ASSERT_STREQ("2023-01-01 10:00:02.300000", doc["rows"][1]["user_ts"].GetString());
+}
+
+TEST(RingBuffer, FetchBinary)
+{
+	ReadingRing ring(100, 0);
+	ASSERT_EQ(3, ring.appendReadings(readings));
+
+	string block;
+	ring.fetchReadingsBinary(2, 10, block);
+	vector<Reading *> *fetched = ReadingStreamCodec::decodeBlock(block.data(), block.length());
+	ASSERT_NE(nullptr, fetched);
+	ASSERT_EQ(2U, fetched->size());
+	ASSERT_EQ(2U, (*fetched)[0]->getId());
+	ASSERT_EQ("valve", (*fetched)[0]->getAssetName());
+	ASSERT_EQ("yes", (*fetched)[0]->getDatapoint("open")->getData().toStringValue());
+	ASSERT_EQ("2023-01-01 10:00:02.300000", (*fetched)[1]->getAssetDateUserTime(Reading::FMT_DEFAULT, true));
+	for (auto reading : *fetched)
+		delete reading;
+	delete fetched;
+}
+
+TEST(RingBuffer, Overwrite)
+{
+	ReadingRing ring(4, 0);
+	ASSERT_EQ(3, ring.appendReadings(readings));
+	ASSERT_EQ(3, ring.appendReadings(readings));
+
+	string result;
+	ring.fetchReadings(1, 10, result);
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(4, doc["count"].GetInt());
+	ASSERT_EQ(3, doc["rows"][0]["id"].GetInt());
+}
+
+TEST(RingBuffer, RetrieveAsset)
+{
+	ReadingRing ring(100, 0);
+	ring.appendReadings(readings);
+	ring.appendReadings(readings);
+
+	string result;
+	ASSERT_TRUE(ring.retrieveReadings(R"({ "where" : { "column" : "asset_code", "condition" : "=", "value" : "pump" },
+		"return" : [ "reading", { "column" : "user_ts", "alias" : "timestamp" } ],
+		"sort" : { "column" : "user_ts", "direction" : "desc" }, "limit" : 3 })", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(3, doc["count"].GetInt());
+	ASSERT_EQ(3, doc["rows"][0]["reading"]["flow"].GetInt());
+	ASSERT_EQ(1, doc["rows"][1]["reading"]["flow"].GetInt());
+	ASSERT_TRUE(doc["rows"][0].HasMember("timestamp"));
+	ASSERT_FALSE(doc["rows"][0].HasMember("id"));
+
+	ASSERT_TRUE(ring.retrieveReadings(R"({ "aggregate" : { "operation" : "count", "column" : "*", "alias" : "count" },
+		"group" : "asset_code" })", result));
+	doc.Parse(result.c_str());
+	ASSERT_EQ(2, doc["count"].GetInt());
+	for (auto& row : doc["rows"].GetArray())
+		ASSERT_EQ(strcmp(row["asset_code"].GetString(), "pump") ? 2 : 4, row["count"].GetInt());
+
+	ASSERT_FALSE(ring.retrieveReadings(R"({ "timebucket" : { "timestamp" : "user_ts" } })", result));
+}
+
+TEST(RingBuffer, Purge)
+{
+	ReadingRing ring(100, 0);
+	ring.appendReadings(readings);
+	ring.appendReadings(readings);
+
+	string result;
+	ASSERT_EQ(3, ring.purgeReadingsByRows(3, STORAGE_PURGE_SIZE, 0, result));
+	ASSERT_EQ(0, ring.purgeReadingsByRows(1, STORAGE_PURGE_SIZE | STORAGE_PURGE_RETAIN_ANY, 3, result));
+	ASSERT_EQ(2, ring.purgeReadingsAsset("pump"));
+
+	ring.fetchReadings(1, 10, result);
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(1, doc["count"].GetInt());
+	ASSERT_STREQ("valve", doc["rows"][0]["asset_code"].GetString());
+
+	// All the readings are older than an hour
+	ring.appendReadings(readings);
+	ASSERT_EQ(4, ring.purgeReadings(1, 0, 0, result));
+	ring.fetchReadings(1, 10, result);
+	doc.Parse(result.c_str());
+	ASSERT_EQ(0, doc["count"].GetInt());
+}
+
+TEST(RingBuffer, ConcurrentAssetOrder)
+{
+	const int threads = 4;
+	const int appends = 50;
+	const int perAppend = 100;
+	ReadingRing ring(threads * appends * perAppend * 2, 0);
+
+	// Each append alternates pump readings with readings of another asset,
+	// the appends of several threads overlap while they are linked
+	vector<thread> appenders;
+	for (int t = 0; t < threads; t++)
+	{
+		appenders.push_back(thread([&ring, t, perAppend]() {
+			string block = R"({ "readings" : [ )";
+			for (int i = 0; i < perAppend; i++)
+			{
+				if (i)
+					block += ", ";
+				block += R"({ "asset_code" : "pump", "reading" : { "thread" : )" + to_string(t) + R"( } }, )";
+				block += R"({ "asset_code" : "other)" + to_string(t) + R"(", "reading" : { "v" : 1 } })";
+			}
+			block += " ] }";
+			for (int i = 0; i < appends; i++)
+				ring.appendReadings(block.c_str());
+		}));
+	}
+	for (auto& t : appenders)
+		t.join();
+
+	string result;
+	ASSERT_TRUE(ring.retrieveReadings(R"({ "where" : { "column" : "asset_code", "condition" : "=", "value" : "pump" },
+		"return" : [ "id" ] })", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(threads * appends * perAppend, doc["count"].GetInt());
+	long previous = 0;
+	for (auto& row : doc["rows"].GetArray())
+	{
+		ASSERT_LT(previous, row["id"].GetInt64());
+		previous = row["id"].GetInt64();
+	}
+
+	ASSERT_EQ((unsigned int)(threads * appends * perAppend), ring.purgeReadingsAsset("pump"));
+	ASSERT_TRUE(ring.retrieveReadings(R"({ "aggregate" : { "operation" : "count", "column" : "*", "alias" : "count" },
+		"group" : "asset_code" })", result));
+	doc.Parse(result.c_str());
+	ASSERT_EQ(threads, doc["count"].GetInt());
+	for (auto& row : doc["rows"].GetArray())
+		ASSERT_EQ(appends * perAppend, row["count"].GetInt());
+}
+
+TEST(RingBuffer, ConcurrentAssetQuery)
+{
+	const int threads = 4;
+	const int appends = 50;
+	const int perAppend = 20;
+	ReadingRing ring(threads * appends * perAppend * 2, 0);
+
+	string block = R"({ "readings" : [ )";
+	for (int i = 0; i < perAppend; i++)
+	{
+		if (i)
+			block += ", ";
+		block += R"({ "asset_code" : "pump", "reading" : { "flow" : 1 } }, )";
+		block += R"({ "asset_code" : "valve", "reading" : { "open" : 1 } })";
+	}
+	block += " ] }";
+
+	// Appends commit whole, so a query that walks the pump chain while
+	// readings are being appended must always see whole appends
+	atomic<bool> done(false);
+	vector<thread> appenders;
+	for (int t = 0; t < threads; t++)
+	{
+		appenders.push_back(thread([&ring, &block]() {
+			for (int i = 0; i < appends; i++)
+				ring.appendReadings(block.c_str());
+		}));
+	}
+	thread querier([&ring, &done]() {
+		int previous = 0;
+		while (!done.load())
+		{
+			string result;
+			ASSERT_TRUE(ring.retrieveReadings(R"({ "where" : { "column" : "asset_code", "condition" : "=", "value" : "pump" },
+				"aggregate" : { "operation" : "count", "column" : "*", "alias" : "count" } })", result));
+			Document doc;
+			doc.Parse(result.c_str());
+			int count = doc["rows"][0]["count"].GetInt();
+			ASSERT_EQ(0, count % perAppend);
+			ASSERT_LE(previous, count);
+			previous = count;
+		}
+	});
+	for (auto& t : appenders)
+		t.join();
+	done = true;
+	querier.join();
+}
+
+TEST(RingBuffer, Snapshot)
+{
+	char path[] = "/tmp/ringbufferXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+
+	string result;
+	{
+		ReadingRing ring(100, 0);
+		ring.appendReadings(readings);
+		ring.purgeReadingsByRows(2, STORAGE_PURGE_SIZE, 0, result);
+		ASSERT_TRUE(ring.saveSnapshot(path));
+	}
+
+	ReadingRing ring(100, 0);
+	ASSERT_TRUE(ring.loadSnapshot(path));
+	unlink(path);
+	ASSERT_EQ(1, ring.appendReadings(R"({ "readings" : [ { "asset_code" : "pump", "reading" : { "flow" : 4 } } ] })"));
+
+	ring.fetchReadings(1, 10, result);
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(3, doc["count"].GetInt());
+	ASSERT_EQ(2, doc["rows"][0]["id"].GetInt());
+	ASSERT_EQ(4, doc["rows"][2]["id"].GetInt());
+
+	ASSERT_TRUE(ring.retrieveReadings(R"({ "where" : { "column" : "asset_code", "condition" : "=", "value" : "pump" } })", result));
+	doc.Parse(result.c_str());
+	ASSERT_EQ(2, doc["count"].GetInt());
+	ASSERT_EQ(3, doc["rows"][0]["reading"]["flow"].GetInt());
+	ASSERT_EQ(4, doc["rows"][1]["reading"]["flow"].GetInt());
+}
+
+TEST(RingBuffer, InvalidSnapshot)
+{
+	char path[] = "/tmp/ringbufferXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_NE(-1, fd);
+	close(fd);
+
+	{
+		ReadingRing ring(100, 0);
+		ring.appendReadings(readings);
+		ASSERT_TRUE(ring.saveSnapshot(path));
+	}
+	FILE *fp = fopen(path, "r+");
+	ASSERT_NE(nullptr, fp);
+
+	// A count of readings that the file could not hold
+	RDSFetchHeader hdr;
+	ASSERT_EQ(1U, fread(&hdr, sizeof(hdr), 1, fp));
+	hdr.count = 0xffffffff;
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	fflush(fp);
+	{
+		ReadingRing ring(100, 0);
+		ASSERT_FALSE(ring.loadSnapshot(path));
+	}
+
+	// An asset name longer than the rest of the file
+	RDSFetchReadingHeader rhdr;
+	hdr.count = 3;
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	ASSERT_EQ(1U, fread(&rhdr, sizeof(rhdr), 1, fp));
+	rhdr.assetLength = 0x7fffffff;
+	fseek(fp, sizeof(hdr), SEEK_SET);
+	fwrite(&rhdr, sizeof(rhdr), 1, fp);
+	fclose(fp);
+	{
+		ReadingRing ring(100, 0);
+		ASSERT_FALSE(ring.loadSnapshot(path));
+
+		// Nothing is loaded from a snapshot that is not valid
+		string result;
+		ring.fetchReadings(1, 10, result);
+		Document doc;
+		doc.Parse(result.c_str());
+		ASSERT_EQ(0, doc["count"].GetInt());
+	}
+	unlink(path);
+}
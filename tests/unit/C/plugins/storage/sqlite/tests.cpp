@@ -1,8 +1,15 @@
 #include <gtest/gtest.h>
 #include <connection.h>
+#include <connection_manager.h>
 #include <logger.h>
 #include <string.h>
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include <readings_catalogue.h>
 
 using namespace std;
@@ -116,3 +123,146 @@ INSTANTIATE_TEST_CASE_P(
 		RowFormatDate("2019-50-50 10:01:01.0",  "", false)
 	)
 );
+
+/**
+ * Readings catalogue backed by the databases created by the storage init scripts
+ * in the partition_data directory, the catalogue is a singleton so the databases
+ * are created once and shared by all the repetitions.
+ */
+class ReadingsPartitionTest : public testing::Test {
+ protected:
+	static void SetUpTestCase()
+	{
+		static bool initialised = false;
+
+		if (initialised)
+			return;
+		initialised = true;
+
+		char cwd[PATH_MAX];
+		ASSERT_NE(getcwd(cwd, sizeof(cwd)), (char *)NULL);
+		string dataDir = string(cwd) + "/partition_data";
+		ASSERT_EQ(system(("rm -rf " + dataDir).c_str()), 0);
+		ASSERT_EQ(mkdir(dataDir.c_str(), 0755), 0);
+		setenv("FLEDGE_DATA", dataDir.c_str(), 1);
+
+		ASSERT_NE(getenv("FLEDGE_ROOT"), (char *)NULL);
+		string scripts = string(getenv("FLEDGE_ROOT")) + "/scripts/plugins/storage/sqlite/";
+		createDb(dataDir + "/fledge.db", "fledge", scripts + "init.sql");
+		createDb(dataDir + "/readings_1.db", "readings_1", scripts + "init_readings.sql");
+
+		STORAGE_CONFIGURATION storageConfig;
+		storageConfig.partitionWindow = 1;
+		ConnectionManager::getInstance()->growPool(storageConfig.poolSize);
+		ReadingsCatalogue::getInstance()->multipleReadingsInit(storageConfig);
+	}
+
+	static void createDb(const string& path, const string& alias, const string& script)
+	{
+		ifstream file(script);
+		ASSERT_TRUE(file.good()) << script;
+		stringstream sql;
+		sql << "PRAGMA page_size = 4096;" << endl;
+		sql << "ATTACH DATABASE '" << path << "' AS '" << alias << "';" << endl;
+		sql << file.rdbuf();
+
+		sqlite3 *db;
+		ASSERT_EQ(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+		char *errMsg = NULL;
+		int rc = sqlite3_exec(db, sql.str().c_str(), NULL, NULL, &errMsg);
+		ASSERT_EQ(rc, SQLITE_OK) << (errMsg ? errMsg : "");
+		sqlite3_close(db);
+	}
+
+	void SetUp() override
+	{
+		m_catalogue = ReadingsCatalogue::getInstance();
+		m_connection = ConnectionManager::getInstance()->allocate();
+	}
+
+	void TearDown() override
+	{
+		ConnectionManager::getInstance()->release(m_connection);
+	}
+
+	void append(const string& asset, const string& userTs)
+	{
+		string readings = "{ \"readings\" : [ { \"asset_code\" : \"" + asset + "\", "
+			"\"user_ts\" : \"" + userTs + "\", \"reading\" : { \"value\" : 1 } } ] }";
+		ASSERT_EQ(m_connection->appendReadings(readings.c_str()), 1);
+	}
+
+	// Seals the current partition the next time a table is allocated
+	void expirePartition()
+	{
+		m_catalogue->m_partitionStart = 0;
+	}
+
+	// Returns the database of the table in use by the asset, -1 if none
+	int currentDb(const string& asset)
+	{
+		auto item = m_catalogue->m_AssetReadingCatalogue.find(asset);
+		return item == m_catalogue->m_AssetReadingCatalogue.end() ? -1 : item->second.second;
+	}
+
+	bool referencesDb(int dbId)
+	{
+		for (auto &item : m_catalogue->m_AssetReadingCatalogue)
+			if (item.second.second == dbId)
+				return true;
+		for (auto &item : m_catalogue->m_SealedReadingCatalogue)
+			if (item.second.second == dbId)
+				return true;
+		return false;
+	}
+
+	ReadingsCatalogue	*m_catalogue;
+	Connection		*m_connection;
+};
+
+TEST_F(ReadingsPartitionTest, DropPartition)
+{
+	// Readings that have expired, stored in a partition that is then sealed
+	append("expired", "2020-01-01 10:00:00.000000");
+	int dropped = currentDb("expired");
+	ASSERT_GT(dropped, 1);
+	expirePartition();
+
+	unsigned long unsent;
+	ASSERT_GE(m_catalogue->purgePartitions(m_connection->getDbHandle(), 1, 0, false, &unsent), 1UL);
+
+	// The catalogue no longer references the database that was removed
+	ASSERT_FALSE(referencesDb(dropped));
+	ASSERT_EQ(currentDb("expired"), -1);
+
+	// New and returning assets are stored in the new partition
+	append("new", "2020-01-01 10:00:00.000000");
+	append("expired", "2020-01-01 10:00:00.000000");
+	ASSERT_GT(currentDb("new"), dropped);
+	ASSERT_EQ(currentDb("expired"), currentDb("new"));
+}
+
+TEST_F(ReadingsPartitionTest, PartitionCounts)
+{
+	unsigned long unsent;
+
+	// Removes the partitions left by the other tests, the append attaches
+	// the databases created by the other connections
+	append("cleanup", "2020-01-01 10:00:00.000000");
+	expirePartition();
+	m_catalogue->purgePartitions(m_connection->getDbHandle(), 1, 0, false, &unsent);
+
+	// The readings are counted as they are appended and purged
+	append("counted", "2020-01-01 10:00:00.000000");
+	append("counted", "2020-01-01 10:00:01.000000");
+	ASSERT_EQ(m_connection->purgeReadingsAsset("counted"), 2U);
+	append("counted", "2020-01-01 10:00:02.000000");
+	append("counted", "2020-01-01 10:00:03.000000");
+	append("counted", "2020-01-01 10:00:04.000000");
+	expirePartition();
+
+	// Only the first reading has been sent, the unsent ones are counted by id
+	unsent = 0;
+	ASSERT_EQ(m_catalogue->purgePartitions(m_connection->getDbHandle(), 1, 1, false, &unsent), 3UL);
+	ASSERT_EQ(unsent, 3UL);
+}
@@ -0,0 +1,328 @@
+#include <gtest/gtest.h>
+#include <spill_buffer.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+/**
+ * Creates an empty spill directory for each test and removes it
+ * once the test completes
+ */
+class SpillBufferTest : public testing::Test {
+ protected:
+	void SetUp() override
+	{
+		char path[] = "/tmp/spillbufferXXXXXX";
+		ASSERT_NE(nullptr, mkdtemp(path));
+		m_dir = path;
+	}
+
+	void TearDown() override
+	{
+		for (auto& file : segments())
+			unlink(file.c_str());
+		rmdir(m_dir.c_str());
+	}
+
+	/**
+	 * Return the paths of the segment files, in sequence order
+	 */
+	vector<string> segments()
+	{
+		vector<string> files;
+		DIR *dir = opendir(m_dir.c_str());
+		if (!dir)
+			return files;
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL)
+			if (entry->d_name[0] != '.')
+				files.push_back(m_dir + "/" + entry->d_name);
+		closedir(dir);
+		sort(files.begin(), files.end());
+		return files;
+	}
+
+	/**
+	 * Create a block of readings, the value of each reading is its
+	 * position in the sequence of readings appended by a test
+	 */
+	static vector<Reading *> block(long first, int count, size_t padding = 0)
+	{
+		vector<Reading *> readings;
+		for (int i = 0; i < count; i++)
+		{
+			vector<Datapoint *> values;
+			values.push_back(new Datapoint("seq", DatapointValue(first + i)));
+			if (padding)
+				values.push_back(new Datapoint("padding", DatapointValue(string(padding, 'x'))));
+			readings.push_back(new Reading("spill", values));
+		}
+		return readings;
+	}
+
+	static void free(vector<Reading *>& readings)
+	{
+		for (auto reading : readings)
+			delete reading;
+		readings.clear();
+	}
+
+	/**
+	 * Read and commit a block, returning the sequence of its first reading
+	 * and checking the readings of the block are in sequence
+	 */
+	static long readBlock(SpillBuffer& buffer, int expected)
+	{
+		vector<Reading *> *readings = buffer.read();
+		if (!readings)
+			return -1;
+		EXPECT_EQ((size_t)expected, readings->size());
+		long first = (*readings)[0]->getDatapoint("seq")->getData().toInt();
+		for (size_t i = 0; i < readings->size(); i++)
+		{
+			EXPECT_EQ(first + (long)i, (*readings)[i]->getDatapoint("seq")->getData().toInt());
+			EXPECT_EQ("spill", (*readings)[i]->getAssetName());
+		}
+		free(*readings);
+		delete readings;
+		buffer.commit();
+		return first;
+	}
+
+	/**
+	 * Return the offset of the last record in a segment file
+	 */
+	static size_t lastRecord(const string& path)
+	{
+		ifstream file(path, ios::binary);
+		string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+		uint32_t magic = SPILL_RECORD_MAGIC;
+		return content.rfind(string((const char *)&magic, sizeof(magic)));
+	}
+
+	string	m_dir;
+};
+
+TEST_F(SpillBufferTest, ReadOrder)
+{
+	SpillBuffer buffer(m_dir, 1024 * 1024);
+	unsigned long discarded = 0;
+	ASSERT_TRUE(buffer.empty());
+	ASSERT_EQ(nullptr, buffer.read());
+
+	for (int i = 0; i < 3; i++)
+	{
+		vector<Reading *> readings = block(i * 10, 10);
+		ASSERT_TRUE(buffer.append(readings, discarded));
+		free(readings);
+	}
+	ASSERT_EQ(30UL, buffer.size());
+
+	// A block that is not committed is read again
+	vector<Reading *> *readings = buffer.read();
+	ASSERT_NE(nullptr, readings);
+	ASSERT_EQ(0, (*readings)[0]->getDatapoint("seq")->getData().toInt());
+	free(*readings);
+	delete readings;
+
+	ASSERT_EQ(0, readBlock(buffer, 10));
+	ASSERT_EQ(10, readBlock(buffer, 10));
+	ASSERT_EQ(20, readBlock(buffer, 10));
+	ASSERT_EQ(-1, readBlock(buffer, 10));
+	ASSERT_TRUE(buffer.empty());
+	ASSERT_EQ(0UL, discarded);
+}
+
+TEST_F(SpillBufferTest, ReloadOrder)
+{
+	unsigned long discarded = 0;
+	{
+		// Enough readings to fill several of the smallest segments
+		SpillBuffer buffer(m_dir, 256 * 1024);
+		for (int i = 0; i < 20; i++)
+		{
+			vector<Reading *> readings = block(i * 10, 10, 1000);
+			ASSERT_TRUE(buffer.append(readings, discarded));
+			free(readings);
+		}
+		ASSERT_EQ(0, readBlock(buffer, 10));
+	}
+	ASSERT_GT(segments().size(), 1U);
+
+	// The readings not committed are recovered in the order they were appended
+	{
+		SpillBuffer buffer(m_dir, 256 * 1024);
+		ASSERT_EQ(190UL, buffer.size());
+		for (int i = 1; i < 10; i++)
+			ASSERT_EQ(i * 10, readBlock(buffer, 10));
+	}
+	{
+		SpillBuffer buffer(m_dir, 256 * 1024);
+		ASSERT_EQ(100UL, buffer.size());
+		for (int i = 10; i < 20; i++)
+			ASSERT_EQ(i * 10, readBlock(buffer, 10));
+		ASSERT_TRUE(buffer.empty());
+	}
+	ASSERT_EQ(0UL, discarded);
+}
+
+TEST_F(SpillBufferTest, PartialRecord)
+{
+	unsigned long discarded = 0;
+	{
+		SpillBuffer buffer(m_dir, 1024 * 1024);
+		for (int i = 0; i < 2; i++)
+		{
+			vector<Reading *> readings = block(i * 10, 10);
+			ASSERT_TRUE(buffer.append(readings, discarded));
+			free(readings);
+		}
+	}
+	ASSERT_EQ(1U, segments().size());
+
+	// The service stopped part way through writing the last record
+	string path = segments()[0];
+	size_t last = lastRecord(path);
+	ASSERT_NE(string::npos, last);
+	ASSERT_EQ(0, truncate(path.c_str(), last + sizeof(SpillRecordHeader) + 10));
+
+	{
+		SpillBuffer buffer(m_dir, 1024 * 1024);
+		ASSERT_EQ(10UL, buffer.size());
+
+		// Appends after the recovery overwrite the partial record
+		vector<Reading *> readings = block(100, 5);
+		ASSERT_TRUE(buffer.append(readings, discarded));
+		free(readings);
+	}
+	SpillBuffer buffer(m_dir, 1024 * 1024);
+	ASSERT_EQ(15UL, buffer.size());
+	ASSERT_EQ(0, readBlock(buffer, 10));
+	ASSERT_EQ(100, readBlock(buffer, 5));
+	ASSERT_TRUE(buffer.empty());
+}
+
+TEST_F(SpillBufferTest, CorruptRecord)
+{
+	unsigned long discarded = 0;
+	{
+		SpillBuffer buffer(m_dir, 1024 * 1024);
+		for (int i = 0; i < 3; i++)
+		{
+			vector<Reading *> readings = block(i * 10, 10);
+			ASSERT_TRUE(buffer.append(readings, discarded));
+			free(readings);
+		}
+	}
+
+	// Damage the body of the last record, it fails the checksum
+	string path = segments()[0];
+	size_t last = lastRecord(path);
+	ASSERT_NE(string::npos, last);
+	FILE *fp = fopen(path.c_str(), "r+");
+	ASSERT_NE(nullptr, fp);
+	fseek(fp, last + sizeof(SpillRecordHeader) + 4, SEEK_SET);
+	fputc(0xff, fp);
+	fclose(fp);
+
+	SpillBuffer buffer(m_dir, 1024 * 1024);
+	ASSERT_EQ(20UL, buffer.size());
+	ASSERT_EQ(0, readBlock(buffer, 10));
+	ASSERT_EQ(10, readBlock(buffer, 10));
+	ASSERT_EQ(-1, readBlock(buffer, 10));
+}
+
+TEST_F(SpillBufferTest, InvalidSegment)
+{
+	// A file that is not a segment is removed when the buffer is recovered
+	string path = m_dir + "/segment-00000007.spill";
+	FILE *fp = fopen(path.c_str(), "w");
+	ASSERT_NE(nullptr, fp);
+	for (int i = 0; i < 100; i++)
+		fputs("not a spill buffer segment\n", fp);
+	fclose(fp);
+
+	SpillBuffer buffer(m_dir, 1024 * 1024);
+	ASSERT_TRUE(buffer.empty());
+	ASSERT_TRUE(segments().empty());
+
+	unsigned long discarded = 0;
+	vector<Reading *> readings = block(0, 10);
+	ASSERT_TRUE(buffer.append(readings, discarded));
+	free(readings);
+	ASSERT_EQ(0, readBlock(buffer, 10));
+}
+
+TEST_F(SpillBufferTest, SizeLimit)
+{
+	// The smallest segments, four of which make up the limit
+	const size_t limit = 4 * SPILL_MIN_SEGMENT_SIZE;
+	SpillBuffer buffer(m_dir, limit);
+	unsigned long discarded = 0;
+	long appended = 0;
+
+	for (int i = 0; i < 100; i++)
+	{
+		vector<Reading *> readings = block(appended, 10, 1000);
+		ASSERT_TRUE(buffer.append(readings, discarded));
+		free(readings);
+		appended += 10;
+	}
+
+	// The oldest readings were discarded to keep within the limit
+	ASSERT_GT(discarded, 0UL);
+	ASSERT_EQ((unsigned long)appended, buffer.size() + discarded);
+	size_t used = 0;
+	for (auto& file : segments())
+	{
+		ifstream segment(file, ios::binary | ios::ate);
+		used += segment.tellg();
+	}
+	ASSERT_LE(used, limit);
+
+	// The readings that remain are the newest, still in order
+	long expected = discarded;
+	while (!buffer.empty())
+	{
+		ASSERT_EQ(expected, readBlock(buffer, 10));
+		expected += 10;
+	}
+	ASSERT_EQ(appended, expected);
+}
+
+TEST_F(SpillBufferTest, LongAssetName)
+{
+	// An asset name too long for a 16 bit length
+	string asset(70000, 'a');
+	unsigned long discarded = 0;
+	{
+		SpillBuffer buffer(m_dir, 1024 * 1024);
+		vector<Reading *> readings;
+		readings.push_back(new Reading(asset, new Datapoint("seq", DatapointValue(7L))));
+		ASSERT_TRUE(buffer.append(readings, discarded));
+		free(readings);
+	}
+
+	SpillBuffer buffer(m_dir, 1024 * 1024);
+	vector<Reading *> *readings = buffer.read();
+	ASSERT_NE(nullptr, readings);
+	ASSERT_EQ(1U, readings->size());
+	EXPECT_EQ(asset, (*readings)[0]->getAssetName());
+	EXPECT_EQ(7, (*readings)[0]->getDatapoint("seq")->getData().toInt());
+	free(*readings);
+	delete readings;
+}
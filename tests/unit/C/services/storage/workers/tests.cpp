@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <storage_workers.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+/**
+ * A gate that blocks the requests that pass through it until it is opened
+ */
+class Gate {
+	public:
+		Gate() : m_open(false), m_waiting(0) {};
+		void	pass()
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_waiting++;
+			m_cv.notify_all();
+			m_cv.wait(lock, [this] { return m_open; });
+			m_waiting--;
+		};
+		void	open()
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_open = true;
+			m_cv.notify_all();
+		};
+		bool	waitFor(int waiting)
+		{
+			unique_lock<mutex> lock(m_mutex);
+			return m_cv.wait_for(lock, chrono::seconds(5),
+					[this, waiting] { return m_waiting == waiting; });
+		};
+	private:
+		mutex			m_mutex;
+		condition_variable	m_cv;
+		bool			m_open;
+		int			m_waiting;
+};
+
+TEST(StorageWorkers, PriorityOrder)
+{
+	Gate gate;
+	mutex orderMutex;
+	string order;
+	{
+		StorageWorkers workers(1, 10);
+		ASSERT_EQ(1U, workers.threads());
+
+		// Occupy the only worker while the requests are queued
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&gate] { gate.pass(); }));
+		ASSERT_TRUE(gate.waitFor(1));
+		auto record = [&orderMutex, &order](char c) {
+			lock_guard<mutex> guard(orderMutex);
+			order += c;
+		};
+		ASSERT_TRUE(workers.submit(StorageWorkers::Low, [&record] { record('L'); }));
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&record] { record('N'); }));
+		ASSERT_TRUE(workers.submit(StorageWorkers::High, [&record] { record('H'); }));
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&record] { record('n'); }));
+		ASSERT_EQ(4U, workers.queued());
+		gate.open();
+	}
+	ASSERT_EQ("HNnL", order);
+}
+
+TEST(StorageWorkers, LowPriorityCap)
+{
+	Gate lowGate, highGate;
+	StorageWorkers workers(3, 10);
+
+	// Only two of the three workers may run low priority requests
+	for (int i = 0; i < 3; i++)
+		ASSERT_TRUE(workers.submit(StorageWorkers::Low, [&lowGate] { lowGate.pass(); }));
+	ASSERT_TRUE(lowGate.waitFor(2));
+	ASSERT_EQ(1U, workers.queued());
+	ASSERT_EQ(2U, workers.active());
+
+	// The free worker still takes other requests
+	ASSERT_TRUE(workers.submit(StorageWorkers::High, [&highGate] { highGate.pass(); }));
+	ASSERT_TRUE(highGate.waitFor(1));
+	ASSERT_EQ(1U, workers.queued());
+	highGate.open();
+
+	// The held back request runs once a low priority request completes
+	lowGate.open();
+	for (int i = 0; i < 500 && (workers.queued() || workers.active()); i++)
+		this_thread::sleep_for(chrono::milliseconds(10));
+	ASSERT_EQ(0U, workers.queued());
+	ASSERT_EQ(0U, workers.active());
+}
+
+TEST(StorageWorkers, SingleThreadRunsLow)
+{
+	StorageWorkers workers(1, 10);
+	mutex m;
+	condition_variable cv;
+	bool done = false;
+	ASSERT_TRUE(workers.submit(StorageWorkers::Low, [&] {
+		lock_guard<mutex> guard(m);
+		done = true;
+		cv.notify_all();
+	}));
+	unique_lock<mutex> lock(m);
+	ASSERT_TRUE(cv.wait_for(lock, chrono::seconds(5), [&done] { return done; }));
+}
+
+TEST(StorageWorkers, QueueFull)
+{
+	Gate gate;
+	StorageWorkers workers(1, 2);
+	ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&gate] { gate.pass(); }));
+	ASSERT_TRUE(gate.waitFor(1));
+	ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [] {}));
+	ASSERT_TRUE(workers.submit(StorageWorkers::High, [] {}));
+	ASSERT_FALSE(workers.submit(StorageWorkers::High, [] {}));
+	ASSERT_EQ(1UL, workers.rejected());
+	gate.open();
+}
+
+TEST(StorageWorkers, ShutdownDrainsQueue)
+{
+	Gate gate;
+	atomic<int> executed(0);
+	{
+		StorageWorkers workers(2, 100);
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&gate] { gate.pass(); }));
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&gate] { gate.pass(); }));
+		ASSERT_TRUE(gate.waitFor(2));
+		for (int i = 0; i < 50; i++)
+		{
+			StorageWorkers::Priority priority = (StorageWorkers::Priority)(i % StorageWorkers::NumPriorities);
+			ASSERT_TRUE(workers.submit(priority, [&executed] { executed++; }));
+		}
+		gate.open();
+	}
+	ASSERT_EQ(50, executed.load());
+}
+
+TEST(StorageWorkers, FailedRequest)
+{
+	atomic<int> executed(0);
+	{
+		StorageWorkers workers(1, 10);
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [] { throw runtime_error("failed"); }));
+		ASSERT_TRUE(workers.submit(StorageWorkers::Normal, [&executed] { executed++; }));
+	}
+	ASSERT_EQ(1, executed.load());
+}